@@ -1,17 +1,152 @@
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "globals.h"
 #include "minimidi.h"
 #include "minimidi-tui.h"
 #include "minimidi-log.h"
+#include "minimidi-player.h"
+#include "minimidi-synth.h"
+#include "minimidi-capture.h"
+#include "minimidi-index.h"
+#include "minimidi-export.h"
+#include "minimidi-transform.h"
+#include "minimidi-writer.h"
+#include "minimidi-polyphony.h"
+#include "minimidi-search.h"
+#include "minimidi-fingerprint.h"
+#include "minimidi-workspace.h"
+#include "minimidi-daemon.h"
 
-#define ARG_MAX_LEN 100
+#define ARG_MAX_LEN PATH_MAX
+#define PATTERN_MAX_LEN 64
 
-void quit( MiniMidi_TUI *ui, MiniMidi_File *f, int is_error )
+static const char *usage = "usage: minimidi [-o sink] [-P] [-w out.wav] [-j threads] file.mid\n"
+    "       minimidi [-o sink] [-M mb] file.mid...\n"
+    "       minimidi [-o sink] -c source\n"
+    "       minimidi -x out file.mid...\n"
+    "       minimidi [-r range] -t transform [-t transform...] -s out.mid file.mid\n"
+    "       minimidi -V voices file.mid\n"
+    "       minimidi -I index.mmi file.mid...\n"
+    "       minimidi -Q pattern -I index.mmi | -Q pattern file.mid\n"
+    "       minimidi -D similarity [-j threads] file.mid|dir...\n"
+    "       minimidi -F filter ... file.mid...\n"
+    "       minimidi -S ... file.mid...\n"
+    "       minimidi -L socket [-M mb]\n"
+    "       minimidi -a socket [-F filter] file.mid\n"
+    TAB "-o sink  send playback to sink: a path / FIFO, or alsa:<device>\n"
+    TAB "-P       play to the sink without the UI, then print timing stats\n"
+    TAB "-w wav   render the file offline to a WAV and exit\n"
+    TAB "-j n     threads used to render voices with -w, or to fingerprint with -D\n"
+    TAB "-c src   capture raw MIDI from src (FIFO, rawmidi device) and follow it live\n"
+    TAB "-x out   export the events of every file as columns to the directory out,\n"
+    TAB "         or as CSV when out ends in .csv\n"
+    TAB "-t spec  transform, applied in order: transpose:semitones[:low:high],\n"
+    TAB "         quantize:grid[:strength[:swing[:ends]]], velocity:scale[:threshold:ratio],\n"
+    TAB "         stretch:factor\n"
+    TAB "-r range only transform notes starting in start:end:low:high (ticks, pitches)\n"
+    TAB "-s out   write the transformed file to out\n"
+    TAB "-V n     print peak polyphony and where more than n voices sound\n"
+    TAB "-I index build a melodic search index over the files, or query it with -Q\n"
+    TAB "-Q pat   find a melody by its intervals in semitones, 2,2,1,2 or with rhythm\n"
+    TAB "         steps (log2 of gap ratios, * for any) 2,2,1,2/0,1,*. <n> <N> jump in the UI\n"
+    TAB "-D sim   group files whose notes match, ignoring transposition and tempo, when\n"
+    TAB "         their estimated similarity is at least sim (0 - 1, 0.8 is a good start)\n"
+    TAB "-F spec  only read some events: classes (notes, on, off, polytouch, cc, program,\n"
+    TAB "         touch, bend, system) and any of :ch=1,10 :ticks=start-end :pitch=low-high\n"
+    TAB "-S       strict: refuse damaged files instead of reading what is there\n"
+    TAB "-M mb    several files open as tabs, <tab> switches. what the ones not on screen\n"
+    TAB "         may take, parsed or packed, in MB (256). with -L what the daemon keeps (1024)\n"
+    TAB "-L sock  parse daemon: parse each file once for every viewer on the host, serve\n"
+    TAB "         it as shared memory on the Unix socket sock, until ctrl-c\n"
+    TAB "-a sock  view the file from the daemon at sock, $" MINIMIDI_DAEMON_ENV " too; read here\n"
+    TAB "         when it can't be had\n";
+
+// the daemon runs until this is set
+static volatile sig_atomic_t _is_stopping = 0;
+
+static void _stop( int sig )
+{
+    _is_stopping = 1;
+}
+
+// the file as parsed by the daemon at socket_path, read-only. NULL, telling why, if it can't be had
+static MiniMidi_Lazy_File *_ask_daemon( const char *socket_path, const char *path, const MiniMidi_Filter *filter )
+{
+    MiniMidi_Parse_Status status;
+    MiniMidi_Lazy_File *lazy = NULL;
+    int fd = MiniMidi_Daemon_request( socket_path, path, &status );
+
+    if (fd >= 0) {
+        lazy = MiniMidi_Lazy_File_init_shared( path, fd, 0 );
+        close( fd );
+    }
+
+    if (!lazy) {
+        printf(YELLOW "WARNING" RESET " Nothing from the daemon at %s: %s, reading the file here.\n", socket_path,
+            status != MINIMIDI_PARSE_OK ? MiniMidi_Parse_Status_str( status ) : "not answering");
+    } else if (filter) {
+        MiniMidi_Lazy_File_set_filter( lazy, filter );
+    }
+
+    return lazy;
+}
+
+// read path, telling why it can't be, or what had to be left out
+static MiniMidi_File *_read_file( char *path, const MiniMidi_Filter *filter, bool strict )
+{
+    MiniMidi_Parse_Error error;
+    MiniMidi_File *f = MiniMidi_File_init_checked( path, filter, !strict, &error );
+
+    if (!f) {
+        printf(RED "ERROR" RESET " Failed to read MIDI file: %s: %s", path, MiniMidi_Parse_Status_str( error.status ));
+    } else if (error.status != MINIMIDI_PARSE_OK) {
+        printf(YELLOW "WARNING" RESET " %s: %s", path, MiniMidi_Parse_Status_str( error.status ));
+    }
+
+    if (error.status == MINIMIDI_PARSE_CUT_CHUNK) {
+        printf( " in track %zu at byte %zu%s\n", error.track, error.offset, f ? ", kept what is there" : "" );
+    } else if (error.status > MINIMIDI_PARSE_CUT_CHUNK) {
+        printf( " in track %zu at byte %zu, after %zu events%s\n", error.track, error.offset, error.n_events,
+            f ? ", kept what came before" : "" );
+    } else if (error.status != MINIMIDI_PARSE_OK) {
+        printf( "\n" );
+    }
+
+    return f;
+}
+
+// before the UI takes over: whatever owns the file lets go of it
+static void _release( MiniMidi_File *f, MiniMidi_Capture *capture, MiniMidi_Lazy_File *lazy, MiniMidi_Workspace *workspace )
+{
+    if (capture)
+        MiniMidi_Capture_free( capture );
+    else if (lazy)
+        MiniMidi_Lazy_File_free( lazy );
+    else if (workspace)
+        MiniMidi_Workspace_free( workspace );
+    else
+        MiniMidi_File_free( f );
+
+    MiniMidi_Log_free();
+}
+
+void quit( MiniMidi_TUI *ui, MiniMidi_File *f, MiniMidi_Capture *capture, MiniMidi_Lazy_File *lazy, int is_error )
 {   
     MiniMidi_TUI_destroy(ui);
-    MiniMidi_File_free( f );
+
+    // a capture or a lazy file owns its file
+    if (capture)
+        MiniMidi_Capture_free( capture );
+    else if (lazy)
+        MiniMidi_Lazy_File_free( lazy );
+    else
+        MiniMidi_File_free( f );
+
     if (is_error)
     {
         printf(RED "ERROR" RESET "Houston we have a problem...");
@@ -23,16 +158,204 @@ void quit( MiniMidi_TUI *ui, MiniMidi_File *f, int is_error )
  */
 int main( int argc, char *argv[] )
 {
+    char *sink_spec = NULL;
+    char *wav_path = NULL;
+    char *capture_src = NULL;
+    char *export_path = NULL;
+    char *save_path = NULL;
+    MiniMidi_Transform chain[ MINIMIDI_TRANSFORM_MAX_CHAIN ];
+    int n_chain = 0;
+    int voice_limit = 0;
+    double dedup_threshold = -1;
+    char *index_path = NULL;
+    char *pattern = NULL;
+    int intervals[ PATTERN_MAX_LEN ], rhythm[ PATTERN_MAX_LEN ];
+    size_t n_intervals = 0;
+    bool has_rhythm = false;
+    MiniMidi_Scope scope, *scope_arg = NULL;
+    MiniMidi_Filter filter, *filter_arg = NULL;
+    bool headless_play = false;
+    bool strict = false;
+    int render_threads = 1;
+    long budget_mb = 0;
+    char *listen_path = NULL;
+    char *daemon_path = NULL;
+    int opt;
+
+    while ((opt = getopt( argc, argv, "o:Pw:j:c:x:t:r:s:V:I:Q:D:F:SM:L:a:" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'L':
+                listen_path = optarg;
+                break;
+            case 'a':
+                daemon_path = optarg;
+                break;
+            case 'F':
+                if (MiniMidi_Filter_parse( &filter, optarg )) {
+                    printf(RED "ERROR" RESET " Bad filter: %s\n", optarg);
+                    return 1;
+                }
+                filter_arg = &filter;
+                break;
+            case 'D':
+                dedup_threshold = atof( optarg );
+                if (dedup_threshold <= 0 || dedup_threshold > 1) {
+                    printf(RED "ERROR" RESET " -D needs a similarity between 0 and 1.\n");
+                    return 1;
+                }
+                break;
+            case 'I':
+                index_path = optarg;
+                break;
+            case 'Q':
+                if (MiniMidi_Search_parse( optarg, intervals, rhythm, PATTERN_MAX_LEN, &n_intervals, &has_rhythm )) {
+                    printf(RED "ERROR" RESET " Bad pattern: %s, needs %d intervals or more\n", optarg, MINIMIDI_SEARCH_GRAM);
+                    return 1;
+                }
+                pattern = optarg;
+                break;
+            case 'V':
+                voice_limit = atoi( optarg );
+                if (voice_limit <= 0) {
+                    printf(RED "ERROR" RESET " -V needs a voice count.\n");
+                    return 1;
+                }
+                break;
+            case 't':
+                if (n_chain == MINIMIDI_TRANSFORM_MAX_CHAIN || MiniMidi_Transform_parse( &chain[ n_chain ], optarg )) {
+                    printf(RED "ERROR" RESET " Bad transform: %s\n", optarg);
+                    return 1;
+                }
+                n_chain++;
+                break;
+            case 'r':
+            {
+                unsigned long long start, end;
+                if (sscanf( optarg, "%llu:%llu:%d:%d", &start, &end, &scope.start_note, &scope.end_note ) != 4) {
+                    printf(RED "ERROR" RESET " Bad range: %s\n", optarg);
+                    return 1;
+                }
+                scope.start_ticks = start;
+                scope.end_ticks = end;
+                scope_arg = &scope;
+                break;
+            }
+            case 's':
+                save_path = optarg;
+                break;
+            case 'x':
+                export_path = optarg;
+                break;
+            case 'w':
+                wav_path = optarg;
+                break;
+            case 'j':
+                render_threads = atoi( optarg );
+                break;
+            case 'c':
+                capture_src = optarg;
+                break;
+            case 'o':
+                sink_spec = optarg;
+                break;
+            case 'P':
+                headless_play = true;
+                break;
+            case 'S':
+                strict = true;
+                break;
+            case 'M':
+                budget_mb = atol( optarg );
+                if (budget_mb <= 0) {
+                    printf(RED "ERROR" RESET " -M needs megabytes.\n");
+                    return 1;
+                }
+                break;
+            default:
+                printf( "%s", usage );
+                return 1;
+        }
+    }
+
     // Catch Args
-    if (argc < 2){
-        printf(RED "ERROR" RESET " please supply args.\n");
+    if (optind >= argc && !capture_src && !(pattern && index_path) && !listen_path){
+        printf(RED "ERROR" RESET " please supply args.\n%s", usage);
+        return 1;
+    }
+
+    if (listen_path && (optind < argc || daemon_path || filter_arg || strict || dedup_threshold > 0 || index_path || pattern || voice_limit
+        || export_path || save_path || capture_src || wav_path || sink_spec || headless_play)){
+        printf(RED "ERROR" RESET " -L runs on its own, or with -M.\n");
+        return 1;
+    }
+
+    if (dedup_threshold > 0 && (index_path || pattern || voice_limit || export_path || save_path || capture_src || wav_path || sink_spec || headless_play)){
+        printf(RED "ERROR" RESET " -D only works with -j.\n");
+        return 1;
+    }
+
+    if ((index_path || pattern) && (voice_limit || export_path || save_path || capture_src || wav_path || headless_play)){
+        printf(RED "ERROR" RESET " -I and -Q only go with each other, or -Q with -o.\n");
+        return 1;
+    }
+
+    if (pattern && index_path && optind < argc){
+        printf(RED "ERROR" RESET " -Q with -I searches the index, leave out the files.\n");
         return 1;
     }
 
-    size_t sizeofarg = strlen(argv[1]);
-    if (sizeofarg > ARG_MAX_LEN){
+    if (voice_limit && (export_path || save_path || capture_src || wav_path || sink_spec)){
+        printf(RED "ERROR" RESET " -V works on its own.\n");
+        return 1;
+    }
+
+    if (export_path && (capture_src || wav_path || sink_spec)){
+        printf(RED "ERROR" RESET " -x can't be combined with -c, -o or -w.\n");
+        return 1;
+    }
+
+    if ((n_chain || save_path) && (!n_chain || !save_path || export_path || capture_src || wav_path || sink_spec)){
+        printf(RED "ERROR" RESET " -t and -s go together, without -x, -c, -o or -w.\n");
+        return 1;
+    }
+
+    if (filter_arg && (capture_src || dedup_threshold > 0 || (pattern && index_path))){
+        printf(RED "ERROR" RESET " -F only applies to files being read, not -c, -D or an index query.\n");
+        return 1;
+    }
+
+    if (capture_src && (wav_path || headless_play)){
+        printf(RED "ERROR" RESET " -c only works with the UI.\n");
+        return 1;
+    }
+
+    // more than one file for the UI, they open as tabs
+    bool is_workspace = optind + 1 < argc && !(export_path || index_path || pattern || dedup_threshold > 0
+        || voice_limit || save_path || capture_src || wav_path || headless_play);
+
+    if (budget_mb && !is_workspace && !listen_path){
+        printf(RED "ERROR" RESET " -M goes with several files in the UI, or -L.\n");
+        return 1;
+    }
+
+    if (daemon_path && (is_workspace || strict || export_path || index_path || pattern || dedup_threshold > 0 || voice_limit
+        || save_path || capture_src || wav_path || sink_spec || headless_play)){
+        printf(RED "ERROR" RESET " -a only shows one file in the UI, without -S, -o, -w, -P, -c or -Q.\n");
+        return 1;
+    }
+
+    // what was exported for the session, when it applies
+    if (!daemon_path && !strict && !is_workspace && !capture_src && !wav_path && !sink_spec && !headless_play && !pattern)
+        daemon_path = getenv( MINIMIDI_DAEMON_ENV );
+
+    char *file_arg = capture_src ? capture_src : optind < argc ? argv[optind] : index_path ? index_path : listen_path;
+    bool is_too_long = strlen( file_arg ) >= ARG_MAX_LEN;
+    for (int i = optind; i < argc; i++) is_too_long = is_too_long || strlen( argv[i] ) >= ARG_MAX_LEN;
+    if (is_too_long){
         
-        printf(RED "ERROR" RESET " Too many args.\n");
+        printf(RED "ERROR" RESET " Path too long.\n");
         return 1;
     }
     
@@ -44,6 +367,247 @@ int main( int argc, char *argv[] )
     sprintf( MiniMidi_Log_log_line, "main: initting." );
     MiniMidi_Log_writeline();
 
+    if (listen_path)
+    {
+        MiniMidi_Daemon *daemon = MiniMidi_Daemon_init( listen_path, (size_t)budget_mb * 1024 * 1024 );
+        struct sigaction sa;
+        int err;
+
+        if (!daemon) {
+            printf(RED "ERROR" RESET " Failed to listen on: %s\n", listen_path);
+            MiniMidi_Log_free();
+            return 1;
+        }
+
+        memset( &sa, 0, sizeof( sa ) );
+        sa.sa_handler = _stop;
+        sigemptyset( &sa.sa_mask );
+        sigaction( SIGINT, &sa, NULL );
+        sigaction( SIGTERM, &sa, NULL );
+
+        printf( "serving on %s, ctrl-c to stop\n", listen_path );
+        err = MiniMidi_Daemon_run( daemon, &_is_stopping );
+        printf( "%zu parsed, %zu served from memory\n", daemon->n_builds, daemon->n_hits );
+
+        MiniMidi_Daemon_free( daemon );
+        MiniMidi_Log_free();
+        return err;
+    }
+
+    if (export_path)
+    {
+        size_t len = strlen( export_path );
+        bool is_csv = len > 4 && strcmp( export_path + len - 4, ".csv" ) == 0;
+        MiniMidi_Export *export = MiniMidi_Export_init( export_path, is_csv ? MINIMIDI_EXPORT_CSV : MINIMIDI_EXPORT_COLUMNS );
+        int err = 0;
+
+        if (!export) {
+            printf(RED "ERROR" RESET " Failed to write to: %s\n", export_path);
+            MiniMidi_Log_free();
+            return 1;
+        }
+
+        // one file in memory at a time
+        for (int i = optind; i < argc; i++)
+        {
+            MiniMidi_File *f = _read_file( argv[i], filter_arg, strict );
+            if (!f) {
+                err = 1;
+                continue;
+            }
+            err |= MiniMidi_Export_file( export, f );
+            MiniMidi_File_free( f );
+        }
+
+        if (MiniMidi_Export_close( export )) {
+            printf(RED "ERROR" RESET " Failed to write to: %s\n", export_path);
+            err = 1;
+        }
+        MiniMidi_Log_free();
+        return err;
+    }
+
+    if (dedup_threshold > 0)
+    {
+        MiniMidi_Dedup *dedup = MiniMidi_Dedup_init();
+        int err = !dedup;
+
+        for (int i = optind; i < argc && dedup; i++)
+        {
+            if (MiniMidi_Dedup_add( dedup, argv[i] )) {
+                printf(RED "ERROR" RESET " Failed to read: %s\n", argv[i]);
+                err = 1;
+            }
+        }
+
+        if (dedup && MiniMidi_Dedup_run( dedup, render_threads > 0 ? render_threads : 1, dedup_threshold )) {
+            printf(RED "ERROR" RESET " Out of memory.\n");
+            MiniMidi_Dedup_free( dedup );
+            dedup = NULL;
+            err = 1;
+        }
+
+        // every group under its first file, then the files that couldn't be read
+        for (size_t i = 0; dedup && i < dedup->n_files; i++)
+        {
+            if (dedup->group[i] != i || dedup->next[i] == UINT32_MAX) continue;
+
+            printf( "%s\n", dedup->paths[i] );
+            for (uint32_t j = dedup->next[i]; j != UINT32_MAX; j = dedup->next[j])
+            {
+                printf( TAB "%s" TAB "%.2f\n", dedup->paths[j],
+                    MiniMidi_Fingerprint_similarity( &(dedup->prints[i]), &(dedup->prints[j]) ) );
+            }
+        }
+
+        for (size_t i = 0; dedup && i < dedup->n_files; i++)
+        {
+            if (dedup->failed[i]) printf(RED "ERROR" RESET " Failed to read MIDI file: %s\n", dedup->paths[i]);
+        }
+
+        if (dedup) printf( "%zu files, %zu duplicate groups\n", dedup->n_files, dedup->n_groups );
+
+        MiniMidi_Dedup_free( dedup );
+        MiniMidi_Log_free();
+        return err;
+    }
+
+    if (index_path && !pattern)
+    {
+        MiniMidi_Search_Builder *builder = MiniMidi_Search_Builder_init();
+        MiniMidi_Search_Index *index;
+        int err = !builder;
+
+        // one file in memory at a time
+        for (int i = optind; i < argc && builder; i++)
+        {
+            MiniMidi_File *f = _read_file( argv[i], filter_arg, strict );
+            if (!f) {
+                err = 1;
+                continue;
+            }
+            err |= MiniMidi_Search_Builder_add( builder, f );
+            MiniMidi_File_free( f );
+        }
+
+        index = builder ? MiniMidi_Search_Builder_finish( builder ) : NULL;
+        if (!index || MiniMidi_Search_Index_write( index, index_path )) {
+            printf(RED "ERROR" RESET " Failed to write index: %s\n", index_path);
+            err = 1;
+        } else {
+            printf( "%u files, %zu grams, %zu keys\n", index->n_files, index->n_postings, index->n_keys );
+        }
+
+        MiniMidi_Search_Index_free( index );
+        MiniMidi_Log_free();
+        return err;
+    }
+
+    if (index_path)
+    {
+        MiniMidi_Search_Index *index = MiniMidi_Search_Index_open( index_path );
+        uint64_t *refs;
+        size_t n_refs;
+
+        if (!index) {
+            printf(RED "ERROR" RESET " Failed to open index: %s\n", index_path);
+            MiniMidi_Log_free();
+            return 1;
+        }
+
+        refs = MiniMidi_Search_query( index, intervals, has_rhythm ? rhythm : NULL, n_intervals, &n_refs );
+        for (size_t i = 0; i < n_refs; i++)
+        {
+            printf( "%s" TAB "track %u" TAB "onset %u\n", MiniMidi_Search_Index_path( index, MINIMIDI_SEARCH_REF_FILE( refs[i] ) ),
+                MINIMIDI_SEARCH_REF_TRACK( refs[i] ), MINIMIDI_SEARCH_REF_POS( refs[i] ) );
+        }
+        printf( "%zu matches for %s\n", n_refs, pattern );
+
+        free( refs );
+        MiniMidi_Search_Index_free( index );
+        MiniMidi_Log_free();
+        return 0;
+    }
+
+    if (voice_limit)
+    {
+        MiniMidi_File *f = _read_file( file_arg, filter_arg, strict );
+        MiniMidi_Polyphony *poly = f ? MiniMidi_Polyphony_init( f ) : NULL;
+        MiniMidi_Voice_Region *over;
+        size_t n_over;
+
+        if (!poly) {
+            MiniMidi_File_free( f );
+            MiniMidi_Log_free();
+            return 1;
+        }
+
+        printf( "peak polyphony: %u voices at tick %lu (%.3f s)\n", poly->total.peak,
+            (unsigned long)poly->total.peak_ticks, MiniMidi_File_ticks_to_usec( f, poly->total.peak_ticks ) / 1e6 );
+
+        for (int c = 0; c < 16; c++)
+        {
+            if (poly->channels[c].peak) printf( TAB "channel %2d: %u\n", c + 1, poly->channels[c].peak );
+        }
+
+        over = MiniMidi_Voice_Curve_over( &(poly->total), voice_limit, &n_over );
+        printf( "%zu regions over %d voices\n", n_over, voice_limit );
+
+        for (size_t i = 0; i < n_over; i++)
+        {
+            printf( TAB "ticks %lu - %lu (%.3f - %.3f s): %u voices\n",
+                (unsigned long)over[i].start_ticks, (unsigned long)over[i].end_ticks,
+                MiniMidi_File_ticks_to_usec( f, over[i].start_ticks ) / 1e6,
+                MiniMidi_File_ticks_to_usec( f, over[i].end_ticks ) / 1e6,
+                over[i].peak );
+        }
+
+        free( over );
+        MiniMidi_Polyphony_free( poly );
+        MiniMidi_File_free( f );
+        MiniMidi_Log_free();
+        return 0;
+    }
+
+    if (save_path)
+    {
+        // parsed whole, not a track at a time as it is read: the tempo map folds in every track's
+        // tempo changes before the first one is written, and -S checks the whole file. the
+        // transformed tracks still go out and are let go of one by one
+        MiniMidi_File *f = _read_file( file_arg, filter_arg, strict );
+        int err = 0;
+
+        if (!f) {
+            MiniMidi_Log_free();
+            return 1;
+        }
+
+        for (int k = 0; k < n_chain && !err; k++) err = MiniMidi_Transform_tempo_map( f, &chain[k] );
+
+        MiniMidi_Writer *w = err ? NULL : MiniMidi_Writer_open( save_path, f->header->format, f->n_tracks, f->header->ppqn );
+
+        // one track at a time: transform it, write it, let it go
+        for (size_t t = 0; w && t < f->n_tracks && !err; t++)
+        {
+            MiniMidi_Track *track = &(f->tracks[t]);
+
+            for (int k = 0; k < n_chain && !err; k++) err = MiniMidi_Transform_apply( track, NULL, &chain[k], scope_arg );
+
+            err = err || MiniMidi_Writer_track( w, track, t ? NULL : track->tempo_arr, t ? 0 : track->n_tempos );
+
+            MiniMidi_Track_release( track );
+        }
+
+        if (!w || MiniMidi_Writer_close( w ) || err) {
+            printf(RED "ERROR" RESET " Failed to write: %s\n", save_path);
+            err = 1;
+        }
+
+        MiniMidi_File_free( f );
+        MiniMidi_Log_free();
+        return err;
+    }
+
     if (tmux)
     {
         printf("Running inside tmux. Launching a new tmux session...\n");
@@ -64,18 +628,139 @@ int main( int argc, char *argv[] )
 
 
 
-    // Read the file passed in by arg
-    MiniMidi_File *midi_file = MiniMidi_File_init( argv[1] );
+    MiniMidi_File *midi_file = NULL;
+    MiniMidi_Capture *capture = NULL;
+    MiniMidi_Lazy_File *lazy = NULL;
+    MiniMidi_Workspace *workspace = NULL;
+    struct stat st;
+
+    if (capture_src)
+    {
+        // Record from the source into a growing track
+        int fd = MiniMidi_Capture_open_source( capture_src );
+        capture = MiniMidi_Capture_init( capture_src, 0 );
+
+        if (fd < 0 || !capture || MiniMidi_Capture_start( capture, fd )) {
+            printf(RED "ERROR" RESET " Failed to capture from: %s\n", capture_src);
+            if (fd >= 0) close( fd );
+            _release( NULL, capture, NULL, NULL );
+            return 1;
+        }
+        midi_file = capture->file;
+
+    } else if (is_workspace) {
+        // Every file as a tab, read when it is first shown. start on the first one that reads
+        workspace = MiniMidi_Workspace_init( (size_t)budget_mb * 1024 * 1024, filter_arg, strict );
 
+        for (int i = optind; workspace && i < argc; i++)
+        {
+            if (MiniMidi_Workspace_add( workspace, argv[i] )) {
+                MiniMidi_Workspace_free( workspace );
+                workspace = NULL;
+            }
+        }
 
+        for (size_t i = 0; workspace && !midi_file && i < workspace->n_entries; i++)
+        {
+            midi_file = MiniMidi_Workspace_open( workspace, i );
+            if (!midi_file) {
+                printf(YELLOW "WARNING" RESET " Failed to read MIDI file: %s: %s\n", workspace->entries[i].path,
+                    MiniMidi_Parse_Status_str( workspace->error.status ));
+            }
+        }
+        if (!midi_file) {
+            MiniMidi_Workspace_free( workspace );
+            workspace = NULL;
+        }
+
+    } else if (daemon_path && *daemon_path && (lazy = _ask_daemon( daemon_path, file_arg, filter_arg ))) {
+        // Parsed once for the whole host, only looked at here
+        midi_file = lazy->file;
+
+    } else if (!wav_path && !sink_spec && !headless_play && !pattern && stat( file_arg, &st ) == 0 && st.st_size >= MINIMIDI_LAZY_MIN_BYTES) {
+        // Too big to parse up front, only look at it
+        lazy = MiniMidi_Lazy_File_init( file_arg, 0 );
+        if (lazy && filter_arg) MiniMidi_Lazy_File_set_filter( lazy, filter_arg );
+        if (lazy) midi_file = lazy->file;
+
+    } else {
+        // Read the file passed in by arg
+        midi_file = _read_file( file_arg, filter_arg, strict );
+        if (midi_file == NULL) {
+            MiniMidi_Log_free();
+            return 1;
+        }
+    }
     
     if (midi_file == NULL) {
-        printf(RED "ERROR" RESET " Failed to read MIDI file: %s\n", argv[1]);
+        printf(RED "ERROR" RESET " Failed to read MIDI file: %s\n", file_arg);
+        MiniMidi_Log_free();
         return 1;
     }
 
+    if (wav_path)
+    {
+        MiniMidi_Synth_Config cfg;
+        MiniMidi_Synth_Config_default( &cfg );
+        cfg.n_threads = render_threads > 0 ? render_threads : 1;
+
+        int err = MiniMidi_Synth_render_wav( midi_file, &cfg, wav_path );
+        if (err) {
+            printf(RED "ERROR" RESET " Failed to render %s\n", wav_path);
+        }
+
+        _release( midi_file, capture, lazy, workspace );
+        return err;
+    }
+
+    MiniMidi_Sink *sink = NULL;
+    MiniMidi_Player *player = NULL;
+
+    if (sink_spec)
+    {
+        sink = MiniMidi_Sink_open( sink_spec );
+        if (!sink) {
+            printf(RED "ERROR" RESET " Failed to open sink: %s\n", sink_spec);
+            _release( midi_file, capture, lazy, workspace );
+            return 1;
+        }
+        player = MiniMidi_Player_init( midi_file, sink );
+    }
+
+    if (headless_play)
+    {
+        if (!player) {
+            printf(RED "ERROR" RESET " -P needs a sink, see -o.\n");
+            _release( midi_file, capture, lazy, workspace );
+            return 1;
+        }
+
+        MiniMidi_Player_start( player, 0 );
+        MiniMidi_Player_join( player );
+        MiniMidi_Player_report( player, stdout );
+
+        MiniMidi_Player_free( player );
+        MiniMidi_Sink_free( sink );
+        _release( midi_file, capture, lazy, workspace );
+        return 0;
+    }
+
     MiniMidi_TUI *ui = (MiniMidi_TUI*)malloc( sizeof( MiniMidi_TUI ) );
     MiniMidi_TUI_init(ui, midi_file );
+    MiniMidi_TUI_attach_player( ui, player );
+    MiniMidi_TUI_attach_lazy( ui, lazy );
+    MiniMidi_TUI_attach_workspace( ui, workspace );
+    MiniMidi_TUI_follow( ui, capture != NULL );
+
+    // a re-export of the file shows up without a restart
+    if (!capture && !lazy) MiniMidi_TUI_attach_watch( ui, MiniMidi_Watch_init( midi_file, filter_arg ) );
+
+    if (pattern)
+    {
+        size_t n_matches;
+        MiniMidi_Search_Match *matches = MiniMidi_Search_file( midi_file, intervals, has_rhythm ? rhythm : NULL, n_intervals, &n_matches );
+        MiniMidi_TUI_attach_matches( ui, matches, n_matches );
+    }
 
     int ERRSTATUS = 0;
 
@@ -85,7 +770,12 @@ int main( int argc, char *argv[] )
         ERRSTATUS = MiniMidi_TUI_update( ui );
     }
 
-    quit(ui, midi_file, ERRSTATUS ? true: false);
+    // stop playback before the file goes away
+    MiniMidi_Player_free( player );
+    MiniMidi_Sink_free( sink );
+
+    // the workspace went with the UI, the file with it
+    quit(ui, workspace ? NULL : midi_file, capture, lazy, ERRSTATUS ? true: false);
     
     MiniMidi_Log_free();
 
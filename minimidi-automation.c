@@ -0,0 +1,452 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "minimidi-automation.h"
+#include "minimidi-merge.h"
+#include "minimidi-log.h"
+
+// one slot per possible lane, in lane order
+#define _SLOT_CC 0
+#define _SLOT_PITCH_BEND ( 16 * 128 )
+#define _SLOT_CHAN_AFTERTOUCH ( _SLOT_PITCH_BEND + 16 )
+#define _SLOT_POLY_AFTERTOUCH ( _SLOT_CHAN_AFTERTOUCH + 16 )
+#define _N_SLOTS ( _SLOT_POLY_AFTERTOUCH + 16 * 128 )
+
+typedef struct _Point
+{
+    uint64_t abs_ticks;
+    int16_t  value;
+
+} _Point;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Encoding
+****************************************************************************************/
+// slot of the lane evt belongs to, -1 for anything else
+static int _slot_of( MiniMidi_Event *evt, int16_t *value )
+{
+    _Byte ch = evt->channel & 0x0F;
+
+    switch (evt->status_code)
+    {
+        case MIDI_CONTROL_CHANGE:
+            *value = evt->evt_data[1] & 0x7F;
+            return _SLOT_CC + ch * 128 + ( evt->evt_data[0] & 0x7F );
+        case MIDI_PITCH_BEND:
+            *value = (int16_t)( ( ( evt->evt_data[1] & 0x7F ) << 7 ) | ( evt->evt_data[0] & 0x7F ) ) - 8192;
+            return _SLOT_PITCH_BEND + ch;
+        case MIDI_CHAN_AFTERTOUCH:
+            *value = evt->evt_data[0] & 0x7F;
+            return _SLOT_CHAN_AFTERTOUCH + ch;
+        case MIDI_POLY_AFTERTOUCH:
+            *value = evt->evt_data[1] & 0x7F;
+            return _SLOT_POLY_AFTERTOUCH + ch * 128 + ( evt->evt_data[0] & 0x7F );
+        default:
+            return -1;
+    }
+}
+
+static void _lane_key( int slot, MiniMidi_Lane *lane )
+{
+    if (slot >= _SLOT_POLY_AFTERTOUCH)
+    {
+        lane->kind = MINIMIDI_LANE_POLY_AFTERTOUCH;
+        lane->channel = ( slot - _SLOT_POLY_AFTERTOUCH ) / 128;
+        lane->controller = ( slot - _SLOT_POLY_AFTERTOUCH ) % 128;
+    }
+    else if (slot >= _SLOT_CHAN_AFTERTOUCH)
+    {
+        lane->kind = MINIMIDI_LANE_CHAN_AFTERTOUCH;
+        lane->channel = slot - _SLOT_CHAN_AFTERTOUCH;
+        lane->controller = 0;
+    }
+    else if (slot >= _SLOT_PITCH_BEND)
+    {
+        lane->kind = MINIMIDI_LANE_PITCH_BEND;
+        lane->channel = slot - _SLOT_PITCH_BEND;
+        lane->controller = 0;
+    }
+    else
+    {
+        lane->kind = MINIMIDI_LANE_CC;
+        lane->channel = slot / 128;
+        lane->controller = slot % 128;
+    }
+}
+
+static inline size_t _put_varint( _Byte *out, uint64_t v )
+{
+    size_t n = 0;
+
+    while (v >= 0x80)
+    {
+        out[n++] = ( v & 0x7F ) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+static inline size_t _get_varint( const _Byte *in, uint64_t *v )
+{
+    size_t n = 0;
+    int shift = 0;
+
+    *v = 0;
+    do
+    {
+        *v |= (uint64_t)( in[n] & 0x7F ) << shift;
+        shift += 7;
+    } while (in[n++] & 0x80);
+
+    return n;
+}
+
+static int _lane_build( MiniMidi_Lane *lane, _Point *points, size_t n )
+{
+    lane->n_points = n;
+    lane->n_blocks = ( n + MINIMIDI_LANE_BLOCK_POINTS - 1 ) / MINIMIDI_LANE_BLOCK_POINTS;
+    lane->blocks = (MiniMidi_Lane_Block*)malloc( lane->n_blocks * sizeof( MiniMidi_Lane_Block ) );
+
+    // worst case: 10 bytes of tick delta, 3 of value delta
+    lane->deltas = (_Byte*)malloc( n * 13 + 1 );
+
+    for (lane->tree_size = 1; lane->tree_size < lane->n_blocks; lane->tree_size *= 2);
+    lane->tree_min = (int16_t*)malloc( 2 * lane->tree_size * sizeof( int16_t ) );
+    lane->tree_max = (int16_t*)malloc( 2 * lane->tree_size * sizeof( int16_t ) );
+
+    if (!lane->blocks || !lane->deltas || !lane->tree_min || !lane->tree_max) return 1;
+
+    lane->n_bytes = 0;
+    for (size_t b = 0; b < lane->n_blocks; b++)
+    {
+        MiniMidi_Lane_Block *block = &(lane->blocks[b]);
+        size_t first = b * MINIMIDI_LANE_BLOCK_POINTS,
+               last = first + MINIMIDI_LANE_BLOCK_POINTS < n ? first + MINIMIDI_LANE_BLOCK_POINTS : n;
+
+        block->abs_ticks = points[first].abs_ticks;
+        block->last_ticks = points[last - 1].abs_ticks;
+        block->value = block->min = block->max = points[first].value;
+        block->n_points = last - first;
+        block->offset = lane->n_bytes;
+
+        for (size_t i = first + 1; i < last; i++)
+        {
+            int32_t dv = points[i].value - points[i - 1].value;
+
+            lane->n_bytes += _put_varint( lane->deltas + lane->n_bytes, points[i].abs_ticks - points[i - 1].abs_ticks );
+            lane->n_bytes += _put_varint( lane->deltas + lane->n_bytes, ( (uint32_t)dv << 1 ) ^ (uint32_t)( dv >> 31 ) );
+
+            if (points[i].value < block->min) block->min = points[i].value;
+            if (points[i].value > block->max) block->max = points[i].value;
+        }
+
+        lane->tree_min[ lane->tree_size + b ] = block->min;
+        lane->tree_max[ lane->tree_size + b ] = block->max;
+    }
+
+    _Byte *shrunk = (_Byte*)realloc( lane->deltas, lane->n_bytes + 1 );
+    if (shrunk) lane->deltas = shrunk;
+
+    for (size_t b = lane->n_blocks; b < lane->tree_size; b++)
+    {
+        lane->tree_min[ lane->tree_size + b ] = INT16_MAX;
+        lane->tree_max[ lane->tree_size + b ] = INT16_MIN;
+    }
+    for (size_t i = lane->tree_size; i-- > 1; )
+    {
+        int16_t l = lane->tree_min[2 * i], r = lane->tree_min[2 * i + 1];
+        lane->tree_min[i] = l < r ? l : r;
+        l = lane->tree_max[2 * i];
+        r = lane->tree_max[2 * i + 1];
+        lane->tree_max[i] = l > r ? l : r;
+    }
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Lookups
+****************************************************************************************/
+static size_t _decode_block( MiniMidi_Lane *lane, size_t b, uint64_t *ticks, int16_t *values )
+{
+    MiniMidi_Lane_Block *block = &(lane->blocks[b]);
+    const _Byte *in = lane->deltas + block->offset;
+    uint64_t dt, zz;
+
+    ticks[0] = block->abs_ticks;
+    values[0] = block->value;
+
+    for (uint16_t i = 1; i < block->n_points; i++)
+    {
+        in += _get_varint( in, &dt );
+        in += _get_varint( in, &zz );
+
+        ticks[i] = ticks[i - 1] + dt;
+        values[i] = values[i - 1] + (int16_t)( ( zz >> 1 ) ^ -( zz & 1 ) );
+    }
+
+    return block->n_points;
+}
+
+// number of blocks starting at or before ticks
+static size_t _blocks_upto( MiniMidi_Lane *lane, uint64_t ticks )
+{
+    size_t lo = 0, hi = lane->n_blocks;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (lane->blocks[mid].abs_ticks <= ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// first block ending at or after ticks
+static size_t _first_block_from( MiniMidi_Lane *lane, uint64_t ticks )
+{
+    size_t lo = 0, hi = lane->n_blocks;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (lane->blocks[mid].last_ticks < ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// min / max over whole blocks [ l, r ]
+static void _tree_query( MiniMidi_Lane *lane, size_t l, size_t r, int16_t *min, int16_t *max )
+{
+    for (l += lane->tree_size, r += lane->tree_size + 1; l < r; l /= 2, r /= 2)
+    {
+        if (l & 1)
+        {
+            if (lane->tree_min[l] < *min) *min = lane->tree_min[l];
+            if (lane->tree_max[l] > *max) *max = lane->tree_max[l];
+            l++;
+        }
+        if (r & 1)
+        {
+            r--;
+            if (lane->tree_min[r] < *min) *min = lane->tree_min[r];
+            if (lane->tree_max[r] > *max) *max = lane->tree_max[r];
+        }
+    }
+}
+
+// points of block b inside [ start_ticks, end_ticks ], decoding only if the block sticks out
+static bool _block_range( MiniMidi_Lane *lane, size_t b, uint64_t start_ticks, uint64_t end_ticks, int16_t *min, int16_t *max )
+{
+    MiniMidi_Lane_Block *block = &(lane->blocks[b]);
+    uint64_t ticks[ MINIMIDI_LANE_BLOCK_POINTS ];
+    int16_t values[ MINIMIDI_LANE_BLOCK_POINTS ];
+    bool found = false;
+
+    if (block->abs_ticks >= start_ticks && block->last_ticks <= end_ticks)
+    {
+        if (block->min < *min) *min = block->min;
+        if (block->max > *max) *max = block->max;
+        return true;
+    }
+
+    size_t n = _decode_block( lane, b, ticks, values );
+    for (size_t i = 0; i < n; i++)
+    {
+        if (ticks[i] < start_ticks || ticks[i] > end_ticks) continue;
+
+        if (values[i] < *min) *min = values[i];
+        if (values[i] > *max) *max = values[i];
+        found = true;
+    }
+
+    return found;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Automation *MiniMidi_Automation_init( MiniMidi_File *file )
+{
+    MiniMidi_Automation *self = (MiniMidi_Automation*)calloc( 1, sizeof( MiniMidi_Automation ) );
+    size_t *counts = (size_t*)calloc( _N_SLOTS + 1, sizeof( size_t ) );
+    _Point *points = NULL;
+    MiniMidi_Merge events;
+    MiniMidi_Event *evt;
+    int16_t value;
+    int slot;
+
+    if (!self || !counts)
+    {
+        free( counts );
+        free( self );
+        return NULL;
+    }
+
+    // count, then place: every track, in time order
+    if (MiniMidi_Merge_init( &events, file, 0 )) goto fail;
+    while ((evt = MiniMidi_Merge_next( &events, NULL )))
+    {
+        if ((slot = _slot_of( evt, &value )) >= 0) counts[ slot + 1 ]++;
+    }
+    MiniMidi_Merge_free( &events );
+
+    for (int s = 0; s < _N_SLOTS; s++)
+    {
+        if (counts[ s + 1 ]) self->n_lanes++;
+        counts[ s + 1 ] += counts[s];
+    }
+
+    points = (_Point*)malloc( ( counts[ _N_SLOTS ] ? counts[ _N_SLOTS ] : 1 ) * sizeof( _Point ) );
+    self->lanes = (MiniMidi_Lane*)calloc( self->n_lanes ? self->n_lanes : 1, sizeof( MiniMidi_Lane ) );
+    if (!points || !self->lanes) goto fail;
+
+    if (MiniMidi_Merge_init( &events, file, 0 )) goto fail;
+    while ((evt = MiniMidi_Merge_next( &events, NULL )))
+    {
+        if ((slot = _slot_of( evt, &value )) < 0) continue;
+
+        points[ counts[slot] ].abs_ticks = evt->abs_ticks;
+        points[ counts[slot] ].value = value;
+        counts[slot]++;
+    }
+    MiniMidi_Merge_free( &events );
+
+    // counts[s] is now where slot s ends
+    size_t l = 0, begin = 0;
+    for (int s = 0; s < _N_SLOTS; s++)
+    {
+        if (counts[s] == begin) continue;
+
+        _lane_key( s, &(self->lanes[l]) );
+        if (_lane_build( &(self->lanes[l]), points + begin, counts[s] - begin ))
+        {
+            self->n_lanes = l + 1;
+            goto fail;
+        }
+        l++;
+        begin = counts[s];
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-automation.c > MiniMidi_Automation_init() : %zu lanes, %zu points",
+        self->n_lanes, counts[ _N_SLOTS - 1 ] );
+    MiniMidi_Log_writeline();
+
+    free( points );
+    free( counts );
+    return self;
+
+fail:
+    free( points );
+    free( counts );
+    MiniMidi_Automation_free( self );
+    return NULL;
+}
+
+void MiniMidi_Automation_free( MiniMidi_Automation *self )
+{
+    if (!self) return;
+
+    for (size_t l = 0; self->lanes && l < self->n_lanes; l++)
+    {
+        free( self->lanes[l].blocks );
+        free( self->lanes[l].deltas );
+        free( self->lanes[l].tree_min );
+        free( self->lanes[l].tree_max );
+    }
+    free( self->lanes );
+    free( self );
+}
+
+MiniMidi_Lane *MiniMidi_Automation_find( MiniMidi_Automation *self, MiniMidi_Lane_Kind kind, _Byte channel, _Byte controller )
+{
+    for (size_t l = 0; l < self->n_lanes; l++)
+    {
+        MiniMidi_Lane *lane = &(self->lanes[l]);
+        if (lane->kind == kind && lane->channel == channel && lane->controller == controller) return lane;
+    }
+    return NULL;
+}
+
+int MiniMidi_Lane_value_at( MiniMidi_Lane *lane, uint64_t ticks, int16_t *value )
+{
+    uint64_t t[ MINIMIDI_LANE_BLOCK_POINTS ];
+    int16_t v[ MINIMIDI_LANE_BLOCK_POINTS ];
+
+    size_t b = _blocks_upto( lane, ticks );
+    if (!b) return 1;
+    b--;
+
+    size_t n = _decode_block( lane, b, t, v ), i = 0;
+    while (i + 1 < n && t[i + 1] <= ticks) i++;
+
+    *value = v[i];
+    return 0;
+}
+
+int MiniMidi_Lane_range( MiniMidi_Lane *lane, uint64_t start_ticks, uint64_t end_ticks, int16_t *min, int16_t *max )
+{
+    size_t first = _first_block_from( lane, start_ticks ),
+           last = _blocks_upto( lane, end_ticks );
+    bool found = false;
+
+    *min = INT16_MAX;
+    *max = INT16_MIN;
+
+    if (first >= last) return 1;
+    last--;
+
+    found |= _block_range( lane, first, start_ticks, end_ticks, min, max );
+    if (last > first)
+    {
+        found |= _block_range( lane, last, start_ticks, end_ticks, min, max );
+    }
+    if (last > first + 1)
+    {
+        // everything in between is inside the range
+        _tree_query( lane, first + 1, last - 1, min, max );
+        found = true;
+    }
+
+    return found ? 0 : 1;
+}
+
+int MiniMidi_Lane_envelope( MiniMidi_Lane *lane, uint64_t start_ticks, uint64_t ticks_per_col, size_t n_cols, int16_t *min, int16_t *max )
+{
+    int16_t held, lo, hi;
+
+    for (size_t c = 0; c < n_cols; c++)
+    {
+        uint64_t from = start_ticks + c * ticks_per_col,
+                 to = from + ( ticks_per_col ? ticks_per_col - 1 : 0 );
+        bool has_held = MiniMidi_Lane_value_at( lane, from, &held ) == 0;
+
+        min[c] = has_held ? held : 1;
+        max[c] = has_held ? held : 0;
+
+        if (MiniMidi_Lane_range( lane, from, to, &lo, &hi )) continue;
+
+        if (!has_held || lo < min[c]) min[c] = lo;
+        if (!has_held || hi > max[c]) max[c] = hi;
+    }
+
+    return 0;
+}
+
+void MiniMidi_Lane_limits( MiniMidi_Lane *lane, int16_t *lo, int16_t *hi )
+{
+    *lo = lane->kind == MINIMIDI_LANE_PITCH_BEND ? -8192 : 0;
+    *hi = lane->kind == MINIMIDI_LANE_PITCH_BEND ? 8191 : 127;
+}
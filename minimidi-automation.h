@@ -0,0 +1,91 @@
+#ifndef MINIMIDI_AUTOMATION_H
+#define MINIMIDI_AUTOMATION_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// points per block: a lookup decodes at most this many deltas
+#define MINIMIDI_LANE_BLOCK_POINTS 64
+
+typedef enum {
+    MINIMIDI_LANE_CC = 0,           // controller is the CC number
+    MINIMIDI_LANE_PITCH_BEND,       // values are centered, -8192 .. 8191
+    MINIMIDI_LANE_CHAN_AFTERTOUCH,
+    MINIMIDI_LANE_POLY_AFTERTOUCH   // controller is the key
+} MiniMidi_Lane_Kind;
+
+/***
+*  * Automation Lanes:
+*
+*   Controller, pitch bend and aftertouch points of every track, split per
+*   ( kind, channel, controller ) and kept in tick order.
+*
+*   Points are stored in blocks: the block header keeps the first point and
+*   the block's min / max, the rest are varint deltas (tick, then zigzag
+*   value). A segment tree over the block min / max answers range queries
+*   with whole blocks, only the two blocks at the edges get decoded, so an
+*   envelope column costs O(log n) whatever the zoom.
+*/
+typedef struct MiniMidi_Lane_Block
+{
+    uint64_t abs_ticks,         // first point
+             last_ticks;
+    int16_t  value,             // of the first point
+             min,
+             max;
+    uint16_t n_points;
+    uint32_t offset;            // deltas of the other points, in the lane's byte stream
+
+} MiniMidi_Lane_Block;
+
+typedef struct MiniMidi_Lane
+{
+    MiniMidi_Lane_Kind  kind;
+    _Byte               channel,
+                        controller;
+
+    size_t              n_points;
+
+    MiniMidi_Lane_Block *blocks;
+    size_t              n_blocks;
+
+    _Byte               *deltas;
+    size_t              n_bytes;
+
+    // segment tree over the blocks, leaves start at tree_size
+    int16_t             *tree_min,
+                        *tree_max;
+    size_t              tree_size;
+
+} MiniMidi_Lane;
+
+typedef struct MiniMidi_Automation
+{
+    MiniMidi_Lane   *lanes;     // sorted by kind, channel, controller
+    size_t          n_lanes;
+
+} MiniMidi_Automation;
+
+MiniMidi_Automation *MiniMidi_Automation_init( MiniMidi_File *file );
+void                MiniMidi_Automation_free( MiniMidi_Automation *self );
+
+// NULL if the file has no such points
+MiniMidi_Lane *MiniMidi_Automation_find( MiniMidi_Automation *self, MiniMidi_Lane_Kind kind, _Byte channel, _Byte controller );
+
+// value in effect at ticks ( last point at or before it ). returns 1 if there is none yet
+int MiniMidi_Lane_value_at( MiniMidi_Lane *lane, uint64_t ticks, int16_t *value );
+
+// min / max of the points in [ start_ticks, end_ticks ]. returns 1 if there are none
+int MiniMidi_Lane_range( MiniMidi_Lane *lane, uint64_t start_ticks, uint64_t end_ticks, int16_t *min, int16_t *max );
+
+// n_cols columns of ticks_per_col each from start_ticks. a column without points
+// gets the value in effect, before the first point min > max marks it empty
+int MiniMidi_Lane_envelope( MiniMidi_Lane *lane, uint64_t start_ticks, uint64_t ticks_per_col, size_t n_cols, int16_t *min, int16_t *max );
+
+// bounds of the values the lane can take, for scaling
+void MiniMidi_Lane_limits( MiniMidi_Lane *lane, int16_t *lo, int16_t *hi );
+
+#endif /* MINIMIDI_AUTOMATION_H */
@@ -0,0 +1,285 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "minimidi-capture.h"
+
+uint8_t _get_midi_data_byte_count( MidiStatusCode status );
+MidiStatusCode _get_midi_status_code( _Byte *byte );
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Appending
+****************************************************************************************/
+static uint64_t _now_usec()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// every NOTE ON still open on the pitch ends here. off isn't published yet, the NOTE ONs
+// are: their next is the one thing a reader may be looking at while it changes
+static void _pair_note_off( MiniMidi_Capture *self, MiniMidi_Event *off )
+{
+    MiniMidi_Event *arr = self->file->track->event_arr;
+    uint32_t *slot = &(self->open_notes[ off->channel & 0x0F ][ off->evt_data[0] & 0x7F ]);
+
+    if (!*slot) return;
+
+    off->prev = &(arr[ *slot - 1 ]);
+
+    for (uint32_t on = *slot; on; on = self->open_older[ on - 1 ])
+    {
+        __atomic_store_n( &(arr[ on - 1 ].next), off, __ATOMIC_RELEASE );
+    }
+    *slot = 0;
+}
+
+static int _append( MiniMidi_Capture *self, MidiStatusCode status, _Byte channel, _Byte *data, uint64_t usec )
+{
+    MiniMidi_Track *track = self->file->track;
+    size_t n = track->n_events;
+
+    if (n == self->max_events)
+    {
+        self->n_dropped++;
+        return 1;
+    }
+
+    MiniMidi_Event *evt = &(track->event_arr[n]);
+    uint64_t last_tick = n ? track->event_arr[n - 1].abs_ticks : 0;
+
+    evt->abs_ticks = MiniMidi_File_usec_to_ticks( self->file, usec );
+    if (evt->abs_ticks < last_tick) evt->abs_ticks = last_tick;
+    evt->delta_ticks = evt->abs_ticks - last_tick;
+
+    evt->status_code = status;
+    evt->channel = channel;
+    evt->evt_data[0] = data[0];
+    evt->evt_data[1] = data[1];
+    evt->next = NULL;
+    evt->prev = NULL;
+
+    if (status == MIDI_NOTE_ON && data[1] == 0)
+    {
+        evt->status_code = MIDI_NOTE_OFF;
+    }
+
+    if (evt->status_code == MIDI_NOTE_ON || evt->status_code == MIDI_NOTE_OFF)
+    {
+        evt->note = _event_data_bytes_to_note( data[0] );
+    }
+
+    if (evt->status_code == MIDI_NOTE_ON)
+    {
+        uint32_t *slot = &(self->open_notes[ channel & 0x0F ][ data[0] & 0x7F ]);
+        self->open_older[n] = *slot;
+        *slot = (uint32_t)n + 1;
+    }
+    else if (evt->status_code == MIDI_NOTE_OFF)
+    {
+        _pair_note_off( self, evt );
+    }
+
+    // the event must be complete before readers can see it
+    track->total_ticks = evt->abs_ticks;
+    __atomic_store_n( &(track->n_events), n + 1, __ATOMIC_RELEASE );
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Capture *MiniMidi_Capture_init( const char *name, size_t max_events )
+{
+    MiniMidi_Capture *self = (MiniMidi_Capture*)calloc( 1, sizeof( MiniMidi_Capture ) );
+    if (!self) return NULL;
+
+    // open notes are counted in 32 bits
+    self->max_events = max_events && max_events < UINT32_MAX ? max_events : MINIMIDI_CAPTURE_MAX_EVENTS;
+    self->fd = -1;
+    atomic_init( &(self->is_running), false );
+
+    self->file = create_mini_midi_file( name );
+    if (!self->file)
+    {
+        free( self );
+        return NULL;
+    }
+    self->file->header->ppqn = MINIMIDI_CAPTURE_PPQN;
+
+    // reserve, don't commit: untouched pages cost nothing
+    void *arr = mmap( NULL, self->max_events * sizeof( MiniMidi_Event ),
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+    void *older = mmap( NULL, self->max_events * sizeof( uint32_t ),
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+    if (arr == MAP_FAILED || older == MAP_FAILED || _build_tempo_map( self->file ))
+    {
+        if (arr != MAP_FAILED) munmap( arr, self->max_events * sizeof( MiniMidi_Event ) );
+        if (older != MAP_FAILED) munmap( older, self->max_events * sizeof( uint32_t ) );
+        MiniMidi_File_free( self->file );
+        free( self );
+        return NULL;
+    }
+    self->open_older = (uint32_t*)older;
+
+    self->file->track->event_arr = (MiniMidi_Event*)arr;
+    self->file->track->capacity = self->max_events;
+    self->file->track->total_beats = 1;
+
+    self->t0_usec = _now_usec();
+
+    return self;
+}
+
+void MiniMidi_Capture_free( MiniMidi_Capture *self )
+{
+    if (!self) return;
+
+    MiniMidi_Capture_stop( self );
+
+    munmap( self->file->track->event_arr, self->max_events * sizeof( MiniMidi_Event ) );
+    munmap( self->open_older, self->max_events * sizeof( uint32_t ) );
+    self->file->track->event_arr = NULL;
+
+    MiniMidi_File_free( self->file );
+    free( self );
+}
+
+int MiniMidi_Capture_push( MiniMidi_Capture *self, const _Byte *bytes, size_t len, uint64_t usec )
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        _Byte b = bytes[i];
+
+        // real time messages can show up anywhere, even inside other messages
+        if (b >= 0xF8) continue;
+
+        if (b & 0x80)
+        {
+            self->in_sysex = ( b == 0xF0 );
+            self->n_data = 0;
+
+            if (b >= 0xF0)
+            {
+                // system common cancels running status
+                self->running_status = 0;
+                continue;
+            }
+
+            self->running_status = b;
+            self->need_data = _get_midi_data_byte_count( _get_midi_status_code( &b ) );
+            continue;
+        }
+
+        // data byte
+        if (self->in_sysex || !self->running_status) continue;
+
+        self->data[ self->n_data++ ] = b;
+
+        if (self->n_data == self->need_data)
+        {
+            if (self->need_data == 1) self->data[1] = 0;
+
+            _append( self, _get_midi_status_code( &(self->running_status) ), self->running_status & 0x0F, self->data, usec );
+
+            // keep running status, the next data byte starts a new message
+            self->n_data = 0;
+        }
+    }
+
+    // the track grew: keep the beat count the UI shows in step
+    self->file->track->total_beats = self->file->track->total_ticks / self->file->header->ppqn + 1;
+
+    return 0;
+}
+
+static void *_reader_loop( void *arg )
+{
+    MiniMidi_Capture *self = (MiniMidi_Capture*)arg;
+    struct pollfd pfd = { .fd = self->fd, .events = POLLIN };
+    _Byte buf[ 512 ];
+
+    while (atomic_load( &(self->is_running) ))
+    {
+        // wake up now and then to notice stop requests
+        if (poll( &pfd, 1, 100 ) <= 0) continue;
+
+        ssize_t r = read( self->fd, buf, sizeof( buf ) );
+
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (r <= 0) break;
+
+        MiniMidi_Capture_push( self, buf, r, _now_usec() - self->t0_usec );
+    }
+
+    return NULL;
+}
+
+int MiniMidi_Capture_start( MiniMidi_Capture *self, int fd )
+{
+    if (self->has_thread) return 1;
+
+    self->fd = fd;
+    self->t0_usec = _now_usec();
+    atomic_store( &(self->is_running), true );
+
+    if (pthread_create( &(self->thread), NULL, _reader_loop, self ))
+    {
+        atomic_store( &(self->is_running), false );
+        return 1;
+    }
+    self->has_thread = true;
+
+    return 0;
+}
+
+int MiniMidi_Capture_stop( MiniMidi_Capture *self )
+{
+    if (!self->has_thread) return 0;
+
+    atomic_store( &(self->is_running), false );
+    pthread_join( self->thread, NULL );
+    self->has_thread = false;
+
+    if (self->fd > 2) close( self->fd );
+    self->fd = -1;
+
+    // notes still held stay open ended
+    memset( self->open_notes, 0, sizeof( self->open_notes ) );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-capture.c > MiniMidi_Capture_stop() : captured %zu events, dropped %zu",
+        self->file->track->n_events, self->n_dropped );
+    MiniMidi_Log_writeline();
+
+    return 0;
+}
+
+int MiniMidi_Capture_open_source( const char *path )
+{
+    struct stat st;
+
+    if (stat( path, &st ) == 0 && S_ISFIFO( st.st_mode ))
+    {
+        // holding the write end too means no EOF when a writer goes away
+        return open( path, O_RDWR | O_NONBLOCK );
+    }
+    return open( path, O_RDONLY | O_NONBLOCK );
+}
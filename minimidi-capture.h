@@ -0,0 +1,73 @@
+#ifndef MINIMIDI_CAPTURE_H
+#define MINIMIDI_CAPTURE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "minimidi.h"
+
+// address space reserved for a capture, pages are only committed once written
+#define MINIMIDI_CAPTURE_MAX_EVENTS ( 16 * 1024 * 1024 )
+
+// ticks per beat for captured material, at the default 120 BPM
+#define MINIMIDI_CAPTURE_PPQN 480
+
+/***
+*  * Live Capture:
+*
+*   Raw MIDI bytes (from a FIFO, a rawmidi device, any fd) go through a push
+*   parser and are appended to a track as they arrive.
+*
+*   The event array is one address space reservation that never moves, so
+*   appending is O(1), NOTE ON / OFF pointers stay valid and nothing gets
+*   re-paired. A single writer publishes n_events with release semantics,
+*   readers (the TUI) load it with acquire and never take a lock. A NOTE OFF
+*   is paired before it is published; the only field of a published event
+*   that still changes is the next of a NOTE ON, stored with release.
+*/
+typedef struct MiniMidi_Capture
+{
+    MiniMidi_File   *file;          // what the TUI looks at, one growing track
+    size_t           max_events,
+                     n_dropped;     // events that did not fit the reservation
+
+    // push parser
+    _Byte            running_status,
+                     data[2];
+    uint8_t          n_data,
+                     need_data;
+    bool             in_sysex;
+
+    // unmatched NOTE ONs per channel / pitch until a NOTE OFF closes them all:
+    // index + 1 of the last one, 0 for none. open_older holds, for each event
+    // index, the one open before it the same way. only the writer looks at
+    // these, published events are never touched for them
+    uint32_t         open_notes[16][128],
+                    *open_older;
+
+    // reader thread
+    int              fd;
+    pthread_t        thread;
+    bool             has_thread;
+    atomic_bool      is_running;
+    uint64_t         t0_usec;
+
+} MiniMidi_Capture;
+
+MiniMidi_Capture    *MiniMidi_Capture_init( const char *name, size_t max_events );
+void                MiniMidi_Capture_free( MiniMidi_Capture *self );
+
+// feed bytes received at time usec (since the capture started)
+int MiniMidi_Capture_push( MiniMidi_Capture *self, const _Byte *bytes, size_t len, uint64_t usec );
+
+// read from fd on a thread until stopped, timestamps are taken on arrival
+int MiniMidi_Capture_start( MiniMidi_Capture *self, int fd );
+int MiniMidi_Capture_stop( MiniMidi_Capture *self );
+
+// "path" -> fd, a FIFO is opened so it survives writers coming and going
+int MiniMidi_Capture_open_source( const char *path );
+
+#endif /* MINIMIDI_CAPTURE_H */
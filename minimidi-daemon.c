@@ -0,0 +1,470 @@
+// accept4
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "minimidi-daemon.h"
+#include "minimidi-shared.h"
+#include "minimidi-log.h"
+
+#define _REQUEST_ATTACH 'A'
+
+// a viewer that connects and says nothing is let go after this
+#define _RECEIVE_TIMEOUT_SEC 5
+
+typedef struct _Connection
+{
+    MiniMidi_Daemon *daemon;
+    int             fd;
+
+} _Connection;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Descriptors over the socket
+****************************************************************************************/
+// one byte, with fd alongside it when fd >= 0
+static int _send( int sock, _Byte byte, int fd )
+{
+    char control[ CMSG_SPACE( sizeof( int ) ) ];
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (fd >= 0)
+    {
+        memset( control, 0, sizeof( control ) );
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof( control );
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg );
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN( sizeof( int ) );
+        memcpy( CMSG_DATA( cmsg ), &fd, sizeof( int ) );
+    }
+
+    return sendmsg( sock, &msg, MSG_NOSIGNAL ) == 1 ? 0 : 1;
+}
+
+// one byte, and the descriptor sent with it or -1. returns 0 on success
+static int _receive( int sock, _Byte *byte, int *fd )
+{
+    char control[ CMSG_SPACE( sizeof( int ) ) ];
+    struct iovec iov = { .iov_base = byte, .iov_len = 1 };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof( control ) };
+
+    *fd = -1;
+    if (recvmsg( sock, &msg, MSG_CMSG_CLOEXEC ) != 1) return 1;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg ); cmsg; cmsg = CMSG_NXTHDR( &msg, cmsg ))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN( sizeof( int ) ))
+        {
+            memcpy( fd, CMSG_DATA( cmsg ), sizeof( int ) );
+        }
+    }
+    return 0;
+}
+
+static int _address( struct sockaddr_un *addr, const char *socket_path )
+{
+    if (strlen( socket_path ) >= sizeof( addr->sun_path )) return 1;
+
+    memset( addr, 0, sizeof( struct sockaddr_un ) );
+    addr->sun_family = AF_UNIX;
+    strcpy( addr->sun_path, socket_path );
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Segments
+****************************************************************************************/
+// open for reading, not only a handle on the path: what proves the viewer may read the file
+static bool _is_readable( int fd )
+{
+    int flags = fcntl( fd, F_GETFL );
+
+    return flags >= 0 && !( flags & O_PATH ) && ( ( flags & O_ACCMODE ) == O_RDONLY || ( flags & O_ACCMODE ) == O_RDWR );
+}
+
+static bool _same_time( const struct timespec *a, const struct timespec *b )
+{
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+// the entry of the file st is of, SIZE_MAX if there is none. under lock
+static size_t _find( MiniMidi_Daemon *self, const struct stat *st )
+{
+    for (size_t i = 0; i < self->n_entries; i++)
+    {
+        MiniMidi_Daemon_Entry *entry = &(self->entries[i]);
+
+        if ((entry->fd >= 0 || entry->is_building) && entry->dev == st->st_dev && entry->ino == st->st_ino) return i;
+    }
+    return SIZE_MAX;
+}
+
+// a slot for a new entry, SIZE_MAX when out of memory. under lock
+static size_t _slot( MiniMidi_Daemon *self )
+{
+    for (size_t i = 0; i < self->n_entries; i++)
+    {
+        if (self->entries[i].fd < 0 && !self->entries[i].is_building) return i;
+    }
+
+    if (self->n_entries == self->capacity)
+    {
+        size_t capacity = self->capacity ? self->capacity * 2 : 16;
+        MiniMidi_Daemon_Entry *arr = (MiniMidi_Daemon_Entry*)realloc( self->entries, capacity * sizeof( MiniMidi_Daemon_Entry ) );
+        if (!arr) return SIZE_MAX;
+
+        self->entries = arr;
+        self->capacity = capacity;
+    }
+    return self->n_entries++;
+}
+
+// let go of the least recently used segments until the rest fit. keep is never let go of. under lock
+static void _fit( MiniMidi_Daemon *self, size_t keep )
+{
+    size_t used = 0,
+           n_closed = 0;
+
+    for (size_t i = 0; i < self->n_entries; i++) if (self->entries[i].fd >= 0) used += self->entries[i].bytes;
+
+    while (used > self->budget)
+    {
+        MiniMidi_Daemon_Entry *oldest = NULL;
+
+        for (size_t i = 0; i < self->n_entries; i++)
+        {
+            MiniMidi_Daemon_Entry *entry = &(self->entries[i]);
+
+            if (i == keep || entry->fd < 0) continue;
+            if (!oldest || entry->last_used < oldest->last_used) oldest = entry;
+        }
+        if (!oldest) break;
+
+        used -= oldest->bytes;
+        close( oldest->fd );
+        oldest->fd = -1;
+        n_closed++;
+    }
+
+    if (n_closed)
+    {
+        sprintf( MiniMidi_Log_log_line, "minimidi-daemon.c > _fit() : let go of %zu segments, %zu of %zu bytes kept",
+            n_closed, used, self->budget );
+        MiniMidi_Log_writeline();
+    }
+}
+
+// parse the file open at file_fd into a segment, or find the one kept of it. a descriptor of
+// its own for the caller, -1 on failure with the reason in status
+static int _segment( MiniMidi_Daemon *self, int file_fd, MiniMidi_Parse_Status *status )
+{
+    struct stat st;
+    size_t i;
+    int fd = -1;
+
+    // checked for every request, one served from memory too
+    *status = MINIMIDI_PARSE_UNREADABLE;
+    if (!_is_readable( file_fd ) || fstat( file_fd, &st ) || !S_ISREG( st.st_mode )) return -1;
+
+    pthread_mutex_lock( &(self->lock) );
+
+    // one parse per file: wait for the one under way, then look again
+    while ((i = _find( self, &st )) != SIZE_MAX && self->entries[i].is_building)
+    {
+        pthread_cond_wait( &(self->changed), &(self->lock) );
+    }
+
+    if (i != SIZE_MAX)
+    {
+        MiniMidi_Daemon_Entry *entry = &(self->entries[i]);
+
+        if (entry->size == st.st_size && _same_time( &(entry->mtime), &(st.st_mtim) ))
+        {
+            entry->last_used = ++self->clock;
+            self->n_hits++;
+            fd = fcntl( entry->fd, F_DUPFD_CLOEXEC, 0 );
+            pthread_mutex_unlock( &(self->lock) );
+
+            if (fd >= 0) *status = MINIMIDI_PARSE_OK;
+            return fd;
+        }
+
+        // changed on disk since
+        close( entry->fd );
+        entry->fd = -1;
+    }
+    else if ((i = _slot( self )) == SIZE_MAX)
+    {
+        pthread_mutex_unlock( &(self->lock) );
+        return -1;
+    }
+
+    MiniMidi_Daemon_Entry *entry = &(self->entries[i]);
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    entry->fd = -1;
+    entry->bytes = 0;
+    entry->is_building = true;
+    pthread_mutex_unlock( &(self->lock) );
+
+    // read through the viewer's descriptor, never opened again with the daemon's rights
+    MiniMidi_Parse_Error error;
+    MiniMidi_File *file = MiniMidi_File_init_fd( file_fd, "viewer's file", NULL, true, &error );
+    int segment = file ? MiniMidi_Shared_build( file ) : -1;
+    MiniMidi_File_free( file );
+
+    *status = !file ? error.status : segment < 0 ? MINIMIDI_PARSE_UNREADABLE : MINIMIDI_PARSE_OK;
+
+    pthread_mutex_lock( &(self->lock) );
+
+    // entries may have moved while the lock was let go, not this one's slot
+    entry = &(self->entries[i]);
+    entry->is_building = false;
+    entry->fd = segment;
+    entry->last_used = ++self->clock;
+    if (segment >= 0)
+    {
+        struct stat seg_st;
+
+        entry->bytes = fstat( segment, &seg_st ) == 0 ? (size_t)seg_st.st_size : 0;
+        self->n_builds++;
+        fd = fcntl( segment, F_DUPFD_CLOEXEC, 0 );
+        if (fd < 0) *status = MINIMIDI_PARSE_UNREADABLE;
+        _fit( self, i );
+    }
+    pthread_cond_broadcast( &(self->changed) );
+    pthread_mutex_unlock( &(self->lock) );
+
+    return fd;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Connections
+****************************************************************************************/
+static void *_connection_loop( void *arg )
+{
+    _Connection *conn = (_Connection*)arg;
+    MiniMidi_Daemon *self = conn->daemon;
+    MiniMidi_Parse_Status status = MINIMIDI_PARSE_UNREADABLE;
+    struct timeval timeout = { .tv_sec = _RECEIVE_TIMEOUT_SEC, .tv_usec = 0 };
+    _Byte request;
+    int file_fd = -1,
+        fd = -1;
+
+    setsockopt( conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+
+    if (_receive( conn->fd, &request, &file_fd ) == 0 && request == _REQUEST_ATTACH && file_fd >= 0)
+    {
+        fd = _segment( self, file_fd, &status );
+    }
+
+    _send( conn->fd, (_Byte)status, fd );
+
+    if (file_fd >= 0) close( file_fd );
+    if (fd >= 0) close( fd );
+    close( conn->fd );
+    free( conn );
+
+    pthread_mutex_lock( &(self->lock) );
+    self->n_connections--;
+    pthread_cond_broadcast( &(self->changed) );
+    pthread_mutex_unlock( &(self->lock) );
+
+    return NULL;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Daemon *MiniMidi_Daemon_init( const char *socket_path, size_t budget )
+{
+    struct sockaddr_un addr;
+
+    if (_address( &addr, socket_path )) return NULL;
+
+    MiniMidi_Daemon *self = (MiniMidi_Daemon*)calloc( 1, sizeof( MiniMidi_Daemon ) );
+    if (!self) return NULL;
+
+    self->budget = budget ? budget : MINIMIDI_DAEMON_DEFAULT_BUDGET;
+    self->listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    pthread_mutex_init( &(self->lock), NULL );
+    pthread_cond_init( &(self->changed), NULL );
+
+    if (self->listen_fd < 0)
+    {
+        MiniMidi_Daemon_free( self );
+        return NULL;
+    }
+
+    // a socket nobody answers on is what a daemon that died leaves behind
+    bool is_bound = bind( self->listen_fd, (struct sockaddr*)&addr, sizeof( addr ) ) == 0;
+    if (!is_bound && errno == EADDRINUSE)
+    {
+        int probe = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        bool is_alive = probe >= 0 && connect( probe, (struct sockaddr*)&addr, sizeof( addr ) ) == 0;
+
+        if (probe >= 0) close( probe );
+        is_bound = !is_alive && unlink( socket_path ) == 0 && bind( self->listen_fd, (struct sockaddr*)&addr, sizeof( addr ) ) == 0;
+    }
+
+    // only a socket of its own is removed on the way out
+    if (is_bound) self->socket_path = strdup( socket_path );
+
+    // the daemon's group may ask, and still has to send a file it could open for reading
+    if (!self->socket_path || chmod( socket_path, 0660 ) || listen( self->listen_fd, SOMAXCONN ))
+    {
+        MiniMidi_Daemon_free( self );
+        return NULL;
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-daemon.c > MiniMidi_Daemon_init() : listening on %s, %zu byte budget",
+        socket_path, self->budget );
+    MiniMidi_Log_writeline();
+
+    return self;
+}
+
+void MiniMidi_Daemon_free( MiniMidi_Daemon *self )
+{
+    if (!self) return;
+
+    // the connection threads are detached, they still use self
+    pthread_mutex_lock( &(self->lock) );
+    while (self->n_connections) pthread_cond_wait( &(self->changed), &(self->lock) );
+    pthread_mutex_unlock( &(self->lock) );
+
+    if (self->listen_fd >= 0) close( self->listen_fd );
+    if (self->socket_path) unlink( self->socket_path );
+
+    for (size_t i = 0; i < self->n_entries; i++)
+    {
+        if (self->entries[i].fd >= 0) close( self->entries[i].fd );
+    }
+
+    pthread_mutex_destroy( &(self->lock) );
+    pthread_cond_destroy( &(self->changed) );
+    free( self->entries );
+    free( self->socket_path );
+    free( self );
+}
+
+int MiniMidi_Daemon_run( MiniMidi_Daemon *self, volatile sig_atomic_t *stop )
+{
+    struct pollfd pfd = { .fd = self->listen_fd, .events = POLLIN };
+    pthread_attr_t attr;
+
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+
+    // woken up now and then to look at stop
+    while (!*stop)
+    {
+        if (poll( &pfd, 1, 200 ) <= 0) continue;
+
+        int fd = accept4( self->listen_fd, NULL, NULL, SOCK_CLOEXEC );
+        if (fd < 0) continue;
+
+        _Connection *conn = (_Connection*)malloc( sizeof( _Connection ) );
+        pthread_t thread;
+
+        if (!conn)
+        {
+            close( fd );
+            continue;
+        }
+        conn->daemon = self;
+        conn->fd = fd;
+
+        pthread_mutex_lock( &(self->lock) );
+        self->n_connections++;
+        pthread_mutex_unlock( &(self->lock) );
+
+        if (pthread_create( &thread, &attr, _connection_loop, conn ))
+        {
+            pthread_mutex_lock( &(self->lock) );
+            self->n_connections--;
+            pthread_mutex_unlock( &(self->lock) );
+
+            close( fd );
+            free( conn );
+        }
+    }
+
+    pthread_attr_destroy( &attr );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-daemon.c > MiniMidi_Daemon_run() : stopping, %zu parsed, %zu served from memory",
+        self->n_builds, self->n_hits );
+    MiniMidi_Log_writeline();
+
+    return 0;
+}
+
+int MiniMidi_Daemon_request( const char *socket_path, const char *file_path, MiniMidi_Parse_Status *status )
+{
+    struct sockaddr_un addr;
+    _Byte reply;
+    int sock,
+        file_fd,
+        fd = -1;
+
+    if (status) *status = MINIMIDI_PARSE_OK;
+    if (_address( &addr, socket_path )) return -1;
+
+    file_fd = open( file_path, O_RDONLY | O_CLOEXEC );
+    if (file_fd < 0)
+    {
+        if (status) *status = MINIMIDI_PARSE_UNREADABLE;
+        return -1;
+    }
+
+    sock = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if (sock >= 0 && connect( sock, (struct sockaddr*)&addr, sizeof( addr ) ) == 0 && _send( sock, _REQUEST_ATTACH, file_fd ) == 0)
+    {
+        if (_receive( sock, &reply, &fd ))
+        {
+            if (status) *status = MINIMIDI_PARSE_UNREADABLE;
+        }
+        else if (reply != MINIMIDI_PARSE_OK || fd < 0)
+        {
+            if (status) *status = reply != MINIMIDI_PARSE_OK ? (MiniMidi_Parse_Status)reply : MINIMIDI_PARSE_UNREADABLE;
+            if (fd >= 0) close( fd );
+            fd = -1;
+        }
+    }
+
+    if (sock >= 0) close( sock );
+    close( file_fd );
+
+    return fd;
+}
@@ -0,0 +1,90 @@
+#ifndef MINIMIDI_DAEMON_H
+#define MINIMIDI_DAEMON_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "minimidi.h"
+
+// what the segments kept around may take
+#define MINIMIDI_DAEMON_DEFAULT_BUDGET ( 1024UL * 1024 * 1024 )
+
+// where viewers look for a daemon when not told
+#define MINIMIDI_DAEMON_ENV "MINIMIDI_DAEMON"
+
+/***
+*  * Parse Daemon:
+*
+*   One process on the host parses files for every viewer on it. A viewer
+*   connects to the daemon's Unix socket and sends the file it opened, as
+*   a descriptor open for reading, which shows it may read it. The daemon
+*   reads through that descriptor, never by path, and answers with
+*   a status byte and, on success, a Shared Segment of the file, which the
+*   viewer maps read-only ( see MiniMidi_Lazy_File_init_shared ).
+*
+*   Segments are kept by device, inode, size and modification time: a
+*   file is parsed the first time it is asked for, and again only once it
+*   changed on disk. A viewer asking while another one's parse of the same
+*   file is under way waits for that parse instead of doing its own.
+*
+*   The socket is open to the daemon's user and group only.
+*
+*   Every connection gets a thread. When the segments kept go over budget
+*   bytes the least recently asked for are let go of; viewers that have
+*   one mapped keep it, it is only not handed out again.
+*/
+typedef struct MiniMidi_Daemon_Entry
+{
+    dev_t               dev;
+    ino_t               ino;
+    off_t               size;
+    struct timespec     mtime;
+
+    int                 fd;             // the segment, -1 when there is none
+    size_t              bytes;
+    uint64_t            last_used;
+    bool                is_building;
+
+} MiniMidi_Daemon_Entry;
+
+typedef struct MiniMidi_Daemon
+{
+    char                    *socket_path;
+    int                     listen_fd;
+    size_t                  budget;
+
+    // everything below is under lock
+    pthread_mutex_t         lock;
+    pthread_cond_t          changed;        // a segment was built, a connection ended
+
+    MiniMidi_Daemon_Entry   *entries;
+    size_t                  n_entries,
+                            capacity;
+    uint64_t                clock;
+
+    size_t                  n_connections,  // threads still running
+                            n_builds,
+                            n_hits;
+
+} MiniMidi_Daemon;
+
+// listen on socket_path, budget 0 for MINIMIDI_DAEMON_DEFAULT_BUDGET. a socket left behind
+// by a daemon that is gone is taken over. NULL if it can't listen
+MiniMidi_Daemon *MiniMidi_Daemon_init( const char *socket_path, size_t budget );
+// waits for the connections still open, removes the socket
+void            MiniMidi_Daemon_free( MiniMidi_Daemon *self );
+
+// serve until *stop is set, e.g. from a signal handler. returns 0 on success
+int MiniMidi_Daemon_run( MiniMidi_Daemon *self, volatile sig_atomic_t *stop );
+
+// ask the daemon at socket_path for file_path. the segment's descriptor, -1 on failure.
+// status, when not NULL, gets why the daemon couldn't read the file, MINIMIDI_PARSE_OK if
+// it wasn't asked at all
+int MiniMidi_Daemon_request( const char *socket_path, const char *file_path, MiniMidi_Parse_Status *status );
+
+#endif /* MINIMIDI_DAEMON_H */
@@ -0,0 +1,289 @@
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "minimidi-export.h"
+#include "minimidi-log.h"
+
+// longest csv line: 9 integers and 2 fixed point seconds, with commas
+#define _CSV_LINE_MAX 256
+#define _CSV_BATCH_BYTES ( 1 << 20 )
+
+static const struct
+{
+    const char  *name,
+                *type;
+    uint8_t     width;
+
+} _columns[ MINIMIDI_N_COLS ] = {
+    [ MINIMIDI_COL_FILE_ID ]            = { "file_id",          "u32", 4 },
+    [ MINIMIDI_COL_TRACK ]              = { "track",            "u16", 2 },
+    [ MINIMIDI_COL_CHANNEL ]            = { "channel",          "u8",  1 },
+    [ MINIMIDI_COL_TICKS ]              = { "ticks",            "u64", 8 },
+    [ MINIMIDI_COL_SECONDS ]            = { "seconds",          "f64", 8 },
+    [ MINIMIDI_COL_STATUS ]             = { "status",           "u8",  1 },
+    [ MINIMIDI_COL_DATA1 ]              = { "data1",            "u8",  1 },
+    [ MINIMIDI_COL_DATA2 ]              = { "data2",            "u8",  1 },
+    [ MINIMIDI_COL_DURATION_TICKS ]     = { "duration_ticks",   "u64", 8 },
+    [ MINIMIDI_COL_DURATION_SECONDS ]   = { "duration_seconds", "f64", 8 },
+};
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+static inline void _put_le( _Byte *dst, uint64_t v, uint8_t width )
+{
+    for (uint8_t i = 0; i < width; i++) dst[i] = v >> (8 * i);
+}
+
+static inline void _put_f64( _Byte *dst, double d )
+{
+    uint64_t bits;
+    memcpy( &bits, &d, sizeof( bits ) );
+    _put_le( dst, bits, 8 );
+}
+
+static inline char *_put_u64( char *p, uint64_t v )
+{
+    char tmp[20];
+    int n = 0;
+
+    do
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// microseconds as seconds with 6 decimals, without going through printf
+static inline char *_put_usec( char *p, uint64_t usec )
+{
+    p = _put_u64( p, usec / 1000000 );
+    *p++ = '.';
+
+    uint32_t frac = usec % 1000000;
+    for (int i = 5; i >= 0; i--)
+    {
+        p[i] = '0' + frac % 10;
+        frac /= 10;
+    }
+    return p + 6;
+}
+
+// same as MiniMidi_File_ticks_to_usec, but walks the tempo map along with
+// the events instead of searching it every time
+static inline uint64_t _usec_at( MiniMidi_File *file, size_t *tempo, uint64_t ticks )
+{
+    MiniMidi_Tempo *t = file->track->tempo_arr;
+    size_t n = file->track->n_tempos;
+
+    while (*tempo + 1 < n && t[ *tempo + 1 ].abs_ticks <= ticks) (*tempo)++;
+
+    uint64_t dt = ticks - t[ *tempo ].abs_ticks;
+    return t[ *tempo ].usec
+        + (dt / file->header->ppqn) * t[ *tempo ].usec_per_beat
+        + (dt % file->header->ppqn) * t[ *tempo ].usec_per_beat / file->header->ppqn;
+}
+
+static void _flush( MiniMidi_Export *self )
+{
+    if (self->format == MINIMIDI_EXPORT_CSV)
+    {
+        fwrite( self->text, 1, self->n_text, self->csv );
+        self->n_text = 0;
+        return;
+    }
+
+    for (int c = 0; c < MINIMIDI_N_COLS; c++)
+    {
+        fwrite( self->batch[c], _columns[c].width, self->n_batch, self->cols[c] );
+    }
+    self->n_batch = 0;
+}
+
+static FILE *_open_in( const char *dir, const char *name, const char *mode )
+{
+    char path[ 4096 ];
+
+    if (snprintf( path, sizeof( path ), "%s/%s", dir, name ) >= (int)sizeof( path )) return NULL;
+    return fopen( path, mode );
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Export
+****************************************************************************************/
+MiniMidi_Export *MiniMidi_Export_init( const char *path, MiniMidi_Export_Format format )
+{
+    MiniMidi_Export *self = (MiniMidi_Export*)calloc( 1, sizeof( MiniMidi_Export ) );
+    if (!self) return NULL;
+
+    self->format = format;
+    self->path = strdup( path );
+    if (!self->path) goto fail;
+
+    if (format == MINIMIDI_EXPORT_CSV)
+    {
+        char files_path[ 4096 ];
+        if (snprintf( files_path, sizeof( files_path ), "%s.files", path ) >= (int)sizeof( files_path )) goto fail;
+
+        self->csv = fopen( path, "wb" );
+        self->files = fopen( files_path, "w" );
+        self->text = (char*)malloc( _CSV_BATCH_BYTES );
+        if (!self->csv || !self->files || !self->text) goto fail;
+
+        for (int c = 0; c < MINIMIDI_N_COLS; c++)
+        {
+            fprintf( self->csv, "%s%c", _columns[c].name, c + 1 < MINIMIDI_N_COLS ? ',' : '\n' );
+        }
+    }
+    else
+    {
+        if (mkdir( path, 0755 ) && errno != EEXIST) goto fail;
+
+        self->files = _open_in( path, "files", "w" );
+        if (!self->files) goto fail;
+
+        for (int c = 0; c < MINIMIDI_N_COLS; c++)
+        {
+            char name[ 64 ];
+            snprintf( name, sizeof( name ), "%s.bin", _columns[c].name );
+
+            self->cols[c] = _open_in( path, name, "wb" );
+            self->batch[c] = (_Byte*)malloc( (size_t)_columns[c].width * MINIMIDI_EXPORT_BATCH_ROWS );
+            if (!self->cols[c] || !self->batch[c]) goto fail;
+        }
+    }
+
+    return self;
+
+fail:
+    sprintf( MiniMidi_Log_log_line, "minimidi-export.c > MiniMidi_Export_init() : can't write to %s", path );
+    MiniMidi_Log_writeline();
+
+    MiniMidi_Export_close( self );
+    return NULL;
+}
+
+int MiniMidi_Export_file( MiniMidi_Export *self, MiniMidi_File *file )
+{
+    uint32_t file_id = self->n_files++;
+
+    fprintf( self->files, "%u\t%s\n", file_id, file->filepath );
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+        size_t tempo = 0;
+
+        for (size_t i = 0; i < track->n_events; i++)
+        {
+            MiniMidi_Event *evt = &(track->event_arr[i]);
+            uint64_t usec = _usec_at( file, &tempo, evt->abs_ticks ),
+                     duration_ticks = 0,
+                     duration_usec = 0;
+
+            if (evt->status_code == MIDI_NOTE_ON && evt->next)
+            {
+                // the OFF is ahead of the cursor, start looking from there
+                size_t at = tempo;
+                duration_ticks = evt->next->abs_ticks - evt->abs_ticks;
+                duration_usec = _usec_at( file, &at, evt->next->abs_ticks ) - usec;
+            }
+
+            if (self->format == MINIMIDI_EXPORT_CSV)
+            {
+                char *p = self->text + self->n_text;
+
+                p = _put_u64( p, file_id );             *p++ = ',';
+                p = _put_u64( p, t );                   *p++ = ',';
+                p = _put_u64( p, evt->channel );        *p++ = ',';
+                p = _put_u64( p, evt->abs_ticks );      *p++ = ',';
+                p = _put_usec( p, usec );               *p++ = ',';
+                p = _put_u64( p, evt->status_code );    *p++ = ',';
+                p = _put_u64( p, evt->evt_data[0] );    *p++ = ',';
+                p = _put_u64( p, evt->evt_data[1] );    *p++ = ',';
+                p = _put_u64( p, duration_ticks );      *p++ = ',';
+                p = _put_usec( p, duration_usec );      *p++ = '\n';
+
+                self->n_text = p - self->text;
+                if (self->n_text + _CSV_LINE_MAX > _CSV_BATCH_BYTES) _flush( self );
+            }
+            else
+            {
+                size_t r = self->n_batch;
+
+                _put_le( self->batch[ MINIMIDI_COL_FILE_ID ] + r * 4, file_id, 4 );
+                _put_le( self->batch[ MINIMIDI_COL_TRACK ] + r * 2, t, 2 );
+                self->batch[ MINIMIDI_COL_CHANNEL ][r] = evt->channel;
+                _put_le( self->batch[ MINIMIDI_COL_TICKS ] + r * 8, evt->abs_ticks, 8 );
+                _put_f64( self->batch[ MINIMIDI_COL_SECONDS ] + r * 8, usec / 1e6 );
+                self->batch[ MINIMIDI_COL_STATUS ][r] = evt->status_code;
+                self->batch[ MINIMIDI_COL_DATA1 ][r] = evt->evt_data[0];
+                self->batch[ MINIMIDI_COL_DATA2 ][r] = evt->evt_data[1];
+                _put_le( self->batch[ MINIMIDI_COL_DURATION_TICKS ] + r * 8, duration_ticks, 8 );
+                _put_f64( self->batch[ MINIMIDI_COL_DURATION_SECONDS ] + r * 8, duration_usec / 1e6 );
+
+                if (++self->n_batch == MINIMIDI_EXPORT_BATCH_ROWS) _flush( self );
+            }
+            self->n_rows++;
+        }
+    }
+
+    return 0;
+}
+
+int MiniMidi_Export_close( MiniMidi_Export *self )
+{
+    int err = 0;
+
+    if (!self) return 1;
+
+    // rows are only added once init went through
+    if (self->n_batch || self->n_text) _flush( self );
+
+    // schema last, it holds the row count
+    if (self->format == MINIMIDI_EXPORT_COLUMNS && self->batch[ MINIMIDI_N_COLS - 1 ])
+    {
+        FILE *schema = _open_in( self->path, "schema", "w" );
+
+        if (schema)
+        {
+            fprintf( schema, "minimidi-columns 1\nendian little\nrows %zu\nfiles %u\n", self->n_rows, self->n_files );
+            for (int c = 0; c < MINIMIDI_N_COLS; c++)
+            {
+                fprintf( schema, "column %s %s %s.bin\n", _columns[c].name, _columns[c].type, _columns[c].name );
+            }
+            err |= ferror( schema ) | fclose( schema );
+        }
+        else err = 1;
+    }
+
+    for (int c = 0; c < MINIMIDI_N_COLS; c++)
+    {
+        if (self->cols[c]) err |= ferror( self->cols[c] ) | fclose( self->cols[c] );
+        free( self->batch[c] );
+    }
+    if (self->csv) err |= ferror( self->csv ) | fclose( self->csv );
+    if (self->files) err |= ferror( self->files ) | fclose( self->files );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-export.c > MiniMidi_Export_close() : %zu rows from %u files to %s",
+        self->n_rows, self->n_files, self->path ? self->path : "" );
+    MiniMidi_Log_writeline();
+
+    free( self->text );
+    free( self->path );
+    free( self );
+
+    return err;
+}
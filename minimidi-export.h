@@ -0,0 +1,74 @@
+#ifndef MINIMIDI_EXPORT_H
+#define MINIMIDI_EXPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// rows buffered per column before they are written out
+#define MINIMIDI_EXPORT_BATCH_ROWS 65536
+
+typedef enum {
+    MINIMIDI_EXPORT_COLUMNS = 0,    // a directory, one raw file per column
+    MINIMIDI_EXPORT_CSV
+} MiniMidi_Export_Format;
+
+typedef enum {
+    MINIMIDI_COL_FILE_ID = 0,
+    MINIMIDI_COL_TRACK,
+    MINIMIDI_COL_CHANNEL,
+    MINIMIDI_COL_TICKS,
+    MINIMIDI_COL_SECONDS,
+    MINIMIDI_COL_STATUS,
+    MINIMIDI_COL_DATA1,
+    MINIMIDI_COL_DATA2,
+    MINIMIDI_COL_DURATION_TICKS,
+    MINIMIDI_COL_DURATION_SECONDS,
+    MINIMIDI_N_COLS
+} MiniMidi_Export_Column;
+
+/***
+*  * Event Export:
+*
+*   Flattens every event of every track into rows: file id, track, channel,
+*   abs ticks, seconds, status, data1, data2 and, for NOTE ONs, the duration
+*   up to the matching NOTE OFF.
+*
+*   Columns are fixed width little-endian arrays ( <dir>/<column>.bin ),
+*   described by <dir>/schema, with the file ids in <dir>/files. CSV goes to
+*   a single file with the ids in <path>.files. Rows are written a batch at a
+*   time while walking one track after the other, so only the file being
+*   exported is ever in memory.
+*/
+typedef struct MiniMidi_Export
+{
+    MiniMidi_Export_Format  format;
+    char                    *path;
+
+    FILE                    *cols[ MINIMIDI_N_COLS ],
+                            *csv,
+                            *files;
+
+    _Byte                   *batch[ MINIMIDI_N_COLS ];  // columns, MINIMIDI_EXPORT_BATCH_ROWS each
+    char                    *text;                      // csv, a batch of lines
+    size_t                  n_batch,
+                            n_text,
+                            n_rows;
+
+    uint32_t                n_files;
+
+} MiniMidi_Export;
+
+// path is a directory for MINIMIDI_EXPORT_COLUMNS ( created if needed ), a file for CSV
+MiniMidi_Export *MiniMidi_Export_init( const char *path, MiniMidi_Export_Format format );
+
+// append the rows of every track in file, under the next file id
+int MiniMidi_Export_file( MiniMidi_Export *self, MiniMidi_File *file );
+
+// flush, write the schema and free. returns nonzero if anything failed to write
+int MiniMidi_Export_close( MiniMidi_Export *self );
+
+#endif /* MINIMIDI_EXPORT_H */
@@ -0,0 +1,418 @@
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <math.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "minimidi-fingerprint.h"
+#include "minimidi-log.h"
+
+#define _ROWS_PER_BAND ( MINIMIDI_FP_HASHES / MINIMIDI_FP_BANDS )
+
+// token fields: interval + 64 ( 7 bits ), rhythm step + 16 ( 5 bits ), chord shape ( 12 bits )
+#define _EDGE_STEP 31
+
+typedef struct _Bucket_Entry
+{
+    uint64_t hash;
+    uint32_t file;
+
+} _Bucket_Entry;
+
+typedef struct _Worker
+{
+    MiniMidi_Dedup  *dedup;
+    atomic_size_t   *next;
+
+} _Worker;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Hashing
+****************************************************************************************/
+// splitmix64 finalizer
+static inline uint64_t _mix( uint64_t x )
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ ( x >> 31 );
+}
+
+// one multiply-shift function per row: ( a * x + b ) >> 32, a odd
+static uint64_t _row_a[ MINIMIDI_FP_HASHES ], _row_b[ MINIMIDI_FP_HASHES ];
+static pthread_once_t _rows_once = PTHREAD_ONCE_INIT;
+
+static void _init_rows( void )
+{
+    for (int r = 0; r < MINIMIDI_FP_HASHES; r++)
+    {
+        _row_a[r] = _mix( 2 * r + 1 ) | 1;
+        _row_b[r] = _mix( 2 * r + 2 );
+    }
+}
+
+static int _cmp_u64( const void *a, const void *b )
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int _cmp_bucket( const void *a, const void *b )
+{
+    const _Bucket_Entry *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->file < y->file ? -1 : x->file > y->file;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Fingerprints
+****************************************************************************************/
+// one token per onset, see the header. notes is sorted ( ticks << 7 | pitch )
+static size_t _tokens( const uint64_t *notes, size_t n_notes, uint32_t *tokens )
+{
+    size_t n = 0;
+    uint64_t prev_ticks = 0;
+    int prev_top = -1;
+
+    for (size_t i = 0; i < n_notes; )
+    {
+        uint64_t ticks = notes[i] >> 7;
+        size_t j = i;
+
+        while (j < n_notes && ( notes[j] >> 7 ) == ticks) j++;
+
+        // sorted, so the top note is the last one on the tick
+        int top = notes[ j - 1 ] & 0x7F;
+        uint32_t shape = 0;
+        for (size_t k = i; k < j; k++) shape |= 1u << ( ( top - (int)( notes[k] & 0x7F ) ) % 12 );
+
+        int interval = prev_top < 0 ? 0 : top - prev_top;
+        uint32_t step = _EDGE_STEP;
+
+        if (n && j < n_notes)
+        {
+            double before = (double)( ticks - prev_ticks ),
+                   after = (double)( ( notes[j] >> 7 ) - ticks );
+            int s = (int)lround( 2.0 * log2( after / before ) );
+            step = ( s < -12 ? -12 : s > 12 ? 12 : s ) + 16;
+        }
+
+        tokens[ n++ ] = (uint32_t)( interval + 64 ) | ( step << 7 ) | ( shape << 12 );
+
+        prev_ticks = ticks;
+        prev_top = top;
+        i = j;
+    }
+    return n;
+}
+
+int MiniMidi_Fingerprint_file( MiniMidi_File *file, MiniMidi_Fingerprint *fp )
+{
+    size_t n_notes = 0, n = 0;
+
+    pthread_once( &_rows_once, _init_rows );
+    memset( fp, 0, sizeof( MiniMidi_Fingerprint ) );
+    memset( fp->minhash, 0xFF, sizeof( fp->minhash ) );
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        for (size_t i = 0; i < file->tracks[t].n_events; i++)
+        {
+            if (file->tracks[t].event_arr[i].status_code == MIDI_NOTE_ON) n_notes++;
+        }
+    }
+
+    uint64_t *notes = (uint64_t*)malloc( ( n_notes ? n_notes : 1 ) * sizeof( uint64_t ) );
+    uint32_t *tokens = (uint32_t*)malloc( ( n_notes ? n_notes : 1 ) * sizeof( uint32_t ) );
+
+    if (!notes || !tokens)
+    {
+        free( notes );
+        free( tokens );
+        return 1;
+    }
+
+    // tracks and channels are merged, only onsets and pitches are kept
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        for (size_t i = 0; i < file->tracks[t].n_events; i++)
+        {
+            MiniMidi_Event *e = &(file->tracks[t].event_arr[i]);
+            if (e->status_code == MIDI_NOTE_ON) notes[ n++ ] = ( e->abs_ticks << 7 ) | ( e->evt_data[0] & 0x7F );
+        }
+    }
+    qsort( notes, n, sizeof( uint64_t ), _cmp_u64 );
+
+    size_t n_tokens = _tokens( notes, n, tokens );
+    uint64_t content = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < n_tokens; i++) content = ( content ^ tokens[i] ) * 0x100000001B3ULL;
+    fp->content = _mix( content ^ n_tokens );
+    fp->n_onsets = n_tokens;
+
+    for (size_t i = 0; i + MINIMIDI_FP_SHINGLE <= n_tokens; i++)
+    {
+        uint64_t s = 0;
+        for (int k = 0; k < MINIMIDI_FP_SHINGLE; k++) s = _mix( s ^ tokens[ i + k ] );
+
+        for (int r = 0; r < MINIMIDI_FP_HASHES; r++)
+        {
+            uint32_t h = ( _row_a[r] * s + _row_b[r] ) >> 32;
+            if (h < fp->minhash[r]) fp->minhash[r] = h;
+        }
+        fp->n_shingles++;
+    }
+
+    free( notes );
+    free( tokens );
+    return 0;
+}
+
+double MiniMidi_Fingerprint_similarity( const MiniMidi_Fingerprint *a, const MiniMidi_Fingerprint *b )
+{
+    int equal = 0;
+
+    if (!a->n_shingles || !b->n_shingles) return a->content == b->content && a->n_onsets == b->n_onsets;
+
+    for (int r = 0; r < MINIMIDI_FP_HASHES; r++) equal += a->minhash[r] == b->minhash[r];
+    return (double)equal / MINIMIDI_FP_HASHES;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Deduplication
+****************************************************************************************/
+MiniMidi_Dedup *MiniMidi_Dedup_init( void )
+{
+    return (MiniMidi_Dedup*)calloc( 1, sizeof( MiniMidi_Dedup ) );
+}
+
+void MiniMidi_Dedup_free( MiniMidi_Dedup *self )
+{
+    if (!self) return;
+
+    for (size_t i = 0; i < self->n_files; i++) free( self->paths[i] );
+    free( self->paths );
+    free( self->prints );
+    free( self->group );
+    free( self->next );
+    free( self->failed );
+    free( self );
+}
+
+static int _add_file( MiniMidi_Dedup *self, const char *path )
+{
+    if (self->n_files == self->capacity)
+    {
+        size_t new_cap = self->capacity ? self->capacity * 2 : 256;
+        char **paths = (char**)realloc( self->paths, new_cap * sizeof( char* ) );
+        if (!paths) return 1;
+
+        self->paths = paths;
+        self->capacity = new_cap;
+    }
+
+    self->paths[ self->n_files ] = strdup( path );
+    if (!self->paths[ self->n_files ]) return 1;
+
+    self->n_files++;
+    return 0;
+}
+
+static bool _is_midi_name( const char *name )
+{
+    const char *dot = strrchr( name, '.' );
+    return dot && ( strcasecmp( dot, ".mid" ) == 0 || strcasecmp( dot, ".midi" ) == 0 );
+}
+
+int MiniMidi_Dedup_add( MiniMidi_Dedup *self, const char *path )
+{
+    struct stat st;
+
+    if (stat( path, &st )) return 1;
+    if (!S_ISDIR( st.st_mode )) return _add_file( self, path );
+
+    DIR *dir = opendir( path );
+    struct dirent *entry;
+    int err = 0;
+
+    if (!dir) return 1;
+
+    while (( entry = readdir( dir ) ) && !err)
+    {
+        if (entry->d_name[0] == '.') continue;
+
+        size_t len = strlen( path ) + strlen( entry->d_name ) + 2;
+        char *child = (char*)malloc( len );
+        if (!child)
+        {
+            err = 1;
+            break;
+        }
+        snprintf( child, len, "%s/%s", path, entry->d_name );
+
+        // sub directories are walked, other files only by their extension
+        if (stat( child, &st ) == 0 && ( S_ISDIR( st.st_mode ) || _is_midi_name( entry->d_name ) ))
+        {
+            err = MiniMidi_Dedup_add( self, child );
+        }
+        free( child );
+    }
+
+    closedir( dir );
+    return err;
+}
+
+static void *_worker_loop( void *arg )
+{
+    _Worker *w = (_Worker*)arg;
+    MiniMidi_Dedup *self = w->dedup;
+    size_t i;
+
+    while (( i = atomic_fetch_add( w->next, 1 ) ) < self->n_files)
+    {
+        MiniMidi_File *f = MiniMidi_File_init( self->paths[i] );
+
+        self->failed[i] = !f || MiniMidi_Fingerprint_file( f, &(self->prints[i]) );
+        MiniMidi_File_free( f );
+    }
+    return NULL;
+}
+
+static uint32_t _find( uint32_t *parent, uint32_t i )
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[ parent[i] ];
+        i = parent[i];
+    }
+    return i;
+}
+
+// the smaller index stays the root
+static void _union( uint32_t *parent, uint32_t a, uint32_t b )
+{
+    a = _find( parent, a );
+    b = _find( parent, b );
+    if (a < b) parent[b] = a; else parent[a] = b;
+}
+
+int MiniMidi_Dedup_run( MiniMidi_Dedup *self, uint32_t n_threads, double threshold )
+{
+    size_t n = self->n_files, n_entries = 0;
+
+    free( self->prints );
+    free( self->group );
+    free( self->next );
+    free( self->failed );
+    self->prints = (MiniMidi_Fingerprint*)calloc( n ? n : 1, sizeof( MiniMidi_Fingerprint ) );
+    self->group = (uint32_t*)malloc( ( n ? n : 1 ) * sizeof( uint32_t ) );
+    self->next = (uint32_t*)malloc( ( n ? n : 1 ) * sizeof( uint32_t ) );
+    self->failed = (bool*)calloc( n ? n : 1, sizeof( bool ) );
+    self->n_groups = 0;
+
+    if (!self->prints || !self->group || !self->next || !self->failed || n > UINT32_MAX) return 1;
+
+    // fingerprints, the first worker is this thread
+    atomic_size_t next;
+    _Worker worker = { .dedup = self, .next = &next };
+    if (!n_threads) n_threads = 1;
+    if (n_threads > n) n_threads = n ? n : 1;
+
+    pthread_t threads[ n_threads ];
+    bool started[ n_threads ];
+
+    atomic_init( &next, 0 );
+    for (uint32_t j = 1; j < n_threads; j++) started[j] = pthread_create( &threads[j], NULL, _worker_loop, &worker ) == 0;
+    _worker_loop( &worker );
+    for (uint32_t j = 1; j < n_threads; j++)
+    {
+        if (started[j]) pthread_join( threads[j], NULL );
+    }
+
+    // exact copies first, then LSH buckets. one entry per file and band, plus the content hash
+    _Bucket_Entry *entries = (_Bucket_Entry*)malloc( ( n ? n : 1 ) * ( MINIMIDI_FP_BANDS + 1 ) * sizeof( _Bucket_Entry ) );
+    if (!entries) return 1;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        MiniMidi_Fingerprint *fp = &(self->prints[i]);
+
+        self->group[i] = i;
+        if (self->failed[i] || !fp->n_onsets) continue;
+
+        entries[ n_entries ].hash = fp->content;
+        entries[ n_entries++ ].file = i;
+
+        for (int b = 0; b < MINIMIDI_FP_BANDS && fp->n_shingles; b++)
+        {
+            uint64_t h = _mix( b + 1 );
+            for (int r = 0; r < _ROWS_PER_BAND; r++) h = _mix( h ^ fp->minhash[ b * _ROWS_PER_BAND + r ] );
+
+            entries[ n_entries ].hash = h;
+            entries[ n_entries++ ].file = i;
+        }
+    }
+
+    qsort( entries, n_entries, sizeof( _Bucket_Entry ), _cmp_bucket );
+
+    // against the first file of the bucket only, other bands catch the rest
+    for (size_t i = 0; i < n_entries; )
+    {
+        size_t j = i + 1;
+        MiniMidi_Fingerprint *first = &(self->prints[ entries[i].file ]);
+
+        for (; j < n_entries && entries[j].hash == entries[i].hash; j++)
+        {
+            MiniMidi_Fingerprint *other = &(self->prints[ entries[j].file ]);
+            bool same = first->content == other->content && first->n_onsets == other->n_onsets;
+
+            if (same || MiniMidi_Fingerprint_similarity( first, other ) >= threshold)
+            {
+                _union( self->group, entries[i].file, entries[j].file );
+            }
+        }
+        i = j;
+    }
+    free( entries );
+
+    // chain every group in index order. a group is counted at its second file
+    uint32_t *tail = (uint32_t*)malloc( ( n ? n : 1 ) * sizeof( uint32_t ) );
+    if (!tail) return 1;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t root = _find( self->group, i );
+
+        self->group[i] = root;
+        self->next[i] = UINT32_MAX;
+        tail[i] = i;
+        if (root == i) continue;
+
+        if (tail[ root ] == root) self->n_groups++;
+        self->next[ tail[ root ] ] = i;
+        tail[ root ] = i;
+    }
+    free( tail );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-fingerprint.c > MiniMidi_Dedup_run() : %zu files, %zu groups, %u threads",
+        n, self->n_groups, n_threads );
+    MiniMidi_Log_writeline();
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef MINIMIDI_FINGERPRINT_H
+#define MINIMIDI_FINGERPRINT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// onsets per shingle
+#define MINIMIDI_FP_SHINGLE 4
+
+// MinHash rows, split in LSH bands of MINIMIDI_FP_HASHES / MINIMIDI_FP_BANDS rows
+#define MINIMIDI_FP_HASHES 64
+#define MINIMIDI_FP_BANDS 16
+
+// estimated Jaccard similarity for two files to be called duplicates
+#define MINIMIDI_FP_DEFAULT_THRESHOLD 0.8
+
+/***
+*  * Fingerprints:
+*
+*   All tracks and channels are merged into one stream of onsets. Every onset
+*   becomes a token: the interval its top note moved by, the chord under it
+*   as pitch classes relative to the top note, and the ratio between the gap
+*   before and the gap after it ( log2, in half steps ). None of those change
+*   with a transposition, a tempo map or a different ppqn, and headers,
+*   track layout, channels and velocities are left out.
+*
+*   The content hash covers the whole token stream: equal hashes are exact
+*   re-exports. Runs of MINIMIDI_FP_SHINGLE tokens are the shingles the
+*   MinHash signature is taken over, the share of equal rows estimates the
+*   Jaccard similarity of two files.
+*/
+typedef struct MiniMidi_Fingerprint
+{
+    uint64_t    content;
+    uint32_t    minhash[ MINIMIDI_FP_HASHES ];
+    uint32_t    n_onsets,
+                n_shingles;     // 0: only the content hash can be compared
+
+} MiniMidi_Fingerprint;
+
+/***
+*  * Deduplication:
+*
+*   Files are fingerprinted on n_threads, one file in memory per thread.
+*   Equal content hashes are grouped, then files sharing an LSH band bucket
+*   are compared against the bucket's first file and grouped when their
+*   estimate reaches the threshold. Groups are closed transitively.
+*/
+typedef struct MiniMidi_Dedup
+{
+    char                    **paths;
+    MiniMidi_Fingerprint    *prints;
+    uint32_t                *group,     // smallest index in the file's group
+                            *next;      // next file in the group, UINT32_MAX after the last
+    bool                    *failed;    // couldn't be read
+    size_t                  n_files,
+                            capacity,
+                            n_groups;   // with more than one file
+
+} MiniMidi_Dedup;
+
+int     MiniMidi_Fingerprint_file( MiniMidi_File *file, MiniMidi_Fingerprint *fp );
+
+// share of equal MinHash rows, 1 or 0 on the content hash when there are no shingles
+double  MiniMidi_Fingerprint_similarity( const MiniMidi_Fingerprint *a, const MiniMidi_Fingerprint *b );
+
+MiniMidi_Dedup  *MiniMidi_Dedup_init( void );
+void            MiniMidi_Dedup_free( MiniMidi_Dedup *self );
+
+// a file, or every .mid / .midi under a directory
+int MiniMidi_Dedup_add( MiniMidi_Dedup *self, const char *path );
+
+// fingerprint everything added and fill in the groups
+int MiniMidi_Dedup_run( MiniMidi_Dedup *self, uint32_t n_threads, double threshold );
+
+#endif /* MINIMIDI_FINGERPRINT_H */
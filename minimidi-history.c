@@ -0,0 +1,773 @@
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "minimidi-history.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Selection Helpers
+****************************************************************************************/
+static inline size_t _sel_at( MiniMidi_Selection *sel, size_t k )
+{
+    return sel->indices ? sel->indices[k] : sel->first + k;
+}
+
+// own copy of the selection, so callers can reuse their buffers
+static int _sel_copy( MiniMidi_Selection *dst, MiniMidi_Selection *src )
+{
+    dst->first = src->first;
+    dst->count = src->count;
+    dst->indices = NULL;
+
+    if (src->indices && src->count)
+    {
+        dst->indices = (uint32_t*)malloc( src->count * sizeof( uint32_t ) );
+        if (!dst->indices) return 1;
+        memcpy( dst->indices, src->indices, src->count * sizeof( uint32_t ) );
+    }
+    return 0;
+}
+
+static bool _sel_equals( MiniMidi_Selection *a, MiniMidi_Selection *b )
+{
+    if (a->count != b->count) return false;
+
+    if (!a->indices && !b->indices) return a->first == b->first;
+
+    for (size_t k = 0; k < a->count; k++)
+    {
+        if (_sel_at(a, k) != _sel_at(b, k)) return false;
+    }
+    return true;
+}
+
+static size_t _sel_bytes( MiniMidi_Selection *sel )
+{
+    return sel->indices ? sel->count * sizeof( uint32_t ) : 0;
+}
+
+static bool _sel_is_valid( MiniMidi_Selection *sel, size_t n_events )
+{
+    if (!sel->indices) return sel->first + sel->count <= n_events;
+
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        if (sel->indices[k] >= n_events) return false;
+        if (k && sel->indices[k] <= sel->indices[k-1]) return false; // must be sorted, unique
+    }
+    return true;
+}
+
+static bool _is_note( MiniMidi_Event *e )
+{
+    return e->status_code == MIDI_NOTE_ON || e->status_code == MIDI_NOTE_OFF;
+}
+
+static bool _is_sorted( MiniMidi_Event *arr, size_t n )
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        if (arr[i].abs_ticks < arr[i - 1].abs_ticks) return false;
+    }
+    return true;
+}
+
+static long _elapsed_ms( struct timespec *from, struct timespec *to )
+{
+    return (to->tv_sec - from->tv_sec) * 1000 + (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Track Mutations
+****************************************************************************************/
+static void _set_pitch( MiniMidi_Event *e, int pitch )
+{
+    e->evt_data[0] = (_Byte)pitch;
+    e->note = _event_data_bytes_to_note( e->evt_data[0] );
+}
+
+static void _apply_transpose( MiniMidi_Track *track, MiniMidi_Edit *edit, bool undo )
+{
+    size_t c = 0; // cursor into the clamped list, both lists are sorted
+    MiniMidi_Event *e;
+
+    for (size_t k = 0; k < edit->sel.count; k++)
+    {
+        size_t i = _sel_at( &(edit->sel), k );
+        e = &(track->event_arr[i]);
+
+        if (!_is_note(e)) continue;
+
+        if (c < edit->n_clamped && edit->clamped[c] == i)
+        {
+            if (undo)
+                _set_pitch( e, edit->clamped_pitch[c] );
+            else
+                _set_pitch( e, edit->amount > 0 ? 127 : 0 );
+            c++;
+            continue;
+        }
+
+        _set_pitch( e, e->evt_data[0] + ( undo ? -edit->amount : edit->amount ) );
+    }
+}
+
+static void _apply_replace( MiniMidi_Track *track, MiniMidi_Edit *edit, bool undo )
+{
+    MiniMidi_Event *src = undo ? edit->before : edit->after;
+
+    for (size_t k = 0; k < edit->sel.count; k++)
+    {
+        track->event_arr[ _sel_at( &(edit->sel), k ) ] = src[k];
+    }
+}
+
+// compact the array, dropping the selected events
+static void _remove_at( MiniMidi_Track *track, MiniMidi_Selection *sel )
+{
+    size_t w = 0, k = 0;
+
+    for (size_t i = 0; i < track->n_events; i++)
+    {
+        if (k < sel->count && _sel_at(sel, k) == i)
+        {
+            k++;
+            continue;
+        }
+        track->event_arr[w++] = track->event_arr[i];
+    }
+    track->n_events = w;
+}
+
+// put events back at the exact indices they were removed from
+static int _reinsert_at( MiniMidi_Track *track, MiniMidi_Selection *sel, MiniMidi_Event *events )
+{
+    if (MiniMidi_Track_reserve( track, track->n_events + sel->count )) return 1;
+
+    size_t w = track->n_events + sel->count,
+           i = track->n_events,
+           j = sel->count;
+
+    while (j > 0)
+    {
+        w--;
+        if (_sel_at(sel, j - 1) == w)
+        {
+            track->event_arr[w] = events[--j];
+        } else {
+            track->event_arr[w] = track->event_arr[--i];
+        }
+    }
+    track->n_events += sel->count;
+    return 0;
+}
+
+// merge sorted events in, after any existing event on the same tick.
+// the landing indices are written to sel, so the insert can be undone.
+static int _insert_sorted( MiniMidi_Track *track, MiniMidi_Event *events, MiniMidi_Selection *sel )
+{
+    if (MiniMidi_Track_reserve( track, track->n_events + sel->count )) return 1;
+
+    MiniMidi_Event *arr = track->event_arr;
+    size_t w = track->n_events + sel->count,
+           i = track->n_events,
+           j = sel->count;
+
+    while (j > 0)
+    {
+        w--;
+        if (i > 0 && arr[i - 1].abs_ticks > events[j - 1].abs_ticks)
+        {
+            arr[w] = arr[--i];
+        } else {
+            arr[w] = events[--j];
+            sel->indices[j] = (uint32_t)w;
+        }
+    }
+    track->n_events += sel->count;
+    return 0;
+}
+
+// the pairing keys of the selected notes
+static void _mark_keys( MiniMidi_Track *track, MiniMidi_Selection *sel, bool *keys )
+{
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        MiniMidi_Event *e = &(track->event_arr[ _sel_at(sel, k) ]);
+        if (_is_note(e)) keys[ MINIMIDI_NOTE_KEY( e ) ] = true;
+    }
+}
+
+// relink an edit that kept every event where it was, around the selection only
+static void _relink_in_place( MiniMidi_Track *track, MiniMidi_Selection *sel, bool *keys )
+{
+    if (!sel->count) return;
+
+    _mark_keys( track, sel, keys );
+    MiniMidi_Track_relink_span( track, _sel_at(sel, 0), _sel_at(sel, sel->count - 1) + 1, keys );
+}
+
+static int _apply( MiniMidi_Track *track, MiniMidi_Edit *edit, bool undo )
+{
+    bool keys[MINIMIDI_NOTE_KEYS] = { false };
+    MiniMidi_Event *base = track->event_arr;
+    MiniMidi_Selection *gone = NULL;
+    int err = 0;
+
+    switch (edit->kind)
+    {
+        case MINIMIDI_EDIT_TRANSPOSE:
+        case MINIMIDI_EDIT_REPLACE:
+            _mark_keys( track, &(edit->sel), keys );
+            break;
+        case MINIMIDI_EDIT_REMOVE:
+            if (!undo) gone = &(edit->sel);
+            break;
+        case MINIMIDI_EDIT_INSERT:
+            if (undo) gone = &(edit->sel);
+            break;
+        case MINIMIDI_EDIT_MOVE:
+            gone = undo ? &(edit->landed) : &(edit->sel);
+            break;
+    }
+    // NOTE ONs left behind by removed NOTE OFFs have to be let go of
+    if (gone) _mark_keys( track, gone, keys );
+
+    switch (edit->kind)
+    {
+        case MINIMIDI_EDIT_TRANSPOSE:
+            _apply_transpose( track, edit, undo );
+            break;
+        case MINIMIDI_EDIT_REPLACE:
+            _apply_replace( track, edit, undo );
+            break;
+        case MINIMIDI_EDIT_REMOVE:
+            if (undo)
+                err = _reinsert_at( track, &(edit->sel), edit->before );
+            else
+                _remove_at( track, &(edit->sel) );
+            break;
+        case MINIMIDI_EDIT_INSERT:
+            if (undo)
+                _remove_at( track, &(edit->sel) );
+            else
+                err = _insert_sorted( track, edit->after, &(edit->sel) );
+            break;
+        case MINIMIDI_EDIT_MOVE:
+            if (undo)
+            {
+                _remove_at( track, &(edit->landed) );
+                err = _reinsert_at( track, &(edit->sel), edit->before );
+            } else {
+                _remove_at( track, &(edit->sel) );
+                err = _insert_sorted( track, edit->after, &(edit->landed) );
+            }
+            break;
+    }
+
+    if (err) return err;
+
+    // pitch and order changes can both move NOTE ON / OFF pairs around, but only
+    // for the keys the edit touched and only near it
+    if (edit->kind == MINIMIDI_EDIT_TRANSPOSE || edit->kind == MINIMIDI_EDIT_REPLACE)
+    {
+        _relink_in_place( track, &(edit->sel), keys );
+        return 0;
+    }
+
+    // grown out of its old memory, every link points at the old copy
+    if (track->event_arr != base)
+    {
+        MiniMidi_Track_relink( track );
+        return 0;
+    }
+
+    // everything from the first index touched on moved, the array is walked there anyway
+    size_t lo = edit->sel.count ? _sel_at( &(edit->sel), 0 ) : track->n_events;
+    if (edit->landed.count && _sel_at( &(edit->landed), 0 ) < lo) lo = _sel_at( &(edit->landed), 0 );
+
+    for (size_t i = lo; i < track->n_events; i++)
+    {
+        if (_is_note( &(track->event_arr[i]) )) keys[ MINIMIDI_NOTE_KEY( &(track->event_arr[i]) ) ] = true;
+    }
+    MiniMidi_Track_relink_span( track, lo, track->n_events, keys );
+    return 0;
+}
+
+
+
+// how many events an edit adds to the track, taken back when it is undone. a move
+// removes as many as it puts in before it does
+static int64_t _growth( MiniMidi_Edit *edit, bool undo )
+{
+    int64_t n = edit->sel.count;
+
+    switch (edit->kind)
+    {
+        case MINIMIDI_EDIT_REMOVE:
+            return undo ? n : -n;
+        case MINIMIDI_EDIT_INSERT:
+            return undo ? -n : n;
+        default:
+            return 0;
+    }
+}
+
+// edits [from, to) are undone or redone as one group. the only thing that can fail in
+// _apply is the track growing, so room for the most events the track has at any point
+// of the group is made first: either the whole group goes through or none of it does
+static int _reserve_group( MiniMidi_History *self, size_t from, size_t to, bool undo )
+{
+    MiniMidi_Track *track = self->track;
+    MiniMidi_Event *base = track->event_arr;
+    int64_t n = track->n_events,
+            peak = n;
+
+    for (size_t i = from; i < to; i++)
+    {
+        n += _growth( &(self->edits[ undo ? to - 1 - ( i - from ) : i ]), undo );
+        if (n > peak) peak = n;
+    }
+
+    if (MiniMidi_Track_reserve( track, (size_t)peak )) return 1;
+
+    // grown out of its old memory, every link points at the old copy
+    if (track->event_arr != base) MiniMidi_Track_relink( track );
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Edit Records
+****************************************************************************************/
+static void _edit_free( MiniMidi_Edit *edit )
+{
+    free( edit->sel.indices );
+    free( edit->landed.indices );
+    free( edit->clamped );
+    free( edit->clamped_pitch );
+    free( edit->before );
+    free( edit->after );
+}
+
+static void _drop_redo_tail( MiniMidi_History *self )
+{
+    while (self->n_edits > self->n_applied)
+    {
+        MiniMidi_Edit *edit = &(self->edits[ --self->n_edits ]);
+        self->bytes_used -= edit->bytes;
+        _edit_free( edit );
+    }
+}
+
+// forget the oldest groups until the history fits its budget again.
+// the newest group always stays, even if it is larger than the budget.
+static void _enforce_budget( MiniMidi_History *self )
+{
+    size_t drop = 0;
+
+    while (self->bytes_used > self->budget && drop < self->n_edits)
+    {
+        unsigned int g = self->edits[drop].group;
+        size_t end = drop;
+
+        while (end < self->n_edits && self->edits[end].group == g) end++;
+        if (end == self->n_edits) break;
+
+        for (; drop < end; drop++)
+        {
+            self->bytes_used -= self->edits[drop].bytes;
+            _edit_free( &(self->edits[drop]) );
+        }
+    }
+
+    if (!drop) return;
+
+    memmove( self->edits, self->edits + drop, (self->n_edits - drop) * sizeof( MiniMidi_Edit ) );
+    self->n_edits -= drop;
+    self->n_applied -= drop;
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-history.c > budget : dropped %zu old edits, %zu bytes in use", drop, self->bytes_used );
+    MiniMidi_Log_writeline();
+}
+
+static MiniMidi_Edit *_push( MiniMidi_History *self, MiniMidi_Edit_Kind kind )
+{
+    _drop_redo_tail( self );
+
+    if (self->n_edits == self->capacity)
+    {
+        size_t new_cap = self->capacity ? self->capacity * 2 : 32;
+        MiniMidi_Edit *edits = (MiniMidi_Edit*)realloc( self->edits, new_cap * sizeof( MiniMidi_Edit ) );
+        if (!edits) return NULL;
+
+        self->edits = edits;
+        self->capacity = new_cap;
+    }
+
+    MiniMidi_Edit *edit = &(self->edits[ self->n_edits ]);
+    memset( edit, 0, sizeof( MiniMidi_Edit ) );
+
+    edit->kind = kind;
+    edit->group = self->open_group ? self->open_group : ++self->next_group;
+    clock_gettime( CLOCK_MONOTONIC, &(edit->stamp) );
+
+    return edit;
+}
+
+static void _commit( MiniMidi_History *self, MiniMidi_Edit *edit )
+{
+    edit->bytes = sizeof( MiniMidi_Edit ) + _sel_bytes( &(edit->sel) ) + _sel_bytes( &(edit->landed) )
+        + edit->n_clamped * ( sizeof( uint32_t ) + sizeof( _Byte ) );
+
+    if (edit->before) edit->bytes += edit->sel.count * sizeof( MiniMidi_Event );
+    if (edit->after)  edit->bytes += edit->sel.count * sizeof( MiniMidi_Event );
+
+    self->n_edits++;
+    self->n_applied = self->n_edits;
+    self->bytes_used += edit->bytes;
+
+    _enforce_budget( self );
+}
+
+// last edit, if it can absorb a new one of the same kind on the same selection
+static MiniMidi_Edit *_coalesce_candidate( MiniMidi_History *self, MiniMidi_Edit_Kind kind, MiniMidi_Selection *sel )
+{
+    struct timespec now;
+
+    if (self->open_group || !self->n_applied || self->n_applied != self->n_edits) return NULL;
+
+    MiniMidi_Edit *last = &(self->edits[ self->n_applied - 1 ]);
+    if (last->kind != kind || !_sel_equals( &(last->sel), sel )) return NULL;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    if (_elapsed_ms( &(last->stamp), &now ) > MINIMIDI_HISTORY_COALESCE_MS) return NULL;
+
+    last->stamp = now;
+    return last;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_History *MiniMidi_History_init( MiniMidi_Track *track, size_t budget_bytes )
+{
+    MiniMidi_History *self = (MiniMidi_History*)calloc( 1, sizeof( MiniMidi_History ) );
+    if (!self) return NULL;
+
+    self->track = track;
+    self->budget = budget_bytes ? budget_bytes : MINIMIDI_HISTORY_DEFAULT_BUDGET;
+
+    return self;
+}
+
+void MiniMidi_History_free( MiniMidi_History *self )
+{
+    if (!self) return;
+
+    for (size_t i = 0; i < self->n_edits; i++)
+    {
+        _edit_free( &(self->edits[i]) );
+    }
+    free( self->edits );
+    free( self );
+}
+
+int MiniMidi_History_transpose( MiniMidi_History *self, MiniMidi_Selection *sel, int semitones )
+{
+    MiniMidi_Track *track = self->track;
+    size_t n_clamped = 0;
+
+    if (!semitones || !sel->count) return 0;
+    if (!_sel_is_valid( sel, track->n_events )) return 1;
+
+    // which notes would leave the MIDI range? only these need their pitch saved
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        MiniMidi_Event *e = &(track->event_arr[ _sel_at(sel, k) ]);
+        int p = e->evt_data[0] + semitones;
+
+        if (_is_note(e) && (p < 0 || p > 127)) n_clamped++;
+    }
+
+    // repeated nudges of the same selection collapse into one step
+    MiniMidi_Edit *last = n_clamped ? NULL : _coalesce_candidate( self, MINIMIDI_EDIT_TRANSPOSE, sel );
+    if (last && !last->n_clamped)
+    {
+        MiniMidi_Edit step = *last;
+        step.amount = semitones;
+        bool keys[MINIMIDI_NOTE_KEYS] = { false };
+
+        _mark_keys( track, sel, keys );
+        _apply_transpose( track, &step, false );
+        _relink_in_place( track, sel, keys );
+
+        last->amount += semitones;
+        return 0;
+    }
+
+    MiniMidi_Edit *edit = _push( self, MINIMIDI_EDIT_TRANSPOSE );
+    if (!edit) return 1;
+
+    edit->amount = semitones;
+    if (_sel_copy( &(edit->sel), sel ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    if (n_clamped)
+    {
+        edit->clamped = (uint32_t*)malloc( n_clamped * sizeof( uint32_t ) );
+        edit->clamped_pitch = (_Byte*)malloc( n_clamped * sizeof( _Byte ) );
+        if (!edit->clamped || !edit->clamped_pitch)
+        {
+            _edit_free( edit );
+            return 1;
+        }
+
+        for (size_t k = 0; k < sel->count; k++)
+        {
+            size_t i = _sel_at(sel, k);
+            MiniMidi_Event *e = &(track->event_arr[i]);
+            int p = e->evt_data[0] + semitones;
+
+            if (_is_note(e) && (p < 0 || p > 127))
+            {
+                edit->clamped[ edit->n_clamped ] = (uint32_t)i;
+                edit->clamped_pitch[ edit->n_clamped++ ] = e->evt_data[0];
+            }
+        }
+    }
+
+    _apply( track, edit, false );
+    _commit( self, edit );
+
+    return 0;
+}
+
+int MiniMidi_History_replace( MiniMidi_History *self, MiniMidi_Selection *sel, MiniMidi_Event *new_events )
+{
+    MiniMidi_Track *track = self->track;
+
+    if (!sel->count) return 0;
+    if (!_sel_is_valid( sel, track->n_events )) return 1;
+
+    // replacing must not reorder the track, use remove + insert for that
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        if (new_events[k].abs_ticks != track->event_arr[ _sel_at(sel, k) ].abs_ticks) return 1;
+    }
+
+    // keep the oldest "before" and the newest "after"
+    MiniMidi_Edit *last = _coalesce_candidate( self, MINIMIDI_EDIT_REPLACE, sel );
+    if (last)
+    {
+        memcpy( last->after, new_events, sel->count * sizeof( MiniMidi_Event ) );
+        _apply( track, last, false );
+        return 0;
+    }
+
+    MiniMidi_Edit *edit = _push( self, MINIMIDI_EDIT_REPLACE );
+    if (!edit) return 1;
+
+    edit->before = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+    edit->after = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+
+    if (!edit->before || !edit->after || _sel_copy( &(edit->sel), sel ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        edit->before[k] = track->event_arr[ _sel_at(sel, k) ];
+    }
+    memcpy( edit->after, new_events, sel->count * sizeof( MiniMidi_Event ) );
+
+    _apply( track, edit, false );
+    _commit( self, edit );
+
+    return 0;
+}
+
+int MiniMidi_History_remove( MiniMidi_History *self, MiniMidi_Selection *sel )
+{
+    MiniMidi_Track *track = self->track;
+
+    if (!sel->count) return 0;
+    if (!_sel_is_valid( sel, track->n_events )) return 1;
+
+    MiniMidi_Edit *edit = _push( self, MINIMIDI_EDIT_REMOVE );
+    if (!edit) return 1;
+
+    edit->before = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+    if (!edit->before || _sel_copy( &(edit->sel), sel ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        edit->before[k] = track->event_arr[ _sel_at(sel, k) ];
+    }
+
+    _apply( track, edit, false );
+    _commit( self, edit );
+
+    return 0;
+}
+
+int MiniMidi_History_insert( MiniMidi_History *self, MiniMidi_Event *events, size_t n )
+{
+    if (!n) return 0;
+
+    MiniMidi_Edit *edit = _push( self, MINIMIDI_EDIT_INSERT );
+    if (!edit) return 1;
+
+    edit->sel.count = n;
+    edit->sel.indices = (uint32_t*)malloc( n * sizeof( uint32_t ) );
+    edit->after = (MiniMidi_Event*)malloc( n * sizeof( MiniMidi_Event ) );
+
+    if (!edit->sel.indices || !edit->after)
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    memcpy( edit->after, events, n * sizeof( MiniMidi_Event ) );
+    if (!_is_sorted( edit->after, n )) MiniMidi_Event_sort_by_ticks( edit->after, n );
+
+    if (_apply( self->track, edit, false ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+    _commit( self, edit );
+
+    return 0;
+}
+
+int MiniMidi_History_move( MiniMidi_History *self, MiniMidi_Selection *sel, MiniMidi_Event *new_events )
+{
+    MiniMidi_Track *track = self->track;
+
+    if (!sel->count) return 0;
+    if (!_sel_is_valid( sel, track->n_events )) return 1;
+
+    MiniMidi_Edit *edit = _push( self, MINIMIDI_EDIT_MOVE );
+    if (!edit) return 1;
+
+    edit->before = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+    edit->after = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+    edit->landed.count = sel->count;
+    edit->landed.indices = (uint32_t*)malloc( sel->count * sizeof( uint32_t ) );
+
+    if (!edit->before || !edit->after || !edit->landed.indices || _sel_copy( &(edit->sel), sel ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        edit->before[k] = track->event_arr[ _sel_at(sel, k) ];
+    }
+    memcpy( edit->after, new_events, sel->count * sizeof( MiniMidi_Event ) );
+
+    // copies of a selection moved together are in order already
+    if (( !_is_sorted( edit->after, sel->count ) && MiniMidi_Event_sort_by_ticks( edit->after, sel->count ) )
+        || _apply( track, edit, false ))
+    {
+        _edit_free( edit );
+        return 1;
+    }
+
+    if (sel->indices) memcpy( sel->indices, edit->landed.indices, sel->count * sizeof( uint32_t ) );
+    _commit( self, edit );
+
+    return 0;
+}
+
+int MiniMidi_History_begin_group( MiniMidi_History *self )
+{
+    if (self->open_group) return 1;
+
+    self->open_group = ++self->next_group;
+    return 0;
+}
+
+int MiniMidi_History_end_group( MiniMidi_History *self )
+{
+    self->open_group = 0;
+    return 0;
+}
+
+int MiniMidi_History_undo( MiniMidi_History *self )
+{
+    if (!MiniMidi_History_can_undo( self )) return 1;
+
+    unsigned int g = self->edits[ self->n_applied - 1 ].group;
+    size_t first = self->n_applied;
+
+    while (first > 0 && self->edits[ first - 1 ].group == g) first--;
+
+    // after this no edit of the group can fail
+    if (_reserve_group( self, first, self->n_applied, true )) return 1;
+
+    while (self->n_applied > first)
+    {
+        if (_apply( self->track, &(self->edits[ self->n_applied - 1 ]), true )) return 1;
+        self->n_applied--;
+    }
+
+    return 0;
+}
+
+int MiniMidi_History_redo( MiniMidi_History *self )
+{
+    if (!MiniMidi_History_can_redo( self )) return 1;
+
+    unsigned int g = self->edits[ self->n_applied ].group;
+    size_t last = self->n_applied;
+
+    while (last < self->n_edits && self->edits[ last ].group == g) last++;
+
+    if (_reserve_group( self, self->n_applied, last, false )) return 1;
+
+    while (self->n_applied < last)
+    {
+        if (_apply( self->track, &(self->edits[ self->n_applied ]), false )) return 1;
+        self->n_applied++;
+    }
+
+    return 0;
+}
+
+bool MiniMidi_History_can_undo( MiniMidi_History *self )
+{
+    return self->n_applied > 0;
+}
+
+bool MiniMidi_History_can_redo( MiniMidi_History *self )
+{
+    return self->n_applied < self->n_edits;
+}
@@ -0,0 +1,116 @@
+#ifndef MINIMIDI_HISTORY_H
+#define MINIMIDI_HISTORY_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "minimidi.h"
+
+// default memory budget for a track's undo history
+#define MINIMIDI_HISTORY_DEFAULT_BUDGET ( 64 * 1024 * 1024 )
+
+// edits of the same kind on the same selection closer than this get merged
+#define MINIMIDI_HISTORY_COALESCE_MS 500
+
+/***
+*  * Undo / Redo:
+*
+*   Edits are stored as deltas against the track, never as snapshots.
+*   Arithmetic edits (transpose) keep only the selection and the amount,
+*   so a transpose over a contiguous run costs a few bytes whatever its size.
+*   Lossy edits (replace, remove, move) keep copies of the touched events only.
+*
+*   Edits are replayed in LIFO order, so the indices they recorded are
+*   always valid at the time they are reverted.
+*/
+typedef enum {
+    MINIMIDI_EDIT_TRANSPOSE,    // add semitones to the pitch of note events
+    MINIMIDI_EDIT_REPLACE,      // overwrite events in place, ticks unchanged
+    MINIMIDI_EDIT_REMOVE,       // take events out of the track
+    MINIMIDI_EDIT_INSERT,       // put events in the track, sorted by abs_ticks
+    MINIMIDI_EDIT_MOVE          // swap events for ones on other ticks, in one merge
+} MiniMidi_Edit_Kind;
+
+/***
+*  Which events an edit touches:
+*   indices == NULL -> contiguous run [ first, first + count )
+*   otherwise       -> count sorted indices
+*/
+typedef struct MiniMidi_Selection
+{
+    size_t    first,
+              count;
+    uint32_t *indices;
+
+} MiniMidi_Selection;
+
+typedef struct MiniMidi_Edit
+{
+    MiniMidi_Edit_Kind  kind;
+    unsigned int        group;      // edits sharing a group are undone together
+
+    MiniMidi_Selection  sel;
+    int                 amount;     // TRANSPOSE: semitones
+
+    // TRANSPOSE: events that hit the 0..127 range, with their old pitch
+    uint32_t           *clamped;
+    _Byte              *clamped_pitch;
+    size_t              n_clamped;
+
+    // REPLACE, MOVE: before / after. REMOVE, INSERT: the events themselves
+    MiniMidi_Event     *before,
+                       *after;
+
+    // MOVE: where the after events landed
+    MiniMidi_Selection  landed;
+
+    struct timespec     stamp;
+    size_t              bytes;      // memory held by this edit
+
+} MiniMidi_Edit;
+
+typedef struct MiniMidi_History
+{
+    MiniMidi_Track *track;
+
+    MiniMidi_Edit  *edits;
+    size_t          n_edits,    // recorded
+                    n_applied,  // undo cursor, edits past it can be redone
+                    capacity;
+
+    size_t          bytes_used,
+                    budget;
+
+    unsigned int    next_group,
+                    open_group; // 0 -> every edit is its own group
+
+} MiniMidi_History;
+
+MiniMidi_History    *MiniMidi_History_init( MiniMidi_Track *track, size_t budget_bytes );
+void                MiniMidi_History_free( MiniMidi_History *self );
+
+// edits, applied to the track and recorded. return 0 on success
+int MiniMidi_History_transpose( MiniMidi_History *self, MiniMidi_Selection *sel, int semitones );
+int MiniMidi_History_replace( MiniMidi_History *self, MiniMidi_Selection *sel, MiniMidi_Event *new_events );
+int MiniMidi_History_remove( MiniMidi_History *self, MiniMidi_Selection *sel );
+int MiniMidi_History_insert( MiniMidi_History *self, MiniMidi_Event *events, size_t n );
+
+// the selected events are taken out and new_events ( as many ) merged in, with a single
+// relink. when sel has indices, they are overwritten with where new_events landed
+int MiniMidi_History_move( MiniMidi_History *self, MiniMidi_Selection *sel, MiniMidi_Event *new_events );
+
+// compound edits, e.g. a move is a remove + an insert
+int MiniMidi_History_begin_group( MiniMidi_History *self );
+int MiniMidi_History_end_group( MiniMidi_History *self );
+
+// a whole group at a time. nonzero when there is nothing to take back or replay, or
+// there is no memory for it: the track is then left as it was
+int MiniMidi_History_undo( MiniMidi_History *self );
+int MiniMidi_History_redo( MiniMidi_History *self );
+
+bool MiniMidi_History_can_undo( MiniMidi_History *self );
+bool MiniMidi_History_can_redo( MiniMidi_History *self );
+
+#endif /* MINIMIDI_HISTORY_H */
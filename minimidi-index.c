@@ -0,0 +1,743 @@
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "minimidi-index.h"
+#include "minimidi-shared.h"
+#include "minimidi-log.h"
+
+int hook_up_events( MiniMidi_Event *arr, size_t n );
+int _decode_event( _Byte *data, size_t len, size_t *offset, _Byte *status, uint64_t *ticks, MiniMidi_Event *evt );
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Skimming
+****************************************************************************************/
+// checkpoint from where the skim is now
+static int _add_checkpoint( MiniMidi_Seek_Index *idx )
+{
+    if (idx->n_checkpoints == idx->cap_checkpoints)
+    {
+        size_t cap = idx->cap_checkpoints ? idx->cap_checkpoints * 2 : 64;
+        MiniMidi_Checkpoint *cps = (MiniMidi_Checkpoint*)realloc( idx->checkpoints, cap * sizeof( MiniMidi_Checkpoint ) );
+        if (!cps) return 1;
+        idx->checkpoints = cps;
+
+        MiniMidi_Block *blocks = (MiniMidi_Block*)realloc( idx->blocks, cap * sizeof( MiniMidi_Block ) );
+        if (!blocks) return 1;
+        memset( blocks + idx->cap_checkpoints, 0, (cap - idx->cap_checkpoints) * sizeof( MiniMidi_Block ) );
+        idx->blocks = blocks;
+
+        idx->cap_checkpoints = cap;
+    }
+
+    MiniMidi_Checkpoint *cp = &(idx->checkpoints[ idx->n_checkpoints ]);
+    cp->offset = idx->scan_offset;
+    cp->event_index = idx->scan_events;
+    cp->abs_ticks = idx->scan_ticks;
+    cp->running_status = idx->scan_status;
+    cp->first_open = idx->n_open;
+    cp->n_open = 0;
+
+    for (int p = 0; p < MINIMIDI_NOTE_KEYS; p++)
+    {
+        if (!idx->is_sounding[p]) continue;
+
+        if (idx->n_open == idx->cap_open)
+        {
+            size_t cap = idx->cap_open ? idx->cap_open * 2 : 256;
+            MiniMidi_Open_Note *pool = (MiniMidi_Open_Note*)realloc( idx->open_pool, cap * sizeof( MiniMidi_Open_Note ) );
+            if (!pool) return 1;
+            idx->open_pool = pool;
+            idx->cap_open = cap;
+        }
+        idx->open_pool[ idx->n_open++ ] = idx->sounding[p];
+        cp->n_open++;
+    }
+
+    idx->n_checkpoints++;
+    return 0;
+}
+
+// skim one more block and close it with a checkpoint
+static int _skim_block( MiniMidi_Seek_Index *idx )
+{
+    MiniMidi_Event evt;
+    size_t start = idx->scan_offset,
+           n = 0;
+
+    while (n < MINIMIDI_INDEX_BLOCK_EVENTS && idx->scan_offset - start < MINIMIDI_INDEX_BLOCK_BYTES)
+    {
+        if (_decode_event( idx->data, idx->length, &(idx->scan_offset), &(idx->scan_status), &(idx->scan_ticks), &evt ))
+        {
+            idx->is_complete = true;
+            break;
+        }
+        n++;
+
+        size_t p = MINIMIDI_NOTE_KEY( &evt );
+        if (evt.status_code == MIDI_NOTE_ON)
+        {
+            idx->sounding[p].abs_ticks = evt.abs_ticks;
+            idx->sounding[p].channel = evt.channel;
+            idx->sounding[p].pitch = evt.evt_data[0];
+            idx->sounding[p].velocity = evt.evt_data[1];
+            idx->is_sounding[p] = true;
+        }
+        else if (evt.status_code == MIDI_NOTE_OFF)
+        {
+            idx->is_sounding[p] = false;
+        }
+    }
+    idx->scan_events += n;
+
+    // nothing was left, the last checkpoint already marks the end
+    if (!n) return 0;
+
+    return _add_checkpoint( idx );
+}
+
+static size_t _n_blocks( MiniMidi_Seek_Index *idx )
+{
+    return idx->n_checkpoints ? idx->n_checkpoints - 1 : 0;
+}
+
+// blocks that hold ticks in [ start_ticks, end_ticks ], as far as the skim got
+static void _block_range( MiniMidi_Seek_Index *idx, uint64_t start_ticks, uint64_t end_ticks, size_t *first, size_t *last )
+{
+    size_t n_blocks = _n_blocks( idx ),
+           lo = 0,
+           hi = n_blocks;
+
+    // first block that ends at or after start_ticks
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (idx->checkpoints[mid + 1].abs_ticks < start_ticks) lo = mid + 1; else hi = mid;
+    }
+    *first = lo;
+
+    // last block that starts at or before end_ticks
+    lo = *first;
+    hi = n_blocks;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (idx->checkpoints[mid].abs_ticks <= end_ticks) lo = mid + 1; else hi = mid;
+    }
+    *last = lo > *first ? lo - 1 : *first;
+}
+
+static int _decode_block( MiniMidi_Lazy_File *self, MiniMidi_Seek_Index *idx, size_t k )
+{
+    MiniMidi_Block *block = &(idx->blocks[k]);
+    MiniMidi_Checkpoint *cp = &(idx->checkpoints[k]);
+
+    block->last_used = ++self->clock;
+    if (block->events) return 0;
+
+    size_t n = idx->checkpoints[k + 1].event_index - cp->event_index,
+           offset = cp->offset;
+    _Byte status = cp->running_status;
+    uint64_t ticks = cp->abs_ticks;
+
+    block->events = (MiniMidi_Event*)malloc( ( n ? n : 1 ) * sizeof( MiniMidi_Event ) );
+    if (!block->events) return 1;
+
+    // filtered out events are decoded over, the next one takes their slot
+    block->n_events = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        MiniMidi_Event *evt = &(block->events[ block->n_events ]);
+
+        if (self->is_shared)
+        {
+            // already decoded, only widened
+            const MiniMidi_Shared_Event *shared = (const MiniMidi_Shared_Event*)( idx->data + offset ) + i;
+
+            memset( evt, 0, sizeof( MiniMidi_Event ) );
+            evt->abs_ticks = shared->abs_ticks;
+            evt->delta_ticks = shared->abs_ticks - ticks;
+            evt->status_code = (MidiStatusCode)shared->status;
+            evt->channel = shared->channel;
+            evt->evt_data[0] = shared->data[0];
+            evt->evt_data[1] = shared->data[1];
+            if (evt->status_code == MIDI_NOTE_ON || evt->status_code == MIDI_NOTE_OFF) evt->note = _event_data_bytes_to_note( evt->evt_data[0] );
+            ticks = shared->abs_ticks;
+        }
+        else if (_decode_event( idx->data, idx->length, &offset, &status, &ticks, evt ))
+        {
+            break;
+        }
+        if (!self->has_filter || MiniMidi_Filter_keeps( &(self->filter), evt )) block->n_events++;
+    }
+
+    self->bytes_used += block->n_events * sizeof( MiniMidi_Event );
+    return 0;
+}
+
+// drop least recently used blocks until under budget, never the ones in [ keep_first, keep_last ] of keep
+static void _evict( MiniMidi_Lazy_File *self, MiniMidi_Seek_Index *keep, size_t keep_first, size_t keep_last )
+{
+    while (self->bytes_used > self->budget)
+    {
+        MiniMidi_Block *oldest = NULL;
+
+        for (size_t t = 0; t < self->file->n_tracks; t++)
+        {
+            MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+            for (size_t k = 0; k < _n_blocks( idx ); k++)
+            {
+                if (!idx->blocks[k].events) continue;
+                if (idx == keep && k >= keep_first && k <= keep_last) continue;
+
+                if (!oldest || idx->blocks[k].last_used < oldest->last_used) oldest = &(idx->blocks[k]);
+            }
+        }
+
+        if (!oldest) return;
+
+        self->bytes_used -= oldest->n_events * sizeof( MiniMidi_Event );
+        free( oldest->events );
+        oldest->events = NULL;
+        oldest->n_events = 0;
+    }
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Windows
+****************************************************************************************/
+// blocks keep every NOTE ON before a filter's tick window, they can't tell which still
+// sound in it. once linked, only those stay, the last of their channel and pitch
+static size_t _drop_before_window( MiniMidi_Event *arr, size_t n, uint64_t start_ticks )
+{
+    bool is_seen[MINIMIDI_NOTE_KEYS] = { false };
+    size_t w = 0,
+           first = 0;
+
+    while (first < n && arr[first].abs_ticks < start_ticks) first++;
+
+    for (size_t i = first; i-- > 0; )
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        size_t key = MINIMIDI_NOTE_KEY( evt );
+
+        if (evt->status_code == MIDI_NOTE_ON && !is_seen[key] && ( !evt->next || evt->next->abs_ticks >= start_ticks ))
+        {
+            is_seen[key] = true;
+            continue;
+        }
+        if (evt->status_code == MIDI_NOTE_ON) is_seen[key] = true;
+        evt->status_code = MIDI_INVALID;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (arr[i].status_code != MIDI_INVALID) arr[ w++ ] = arr[i];
+    }
+
+    if (w < n) hook_up_events( arr, w );
+    return w;
+}
+
+// decode what is needed for [ start_ticks, end_ticks ] and copy it into the track, with the lock held
+static int _view( MiniMidi_Lazy_File *self, size_t track, uint64_t start_ticks, uint64_t end_ticks )
+{
+    MiniMidi_Seek_Index *idx = &(self->index[track]);
+    MiniMidi_Track *window = &(self->file->tracks[track]);
+
+    // skim until the viewport's end is covered
+    while (!idx->is_complete && idx->checkpoints[ idx->n_checkpoints - 1 ].abs_ticks <= end_ticks)
+    {
+        if (_skim_block( idx )) return 1;
+    }
+
+    size_t n_blocks = _n_blocks( idx ),
+           first,
+           last;
+
+    _block_range( idx, start_ticks, end_ticks, &first, &last );
+
+    if (idx->has_window && idx->window_first == first && idx->window_last == last)
+    {
+        for (size_t k = first; k < last + 1 && k < n_blocks; k++) idx->blocks[k].last_used = ++self->clock;
+        return 0;
+    }
+
+    // notes that started before the first block go in front, so their NOTE OFFs get linked
+    size_t count = first < n_blocks ? idx->checkpoints[first].n_open : 0;
+
+    for (size_t k = first; k < last + 1 && k < n_blocks; k++)
+    {
+        if (_decode_block( self, idx, k )) return 1;
+        count += idx->blocks[k].n_events;
+    }
+
+    if (count > window->capacity)
+    {
+        MiniMidi_Event *arr = (MiniMidi_Event*)realloc( window->event_arr, count * sizeof( MiniMidi_Event ) );
+        if (!arr) return 1;
+        window->event_arr = arr;
+        window->capacity = count;
+    }
+
+    size_t n = 0;
+    if (first < n_blocks)
+    {
+        MiniMidi_Checkpoint *cp = &(idx->checkpoints[first]);
+
+        for (uint32_t o = 0; o < cp->n_open; o++)
+        {
+            MiniMidi_Open_Note *on = &(idx->open_pool[ cp->first_open + o ]);
+            MiniMidi_Event *evt = &(window->event_arr[n++]);
+
+            memset( evt, 0, sizeof( MiniMidi_Event ) );
+            evt->abs_ticks = on->abs_ticks;
+            evt->status_code = MIDI_NOTE_ON;
+            evt->channel = on->channel;
+            evt->evt_data[0] = on->pitch;
+            evt->evt_data[1] = on->velocity;
+            evt->note = _event_data_bytes_to_note( on->pitch );
+
+            if (self->has_filter && !MiniMidi_Filter_keeps( &(self->filter), evt )) n--;
+        }
+    }
+
+    for (size_t k = first; k < last + 1 && k < n_blocks; k++)
+    {
+        if (idx->blocks[k].n_events) memcpy( window->event_arr + n, idx->blocks[k].events, idx->blocks[k].n_events * sizeof( MiniMidi_Event ) );
+        n += idx->blocks[k].n_events;
+    }
+
+    hook_up_events( window->event_arr, n );
+    if (self->has_filter && self->filter.start_ticks) n = _drop_before_window( window->event_arr, n, self->filter.start_ticks );
+
+    window->n_events = n;
+    window->total_ticks = n ? window->event_arr[n - 1].abs_ticks : 0;
+    window->total_beats = window->total_ticks / self->file->header->ppqn + 1;
+
+    idx->window_first = first;
+    idx->window_last = last;
+    idx->has_window = true;
+
+    _evict( self, idx, first, last );
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Prefetch
+****************************************************************************************/
+// skim or decode one block towards [ start_ticks, end_ticks ] of idx, 1 once it is all there
+static int _prefetch_step( MiniMidi_Lazy_File *self, MiniMidi_Seek_Index *idx, uint64_t start_ticks, uint64_t end_ticks )
+{
+    if (!idx->is_complete && idx->checkpoints[ idx->n_checkpoints - 1 ].abs_ticks <= end_ticks)
+    {
+        return _skim_block( idx );
+    }
+
+    size_t first, last;
+    _block_range( idx, start_ticks, end_ticks, &first, &last );
+
+    for (size_t k = first; k < last + 1 && k < _n_blocks( idx ); k++)
+    {
+        if (idx->blocks[k].events) continue;
+        if (_decode_block( self, idx, k )) return 1;
+
+        _evict( self, idx, first, last );
+        return 0;
+    }
+    return 1;
+}
+
+static void *_prefetch_loop( void *arg )
+{
+    MiniMidi_Lazy_File *self = (MiniMidi_Lazy_File*)arg;
+
+    pthread_mutex_lock( &(self->lock) );
+    while (!self->is_stopping)
+    {
+        if (!self->has_request)
+        {
+            pthread_cond_wait( &(self->wake), &(self->lock) );
+            continue;
+        }
+
+        uint64_t start_ticks = self->request_start,
+                 end_ticks = self->request_end;
+
+        self->has_request = false;
+        memcpy( self->work_tracks, self->request_tracks, self->file->n_tracks * sizeof( bool ) );
+
+        for (size_t t = 0; t < self->file->n_tracks && !self->has_request && !self->is_stopping; t++)
+        {
+            if (!self->work_tracks[t]) continue;
+
+            while (!self->has_request && !self->is_stopping
+                && !_prefetch_step( self, &(self->index[t]), start_ticks, end_ticks ))
+            {
+                // let the view in between blocks
+                pthread_mutex_unlock( &(self->lock) );
+                sched_yield();
+                pthread_mutex_lock( &(self->lock) );
+            }
+        }
+    }
+    pthread_mutex_unlock( &(self->lock) );
+
+    return NULL;
+}
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Lazy_File *MiniMidi_Lazy_File_init( const char *file_path, size_t budget )
+{
+    struct stat st;
+    int fd = open( file_path, O_RDONLY );
+
+    if (fd < 0) return NULL;
+    if (fstat( fd, &st ) || st.st_size < 14)
+    {
+        close( fd );
+        return NULL;
+    }
+
+    _Byte *map = (_Byte*)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (map == MAP_FAILED) return NULL;
+
+    MiniMidi_Lazy_File *self = (MiniMidi_Lazy_File*)calloc( 1, sizeof( MiniMidi_Lazy_File ) );
+    if (!self)
+    {
+        munmap( map, st.st_size );
+        return NULL;
+    }
+    self->map = map;
+    self->map_length = st.st_size;
+    self->budget = budget ? budget : MINIMIDI_INDEX_DEFAULT_BUDGET;
+    pthread_mutex_init( &(self->lock), NULL );
+    pthread_cond_init( &(self->wake), NULL );
+
+    self->file = create_mini_midi_file( file_path );
+    if (!self->file || memcmp( map, "MThd", 4 ) != 0)
+    {
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    _midi_header_read( self->file->header, map );
+    self->file->length = self->map_length;
+
+    if (!self->file->header->ppqn)
+    {
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    // only the chunk headers are read here
+    size_t first_chunk = 8 + self->file->header->length,
+           cursor,
+           n_tracks = 0;
+    uint32_t chunk_len;
+
+    for (cursor = first_chunk; cursor + 8 <= self->map_length; cursor += (size_t)chunk_len + 8)
+    {
+        chunk_len = ( map[cursor + 4] << 24 ) | ( map[cursor + 5] << 16 ) | ( map[cursor + 6] << 8 ) | map[cursor + 7];
+        if (memcmp( map + cursor, "MTrk", 4 ) == 0) n_tracks++;
+    }
+
+    MiniMidi_Track *tracks = n_tracks ? (MiniMidi_Track*)calloc( n_tracks, sizeof( MiniMidi_Track ) ) : NULL;
+    self->index = n_tracks ? (MiniMidi_Seek_Index*)calloc( n_tracks, sizeof( MiniMidi_Seek_Index ) ) : NULL;
+    self->request_tracks = (bool*)calloc( n_tracks ? n_tracks : 1, sizeof( bool ) );
+    self->work_tracks = (bool*)calloc( n_tracks ? n_tracks : 1, sizeof( bool ) );
+
+    if (!tracks || !self->index || !self->request_tracks || !self->work_tracks)
+    {
+        free( tracks );
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    // the placeholder track stays in the file's arena
+    self->file->tracks = tracks;
+    self->file->track = tracks;
+    self->file->n_tracks = n_tracks;
+
+    size_t t = 0;
+    for (cursor = first_chunk; cursor + 8 <= self->map_length && t < n_tracks; cursor += (size_t)chunk_len + 8)
+    {
+        chunk_len = ( map[cursor + 4] << 24 ) | ( map[cursor + 5] << 16 ) | ( map[cursor + 6] << 8 ) | map[cursor + 7];
+        if (memcmp( map + cursor, "MTrk", 4 ) != 0) continue;
+
+        MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+        // a truncated last chunk is read as far as it goes
+        idx->data = map + cursor + 8;
+        idx->length = chunk_len < self->map_length - cursor - 8 ? chunk_len : self->map_length - cursor - 8;
+        tracks[t].length = idx->length;
+
+        if (_add_checkpoint( idx ))
+        {
+            MiniMidi_Lazy_File_free( self );
+            return NULL;
+        }
+        t++;
+    }
+
+    // conversions still work, at 120 BPM
+    if (_build_tempo_map( self->file ))
+    {
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-index.c > MiniMidi_Lazy_File_init() : mapped %s : %zu bytes, %zu tracks",
+        file_path, self->map_length, n_tracks );
+    MiniMidi_Log_writeline();
+
+    return self;
+}
+
+MiniMidi_Lazy_File *MiniMidi_Lazy_File_init_shared( const char *file_path, int fd, size_t budget )
+{
+    const MiniMidi_Shared_Header *header = MiniMidi_Shared_map( fd );
+    if (!header) return NULL;
+
+    MiniMidi_Lazy_File *self = (MiniMidi_Lazy_File*)calloc( 1, sizeof( MiniMidi_Lazy_File ) );
+    if (!self)
+    {
+        MiniMidi_Shared_unmap( header );
+        return NULL;
+    }
+    self->map = (_Byte*)header;
+    self->map_length = header->size;
+    self->is_shared = true;
+    self->budget = budget ? budget : MINIMIDI_INDEX_DEFAULT_BUDGET;
+    pthread_mutex_init( &(self->lock), NULL );
+    pthread_cond_init( &(self->wake), NULL );
+
+    size_t n_tracks = header->n_tracks;
+
+    self->file = create_mini_midi_file( file_path );
+    MiniMidi_Track *tracks = n_tracks ? (MiniMidi_Track*)calloc( n_tracks, sizeof( MiniMidi_Track ) ) : NULL;
+    self->index = n_tracks ? (MiniMidi_Seek_Index*)calloc( n_tracks, sizeof( MiniMidi_Seek_Index ) ) : NULL;
+    self->request_tracks = (bool*)calloc( n_tracks ? n_tracks : 1, sizeof( bool ) );
+    self->work_tracks = (bool*)calloc( n_tracks ? n_tracks : 1, sizeof( bool ) );
+
+    if (!self->file || !tracks || !self->index || !self->request_tracks || !self->work_tracks)
+    {
+        free( tracks );
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    self->file->header->format = header->format;
+    self->file->header->ntrks = n_tracks;
+    self->file->header->ppqn = header->ppqn;
+    self->file->length = header->file_length;
+
+    // the placeholder track stays in the file's arena
+    self->file->tracks = tracks;
+    self->file->track = tracks;
+    self->file->n_tracks = n_tracks;
+
+    // the checkpoints are copied, they are a few for every block. an offset is where its block starts
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        const MiniMidi_Shared_Track *shared = MiniMidi_Shared_tracks( header ) + t;
+        const MiniMidi_Shared_Checkpoint *cps = MiniMidi_Shared_checkpoints( header, shared );
+        MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+        idx->data = (_Byte*)MiniMidi_Shared_events( header, shared );
+        idx->length = shared->n_events * sizeof( MiniMidi_Shared_Event );
+        tracks[t].length = shared->length;
+
+        idx->checkpoints = (MiniMidi_Checkpoint*)malloc( shared->n_checkpoints * sizeof( MiniMidi_Checkpoint ) );
+        idx->blocks = (MiniMidi_Block*)calloc( shared->n_checkpoints, sizeof( MiniMidi_Block ) );
+        idx->open_pool = (MiniMidi_Open_Note*)malloc( ( shared->n_open ? shared->n_open : 1 ) * sizeof( MiniMidi_Open_Note ) );
+
+        if (!idx->checkpoints || !idx->blocks || !idx->open_pool)
+        {
+            MiniMidi_Lazy_File_free( self );
+            return NULL;
+        }
+
+        for (size_t k = 0; k < shared->n_checkpoints; k++)
+        {
+            MiniMidi_Checkpoint *cp = &(idx->checkpoints[k]);
+
+            cp->offset = cps[k].event_index * sizeof( MiniMidi_Shared_Event );
+            cp->event_index = cps[k].event_index;
+            cp->abs_ticks = cps[k].abs_ticks;
+            cp->running_status = 0;
+            cp->first_open = cps[k].first_open;
+            cp->n_open = cps[k].n_open;
+        }
+        memcpy( idx->open_pool, MiniMidi_Shared_open_notes( header, shared ), shared->n_open * sizeof( MiniMidi_Open_Note ) );
+
+        idx->n_checkpoints = idx->cap_checkpoints = shared->n_checkpoints;
+        idx->n_open = idx->cap_open = shared->n_open;
+
+        // nothing left to skim
+        idx->is_complete = true;
+        idx->scan_offset = idx->length;
+        idx->scan_events = shared->n_events;
+        idx->scan_ticks = shared->total_ticks;
+    }
+
+    // the tempo map came along, playing and times work as for a parsed file
+    if (header->n_tempos)
+    {
+        tracks[0].tempo_arr = (MiniMidi_Tempo*)malloc( header->n_tempos * sizeof( MiniMidi_Tempo ) );
+        if (!tracks[0].tempo_arr)
+        {
+            MiniMidi_Lazy_File_free( self );
+            return NULL;
+        }
+        memcpy( tracks[0].tempo_arr, MiniMidi_Shared_tempos( header ), header->n_tempos * sizeof( MiniMidi_Tempo ) );
+        tracks[0].n_tempos = tracks[0].tempo_capacity = header->n_tempos;
+    }
+    else if (_build_tempo_map( self->file ))
+    {
+        MiniMidi_Lazy_File_free( self );
+        return NULL;
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-index.c > MiniMidi_Lazy_File_init_shared() : %s : %zu byte segment, %zu tracks",
+        file_path, self->map_length, n_tracks );
+    MiniMidi_Log_writeline();
+
+    return self;
+}
+
+void MiniMidi_Lazy_File_free( MiniMidi_Lazy_File *self )
+{
+    if (!self) return;
+
+    if (self->has_thread)
+    {
+        pthread_mutex_lock( &(self->lock) );
+        self->is_stopping = true;
+        pthread_cond_signal( &(self->wake) );
+        pthread_mutex_unlock( &(self->lock) );
+        pthread_join( self->thread, NULL );
+    }
+    pthread_mutex_destroy( &(self->lock) );
+    pthread_cond_destroy( &(self->wake) );
+
+    for (size_t t = 0; self->index && t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+        for (size_t k = 0; k < _n_blocks( idx ); k++) free( idx->blocks[k].events );
+        free( idx->blocks );
+        free( idx->checkpoints );
+        free( idx->open_pool );
+    }
+    free( self->index );
+    free( self->request_tracks );
+    free( self->work_tracks );
+
+    if (self->file) MiniMidi_File_free( self->file );
+    munmap( self->map, self->map_length );
+    free( self );
+}
+
+int MiniMidi_Lazy_File_set_filter( MiniMidi_Lazy_File *self, const MiniMidi_Filter *filter )
+{
+    pthread_mutex_lock( &(self->lock) );
+
+    self->has_filter = filter != NULL;
+    if (filter) self->filter = *filter;
+
+    // everything decoded so far was kept by the old filter
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+        for (size_t k = 0; k < _n_blocks( idx ); k++)
+        {
+            self->bytes_used -= idx->blocks[k].n_events * sizeof( MiniMidi_Event );
+            free( idx->blocks[k].events );
+            idx->blocks[k].events = NULL;
+            idx->blocks[k].n_events = 0;
+        }
+        idx->has_window = false;
+    }
+
+    pthread_mutex_unlock( &(self->lock) );
+    return 0;
+}
+
+int MiniMidi_Lazy_view( MiniMidi_Lazy_File *self, size_t track, uint64_t start_ticks, uint64_t end_ticks )
+{
+    if (track >= self->file->n_tracks) return 1;
+
+    pthread_mutex_lock( &(self->lock) );
+    int err = _view( self, track, start_ticks, end_ticks );
+    pthread_mutex_unlock( &(self->lock) );
+
+    return err;
+}
+
+int MiniMidi_Lazy_prefetch( MiniMidi_Lazy_File *self, uint64_t start_ticks, uint64_t end_ticks, const bool *tracks )
+{
+    pthread_mutex_lock( &(self->lock) );
+
+    self->request_start = start_ticks;
+    self->request_end = end_ticks;
+    for (size_t t = 0; t < self->file->n_tracks; t++) self->request_tracks[t] = tracks ? tracks[t] : true;
+    self->has_request = true;
+
+    if (!self->has_thread) self->has_thread = pthread_create( &(self->thread), NULL, _prefetch_loop, self ) == 0;
+    pthread_cond_signal( &(self->wake) );
+
+    pthread_mutex_unlock( &(self->lock) );
+
+    return self->has_thread ? 0 : 1;
+}
+
+void MiniMidi_Lazy_progress( MiniMidi_Lazy_File *self, size_t *n_events, uint64_t *total_ticks, double *fraction )
+{
+    size_t scanned = 0,
+           total = 0;
+
+    *n_events = 0;
+    *total_ticks = 0;
+
+    pthread_mutex_lock( &(self->lock) );
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Seek_Index *idx = &(self->index[t]);
+
+        *n_events += idx->scan_events;
+        if (idx->scan_ticks > *total_ticks) *total_ticks = idx->scan_ticks;
+
+        // a finished track counts whole, even if it has trailing garbage
+        scanned += idx->is_complete ? idx->length : idx->scan_offset;
+        total += idx->length;
+    }
+    pthread_mutex_unlock( &(self->lock) );
+
+    *fraction = total ? (double)scanned / total : 1.0;
+}
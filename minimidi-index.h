@@ -0,0 +1,163 @@
+#ifndef MINIMIDI_INDEX_H
+#define MINIMIDI_INDEX_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "minimidi.h"
+
+// a checkpoint every so many events, or bytes when SysEx makes events large
+#define MINIMIDI_INDEX_BLOCK_EVENTS 4096
+#define MINIMIDI_INDEX_BLOCK_BYTES ( 64 * 1024 )
+
+// decoded blocks kept around, the ones on screen are never dropped
+#define MINIMIDI_INDEX_DEFAULT_BUDGET ( 64 * 1024 * 1024 )
+
+// files at least this big are opened lazily by the UI
+#define MINIMIDI_LAZY_MIN_BYTES ( 32 * 1024 * 1024 )
+
+/***
+*  * Seek Index:
+*
+*   VLQ deltas and running status mean a track can only be decoded front to
+*   back. A skim over the bytes (no events are built) leaves a checkpoint
+*   every block: where it starts, the tick and running status at that point
+*   and the notes sounding across it. Any block can then be decoded on its
+*   own.
+*
+*   The skim is done on demand, only as far as the viewport has been, so
+*   opening a huge file costs the first screen and nothing more.
+*/
+typedef struct MiniMidi_Open_Note
+{
+    uint64_t abs_ticks;         // of the NOTE ON
+    _Byte    channel,
+             pitch,
+             velocity;
+
+} MiniMidi_Open_Note;
+
+typedef struct MiniMidi_Checkpoint
+{
+    size_t   offset,            // into the track data, at an event's delta
+             event_index;
+    uint64_t abs_ticks;         // of the event before offset
+    _Byte    running_status;    // 0 if none yet
+    uint32_t first_open,        // notes sounding at offset, in the open pool
+             n_open;
+
+} MiniMidi_Checkpoint;
+
+typedef struct MiniMidi_Block
+{
+    MiniMidi_Event *events;     // NULL while not decoded
+    size_t          n_events;
+    uint64_t        last_used;
+
+} MiniMidi_Block;
+
+typedef struct MiniMidi_Seek_Index
+{
+    _Byte               *data;          // track data, inside the file mapping
+    size_t              length;
+
+    // block k goes from checkpoint k to checkpoint k + 1
+    MiniMidi_Checkpoint *checkpoints;
+    MiniMidi_Block      *blocks;
+    size_t              n_checkpoints,
+                        cap_checkpoints;
+
+    MiniMidi_Open_Note  *open_pool;
+    size_t              n_open,
+                        cap_open;
+
+    // where the skim stopped
+    size_t              scan_offset,
+                        scan_events;
+    uint64_t            scan_ticks;
+    _Byte               scan_status;
+    bool                is_complete;
+
+    // sounding notes during the skim, keyed by channel and pitch like the NOTE ON / OFF links
+    MiniMidi_Open_Note  sounding[MINIMIDI_NOTE_KEYS];
+    bool                is_sounding[MINIMIDI_NOTE_KEYS];
+
+    // the blocks currently copied into the track's window
+    size_t              window_first,
+                        window_last;
+    bool                has_window;
+
+} MiniMidi_Seek_Index;
+
+/***
+*  * Lazy File:
+*
+*   The file is mapped, not read. Every track of file gets an index, and its
+*   event_arr only holds the decoded window asked for with MiniMidi_Lazy_view,
+*   linked like a fully parsed track. Decoded blocks live in an LRU bounded by
+*   budget bytes.
+*
+*   Tempo changes are not looked at: a lazy file is for looking, not playing.
+*
+*   A lazy file can also sit on a segment from the parse daemon ( see Shared
+*   Segment ) instead of the MIDI file: the seek index comes whole with it,
+*   with the tempo map, and blocks are copied out of the segment instead of
+*   decoded.
+*
+*   MiniMidi_Lazy_prefetch hands a range to a thread that skims and decodes
+*   it ahead of the view, so the blocks are there when the view gets to
+*   them. It takes the lock one block at a time and drops what it was doing
+*   as soon as a newer range comes in.
+*/
+typedef struct MiniMidi_Lazy_File
+{
+    MiniMidi_File       *file;
+    MiniMidi_Seek_Index *index;     // one per file->tracks
+
+    _Byte               *map;           // the file, or the segment when is_shared
+    size_t              map_length;
+    bool                is_shared;
+
+    size_t              budget,
+                        bytes_used;
+    uint64_t            clock;
+
+    MiniMidi_Filter     filter;
+    bool                has_filter;
+
+    // held by every call and by the prefetch thread
+    pthread_mutex_t     lock;
+    pthread_cond_t      wake;
+    pthread_t           thread;
+    bool                has_thread,
+                        is_stopping,
+                        has_request;
+    uint64_t            request_start,
+                        request_end;
+    bool                *request_tracks,    // per track, what to prefetch
+                        *work_tracks;       // the thread's copy
+
+} MiniMidi_Lazy_File;
+
+MiniMidi_Lazy_File  *MiniMidi_Lazy_File_init( const char *file_path, size_t budget );
+// on the shared segment in fd, file_path is only what it is called. fd can be closed afterwards
+MiniMidi_Lazy_File  *MiniMidi_Lazy_File_init_shared( const char *file_path, int fd, size_t budget );
+void                MiniMidi_Lazy_File_free( MiniMidi_Lazy_File *self );
+
+// decode only what filter keeps from now on, NULL for everything. decoded blocks are dropped.
+// blocks are decoded on their own, so NOTE OFFs are judged by MiniMidi_Filter_keeps
+int MiniMidi_Lazy_File_set_filter( MiniMidi_Lazy_File *self, const MiniMidi_Filter *filter );
+
+// decode what is needed for ticks in [ start_ticks, end_ticks ] into file->tracks[track]
+int MiniMidi_Lazy_view( MiniMidi_Lazy_File *self, size_t track, uint64_t start_ticks, uint64_t end_ticks );
+
+// have ticks in [ start_ticks, end_ticks ] of the tracks set in tracks ( NULL for all ) decoded
+// in the background, in place of anything asked for before. starts the thread the first time
+int MiniMidi_Lazy_prefetch( MiniMidi_Lazy_File *self, uint64_t start_ticks, uint64_t end_ticks, const bool *tracks );
+
+// how much of the file has been skimmed so far
+void MiniMidi_Lazy_progress( MiniMidi_Lazy_File *self, size_t *n_events, uint64_t *total_ticks, double *fraction );
+
+#endif /* MINIMIDI_INDEX_H */
@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "minimidi.h"
+#include "minimidi-lib.h"
+
+static const size_t _widths[ MINIMIDI_N_COLUMNS ] = {
+    [ MINIMIDI_COLUMN_TICKS ]               = sizeof( uint64_t ),
+    [ MINIMIDI_COLUMN_SECONDS ]             = sizeof( double ),
+    [ MINIMIDI_COLUMN_STATUS ]              = sizeof( uint8_t ),
+    [ MINIMIDI_COLUMN_CHANNEL ]             = sizeof( uint8_t ),
+    [ MINIMIDI_COLUMN_PITCH ]               = sizeof( uint8_t ),
+    [ MINIMIDI_COLUMN_VELOCITY ]            = sizeof( uint8_t ),
+    [ MINIMIDI_COLUMN_DURATION_TICKS ]      = sizeof( uint64_t ),
+    [ MINIMIDI_COLUMN_DURATION_SECONDS ]    = sizeof( double ),
+};
+
+typedef struct MiniMidi_Handle_Track
+{
+    size_t  n_events;
+    void    *columns[ MINIMIDI_N_COLUMNS ];
+
+} MiniMidi_Handle_Track;
+
+struct MiniMidi_Handle
+{
+    MiniMidi_File           *file;      // header and tempo map, the events only live in the columns
+    MiniMidi_Handle_Track   *tracks;
+    size_t                  n_tracks;
+};
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Columns
+****************************************************************************************/
+static int _build_columns( MiniMidi_Handle *self, size_t t )
+{
+    MiniMidi_Track *track = &(self->file->tracks[t]);
+    MiniMidi_Handle_Track *out = &(self->tracks[t]);
+    size_t n = track->n_events;
+
+    out->n_events = n;
+    for (int c = 0; c < MINIMIDI_N_COLUMNS; c++)
+    {
+        out->columns[c] = malloc( ( n ? n : 1 ) * _widths[c] );
+        if (!out->columns[c]) return 1;
+    }
+
+    uint64_t *ticks = out->columns[ MINIMIDI_COLUMN_TICKS ],
+             *duration_ticks = out->columns[ MINIMIDI_COLUMN_DURATION_TICKS ];
+    double   *seconds = out->columns[ MINIMIDI_COLUMN_SECONDS ],
+             *duration_seconds = out->columns[ MINIMIDI_COLUMN_DURATION_SECONDS ];
+    uint8_t  *status = out->columns[ MINIMIDI_COLUMN_STATUS ],
+             *channel = out->columns[ MINIMIDI_COLUMN_CHANNEL ],
+             *pitch = out->columns[ MINIMIDI_COLUMN_PITCH ],
+             *velocity = out->columns[ MINIMIDI_COLUMN_VELOCITY ];
+
+    for (size_t i = 0; i < n; i++)
+    {
+        MiniMidi_Event *evt = &(track->event_arr[i]);
+        uint64_t usec = MiniMidi_File_ticks_to_usec( self->file, evt->abs_ticks );
+
+        ticks[i] = evt->abs_ticks;
+        seconds[i] = usec / 1e6;
+        status[i] = evt->status_code;
+        channel[i] = evt->channel;
+        pitch[i] = evt->evt_data[0];
+        velocity[i] = evt->evt_data[1];
+
+        if (evt->status_code == MIDI_NOTE_ON && evt->next)
+        {
+            duration_ticks[i] = evt->next->abs_ticks - evt->abs_ticks;
+            duration_seconds[i] = ( MiniMidi_File_ticks_to_usec( self->file, evt->next->abs_ticks ) - usec ) / 1e6;
+        }
+        else
+        {
+            duration_ticks[i] = 0;
+            duration_seconds[i] = 0;
+        }
+    }
+
+    // the columns are the events from now on
+    MiniMidi_Track_release( track );
+
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Handle
+****************************************************************************************/
+MiniMidi_Handle *MiniMidi_Handle_open( const char *path )
+{
+    MiniMidi_Handle *self = (MiniMidi_Handle*)calloc( 1, sizeof( MiniMidi_Handle ) );
+    if (!self) return NULL;
+
+    self->file = MiniMidi_File_init( (char*)path );
+    if (!self->file)
+    {
+        free( self );
+        return NULL;
+    }
+
+    self->tracks = (MiniMidi_Handle_Track*)calloc( self->file->n_tracks, sizeof( MiniMidi_Handle_Track ) );
+    if (!self->tracks)
+    {
+        MiniMidi_Handle_close( self );
+        return NULL;
+    }
+
+    for (; self->n_tracks < self->file->n_tracks; self->n_tracks++)
+    {
+        if (_build_columns( self, self->n_tracks ))
+        {
+            self->n_tracks++;   // so its columns get freed
+            MiniMidi_Handle_close( self );
+            return NULL;
+        }
+    }
+
+    return self;
+}
+
+void MiniMidi_Handle_close( MiniMidi_Handle *self )
+{
+    if (!self) return;
+
+    for (size_t t = 0; t < self->n_tracks; t++)
+    {
+        for (int c = 0; c < MINIMIDI_N_COLUMNS; c++) free( self->tracks[t].columns[c] );
+    }
+    free( self->tracks );
+    MiniMidi_File_free( self->file );
+    free( self );
+}
+
+size_t MiniMidi_Handle_n_tracks( MiniMidi_Handle *self )
+{
+    return self->n_tracks;
+}
+
+uint16_t MiniMidi_Handle_ppqn( MiniMidi_Handle *self )
+{
+    return self->file->header->ppqn;
+}
+
+size_t MiniMidi_Handle_n_events( MiniMidi_Handle *self, size_t track )
+{
+    return track < self->n_tracks ? self->tracks[ track ].n_events : 0;
+}
+
+const void *MiniMidi_Handle_column( MiniMidi_Handle *self, size_t track, MiniMidi_Column column, size_t *n )
+{
+    if (track >= self->n_tracks || column < 0 || column >= MINIMIDI_N_COLUMNS)
+    {
+        if (n) *n = 0;
+        return NULL;
+    }
+
+    if (n) *n = self->tracks[ track ].n_events;
+    return self->tracks[ track ].columns[ column ];
+}
+
+size_t MiniMidi_Handle_column_width( MiniMidi_Column column )
+{
+    return column >= 0 && column < MINIMIDI_N_COLUMNS ? _widths[ column ] : 0;
+}
+
+double MiniMidi_Handle_seconds( MiniMidi_Handle *self, uint64_t ticks )
+{
+    return MiniMidi_File_ticks_to_usec( self->file, ticks ) / 1e6;
+}
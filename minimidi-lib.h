@@ -0,0 +1,54 @@
+#ifndef MINIMIDI_LIB_H
+#define MINIMIDI_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***
+*  * libminimidi:
+*
+*   What `make lib` puts in libminimidi.a / libminimidi.so. The parser behind
+*   an opaque handle, with the events of every track laid out as columns.
+*
+*   Columns are built once when the file is opened and belong to the handle:
+*   the pointers stay valid until MiniMidi_Handle_close, so callers wrap them
+*   as arrays instead of copying, e.g. from Python
+*
+*       n = ctypes.c_size_t()
+*       p = lib.MiniMidi_Handle_column( h, 0, MINIMIDI_COLUMN_TICKS, ctypes.byref( n ) )
+*       ticks = numpy.ctypeslib.as_array( ctypes.cast( p, ctypes.POINTER( ctypes.c_uint64 ) ), ( n.value, ) )
+*
+*   Nothing is logged unless the program called MiniMidi_Log_init itself.
+*/
+typedef struct MiniMidi_Handle MiniMidi_Handle;
+
+typedef enum {
+    MINIMIDI_COLUMN_TICKS = 0,          // uint64_t, absolute
+    MINIMIDI_COLUMN_SECONDS,            // double, through the tempo map
+    MINIMIDI_COLUMN_STATUS,             // uint8_t, 0x80 .. 0xF0
+    MINIMIDI_COLUMN_CHANNEL,            // uint8_t
+    MINIMIDI_COLUMN_PITCH,              // uint8_t, first data byte ( meta type for 0xF0 )
+    MINIMIDI_COLUMN_VELOCITY,           // uint8_t, second data byte
+    MINIMIDI_COLUMN_DURATION_TICKS,     // uint64_t, NOTE ON to its NOTE OFF, 0 for the rest
+    MINIMIDI_COLUMN_DURATION_SECONDS,   // double
+    MINIMIDI_N_COLUMNS
+} MiniMidi_Column;
+
+// NULL if the file can't be read or isn't a MIDI file
+MiniMidi_Handle *MiniMidi_Handle_open( const char *path );
+void            MiniMidi_Handle_close( MiniMidi_Handle *self );
+
+size_t          MiniMidi_Handle_n_tracks( MiniMidi_Handle *self );
+uint16_t        MiniMidi_Handle_ppqn( MiniMidi_Handle *self );
+size_t          MiniMidi_Handle_n_events( MiniMidi_Handle *self, size_t track );
+
+// n_events values of column for track, NULL ( and *n = 0 ) when out of range
+const void      *MiniMidi_Handle_column( MiniMidi_Handle *self, size_t track, MiniMidi_Column column, size_t *n );
+
+// bytes per value of column
+size_t          MiniMidi_Handle_column_width( MiniMidi_Column column );
+
+// wall time at ticks
+double          MiniMidi_Handle_seconds( MiniMidi_Handle *self, uint64_t ticks );
+
+#endif /* MINIMIDI_LIB_H */
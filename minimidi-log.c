@@ -16,8 +16,7 @@ static const char *run_header = "\n\n"
     "**************************************************\n"
     "**************************************************\n";
 
-static char date_time_header[100];
-char MiniMidi_Log_log_line[ LOG_LINE_MAX_LEN ]; // extern
+_Thread_local char MiniMidi_Log_log_line[ LOG_LINE_MAX_LEN ]; // extern, one per thread
 FILE *MiniMidi_Log_file;
 
 int MiniMidi_Log_init()
@@ -36,11 +35,15 @@ int MiniMidi_Log_init()
     return 0;
 }
 
-// append right to file, screw performance and whatever
+// append right to file, screw performance and whatever.
+// no-op until MiniMidi_Log_init, so library users don't get a log file
 int MiniMidi_Log_writeline()
 {
+    if (!MiniMidi_Log_file) return 0;
+
+    char date_time_header[100];
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
+    struct tm tm, *t = localtime_r(&now, &tm);
 
     strftime(date_time_header, sizeof(date_time_header)-1, "[ %d/%m/%Y . %H:%M:%S ]", t);
     fprintf( MiniMidi_Log_file, "%s : %s\n", date_time_header, MiniMidi_Log_log_line );
@@ -51,8 +54,12 @@ int MiniMidi_Log_writeline()
 int MiniMidi_Log_free()
 {
     int err;
+
+    if (!MiniMidi_Log_file) return 0;
+
     // Close the file
     err = fclose( MiniMidi_Log_file );
+    MiniMidi_Log_file = NULL;
     if (err !=0) return err;
 
     // free(MiniMidi_Log_log_line);
@@ -6,7 +6,7 @@
 
 #define LOG_LINE_MAX_LEN 512
 
-extern char MiniMidi_Log_log_line[ LOG_LINE_MAX_LEN ];
+extern _Thread_local char MiniMidi_Log_log_line[ LOG_LINE_MAX_LEN ];
 
 int MiniMidi_Log_init();
 int MiniMidi_Log_writeline();
@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "minimidi-merge.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Heap
+****************************************************************************************/
+static inline bool _before( const MiniMidi_Merge_Cursor *a, const MiniMidi_Merge_Cursor *b )
+{
+    return a->abs_ticks < b->abs_ticks || (a->abs_ticks == b->abs_ticks && a->track < b->track);
+}
+
+static void _sift_down( MiniMidi_Merge_Cursor *heap, size_t n, size_t i )
+{
+    MiniMidi_Merge_Cursor c = heap[i];
+
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && _before( &heap[child + 1], &heap[child] )) child++;
+        if (!_before( &heap[child], &c )) break;
+
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = c;
+}
+
+static size_t _first_event_at( MiniMidi_Event *arr, size_t n, uint64_t ticks )
+{
+    size_t lo = 0, hi = n;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (arr[mid].abs_ticks < ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+int MiniMidi_Merge_init( MiniMidi_Merge *self, MiniMidi_File *file, uint64_t start_ticks )
+{
+    self->file = file;
+    self->n_heap = 0;
+    self->heap = (MiniMidi_Merge_Cursor*)malloc( file->n_tracks * sizeof( MiniMidi_Merge_Cursor ) );
+    self->n_events = (size_t*)malloc( file->n_tracks * sizeof( size_t ) );
+
+    if (!self->heap || !self->n_events)
+    {
+        MiniMidi_Merge_free( self );
+        return 1;
+    }
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+
+        // a live capture keeps appending, walk what is there now
+        self->n_events[t] = __atomic_load_n( &(track->n_events), __ATOMIC_ACQUIRE );
+
+        size_t i = _first_event_at( track->event_arr, self->n_events[t], start_ticks );
+        if (i == self->n_events[t]) continue;
+
+        self->heap[ self->n_heap ].abs_ticks = track->event_arr[i].abs_ticks;
+        self->heap[ self->n_heap ].track = t;
+        self->heap[ self->n_heap ].index = i;
+        self->n_heap++;
+    }
+
+    for (size_t i = self->n_heap / 2; i-- > 0; )
+    {
+        _sift_down( self->heap, self->n_heap, i );
+    }
+
+    return 0;
+}
+
+void MiniMidi_Merge_free( MiniMidi_Merge *self )
+{
+    free( self->heap );
+    free( self->n_events );
+    self->heap = NULL;
+    self->n_events = NULL;
+    self->n_heap = 0;
+}
+
+MiniMidi_Event *MiniMidi_Merge_peek( MiniMidi_Merge *self, uint32_t *track )
+{
+    if (!self->n_heap) return NULL;
+
+    if (track) *track = self->heap[0].track;
+    return &(self->file->tracks[ self->heap[0].track ].event_arr[ self->heap[0].index ]);
+}
+
+MiniMidi_Event *MiniMidi_Merge_next( MiniMidi_Merge *self, uint32_t *track )
+{
+    MiniMidi_Event *evt = MiniMidi_Merge_peek( self, track );
+    if (!evt) return NULL;
+
+    MiniMidi_Merge_Cursor *top = &(self->heap[0]);
+
+    // advance the cursor in place, or retire the track
+    if (++top->index < self->n_events[ top->track ])
+    {
+        top->abs_ticks = self->file->tracks[ top->track ].event_arr[ top->index ].abs_ticks;
+    }
+    else
+    {
+        *top = self->heap[ --self->n_heap ];
+    }
+    _sift_down( self->heap, self->n_heap, 0 );
+
+    return evt;
+}
+
+MiniMidi_Merge_Ref *MiniMidi_Merge_materialize( MiniMidi_File *file, size_t *n_out )
+{
+    MiniMidi_Merge it;
+    MiniMidi_Merge_Ref *refs;
+    size_t total = 0, n = 0;
+    uint32_t track;
+
+    *n_out = 0;
+    if (MiniMidi_Merge_init( &it, file, 0 )) return NULL;
+
+    for (size_t t = 0; t < file->n_tracks; t++) total += it.n_events[t];
+
+    // one allocation for the whole index
+    refs = (MiniMidi_Merge_Ref*)malloc( (total ? total : 1) * sizeof( MiniMidi_Merge_Ref ) );
+    if (!refs)
+    {
+        MiniMidi_Merge_free( &it );
+        return NULL;
+    }
+
+    while (n < total && MiniMidi_Merge_peek( &it, &track ))
+    {
+        refs[n].track = track;
+        refs[n].index = it.heap[0].index;
+        MiniMidi_Merge_next( &it, NULL );
+        n++;
+    }
+
+    MiniMidi_Merge_free( &it );
+    *n_out = n;
+
+    return refs;
+}
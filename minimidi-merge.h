@@ -0,0 +1,56 @@
+#ifndef MINIMIDI_MERGE_H
+#define MINIMIDI_MERGE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+/***
+*  * Merged View:
+*
+*   Every track is already sorted by abs_ticks, so a time ordered walk over
+*   the whole file is a k-way merge: a binary min heap holds one cursor per
+*   track, keyed on ( abs_ticks, track ). Ties go to the lower track index,
+*   which keeps the order stable and the conductor's tempo changes first.
+*
+*   Each step is O(log k), nothing is allocated after init.
+*/
+typedef struct MiniMidi_Merge_Ref
+{
+    uint32_t track,
+             index;
+
+} MiniMidi_Merge_Ref;
+
+typedef struct MiniMidi_Merge_Cursor
+{
+    uint64_t abs_ticks;
+    uint32_t track,
+             index;
+
+} MiniMidi_Merge_Cursor;
+
+typedef struct MiniMidi_Merge
+{
+    MiniMidi_File           *file;
+    MiniMidi_Merge_Cursor   *heap;
+    size_t                   n_heap;
+    size_t                  *n_events;  // per track, taken at init
+
+} MiniMidi_Merge;
+
+// position on the first event at or after start_ticks, on every track
+int MiniMidi_Merge_init( MiniMidi_Merge *self, MiniMidi_File *file, uint64_t start_ticks );
+void MiniMidi_Merge_free( MiniMidi_Merge *self );
+
+// next event in time order, NULL when all tracks are done. track may be NULL
+MiniMidi_Event *MiniMidi_Merge_peek( MiniMidi_Merge *self, uint32_t *track );
+MiniMidi_Event *MiniMidi_Merge_next( MiniMidi_Merge *self, uint32_t *track );
+
+// the whole merged order as one array of refs, n_out is set to its length.
+// free() the result
+MiniMidi_Merge_Ref *MiniMidi_Merge_materialize( MiniMidi_File *file, size_t *n_out );
+
+#endif /* MINIMIDI_MERGE_H */
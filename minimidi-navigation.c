@@ -0,0 +1,232 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "minimidi-navigation.h"
+#include "minimidi-merge.h"
+#include "minimidi-log.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+// first column index in [ lo, hi ) whose onset is at or after ticks, through idx when it is not NULL
+static size_t _first_at( MiniMidi_Navigation *self, const size_t *idx, size_t lo, size_t hi, uint64_t ticks )
+{
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (self->ticks[ idx ? idx[mid] : mid ] < ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static size_t _step_forward( MiniMidi_Navigation *self, const size_t *idx, size_t k, size_t hi )
+{
+    for (; k < hi; k++)
+    {
+        size_t i = idx ? idx[k] : k;
+        if (!self->is_skipped[ self->tracks[i] ]) return i;
+    }
+    return self->n_onsets;
+}
+
+// from k - 1 down to lo
+static size_t _step_back( MiniMidi_Navigation *self, const size_t *idx, size_t k, size_t lo )
+{
+    for (; k > lo; k--)
+    {
+        size_t i = idx ? idx[ k - 1 ] : k - 1;
+        if (!self->is_skipped[ self->tracks[i] ]) return i;
+    }
+    return self->n_onsets;
+}
+
+// count onsets a bar at a time, they are sorted
+static void _find_densest_bar( MiniMidi_Navigation *self )
+{
+    self->densest_bar = 0;
+    self->densest_count = 0;
+
+    for (size_t i = 0; i < self->n_onsets; )
+    {
+        uint64_t bar = self->ticks[i] / self->bar_ticks;
+        size_t first = i;
+
+        while (i < self->n_onsets && self->ticks[i] / self->bar_ticks == bar) i++;
+
+        if (i - first > self->densest_count)
+        {
+            self->densest_count = i - first;
+            self->densest_bar = bar;
+        }
+    }
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Navigation *MiniMidi_Navigation_init( MiniMidi_File *file, uint64_t bar_ticks )
+{
+    MiniMidi_Navigation *self = (MiniMidi_Navigation*)calloc( 1, sizeof( MiniMidi_Navigation ) );
+    MiniMidi_Merge events;
+    MiniMidi_Event *evt;
+    uint32_t track;
+    size_t n = 0;
+
+    if (!self) return NULL;
+
+    self->bar_ticks = bar_ticks ? bar_ticks : 1;
+    self->n_tracks = file->n_tracks;
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        MiniMidi_Track *tr = &(file->tracks[t]);
+        size_t n_events = __atomic_load_n( &(tr->n_events), __ATOMIC_ACQUIRE );
+
+        self->n_events += n_events;
+        for (size_t i = 0; i < n_events; i++)
+        {
+            if (tr->event_arr[i].status_code == MIDI_NOTE_ON) n++;
+        }
+    }
+
+    self->ticks = (uint64_t*)malloc( ( n ? n : 1 ) * sizeof( uint64_t ) );
+    self->tracks = (uint32_t*)malloc( ( n ? n : 1 ) * sizeof( uint32_t ) );
+    self->pitches = (_Byte*)malloc( n ? n : 1 );
+    self->by_pitch = (size_t*)malloc( ( n ? n : 1 ) * sizeof( size_t ) );
+    self->is_skipped = (bool*)calloc( file->n_tracks ? file->n_tracks : 1, sizeof( bool ) );
+
+    if (!self->ticks || !self->tracks || !self->pitches || !self->by_pitch || !self->is_skipped) goto fail;
+
+    // the columns, in time order. a capture may have appended since the count
+    if (MiniMidi_Merge_init( &events, file, 0 )) goto fail;
+    while (self->n_onsets < n && (evt = MiniMidi_Merge_next( &events, &track )))
+    {
+        if (evt->status_code != MIDI_NOTE_ON) continue;
+
+        _Byte pitch = evt->evt_data[0] & 0x7F;
+
+        self->ticks[ self->n_onsets ] = evt->abs_ticks;
+        self->tracks[ self->n_onsets ] = track;
+        self->pitches[ self->n_onsets++ ] = pitch;
+        self->pitch_first[ pitch + 1 ]++;
+    }
+    MiniMidi_Merge_free( &events );
+
+    // counting sort by pitch, stable so every list stays in time order
+    for (int p = 0; p < 128; p++) self->pitch_first[ p + 1 ] += self->pitch_first[p];
+
+    size_t fill[128];
+    memcpy( fill, self->pitch_first, sizeof( fill ) );
+    for (size_t i = 0; i < self->n_onsets; i++) self->by_pitch[ fill[ self->pitches[i] ]++ ] = i;
+
+    _find_densest_bar( self );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-navigation.c > MiniMidi_Navigation_init() : %zu onsets, busiest bar %lu",
+        self->n_onsets, self->densest_bar );
+    MiniMidi_Log_writeline();
+
+    return self;
+
+fail:
+    MiniMidi_Navigation_free( self );
+    return NULL;
+}
+
+void MiniMidi_Navigation_free( MiniMidi_Navigation *self )
+{
+    if (!self) return;
+
+    free( self->ticks );
+    free( self->tracks );
+    free( self->pitches );
+    free( self->by_pitch );
+    free( self->is_skipped );
+    free( self );
+}
+
+size_t MiniMidi_Navigation_next( MiniMidi_Navigation *self, uint64_t ticks )
+{
+    return _step_forward( self, NULL, _first_at( self, NULL, 0, self->n_onsets, ticks ), self->n_onsets );
+}
+
+size_t MiniMidi_Navigation_prev( MiniMidi_Navigation *self, uint64_t ticks )
+{
+    return _step_back( self, NULL, _first_at( self, NULL, 0, self->n_onsets, ticks ), 0 );
+}
+
+size_t MiniMidi_Navigation_next_pitch( MiniMidi_Navigation *self, _Byte pitch, uint64_t ticks )
+{
+    if (pitch > 127) return self->n_onsets;
+
+    size_t lo = self->pitch_first[ pitch ],
+           hi = self->pitch_first[ pitch + 1 ];
+
+    return _step_forward( self, self->by_pitch, _first_at( self, self->by_pitch, lo, hi, ticks ), hi );
+}
+
+size_t MiniMidi_Navigation_prev_pitch( MiniMidi_Navigation *self, _Byte pitch, uint64_t ticks )
+{
+    if (pitch > 127) return self->n_onsets;
+
+    size_t lo = self->pitch_first[ pitch ],
+           hi = self->pitch_first[ pitch + 1 ];
+
+    return _step_back( self, self->by_pitch, _first_at( self, self->by_pitch, lo, hi, ticks ), lo );
+}
+
+int MiniMidi_Navigation_parse_goto( MiniMidi_File *file, const char *spec, uint64_t bar_ticks, uint64_t *ticks )
+{
+    char *end;
+    size_t len = strlen( spec );
+
+    if (!len) return 1;
+
+    if (spec[ len - 1 ] == 't')
+    {
+        unsigned long long t = strtoull( spec, &end, 10 );
+        if (len < 2 || end != spec + len - 1 || spec[0] == '-') return 1;
+
+        *ticks = t;
+        return 0;
+    }
+
+    double seconds;
+
+    if (spec[ len - 1 ] == 's')
+    {
+        seconds = strtod( spec, &end );
+        if (len < 2 || end != spec + len - 1) return 1;
+    }
+    else if (strchr( spec, ':' ))
+    {
+        unsigned long minutes = strtoul( spec, &end, 10 );
+        if (*end != ':' || spec[0] == '-') return 1;
+
+        char *sec_start = end + 1;
+        seconds = strtod( sec_start, &end );
+        if (*end || end == sec_start) return 1;
+
+        seconds += 60.0 * minutes;
+    }
+    else
+    {
+        unsigned long long bar = strtoull( spec, &end, 10 );
+        if (*end || spec[0] == '-') return 1;
+
+        *ticks = bar * bar_ticks;
+        return 0;
+    }
+
+    if (seconds < 0 || !file->track->n_tempos) return 1;
+
+    *ticks = MiniMidi_File_usec_to_ticks( file, (uint64_t)( seconds * 1e6 ) );
+    return 0;
+}
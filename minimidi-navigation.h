@@ -0,0 +1,63 @@
+#ifndef MINIMIDI_NAVIGATION_H
+#define MINIMIDI_NAVIGATION_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+/***
+*  * Navigation:
+*
+*   Every NOTE ON of the file, merged across tracks, as columns sorted by
+*   ticks: the onset ticks, the track and the pitch. The onsets of each
+*   pitch are also listed on their own, as indexes into the columns, so
+*   the next C4 is one binary search too. Every jump is O(log n) however
+*   long the file is.
+*
+*   Onsets of tracks marked in is_skipped are stepped over one by one, so
+*   they only cost what lies between the start and the onset found.
+*
+*   The bar with the most onsets is found while building, for the jump to
+*   the busiest part of the file.
+*/
+typedef struct MiniMidi_Navigation
+{
+    uint64_t    *ticks;
+    uint32_t    *tracks;
+    _Byte       *pitches;       // MIDI note numbers
+    size_t      n_onsets;
+
+    // onsets of pitch p: by_pitch[ pitch_first[p] ] .. by_pitch[ pitch_first[p + 1] - 1 ]
+    size_t      *by_pitch,
+                pitch_first[129];
+
+    bool        *is_skipped;    // per track, all false after init
+    size_t      n_tracks;
+
+    uint64_t    bar_ticks,
+                densest_bar;
+    size_t      densest_count;
+
+    // events of the file it was built from, a growing file outruns it
+    size_t      n_events;
+
+} MiniMidi_Navigation;
+
+MiniMidi_Navigation *MiniMidi_Navigation_init( MiniMidi_File *file, uint64_t bar_ticks );
+void                MiniMidi_Navigation_free( MiniMidi_Navigation *self );
+
+// first onset at or after ticks, n_onsets if there is none
+size_t MiniMidi_Navigation_next( MiniMidi_Navigation *self, uint64_t ticks );
+// last onset before ticks, n_onsets if there is none
+size_t MiniMidi_Navigation_prev( MiniMidi_Navigation *self, uint64_t ticks );
+
+// the same, only looking at onsets of pitch
+size_t MiniMidi_Navigation_next_pitch( MiniMidi_Navigation *self, _Byte pitch, uint64_t ticks );
+size_t MiniMidi_Navigation_prev_pitch( MiniMidi_Navigation *self, _Byte pitch, uint64_t ticks );
+
+// "12" a bar, "1:30.5" or "90s" a time, "4800t" ticks. returns 1 if it can't be read
+int MiniMidi_Navigation_parse_goto( MiniMidi_File *file, const char *spec, uint64_t bar_ticks, uint64_t *ticks );
+
+#endif /* MINIMIDI_NAVIGATION_H */
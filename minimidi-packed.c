@@ -0,0 +1,430 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "minimidi-packed.h"
+#include "minimidi-log.h"
+
+int hook_up_events( MiniMidi_Event *arr, size_t n );
+
+// NOTE ON and OFF share this tag, the velocity byte's high bit marks an OFF
+#define _NOTE_TAG MIDI_NOTE_ON
+#define _OFF_BIT 0x80
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Encoding
+****************************************************************************************/
+static inline size_t _put_varint( _Byte *out, uint64_t v )
+{
+    size_t n = 0;
+
+    while (v >= 0x80)
+    {
+        out[n++] = ( v & 0x7F ) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+static inline const _Byte *_get_varint( const _Byte *in, uint64_t *v )
+{
+    int shift = 0;
+
+    *v = 0;
+    do
+    {
+        *v |= (uint64_t)( *in & 0x7F ) << shift;
+        shift += 7;
+    } while (*in++ & 0x80);
+
+    return in;
+}
+
+static inline bool _is_note( MidiStatusCode status )
+{
+    return status == MIDI_NOTE_ON || status == MIDI_NOTE_OFF;
+}
+
+static inline uint8_t _n_data_bytes( _Byte tag )
+{
+    switch (tag & 0xF0)
+    {
+        case MIDI_PROGRAM_CHANGE:
+        case MIDI_CHAN_AFTERTOUCH:
+        case MIDI_SYSTEM:           // meta type, 0 for SysEx
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+static size_t _encode_event( MiniMidi_Event *evt, _Byte *out, _Byte *tag, bool is_first )
+{
+    size_t n = 0;
+    _Byte evt_tag = ( _is_note( evt->status_code ) ? _NOTE_TAG : ( evt->status_code & 0xF0 ) ) | ( evt->channel & 0x0F ),
+          data[2] = { evt->evt_data[0], evt->evt_data[1] };
+
+    if (_is_note( evt->status_code ))
+    {
+        data[0] &= 0x7F;
+        data[1] = ( data[1] & 0x7F ) | ( evt->status_code == MIDI_NOTE_OFF ? _OFF_BIT : 0 );
+    }
+
+    // left out when it repeats and the next byte can't be mistaken for it
+    if (is_first || evt_tag != *tag || ( data[0] & 0x80 ))
+    {
+        out[n++] = evt_tag;
+        *tag = evt_tag;
+    }
+
+    out[n++] = data[0];
+    if (_n_data_bytes( evt_tag ) == 2) out[n++] = data[1];
+
+    return n;
+}
+
+// decode at the iterator and move it on. the iterator must not be at the end
+static void _decode_event( MiniMidi_Packed_Iter *it, MiniMidi_Event *evt )
+{
+    MiniMidi_Packed_Track *track = it->track;
+    MiniMidi_Packed_Block *block = &(track->blocks[ it->block ]);
+    uint64_t delta;
+
+    if (it->index == 0)
+    {
+        it->cursor = track->bytes + block->offset;
+        delta = block->first_ticks - ( it->block ? track->blocks[ it->block - 1 ].last_ticks : 0 );
+        it->ticks = block->first_ticks;
+    }
+    else
+    {
+        it->cursor = _get_varint( it->cursor, &delta );
+        it->ticks += delta;
+    }
+
+    if (*(it->cursor) & 0x80) it->tag = *(it->cursor++);
+
+    evt->delta_ticks = delta;
+    evt->abs_ticks = it->ticks;
+    evt->channel = it->tag & 0x0F;
+    evt->status_code = (MidiStatusCode)( it->tag & 0xF0 );
+    evt->evt_data[0] = *(it->cursor++);
+    evt->evt_data[1] = _n_data_bytes( it->tag ) == 2 ? *(it->cursor++) : 0;
+    evt->next = NULL;
+    evt->prev = NULL;
+
+    if (evt->status_code == _NOTE_TAG)
+    {
+        if (evt->evt_data[1] & _OFF_BIT) evt->status_code = MIDI_NOTE_OFF;
+        evt->evt_data[1] &= 0x7F;
+        evt->note = _event_data_bytes_to_note( evt->evt_data[0] );
+    }
+    else
+    {
+        memset( &(evt->note), 0, sizeof( MidiNote ) );
+    }
+
+    if (++it->index == block->n_events)
+    {
+        it->block++;
+        it->index = 0;
+    }
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Tracks
+****************************************************************************************/
+int MiniMidi_Packed_Track_init( MiniMidi_Packed_Track *self, MiniMidi_Track *track )
+{
+    memset( self, 0, sizeof( MiniMidi_Packed_Track ) );
+
+    self->n_events = track->n_events;
+    self->total_ticks = track->total_ticks;
+    self->n_blocks = ( track->n_events + MINIMIDI_PACKED_BLOCK_EVENTS - 1 ) / MINIMIDI_PACKED_BLOCK_EVENTS;
+
+    // worst case: 10 bytes of delta, a tag and two data bytes
+    _Byte *bytes = (_Byte*)malloc( track->n_events * 13 + 1 );
+    self->blocks = (MiniMidi_Packed_Block*)malloc( ( self->n_blocks ? self->n_blocks : 1 ) * sizeof( MiniMidi_Packed_Block ) );
+
+    if (!bytes || !self->blocks)
+    {
+        free( bytes );
+        MiniMidi_Packed_Track_free( self );
+        return 1;
+    }
+
+    for (size_t b = 0; b < self->n_blocks; b++)
+    {
+        MiniMidi_Packed_Block *block = &(self->blocks[b]);
+        size_t first = b * MINIMIDI_PACKED_BLOCK_EVENTS,
+               last = first + MINIMIDI_PACKED_BLOCK_EVENTS < track->n_events ? first + MINIMIDI_PACKED_BLOCK_EVENTS : track->n_events;
+        _Byte tag = 0;
+
+        block->first_ticks = track->event_arr[first].abs_ticks;
+        block->last_ticks = track->event_arr[last - 1].abs_ticks;
+        block->offset = self->n_bytes;
+        block->n_events = last - first;
+        block->min_pitch = 0x7F;
+        block->max_pitch = 0;
+
+        for (size_t i = first; i < last; i++)
+        {
+            MiniMidi_Event *evt = &(track->event_arr[i]);
+
+            if (i > first)
+            {
+                self->n_bytes += _put_varint( bytes + self->n_bytes, evt->abs_ticks - track->event_arr[i - 1].abs_ticks );
+            }
+            self->n_bytes += _encode_event( evt, bytes + self->n_bytes, &tag, i == first );
+
+            if (_is_note( evt->status_code ))
+            {
+                _Byte p = evt->evt_data[0] & 0x7F;
+                if (p < block->min_pitch) block->min_pitch = p;
+                if (p > block->max_pitch) block->max_pitch = p;
+            }
+        }
+    }
+
+    self->bytes = (_Byte*)realloc( bytes, self->n_bytes + 1 );
+    if (!self->bytes) self->bytes = bytes;
+
+    return 0;
+}
+
+void MiniMidi_Packed_Track_free( MiniMidi_Packed_Track *self )
+{
+    free( self->blocks );
+    free( self->bytes );
+    self->blocks = NULL;
+    self->bytes = NULL;
+    self->n_blocks = 0;
+    self->n_bytes = 0;
+}
+
+int MiniMidi_Packed_Track_unpack( MiniMidi_Packed_Track *self, MiniMidi_Track *track )
+{
+    MiniMidi_Packed_Iter it;
+    MiniMidi_Event *arr = (MiniMidi_Event*)malloc( ( self->n_events ? self->n_events : 1 ) * sizeof( MiniMidi_Event ) );
+
+    if (!arr) return 1;
+
+    MiniMidi_Packed_Iter_init( &it, self, 0 );
+    for (size_t i = 0; i < self->n_events; i++) _decode_event( &it, &arr[i] );
+
+    MiniMidi_Track_release( track );
+    track->event_arr = arr;
+    track->n_events = self->n_events;
+    track->capacity = self->n_events;
+    track->total_ticks = self->total_ticks;
+    hook_up_events( arr, self->n_events );
+
+    return 0;
+}
+
+size_t MiniMidi_Packed_Track_range( MiniMidi_Packed_Track *self, uint64_t start_ticks, uint64_t end_ticks,
+    int start_note, int end_note, MiniMidi_Event *out, size_t max_out )
+{
+    MiniMidi_Packed_Iter it = { .track = self };
+    MiniMidi_Event evt;
+    size_t n = 0, lo = 0, hi = self->n_blocks;
+
+    // first block ending at or after start_ticks
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (self->blocks[mid].last_ticks < start_ticks) lo = mid + 1; else hi = mid;
+    }
+
+    for (size_t b = lo; b < self->n_blocks && self->blocks[b].first_ticks <= end_ticks && n < max_out; b++)
+    {
+        MiniMidi_Packed_Block *block = &(self->blocks[b]);
+
+        // nothing in the pitch window, don't even decode it
+        if (block->min_pitch > block->max_pitch || block->max_pitch < start_note || block->min_pitch > end_note) continue;
+
+        it.block = b;
+        it.index = 0;
+        for (uint16_t i = 0; i < block->n_events && n < max_out; i++)
+        {
+            _decode_event( &it, &evt );
+
+            if (!_is_note( evt.status_code ) || evt.abs_ticks < start_ticks || evt.abs_ticks > end_ticks) continue;
+            if (evt.evt_data[0] < start_note || evt.evt_data[0] > end_note) continue;
+
+            out[n++] = evt;
+        }
+    }
+
+    return n;
+}
+
+int MiniMidi_Packed_Iter_init( MiniMidi_Packed_Iter *it, MiniMidi_Packed_Track *track, uint64_t start_ticks )
+{
+    MiniMidi_Packed_Iter before;
+    MiniMidi_Event evt;
+    size_t lo = 0, hi = track->n_blocks;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (track->blocks[mid].last_ticks < start_ticks) lo = mid + 1; else hi = mid;
+    }
+
+    it->track = track;
+    it->block = lo;
+    it->index = 0;
+    it->cursor = NULL;
+    it->tag = 0;
+    it->ticks = 0;
+
+    // walk up to the first event at or after start_ticks, and stay in front of it
+    while (it->block < track->n_blocks)
+    {
+        before = *it;
+        _decode_event( it, &evt );
+
+        if (evt.abs_ticks >= start_ticks)
+        {
+            *it = before;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+int MiniMidi_Packed_Iter_next( MiniMidi_Packed_Iter *it, MiniMidi_Event *evt )
+{
+    if (it->block >= it->track->n_blocks) return 1;
+
+    _decode_event( it, evt );
+    return 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Files
+****************************************************************************************/
+MiniMidi_Packed_File *MiniMidi_Packed_File_init( MiniMidi_File *file )
+{
+    MiniMidi_Packed_File *self = (MiniMidi_Packed_File*)calloc( 1, sizeof( MiniMidi_Packed_File ) );
+    if (!self) return NULL;
+
+    self->filepath = strdup( file->filepath ? file->filepath : "" );
+    self->header = *(file->header);
+    self->length = file->length;
+    self->n_tempos = file->track->n_tempos;
+    self->tempo_arr = (MiniMidi_Tempo*)malloc( ( self->n_tempos ? self->n_tempos : 1 ) * sizeof( MiniMidi_Tempo ) );
+    self->tracks = (MiniMidi_Packed_Track*)calloc( file->n_tracks ? file->n_tracks : 1, sizeof( MiniMidi_Packed_Track ) );
+
+    if (!self->filepath || !self->tempo_arr || !self->tracks)
+    {
+        MiniMidi_Packed_File_free( self );
+        return NULL;
+    }
+    if (self->n_tempos) memcpy( self->tempo_arr, file->track->tempo_arr, self->n_tempos * sizeof( MiniMidi_Tempo ) );
+
+    for (; self->n_tracks < file->n_tracks; self->n_tracks++)
+    {
+        if (MiniMidi_Packed_Track_init( &(self->tracks[ self->n_tracks ]), &(file->tracks[ self->n_tracks ]) ))
+        {
+            MiniMidi_Packed_File_free( self );
+            return NULL;
+        }
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-packed.c > MiniMidi_Packed_File_init() : %s packed in %zu bytes",
+        self->filepath, MiniMidi_Packed_File_bytes( self ) );
+    MiniMidi_Log_writeline();
+
+    return self;
+}
+
+void MiniMidi_Packed_File_free( MiniMidi_Packed_File *self )
+{
+    if (!self) return;
+
+    for (size_t t = 0; self->tracks && t < self->n_tracks; t++)
+    {
+        MiniMidi_Packed_Track_free( &(self->tracks[t]) );
+    }
+    free( self->tracks );
+    free( self->tempo_arr );
+    free( self->filepath );
+    free( self );
+}
+
+MiniMidi_File *MiniMidi_Packed_File_unpack( MiniMidi_Packed_File *self )
+{
+    MiniMidi_File *file = create_mini_midi_file( self->filepath );
+    if (!file) return NULL;
+
+    MiniMidi_Track *tracks = (MiniMidi_Track*)calloc( self->n_tracks ? self->n_tracks : 1, sizeof( MiniMidi_Track ) );
+    if (!tracks)
+    {
+        MiniMidi_File_free( file );
+        return NULL;
+    }
+
+    // the placeholder track stays in the file's arena
+    file->tracks = tracks;
+    file->track = tracks;
+    file->n_tracks = self->n_tracks ? self->n_tracks : 1;
+    *(file->header) = self->header;
+    file->length = self->length;
+
+    for (size_t t = 0; t < self->n_tracks; t++)
+    {
+        if (MiniMidi_Packed_Track_unpack( &(self->tracks[t]), &(tracks[t]) ))
+        {
+            MiniMidi_File_free( file );
+            return NULL;
+        }
+        tracks[t].total_beats = tracks[t].total_ticks / self->header.ppqn + 1;
+    }
+
+    // the tempo map was already built
+    if (self->n_tempos)
+    {
+        file->track->tempo_arr = (MiniMidi_Tempo*)malloc( self->n_tempos * sizeof( MiniMidi_Tempo ) );
+        if (!file->track->tempo_arr)
+        {
+            MiniMidi_File_free( file );
+            return NULL;
+        }
+        memcpy( file->track->tempo_arr, self->tempo_arr, self->n_tempos * sizeof( MiniMidi_Tempo ) );
+        file->track->n_tempos = self->n_tempos;
+        file->track->tempo_capacity = self->n_tempos;
+    }
+    else if (_build_tempo_map( file ))
+    {
+        MiniMidi_File_free( file );
+        return NULL;
+    }
+
+    return file;
+}
+
+size_t MiniMidi_Packed_File_bytes( MiniMidi_Packed_File *self )
+{
+    size_t bytes = sizeof( MiniMidi_Packed_File ) + self->n_tempos * sizeof( MiniMidi_Tempo );
+
+    for (size_t t = 0; t < self->n_tracks; t++)
+    {
+        bytes += sizeof( MiniMidi_Packed_Track ) + self->tracks[t].n_bytes
+            + self->tracks[t].n_blocks * sizeof( MiniMidi_Packed_Block );
+    }
+    return bytes;
+}
@@ -0,0 +1,103 @@
+#ifndef MINIMIDI_PACKED_H
+#define MINIMIDI_PACKED_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// events per block, a random access decodes at most this many
+#define MINIMIDI_PACKED_BLOCK_EVENTS 256
+
+/***
+*  * Packed Tracks:
+*
+*   A compressed copy of a track for keeping lots of files resident.
+*
+*   Every event is a varint delta, a tag byte ( status nibble | channel ) that
+*   is left out when it repeats, like running status, then its data bytes.
+*   NOTE ON and NOTE OFF share a tag, the high bit of the velocity byte tells
+*   them apart, so runs of notes are three bytes an event.
+*
+*   Blocks of 256 events start with an explicit tag and a header holding
+*   their tick span and pitch span: lookups binary search the headers and
+*   range queries skip blocks without decoding them.
+*/
+typedef struct MiniMidi_Packed_Block
+{
+    uint64_t first_ticks,
+             last_ticks;
+    uint32_t offset;            // into the track's byte stream
+    uint16_t n_events;
+    _Byte    min_pitch,         // of the NOTE ON / OFF events, min > max if none
+             max_pitch;
+
+} MiniMidi_Packed_Block;
+
+typedef struct MiniMidi_Packed_Track
+{
+    size_t                  n_events;
+    uint64_t                total_ticks;
+
+    MiniMidi_Packed_Block   *blocks;
+    size_t                  n_blocks;
+
+    _Byte                   *bytes;
+    size_t                  n_bytes;
+
+} MiniMidi_Packed_Track;
+
+typedef struct MiniMidi_Packed_File
+{
+    char                    *filepath;
+    MiniMidi_Header         header;
+    size_t                  length;
+
+    MiniMidi_Tempo          *tempo_arr;     // the conductor's tempo map, as built
+    size_t                  n_tempos;
+
+    MiniMidi_Packed_Track   *tracks;
+    size_t                  n_tracks;
+
+} MiniMidi_Packed_File;
+
+// decode-on-access walk over a packed track
+typedef struct MiniMidi_Packed_Iter
+{
+    MiniMidi_Packed_Track   *track;
+    size_t                  block,
+                            index;          // in the block
+    const _Byte             *cursor;
+    _Byte                   tag;
+    uint64_t                ticks;
+
+} MiniMidi_Packed_Iter;
+
+int     MiniMidi_Packed_Track_init( MiniMidi_Packed_Track *self, MiniMidi_Track *track );
+void    MiniMidi_Packed_Track_free( MiniMidi_Packed_Track *self );
+
+// decode everything back into track ( event_arr, n_events, total_ticks ), linked
+int     MiniMidi_Packed_Track_unpack( MiniMidi_Packed_Track *self, MiniMidi_Track *track );
+
+// NOTE ON / OFF events in the tick and pitch window, decoded into out ( links are NULL ).
+// returns how many, at most max_out
+size_t  MiniMidi_Packed_Track_range( MiniMidi_Packed_Track *self, uint64_t start_ticks, uint64_t end_ticks,
+            int start_note, int end_note, MiniMidi_Event *out, size_t max_out );
+
+// first event at or after start_ticks
+int     MiniMidi_Packed_Iter_init( MiniMidi_Packed_Iter *it, MiniMidi_Packed_Track *track, uint64_t start_ticks );
+// 0 and the event in evt ( links are NULL ), 1 at the end
+int     MiniMidi_Packed_Iter_next( MiniMidi_Packed_Iter *it, MiniMidi_Event *evt );
+
+// compress every track, file can be freed afterwards
+MiniMidi_Packed_File    *MiniMidi_Packed_File_init( MiniMidi_File *file );
+void                    MiniMidi_Packed_File_free( MiniMidi_Packed_File *self );
+
+// back to a full MiniMidi_File
+MiniMidi_File           *MiniMidi_Packed_File_unpack( MiniMidi_Packed_File *self );
+
+// resident size
+size_t                  MiniMidi_Packed_File_bytes( MiniMidi_Packed_File *self );
+
+#endif /* MINIMIDI_PACKED_H */
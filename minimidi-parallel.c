@@ -0,0 +1,350 @@
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "minimidi-parallel.h"
+#include "minimidi-log.h"
+
+int _decode_event( _Byte *data, size_t len, size_t *offset, _Byte *status, uint64_t *ticks, MiniMidi_Event *evt );
+
+typedef struct _Segment
+{
+    _Byte           *data;
+    size_t          len;
+
+    // events starting in [ start, stop ), running status at start.
+    // a segment cut in a run of running status events starts with a guess
+    size_t          start,
+                    stop;
+    _Byte           status;
+    bool            is_guess;
+
+    // skim results, ticks are relative to start
+    size_t          end,
+                    n_events,
+                    n_tempos,
+                    n_payload_bytes;
+    uint64_t        ticks;
+    _Byte           end_status;
+    bool            saw_status,     // a channel status byte of its own
+                    failed;
+
+    // where the decode goes
+    bool            is_writing;
+    MiniMidi_Event  *out;
+    MiniMidi_Tempo  *tempo_out;
+    _Byte           *payload_out;
+    size_t          payload_base;   // of payload_out in the track's payload bytes
+    uint64_t        base_ticks;
+
+} _Segment;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Segments
+****************************************************************************************/
+static inline bool _is_tempo( _Byte *data, size_t end, MiniMidi_Event *evt )
+{
+    // FF 51 03 tt tt tt, end is right after the payload
+    return evt->status_code == MIDI_SYSTEM && evt->channel == 0x0F && evt->evt_data[0] == MIDI_META_TEMPO
+        && end >= 4 && data[end - 4] == 3;
+}
+
+// skim ( count ) or decode ( write ) the segment
+static void _walk( _Segment *seg )
+{
+    MiniMidi_Event evt, *e = &evt;
+    size_t offset = seg->start,
+           at,
+           n = 0,
+           n_tempos = 0,
+           n_payload_bytes = 0;
+    _Byte status = seg->status;
+    uint64_t ticks = seg->is_writing ? seg->base_ticks : 0;
+
+    seg->failed = false;
+    seg->saw_status = false;
+
+    while (seg->is_writing ? n < seg->n_events : offset < seg->stop)
+    {
+        if (seg->is_writing) e = &(seg->out[n]);
+
+        if (!seg->saw_status)
+        {
+            // past the delta, is there a channel status byte of its own?
+            size_t p = offset;
+            while (p < seg->len && p - offset < 4 && ( seg->data[p] & 0x80 )) p++;
+            p++;
+            seg->saw_status = p < seg->len && seg->data[p] >= 0x80 && seg->data[p] < 0xF0;
+        }
+
+        at = offset;
+        if (_decode_event( seg->data, seg->len, &offset, &status, &ticks, e ))
+        {
+            seg->failed = true;
+            break;
+        }
+        n++;
+
+        // SysEx / Meta: what follows the status byte, past the delta, is kept
+        if (e->status_code == MIDI_SYSTEM)
+        {
+            while (seg->data[at] & 0x80) at++;
+            at += 2;
+
+            if (seg->is_writing)
+            {
+                memcpy( seg->payload_out + n_payload_bytes, seg->data + at, offset - at );
+                e->payload = (uint32_t)( seg->payload_base + n_payload_bytes ) + 1;
+            }
+            n_payload_bytes += offset - at;
+        }
+
+        if (_is_tempo( seg->data, offset, e ))
+        {
+            if (seg->is_writing)
+            {
+                MiniMidi_Tempo *t = &(seg->tempo_out[ n_tempos ]);
+                t->abs_ticks = e->abs_ticks;
+                t->usec = 0;
+                t->usec_per_beat = ( seg->data[offset - 3] << 16 ) | ( seg->data[offset - 2] << 8 ) | seg->data[offset - 1];
+            }
+            n_tempos++;
+        }
+    }
+
+    if (seg->is_writing) return;
+
+    seg->end = offset;
+    seg->end_status = status;
+    seg->n_events = n;
+    seg->n_tempos = n_tempos;
+    seg->n_payload_bytes = n_payload_bytes;
+    seg->ticks = ticks;
+}
+
+static void *_walk_thread( void *arg )
+{
+    _walk( (_Segment*)arg );
+    return NULL;
+}
+
+// run every segment, the first one on this thread
+static void _walk_all( _Segment *segs, size_t n_segs )
+{
+    pthread_t threads[ n_segs ];
+    bool started[ n_segs ];
+
+    for (size_t j = 1; j < n_segs; j++)
+    {
+        started[j] = pthread_create( &threads[j], NULL, _walk_thread, &segs[j] ) == 0;
+        if (!started[j]) _walk( &segs[j] );
+    }
+
+    _walk( &segs[0] );
+
+    for (size_t j = 1; j < n_segs; j++)
+    {
+        if (started[j]) pthread_join( threads[j], NULL );
+    }
+}
+
+// running status has to be guessed when a cut lands in a run of events without
+// status bytes. any two data byte status will do to find the boundaries, the real
+// one is filled in once the segment before is known
+#define _GUESSED_STATUS 0x90
+
+static inline bool _has_two_data_bytes( _Byte status )
+{
+    return ( status & 0xF0 ) != MIDI_PROGRAM_CHANGE && ( status & 0xF0 ) != MIDI_CHAN_AFTERTOUCH;
+}
+
+// a believable event start at: a delta then a channel status byte, or data
+// bytes under a guessed running status
+static bool _plausible_start( _Byte *data, size_t len, size_t at, bool *is_guess )
+{
+    size_t i = at,
+           offset = at;
+    _Byte status = _GUESSED_STATUS;
+    uint64_t ticks = 0;
+    MiniMidi_Event evt;
+
+    // delta
+    while (i < len && i - at < 4 && ( data[i] & 0x80 )) i++;
+    if (i >= len || i - at == 4) return false;
+    i++;
+
+    // channel status, or running status
+    if (i >= len || data[i] >= 0xF0) return false;
+    *is_guess = data[i] < 0x80;
+
+    for (int k = 0; k < MINIMIDI_PARALLEL_RESYNC_EVENTS && offset < len; k++)
+    {
+        if (_decode_event( data, len, &offset, &status, &ticks, &evt )) return false;
+
+        // data bytes never have the high bit set
+        if (( evt.evt_data[0] | evt.evt_data[1] ) & 0x80) return false;
+    }
+
+    return true;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+int MiniMidi_Track_decode_parallel( MiniMidi_Track *track, _Byte *data, size_t len, uint32_t n_threads )
+{
+    size_t n_segs = len / MINIMIDI_PARALLEL_MIN_SEGMENT;
+
+    if (n_segs > n_threads) n_segs = n_threads;
+    if (n_segs < 1) n_segs = 1;
+
+    _Segment segs[ n_segs ];
+    size_t k = 0;
+
+    // move every cut forward to something that looks like an event start
+    for (size_t j = 0; j < n_segs; j++)
+    {
+        size_t at = j * ( len / n_segs ),
+               limit = at + MINIMIDI_PARALLEL_RESYNC_BYTES;
+
+        bool is_guess = false;
+
+        if (j > 0)
+        {
+            if (at <= segs[k - 1].start) continue;
+            while (at < limit && at < len && !_plausible_start( data, len, at, &is_guess )) at++;
+            if (at >= limit || at >= len) continue;
+        }
+
+        memset( &segs[k], 0, sizeof( _Segment ) );
+        segs[k].data = data;
+        segs[k].len = len;
+        segs[k].start = at;
+        segs[k].is_guess = is_guess;
+        segs[k].status = is_guess ? _GUESSED_STATUS : 0;
+        if (k > 0) segs[k - 1].stop = at;
+        k++;
+    }
+    segs[k - 1].stop = len;
+    n_segs = k;
+
+    _walk_all( segs, n_segs );
+
+    // the first segment is right by definition, every next one has to start where
+    // it ended, and a guessed running status must take as many data bytes as the real one
+    size_t n_repaired = 0;
+    for (size_t j = 0; j < n_segs; j++)
+    {
+        if (segs[j].failed)
+        {
+            // the sequential parser stops here too
+            n_segs = j + 1;
+            break;
+        }
+        if (j + 1 == n_segs) break;
+
+        _Segment *next = &segs[j + 1];
+        _Byte real_status = segs[j].end_status;
+
+        if (next->start == segs[j].end && ( !next->is_guess || ( real_status && _has_two_data_bytes( real_status ) ) ))
+        {
+            // right guess, the decode pass runs with the real thing
+            if (next->is_guess)
+            {
+                next->status = real_status;
+                if (!next->saw_status) next->end_status = real_status;
+            }
+            continue;
+        }
+
+        next->start = segs[j].end;
+        next->status = real_status;
+        next->is_guess = false;
+
+        if (next->start >= next->stop)
+        {
+            // the real events ran over this segment entirely
+            next->end = next->start;
+            next->end_status = next->status;
+            next->n_events = 0;
+            next->n_tempos = 0;
+            next->n_payload_bytes = 0;
+            next->ticks = 0;
+            next->failed = false;
+        }
+        else
+        {
+            _walk( next );
+        }
+        n_repaired++;
+    }
+
+    size_t n_events = 0,
+           n_tempos = 0,
+           n_payload_bytes = 0;
+    uint64_t ticks = 0;
+
+    for (size_t j = 0; j < n_segs; j++)
+    {
+        segs[j].base_ticks = ticks;
+        ticks += segs[j].ticks;
+        n_events += segs[j].n_events;
+        n_tempos += segs[j].n_tempos;
+        n_payload_bytes += segs[j].n_payload_bytes;
+    }
+
+    MiniMidi_Event *arr = (MiniMidi_Event*)malloc( ( n_events ? n_events : 1 ) * sizeof( MiniMidi_Event ) );
+    MiniMidi_Tempo *tempos = n_tempos ? (MiniMidi_Tempo*)malloc( n_tempos * sizeof( MiniMidi_Tempo ) ) : NULL;
+    _Byte *payload = n_payload_bytes ? (_Byte*)malloc( n_payload_bytes ) : NULL;
+
+    if (!arr || ( n_tempos && !tempos ) || ( n_payload_bytes && !payload ))
+    {
+        free( arr );
+        free( tempos );
+        free( payload );
+        return 1;
+    }
+
+    n_events = 0;
+    n_tempos = 0;
+    n_payload_bytes = 0;
+    for (size_t j = 0; j < n_segs; j++)
+    {
+        segs[j].is_writing = true;
+        segs[j].out = arr + n_events;
+        segs[j].tempo_out = tempos ? tempos + n_tempos : NULL;
+        segs[j].payload_out = payload ? payload + n_payload_bytes : NULL;
+        segs[j].payload_base = n_payload_bytes;
+        n_events += segs[j].n_events;
+        n_tempos += segs[j].n_tempos;
+        n_payload_bytes += segs[j].n_payload_bytes;
+    }
+
+    _walk_all( segs, n_segs );
+
+    free( track->event_arr );
+    free( track->tempo_arr );
+    free( track->payload_arr );
+    track->event_arr = arr;
+    track->n_events = n_events;
+    track->capacity = n_events;
+    track->total_ticks = ticks;
+    track->tempo_arr = tempos;
+    track->n_tempos = n_tempos;
+    track->payload_arr = payload;
+    track->n_payload_bytes = n_payload_bytes;
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-parallel.c > MiniMidi_Track_decode_parallel() : %zu events in %zu segments, %zu re-decoded",
+        n_events, n_segs, n_repaired );
+    MiniMidi_Log_writeline();
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef MINIMIDI_PARALLEL_H
+#define MINIMIDI_PARALLEL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// track chunks smaller than this are parsed on one thread
+#define MINIMIDI_PARALLEL_MIN_BYTES ( 4 * 1024 * 1024 )
+#define MINIMIDI_PARALLEL_MIN_SEGMENT ( 1024 * 1024 )
+
+// how far past a split point to look for an event start, and how many
+// events have to decode cleanly from there for it to be believed
+#define MINIMIDI_PARALLEL_RESYNC_BYTES 4096
+#define MINIMIDI_PARALLEL_RESYNC_EVENTS 64
+
+/***
+*  * Parallel Decoding:
+*
+*   The chunk is cut in segments. Each cut is moved forward to a plausible
+*   event start: a delta, a channel status or data bytes under a guessed
+*   running status, then a run of events that decode cleanly. Segments are
+*   then skimmed concurrently with ticks relative to their start.
+*
+*   A segment is only trusted once the one before it, decoded for real,
+*   ends exactly where it starts (and its running status takes as many data
+*   bytes as the guessed one). When it doesn't, the guess was wrong and
+*   that segment is skimmed again from the true boundary on this thread.
+*   Prefix sums over the skims give every segment its place in the event
+*   array and its first tick, and a second concurrent pass decodes in place.
+*/
+
+// decode len bytes of track events into track ( event_arr, n_events, total_ticks,
+// tempo_arr, payload_arr ). NOTE ON / OFF are not linked. returns 0 on success
+int MiniMidi_Track_decode_parallel( MiniMidi_Track *track, _Byte *data, size_t len, uint32_t n_threads );
+
+#endif /* MINIMIDI_PARALLEL_H */
@@ -0,0 +1,445 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef MINIMIDI_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "minimidi-player.h"
+#include "minimidi-merge.h"
+
+uint8_t _get_midi_data_byte_count( MidiStatusCode status );
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Sinks
+****************************************************************************************/
+static int _fd_sink_write( MiniMidi_Sink *self, const _Byte *bytes, size_t len )
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t w = write( self->fd, bytes + done, len - done );
+
+        if (w < 0)
+        {
+            if (errno == EINTR) continue;
+
+            // nobody is draining the other end, don't stall the scheduler
+            self->n_dropped += len - done;
+            return 1;
+        }
+        done += w;
+    }
+    return 0;
+}
+
+static void _fd_sink_close( MiniMidi_Sink *self )
+{
+    if (self->fd > 2) close( self->fd );
+}
+
+MiniMidi_Sink *MiniMidi_Sink_fd_init( int fd )
+{
+    MiniMidi_Sink *self = (MiniMidi_Sink*)calloc( 1, sizeof( MiniMidi_Sink ) );
+    if (!self) return NULL;
+
+    self->fd = fd;
+    self->write = _fd_sink_write;
+    self->close = _fd_sink_close;
+
+    return self;
+}
+
+#ifdef MINIMIDI_ALSA
+static int _alsa_sink_write( MiniMidi_Sink *self, const _Byte *bytes, size_t len )
+{
+    ssize_t w = snd_rawmidi_write( (snd_rawmidi_t*)self->handle, bytes, len );
+
+    if (w < 0 || (size_t)w < len)
+    {
+        self->n_dropped += w < 0 ? len : len - w;
+        return 1;
+    }
+    return 0;
+}
+
+static void _alsa_sink_close( MiniMidi_Sink *self )
+{
+    snd_rawmidi_drain( (snd_rawmidi_t*)self->handle );
+    snd_rawmidi_close( (snd_rawmidi_t*)self->handle );
+}
+#endif
+
+MiniMidi_Sink *MiniMidi_Sink_open( const char *spec )
+{
+    MiniMidi_Sink *self;
+    struct stat st;
+    int fd;
+
+    if (strncmp( spec, "alsa:", 5 ) == 0)
+    {
+#ifdef MINIMIDI_ALSA
+        snd_rawmidi_t *out = NULL;
+
+        if (snd_rawmidi_open( NULL, &out, spec + 5, SND_RAWMIDI_NONBLOCK ) < 0) return NULL;
+
+        self = MiniMidi_Sink_fd_init( -1 );
+        if (!self) return NULL;
+
+        self->handle = out;
+        self->write = _alsa_sink_write;
+        self->close = _alsa_sink_close;
+        return self;
+#else
+        sprintf( MiniMidi_Log_log_line, "minimidi-player.c > MiniMidi_Sink_open() : built without ALSA, can't open %s", spec );
+        MiniMidi_Log_writeline();
+        return NULL;
+#endif
+    }
+
+    if (stat( spec, &st ) == 0 && S_ISFIFO( st.st_mode ))
+    {
+        // read-write so opening never waits for a reader to show up
+        fd = open( spec, O_RDWR | O_NONBLOCK );
+    } else {
+        fd = open( spec, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644 );
+    }
+
+    if (fd < 0) return NULL;
+
+    self = MiniMidi_Sink_fd_init( fd );
+    if (!self) close( fd );
+
+    return self;
+}
+
+void MiniMidi_Sink_free( MiniMidi_Sink *self )
+{
+    if (!self) return;
+
+    if (self->close) self->close( self );
+    free( self );
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Histograms
+****************************************************************************************/
+void MiniMidi_Histogram_add( MiniMidi_Histogram *self, uint64_t usec )
+{
+    self->buckets[ usec < MINIMIDI_HISTOGRAM_BUCKETS ? usec : MINIMIDI_HISTOGRAM_BUCKETS - 1 ]++;
+    self->count++;
+    self->sum_usec += usec;
+
+    if (usec > self->max_usec) self->max_usec = usec;
+}
+
+uint64_t MiniMidi_Histogram_percentile( MiniMidi_Histogram *self, double p )
+{
+    uint64_t target = (uint64_t)( p / 100.0 * self->count ),
+             seen = 0;
+
+    for (uint64_t i = 0; i < MINIMIDI_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += self->buckets[i];
+        if (seen > target) return i;
+    }
+    return self->max_usec;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Scheduler
+****************************************************************************************/
+static void _timespec_add_usec( struct timespec *ts, uint64_t usec )
+{
+    ts->tv_sec += usec / 1000000;
+    ts->tv_nsec += (usec % 1000000) * 1000;
+
+    if (ts->tv_nsec >= 1000000000)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static int64_t _timespec_diff_usec( struct timespec *a, struct timespec *b )
+{
+    return (a->tv_sec - b->tv_sec) * 1000000 + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+static void _publish_playhead( MiniMidi_Player *self, uint64_t ticks )
+{
+    MiniMidi_Playhead_Queue *q = &(self->playhead);
+
+    size_t head = atomic_load_explicit( &(q->head), memory_order_relaxed );
+    size_t tail = atomic_load_explicit( &(q->tail), memory_order_acquire );
+
+    // UI is not keeping up, it only cares about the latest value anyway
+    if (head - tail >= MINIMIDI_PLAYHEAD_QUEUE_SIZE) return;
+
+    q->ticks[ head & (MINIMIDI_PLAYHEAD_QUEUE_SIZE - 1) ] = ticks;
+    atomic_store_explicit( &(q->head), head + 1, memory_order_release );
+}
+
+static void _all_notes_off( MiniMidi_Player *self )
+{
+    _Byte msg[3] = { MIDI_CONTROL_CHANGE, 123, 0 };
+
+    for (_Byte ch = 0; ch < 16; ch++)
+    {
+        msg[0] = MIDI_CONTROL_CHANGE | ch;
+        self->sink->write( self->sink, msg, 3 );
+    }
+}
+
+static void *_scheduler_loop( void *arg )
+{
+    MiniMidi_Player *self = (MiniMidi_Player*)arg;
+    MiniMidi_Merge events;
+    MiniMidi_Event *evt;
+    uint32_t track;
+
+    struct timespec t0, deadline, now, wake;
+    _Byte msg[3];
+    int64_t late, prev_late = -1;
+
+    uint64_t base_usec = MiniMidi_File_ticks_to_usec( self->file, self->start_ticks );
+
+    // every track, in time order
+    if (MiniMidi_Merge_init( &events, self->file, self->start_ticks ))
+    {
+        atomic_store( &(self->is_playing), false );
+        return NULL;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+    while (atomic_load( &(self->is_playing) ) && (evt = MiniMidi_Merge_next( &events, &track )))
+    {
+        if (evt->status_code == MIDI_SYSTEM) continue;
+
+        // a note muted while it sounds still has to end
+        if (evt->status_code != MIDI_NOTE_OFF && track < self->n_tracks
+            && atomic_load_explicit( &(self->is_silenced[ track ]), memory_order_relaxed )) continue;
+
+        deadline = t0;
+        _timespec_add_usec( &deadline, MiniMidi_File_ticks_to_usec( self->file, evt->abs_ticks ) - base_usec );
+
+        // sleep in slices, so long gaps don't hold up stop requests or the playhead
+        for (;;)
+        {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            if (_timespec_diff_usec( &deadline, &now ) <= 0 || !atomic_load( &(self->is_playing) )) break;
+
+            wake = now;
+            _timespec_add_usec( &wake, MINIMIDI_PLAYER_MAX_SLEEP_USEC );
+            if (_timespec_diff_usec( &wake, &deadline ) > 0) wake = deadline;
+
+            clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL );
+
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            if (_timespec_diff_usec( &deadline, &now ) > 0)
+            {
+                _publish_playhead( self, MiniMidi_File_usec_to_ticks( self->file, base_usec + _timespec_diff_usec( &now, &t0 ) ) );
+            }
+        }
+
+        if (!atomic_load( &(self->is_playing) )) break;
+
+        msg[0] = evt->status_code | evt->channel;
+        msg[1] = evt->evt_data[0];
+        msg[2] = evt->evt_data[1];
+        self->sink->write( self->sink, msg, 1 + _get_midi_data_byte_count( evt->status_code ) );
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        late = _timespec_diff_usec( &now, &deadline );
+        if (late < 0) late = 0;
+
+        MiniMidi_Histogram_add( &(self->latency), late );
+        if (prev_late >= 0)
+        {
+            MiniMidi_Histogram_add( &(self->jitter), late > prev_late ? late - prev_late : prev_late - late );
+        }
+        prev_late = late;
+
+        _publish_playhead( self, evt->abs_ticks );
+    }
+
+    MiniMidi_Merge_free( &events );
+    _all_notes_off( self );
+    atomic_store( &(self->is_playing), false );
+
+    return NULL;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Player *MiniMidi_Player_init( MiniMidi_File *file, MiniMidi_Sink *sink )
+{
+    MiniMidi_Player *self = (MiniMidi_Player*)calloc( 1, sizeof( MiniMidi_Player ) );
+    if (!self) return NULL;
+
+    self->file = file;
+    self->sink = sink;
+    self->n_tracks = file->n_tracks;
+    self->is_silenced = (atomic_bool*)malloc( ( self->n_tracks ? self->n_tracks : 1 ) * sizeof( atomic_bool ) );
+    if (!self->is_silenced)
+    {
+        free( self );
+        return NULL;
+    }
+    for (size_t t = 0; t < self->n_tracks; t++) atomic_init( &(self->is_silenced[t]), false );
+
+    atomic_init( &(self->is_playing), false );
+    atomic_init( &(self->playhead.head), 0 );
+    atomic_init( &(self->playhead.tail), 0 );
+
+    return self;
+}
+
+void MiniMidi_Player_free( MiniMidi_Player *self )
+{
+    if (!self) return;
+
+    MiniMidi_Player_stop( self );
+    free( self->is_silenced );
+    free( self );
+}
+
+int MiniMidi_Player_set_file( MiniMidi_Player *self, MiniMidi_File *file )
+{
+    atomic_bool *is_silenced = (atomic_bool*)malloc( ( file->n_tracks ? file->n_tracks : 1 ) * sizeof( atomic_bool ) );
+    if (!is_silenced) return 1;
+
+    MiniMidi_Player_stop( self );
+
+    for (size_t t = 0; t < file->n_tracks; t++) atomic_init( &(is_silenced[t]), false );
+    free( self->is_silenced );
+    self->is_silenced = is_silenced;
+    self->n_tracks = file->n_tracks;
+    self->file = file;
+
+    return 0;
+}
+
+int MiniMidi_Player_silence( MiniMidi_Player *self, size_t track, bool silenced )
+{
+    if (track >= self->n_tracks) return 1;
+
+    atomic_store_explicit( &(self->is_silenced[ track ]), silenced, memory_order_relaxed );
+    return 0;
+}
+
+int MiniMidi_Player_start( MiniMidi_Player *self, uint64_t start_ticks )
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+
+    MiniMidi_Player_stop( self );
+
+    self->start_ticks = start_ticks;
+    memset( &(self->latency), 0, sizeof( MiniMidi_Histogram ) );
+    memset( &(self->jitter), 0, sizeof( MiniMidi_Histogram ) );
+    atomic_store( &(self->is_playing), true );
+
+    // ask for SCHED_FIFO, fall back to a normal thread if we are not allowed to
+    pthread_attr_init( &attr );
+    pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED );
+    pthread_attr_setschedpolicy( &attr, SCHED_FIFO );
+    param.sched_priority = sched_get_priority_max( SCHED_FIFO ) - 1;
+    pthread_attr_setschedparam( &attr, &param );
+
+    self->is_realtime = pthread_create( &(self->thread), &attr, _scheduler_loop, self ) == 0;
+    pthread_attr_destroy( &attr );
+
+    if (!self->is_realtime && pthread_create( &(self->thread), NULL, _scheduler_loop, self ))
+    {
+        atomic_store( &(self->is_playing), false );
+        return 1;
+    }
+    self->has_thread = true;
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-player.c > MiniMidi_Player_start() : playing from tick %lu, realtime=%i",
+        start_ticks, self->is_realtime );
+    MiniMidi_Log_writeline();
+
+    return 0;
+}
+
+int MiniMidi_Player_join( MiniMidi_Player *self )
+{
+    if (!self->has_thread) return 0;
+
+    pthread_join( self->thread, NULL );
+    self->has_thread = false;
+
+    MiniMidi_Player_report( self, NULL );
+    return 0;
+}
+
+int MiniMidi_Player_stop( MiniMidi_Player *self )
+{
+    atomic_store( &(self->is_playing), false );
+    return MiniMidi_Player_join( self );
+}
+
+bool MiniMidi_Player_is_playing( MiniMidi_Player *self )
+{
+    return atomic_load( &(self->is_playing) );
+}
+
+bool MiniMidi_Player_poll_playhead( MiniMidi_Player *self, uint64_t *ticks )
+{
+    MiniMidi_Playhead_Queue *q = &(self->playhead);
+
+    size_t head = atomic_load_explicit( &(q->head), memory_order_acquire );
+    size_t tail = atomic_load_explicit( &(q->tail), memory_order_relaxed );
+
+    if (head == tail) return false;
+
+    *ticks = q->ticks[ (head - 1) & (MINIMIDI_PLAYHEAD_QUEUE_SIZE - 1) ];
+    atomic_store_explicit( &(q->tail), head, memory_order_release );
+
+    return true;
+}
+
+void MiniMidi_Player_report( MiniMidi_Player *self, FILE *out )
+{
+    MiniMidi_Histogram *l = &(self->latency), *j = &(self->jitter);
+
+    snprintf( MiniMidi_Log_log_line, LOG_LINE_MAX_LEN,
+        "MiniMidi_Player: %lu events, realtime=%i, dropped %zu bytes. "
+        "latency usec p50=%lu p99=%lu p99.9=%lu max=%lu. jitter usec p50=%lu p99=%lu p99.9=%lu max=%lu.",
+        l->count, self->is_realtime, self->sink->n_dropped,
+        MiniMidi_Histogram_percentile( l, 50 ), MiniMidi_Histogram_percentile( l, 99 ),
+        MiniMidi_Histogram_percentile( l, 99.9 ), l->max_usec,
+        MiniMidi_Histogram_percentile( j, 50 ), MiniMidi_Histogram_percentile( j, 99 ),
+        MiniMidi_Histogram_percentile( j, 99.9 ), j->max_usec );
+
+    MiniMidi_Log_writeline();
+
+    if (out) fprintf( out, "%s\n", MiniMidi_Log_log_line );
+}
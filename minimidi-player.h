@@ -0,0 +1,126 @@
+#ifndef MINIMIDI_PLAYER_H
+#define MINIMIDI_PLAYER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "minimidi.h"
+
+// slots in the playhead queue towards the UI, power of two
+#define MINIMIDI_PLAYHEAD_QUEUE_SIZE 256
+
+// 1 usec per bucket, anything slower lands in the last one
+#define MINIMIDI_HISTOGRAM_BUCKETS 2000
+
+// longest the scheduler sleeps before checking for stop requests
+#define MINIMIDI_PLAYER_MAX_SLEEP_USEC 20000
+
+/***
+*  * Sinks:
+*
+*   where dispatched MIDI bytes go. The default writes raw bytes to a
+*   file descriptor (a FIFO, a file, a tty), ALSA rawmidi is optional
+*   and only built with MINIMIDI_ALSA.
+*/
+typedef struct MiniMidi_Sink
+{
+    int  (*write)( struct MiniMidi_Sink *self, const _Byte *bytes, size_t len );
+    void (*close)( struct MiniMidi_Sink *self );
+
+    int     fd;
+    void   *handle;     // backend specific
+    size_t  n_dropped;  // bytes the backend could not take without blocking
+
+} MiniMidi_Sink;
+
+MiniMidi_Sink       *MiniMidi_Sink_fd_init( int fd );
+
+// "alsa:<device>" opens a rawmidi device, anything else is a path
+MiniMidi_Sink       *MiniMidi_Sink_open( const char *spec );
+void                MiniMidi_Sink_free( MiniMidi_Sink *self );
+
+
+/***
+*  * Timing stats:
+*
+*   latency -> how late an event left, from its deadline to the sink write
+*   jitter  -> how much that latency moved between consecutive events
+*/
+typedef struct MiniMidi_Histogram
+{
+    uint64_t buckets[ MINIMIDI_HISTOGRAM_BUCKETS ];
+    uint64_t count,
+             sum_usec,
+             max_usec;
+
+} MiniMidi_Histogram;
+
+void     MiniMidi_Histogram_add( MiniMidi_Histogram *self, uint64_t usec );
+uint64_t MiniMidi_Histogram_percentile( MiniMidi_Histogram *self, double p );
+
+
+/***
+*  Single producer (scheduler) / single consumer (UI) ring of playhead ticks.
+*/
+typedef struct MiniMidi_Playhead_Queue
+{
+    uint64_t        ticks[ MINIMIDI_PLAYHEAD_QUEUE_SIZE ];
+    _Atomic size_t  head,   // written by the scheduler
+                    tail;   // written by the UI
+
+} MiniMidi_Playhead_Queue;
+
+
+typedef struct MiniMidi_Player
+{
+    MiniMidi_File          *file;
+    MiniMidi_Sink          *sink;
+
+    pthread_t               thread;
+    bool                    has_thread,
+                            is_realtime;    // got SCHED_FIFO
+    atomic_bool             is_playing;
+
+    uint64_t                start_ticks;
+
+    MiniMidi_Playhead_Queue playhead;
+
+    MiniMidi_Histogram      latency,
+                            jitter;
+
+    // per track, set by the UI while playing. NOTE OFFs still go out
+    atomic_bool             *is_silenced;
+    size_t                  n_tracks;
+
+} MiniMidi_Player;
+
+MiniMidi_Player     *MiniMidi_Player_init( MiniMidi_File *file, MiniMidi_Sink *sink );
+void                MiniMidi_Player_free( MiniMidi_Player *self );
+
+// spawn the scheduler thread, playing from start_ticks
+int MiniMidi_Player_start( MiniMidi_Player *self, uint64_t start_ticks );
+
+// ask the scheduler to stop and wait for it. sends all notes off
+int MiniMidi_Player_stop( MiniMidi_Player *self );
+
+// wait until the file played to its end
+int MiniMidi_Player_join( MiniMidi_Player *self );
+
+bool MiniMidi_Player_is_playing( MiniMidi_Player *self );
+
+// stop and play file from now on, every track unmuted
+int MiniMidi_Player_set_file( MiniMidi_Player *self, MiniMidi_File *file );
+
+// mute / unmute one track, takes effect on its next event
+int MiniMidi_Player_silence( MiniMidi_Player *self, size_t track, bool silenced );
+
+// UI side: drain the queue, latest playhead lands in ticks. returns false if nothing new
+bool MiniMidi_Player_poll_playhead( MiniMidi_Player *self, uint64_t *ticks );
+
+// latency / jitter summary to the log, and to out if not NULL
+void MiniMidi_Player_report( MiniMidi_Player *self, FILE *out );
+
+#endif /* MINIMIDI_PLAYER_H */
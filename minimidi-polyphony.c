@@ -0,0 +1,279 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "minimidi-polyphony.h"
+#include "minimidi-log.h"
+
+// point keys: ticks << 5 | is_start << 4 | channel
+#define _KEY( ticks, is_start, channel ) ( ( (uint64_t)(ticks) << 5 ) | ( (uint64_t)(is_start) << 4 ) | (channel) )
+#define _KEY_TICKS( key ) ( (key) >> 5 )
+#define _KEY_IS_START( key ) ( ( (key) >> 4 ) & 1 )
+#define _KEY_CHANNEL( key ) ( (key) & 0x0F )
+
+#define _RADIX_BITS 16
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+// LSD radix sort, only as many passes as the largest key needs
+static int _radix_sort( uint64_t *keys, size_t n, uint64_t max_key )
+{
+    uint64_t *aux = (uint64_t*)malloc( ( n ? n : 1 ) * sizeof( uint64_t ) ),
+             *src = keys,
+             *dst = aux;
+    size_t *counts = (size_t*)malloc( ( 1 << _RADIX_BITS ) * sizeof( size_t ) );
+
+    if (!aux || !counts)
+    {
+        free( aux );
+        free( counts );
+        return 1;
+    }
+
+    for (int shift = 0; shift < 64 && ( max_key >> shift ); shift += _RADIX_BITS)
+    {
+        memset( counts, 0, ( 1 << _RADIX_BITS ) * sizeof( size_t ) );
+
+        for (size_t i = 0; i < n; i++) counts[ ( src[i] >> shift ) & 0xFFFF ]++;
+
+        size_t sum = 0;
+        for (size_t d = 0; d < ( 1 << _RADIX_BITS ); d++)
+        {
+            size_t c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < n; i++) dst[ counts[ ( src[i] >> shift ) & 0xFFFF ]++ ] = src[i];
+
+        uint64_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != keys) memcpy( keys, src, n * sizeof( uint64_t ) );
+
+    free( aux );
+    free( counts );
+    return 0;
+}
+
+static int _curve_alloc( MiniMidi_Voice_Curve *curve, size_t n )
+{
+    curve->ticks = (uint64_t*)malloc( ( n ? n : 1 ) * sizeof( uint64_t ) );
+    curve->count = (uint32_t*)malloc( ( n ? n : 1 ) * sizeof( uint32_t ) );
+    return !curve->ticks || !curve->count;
+}
+
+static inline void _curve_push( MiniMidi_Voice_Curve *curve, uint64_t ticks, uint32_t count )
+{
+    // nothing changed on this tick
+    if (curve->n && curve->count[ curve->n - 1 ] == count) return;
+
+    curve->ticks[ curve->n ] = ticks;
+    curve->count[ curve->n++ ] = count;
+
+    if (count > curve->peak)
+    {
+        curve->peak = count;
+        curve->peak_ticks = ticks;
+    }
+}
+
+static void _curve_free( MiniMidi_Voice_Curve *curve )
+{
+    free( curve->ticks );
+    free( curve->count );
+}
+
+// last step at or before ticks, n if there is none
+static size_t _step_at( MiniMidi_Voice_Curve *curve, uint64_t ticks )
+{
+    size_t lo = 0, hi = curve->n;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (curve->ticks[mid] <= ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo ? lo - 1 : curve->n;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Polyphony *MiniMidi_Polyphony_init( MiniMidi_File *file )
+{
+    MiniMidi_Polyphony *self = (MiniMidi_Polyphony*)calloc( 1, sizeof( MiniMidi_Polyphony ) );
+    size_t n_notes = 0, n_keys = 0, per_channel[16] = { 0 };
+    uint64_t end_ticks = 0, max_key = 0;
+
+    if (!self) return NULL;
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+
+        if (track->total_ticks > end_ticks) end_ticks = track->total_ticks;
+        for (size_t i = 0; i < track->n_events; i++)
+        {
+            if (track->event_arr[i].status_code == MIDI_NOTE_ON) n_notes++;
+        }
+    }
+
+    uint64_t *keys = (uint64_t*)malloc( ( n_notes ? 2 * n_notes : 1 ) * sizeof( uint64_t ) );
+    if (!keys)
+    {
+        free( self );
+        return NULL;
+    }
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+
+        for (size_t i = 0; i < track->n_events; i++)
+        {
+            MiniMidi_Event *e = &(track->event_arr[i]);
+            if (e->status_code != MIDI_NOTE_ON) continue;
+
+            uint64_t off = e->next ? e->next->abs_ticks : end_ticks;
+            if (off <= e->abs_ticks) continue;
+
+            keys[ n_keys++ ] = _KEY( e->abs_ticks, 1, e->channel & 0x0F );
+            keys[ n_keys++ ] = _KEY( off, 0, e->channel & 0x0F );
+            per_channel[ e->channel & 0x0F ] += 2;
+
+            if (keys[ n_keys - 1 ] > max_key) max_key = keys[ n_keys - 1 ];
+        }
+    }
+
+    int err = _radix_sort( keys, n_keys, max_key ) || _curve_alloc( &(self->total), n_keys );
+    for (int c = 0; c < 16 && !err; c++) err = _curve_alloc( &(self->channels[c]), per_channel[c] );
+
+    if (err)
+    {
+        free( keys );
+        MiniMidi_Polyphony_free( self );
+        return NULL;
+    }
+
+    // sweep, one tick at a time
+    uint32_t total = 0, voices[16] = { 0 };
+
+    for (size_t i = 0; i < n_keys; )
+    {
+        uint64_t ticks = _KEY_TICKS( keys[i] );
+        uint16_t touched = 0;
+
+        for (; i < n_keys && _KEY_TICKS( keys[i] ) == ticks; i++)
+        {
+            int c = _KEY_CHANNEL( keys[i] );
+
+            if (_KEY_IS_START( keys[i] ))
+            {
+                total++;
+                voices[c]++;
+            }
+            else
+            {
+                total--;
+                voices[c]--;
+            }
+            touched |= 1 << c;
+        }
+
+        _curve_push( &(self->total), ticks, total );
+        for (int c = 0; c < 16; c++)
+        {
+            if (touched & ( 1 << c )) _curve_push( &(self->channels[c]), ticks, voices[c] );
+        }
+    }
+
+    free( keys );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-polyphony.c > MiniMidi_Polyphony_init() : %zu notes, %zu steps, peak %u voices at %lu",
+        n_keys / 2, self->total.n, self->total.peak, (unsigned long)self->total.peak_ticks );
+    MiniMidi_Log_writeline();
+
+    return self;
+}
+
+void MiniMidi_Polyphony_free( MiniMidi_Polyphony *self )
+{
+    if (!self) return;
+
+    _curve_free( &(self->total) );
+    for (int c = 0; c < 16; c++) _curve_free( &(self->channels[c]) );
+    free( self );
+}
+
+uint32_t MiniMidi_Voice_Curve_at( MiniMidi_Voice_Curve *curve, uint64_t ticks )
+{
+    size_t i = _step_at( curve, ticks );
+    return i < curve->n ? curve->count[i] : 0;
+}
+
+uint32_t MiniMidi_Voice_Curve_max( MiniMidi_Voice_Curve *curve, uint64_t start_ticks, uint64_t end_ticks )
+{
+    size_t i = _step_at( curve, start_ticks );
+    uint32_t max = 0;
+
+    // what was sounding when the range starts, then every step inside it
+    if (i < curve->n) max = curve->count[i++];
+    else i = 0;
+
+    for (; i < curve->n && curve->ticks[i] < end_ticks; i++)
+    {
+        if (curve->count[i] > max) max = curve->count[i];
+    }
+    return max;
+}
+
+MiniMidi_Voice_Region *MiniMidi_Voice_Curve_over( MiniMidi_Voice_Curve *curve, uint32_t limit, size_t *n_out )
+{
+    MiniMidi_Voice_Region *regions = NULL;
+    size_t n = 0, capacity = 0;
+
+    *n_out = 0;
+
+    for (size_t i = 0; i < curve->n; i++)
+    {
+        if (curve->count[i] <= limit) continue;
+
+        if (n == capacity)
+        {
+            size_t new_cap = capacity ? capacity * 2 : 16;
+            MiniMidi_Voice_Region *r = (MiniMidi_Voice_Region*)realloc( regions, new_cap * sizeof( MiniMidi_Voice_Region ) );
+            if (!r)
+            {
+                free( regions );
+                return NULL;
+            }
+            regions = r;
+            capacity = new_cap;
+        }
+
+        MiniMidi_Voice_Region *region = &(regions[ n++ ]);
+        region->start_ticks = curve->ticks[i];
+        region->peak = 0;
+
+        // the curve always drops back to 0, so the region ends
+        for (; i < curve->n && curve->count[i] > limit; i++)
+        {
+            if (curve->count[i] > region->peak) region->peak = curve->count[i];
+        }
+        region->end_ticks = i < curve->n ? curve->ticks[i] : curve->ticks[ curve->n - 1 ];
+    }
+
+    *n_out = n;
+    return regions;
+}
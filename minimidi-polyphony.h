@@ -0,0 +1,64 @@
+#ifndef MINIMIDI_POLYPHONY_H
+#define MINIMIDI_POLYPHONY_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// voice limit the TUI overlay starts with
+#define MINIMIDI_POLY_DEFAULT_LIMIT 16
+
+/***
+*  * Polyphony:
+*
+*   Active voice count over time, overall and per channel, as step
+*   functions: count[i] voices sound from ticks[i] until ticks[i+1].
+*
+*   Every paired note is a start and an end point packed in a single
+*   integer ( ticks, start / end, channel ), the points are radix sorted
+*   and swept once. Ends sort before starts on the same tick, so back to
+*   back notes don't overlap. Zero length notes take no voice, NOTE ONs
+*   without a NOTE OFF hold theirs until the end of the file.
+*/
+typedef struct MiniMidi_Voice_Curve
+{
+    uint64_t    *ticks;
+    uint32_t    *count;
+    size_t      n;
+
+    uint32_t    peak;
+    uint64_t    peak_ticks;     // first time the peak is reached
+
+} MiniMidi_Voice_Curve;
+
+typedef struct MiniMidi_Voice_Region
+{
+    uint64_t    start_ticks,
+                end_ticks;      // exclusive
+    uint32_t    peak;
+
+} MiniMidi_Voice_Region;
+
+typedef struct MiniMidi_Polyphony
+{
+    MiniMidi_Voice_Curve    total,
+                            channels[16];
+
+} MiniMidi_Polyphony;
+
+MiniMidi_Polyphony  *MiniMidi_Polyphony_init( MiniMidi_File *file );
+void                MiniMidi_Polyphony_free( MiniMidi_Polyphony *self );
+
+// voices sounding at ticks
+uint32_t MiniMidi_Voice_Curve_at( MiniMidi_Voice_Curve *curve, uint64_t ticks );
+
+// most voices sounding at once in [ start_ticks, end_ticks )
+uint32_t MiniMidi_Voice_Curve_max( MiniMidi_Voice_Curve *curve, uint64_t start_ticks, uint64_t end_ticks );
+
+// maximal spans with more than limit voices, in order. n_out is set to how many, free() the result.
+// NULL with n_out = 0 when there are none
+MiniMidi_Voice_Region *MiniMidi_Voice_Curve_over( MiniMidi_Voice_Curve *curve, uint32_t limit, size_t *n_out );
+
+#endif /* MINIMIDI_POLYPHONY_H */
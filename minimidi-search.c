@@ -0,0 +1,666 @@
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "minimidi-search.h"
+#include "minimidi-log.h"
+
+#define _MAGIC "MMNG"
+#define _VERSION 1
+
+// 7 bits per interval, 3 bits per rhythm step, intervals on top
+#define _RHYTHM_BITS ( 3 * ( MINIMIDI_SEARCH_GRAM - 1 ) )
+#define _RHYTHM_MASK ( ( (uint64_t)1 << _RHYTHM_BITS ) - 1 )
+
+#define _RADIX_BITS 16
+
+typedef struct _Index_Header
+{
+    char     magic[4];
+    uint32_t version,
+             gram,
+             n_files;
+    uint64_t n_keys,
+             n_postings,
+             paths_bytes;
+
+} _Index_Header;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Melody Lines and Keys
+****************************************************************************************/
+// highest pitch at every onset, n_events slots are enough
+static size_t _melody( MiniMidi_Track *track, _Byte *pitch, uint64_t *ticks )
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < track->n_events; i++)
+    {
+        MiniMidi_Event *e = &(track->event_arr[i]);
+        if (e->status_code != MIDI_NOTE_ON) continue;
+
+        if (n && ticks[ n - 1 ] == e->abs_ticks)
+        {
+            if (e->evt_data[0] > pitch[ n - 1 ]) pitch[ n - 1 ] = e->evt_data[0];
+            continue;
+        }
+        pitch[n] = e->evt_data[0];
+        ticks[n++] = e->abs_ticks;
+    }
+    return n;
+}
+
+static inline uint64_t _interval_code( int interval )
+{
+    return (uint64_t)( ( interval < -63 ? -63 : interval > 63 ? 63 : interval ) + 64 );
+}
+
+static inline int _rhythm_step( uint64_t gap, uint64_t next_gap )
+{
+    int step = (int)lround( log2( (double)next_gap / (double)gap ) );
+    return step < -3 ? -3 : step > 3 ? 3 : step;
+}
+
+static inline uint64_t _key( const int *intervals, const int *rhythm )
+{
+    uint64_t key = 0;
+
+    for (int k = 0; k < MINIMIDI_SEARCH_GRAM; k++) key = ( key << 7 ) | _interval_code( intervals[k] );
+    for (int k = 0; k < MINIMIDI_SEARCH_GRAM - 1; k++) key = ( key << 3 ) | (uint64_t)( rhythm[k] + 4 );
+
+    return key;
+}
+
+// the gram starting at onset i
+static inline uint64_t _key_at( _Byte *pitch, uint64_t *ticks, size_t i )
+{
+    int intervals[ MINIMIDI_SEARCH_GRAM ], rhythm[ MINIMIDI_SEARCH_GRAM - 1 ];
+
+    for (int k = 0; k < MINIMIDI_SEARCH_GRAM; k++) intervals[k] = (int)pitch[ i + k + 1 ] - (int)pitch[ i + k ];
+    for (int k = 0; k < MINIMIDI_SEARCH_GRAM - 1; k++)
+    {
+        rhythm[k] = _rhythm_step( ticks[ i + k + 1 ] - ticks[ i + k ], ticks[ i + k + 2 ] - ticks[ i + k + 1 ] );
+    }
+    return _key( intervals, rhythm );
+}
+
+// stable LSD radix sort of ( key, ref ) pairs on the key
+static int _sort_pairs( uint64_t *pairs, size_t n, uint64_t max_key )
+{
+    uint64_t *aux = (uint64_t*)malloc( ( n ? 2 * n : 2 ) * sizeof( uint64_t ) ),
+             *src = pairs,
+             *dst = aux;
+    size_t *counts = (size_t*)malloc( ( 1 << _RADIX_BITS ) * sizeof( size_t ) );
+
+    if (!aux || !counts)
+    {
+        free( aux );
+        free( counts );
+        return 1;
+    }
+
+    for (int shift = 0; shift < 64 && ( max_key >> shift ); shift += _RADIX_BITS)
+    {
+        memset( counts, 0, ( 1 << _RADIX_BITS ) * sizeof( size_t ) );
+        for (size_t i = 0; i < n; i++) counts[ ( src[ 2 * i ] >> shift ) & 0xFFFF ]++;
+
+        size_t sum = 0;
+        for (size_t d = 0; d < ( 1 << _RADIX_BITS ); d++)
+        {
+            size_t c = counts[d];
+            counts[d] = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t at = counts[ ( src[ 2 * i ] >> shift ) & 0xFFFF ]++;
+            dst[ 2 * at ] = src[ 2 * i ];
+            dst[ 2 * at + 1 ] = src[ 2 * i + 1 ];
+        }
+
+        uint64_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != pairs) memcpy( pairs, src, 2 * n * sizeof( uint64_t ) );
+
+    free( aux );
+    free( counts );
+    return 0;
+}
+
+static int _cmp_u64( const void *a, const void *b )
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Building
+****************************************************************************************/
+MiniMidi_Search_Builder *MiniMidi_Search_Builder_init( void )
+{
+    return (MiniMidi_Search_Builder*)calloc( 1, sizeof( MiniMidi_Search_Builder ) );
+}
+
+void MiniMidi_Search_Builder_free( MiniMidi_Search_Builder *self )
+{
+    if (!self) return;
+
+    free( self->pairs );
+    free( self->paths );
+    free( self->path_offsets );
+    free( self );
+}
+
+int MiniMidi_Search_Builder_add( MiniMidi_Search_Builder *self, MiniMidi_File *file )
+{
+    size_t path_len = strlen( file->filepath ) + 1, longest = 1;
+    uint32_t file_id = self->n_files;
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        if (file->tracks[t].n_events > longest) longest = file->tracks[t].n_events;
+    }
+
+    char *paths = (char*)realloc( self->paths, self->n_paths_bytes + path_len );
+    uint64_t *offsets = (uint64_t*)realloc( self->path_offsets, ( self->n_files + 2 ) * sizeof( uint64_t ) );
+    _Byte *pitch = (_Byte*)malloc( longest );
+    uint64_t *ticks = (uint64_t*)malloc( longest * sizeof( uint64_t ) );
+
+    if (paths) self->paths = paths;
+    if (offsets) self->path_offsets = offsets;
+    if (!paths || !offsets || !pitch || !ticks)
+    {
+        free( pitch );
+        free( ticks );
+        return 1;
+    }
+
+    memcpy( self->paths + self->n_paths_bytes, file->filepath, path_len );
+    self->path_offsets[ file_id ] = self->n_paths_bytes;
+    self->n_paths_bytes += path_len;
+    self->path_offsets[ file_id + 1 ] = self->n_paths_bytes;
+    self->n_files++;
+
+    // refs only ever grow, so the pairs come out sorted by ref for every key
+    for (size_t t = 0; t < file->n_tracks && t <= 0xFFF; t++)
+    {
+        size_t n = _melody( &(file->tracks[t]), pitch, ticks );
+        if (n <= MINIMIDI_SEARCH_GRAM) continue;
+
+        size_t n_grams = n - MINIMIDI_SEARCH_GRAM;
+        if (self->n_pairs + n_grams > self->capacity)
+        {
+            size_t new_cap = self->capacity ? self->capacity : 4096;
+            while (new_cap < self->n_pairs + n_grams) new_cap *= 2;
+
+            uint64_t *pairs = (uint64_t*)realloc( self->pairs, 2 * new_cap * sizeof( uint64_t ) );
+            if (!pairs)
+            {
+                free( pitch );
+                free( ticks );
+                return 1;
+            }
+            self->pairs = pairs;
+            self->capacity = new_cap;
+        }
+
+        for (size_t i = 0; i < n_grams && i <= 0xFFFFFFF; i++)
+        {
+            self->pairs[ 2 * self->n_pairs ] = _key_at( pitch, ticks, i );
+            self->pairs[ 2 * self->n_pairs + 1 ] = MINIMIDI_SEARCH_REF( file_id, t, i );
+            self->n_pairs++;
+        }
+    }
+
+    free( pitch );
+    free( ticks );
+    return 0;
+}
+
+MiniMidi_Search_Index *MiniMidi_Search_Builder_finish( MiniMidi_Search_Builder *self )
+{
+    MiniMidi_Search_Index *index = (MiniMidi_Search_Index*)calloc( 1, sizeof( MiniMidi_Search_Index ) );
+    uint64_t max_key = 0;
+    size_t n_keys = 0;
+
+    if (!index)
+    {
+        MiniMidi_Search_Builder_free( self );
+        return NULL;
+    }
+
+    for (size_t i = 0; i < self->n_pairs; i++)
+    {
+        if (self->pairs[ 2 * i ] > max_key) max_key = self->pairs[ 2 * i ];
+    }
+
+    if (_sort_pairs( self->pairs, self->n_pairs, max_key ))
+    {
+        free( index );
+        MiniMidi_Search_Builder_free( self );
+        return NULL;
+    }
+
+    for (size_t i = 0; i < self->n_pairs; i++)
+    {
+        if (!i || self->pairs[ 2 * i ] != self->pairs[ 2 * ( i - 1 ) ]) n_keys++;
+    }
+
+    // one block: keys + sentinel, postings, path offsets + sentinel, paths
+    size_t keys_bytes = ( n_keys + 1 ) * sizeof( MiniMidi_Search_Key ),
+           postings_bytes = self->n_pairs * sizeof( uint64_t ),
+           offsets_bytes = ( self->n_files + 1 ) * sizeof( uint64_t );
+    _Byte *block = (_Byte*)malloc( keys_bytes + postings_bytes + offsets_bytes + self->n_paths_bytes + 1 );
+
+    if (!block)
+    {
+        free( index );
+        MiniMidi_Search_Builder_free( self );
+        return NULL;
+    }
+
+    index->block = block;
+    index->keys = (MiniMidi_Search_Key*)block;
+    index->postings = (uint64_t*)( block + keys_bytes );
+    index->path_offsets = (uint64_t*)( block + keys_bytes + postings_bytes );
+    index->paths = (char*)( block + keys_bytes + postings_bytes + offsets_bytes );
+    index->n_keys = n_keys;
+    index->n_postings = self->n_pairs;
+    index->n_files = self->n_files;
+
+    size_t k = 0;
+    for (size_t i = 0; i < self->n_pairs; i++)
+    {
+        if (!i || self->pairs[ 2 * i ] != self->pairs[ 2 * ( i - 1 ) ])
+        {
+            index->keys[k].key = self->pairs[ 2 * i ];
+            index->keys[k++].first = i;
+        }
+        index->postings[i] = self->pairs[ 2 * i + 1 ];
+    }
+    index->keys[ n_keys ].key = UINT64_MAX;
+    index->keys[ n_keys ].first = self->n_pairs;
+
+    if (self->n_files) memcpy( index->path_offsets, self->path_offsets, offsets_bytes );
+    else index->path_offsets[0] = 0;
+    if (self->n_paths_bytes) memcpy( index->paths, self->paths, self->n_paths_bytes );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-search.c > MiniMidi_Search_Builder_finish() : %u files, %zu grams, %zu keys",
+        index->n_files, index->n_postings, index->n_keys );
+    MiniMidi_Log_writeline();
+
+    MiniMidi_Search_Builder_free( self );
+    return index;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Index Files
+****************************************************************************************/
+int MiniMidi_Search_Index_write( MiniMidi_Search_Index *self, const char *path )
+{
+    _Index_Header header = { .magic = _MAGIC, .version = _VERSION, .gram = MINIMIDI_SEARCH_GRAM,
+        .n_files = self->n_files, .n_keys = self->n_keys, .n_postings = self->n_postings,
+        .paths_bytes = self->path_offsets[ self->n_files ] };
+    FILE *out = fopen( path, "wb" );
+
+    if (!out) return 1;
+
+    fwrite( &header, sizeof( header ), 1, out );
+    fwrite( self->keys, sizeof( MiniMidi_Search_Key ), self->n_keys + 1, out );
+    fwrite( self->postings, sizeof( uint64_t ), self->n_postings, out );
+    fwrite( self->path_offsets, sizeof( uint64_t ), self->n_files + 1, out );
+    fwrite( self->paths, 1, header.paths_bytes, out );
+
+    return ferror( out ) | fclose( out );
+}
+
+MiniMidi_Search_Index *MiniMidi_Search_Index_open( const char *path )
+{
+    struct stat st;
+    int fd = open( path, O_RDONLY );
+
+    if (fd < 0) return NULL;
+    if (fstat( fd, &st ) || (size_t)st.st_size < sizeof( _Index_Header ))
+    {
+        close( fd );
+        return NULL;
+    }
+
+    _Byte *map = (_Byte*)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (map == MAP_FAILED) return NULL;
+
+    _Index_Header *header = (_Index_Header*)map;
+    size_t keys_bytes = ( header->n_keys + 1 ) * sizeof( MiniMidi_Search_Key ),
+           postings_bytes = header->n_postings * sizeof( uint64_t ),
+           offsets_bytes = ( (size_t)header->n_files + 1 ) * sizeof( uint64_t );
+
+    MiniMidi_Search_Index *self = NULL;
+
+    if (memcmp( header->magic, _MAGIC, 4 ) == 0 && header->version == _VERSION && header->gram == MINIMIDI_SEARCH_GRAM
+        && sizeof( _Index_Header ) + keys_bytes + postings_bytes + offsets_bytes + header->paths_bytes == (size_t)st.st_size)
+    {
+        self = (MiniMidi_Search_Index*)calloc( 1, sizeof( MiniMidi_Search_Index ) );
+    }
+
+    if (!self)
+    {
+        sprintf( MiniMidi_Log_log_line, "minimidi-search.c > MiniMidi_Search_Index_open() : %s is not a search index", path );
+        MiniMidi_Log_writeline();
+
+        munmap( map, st.st_size );
+        return NULL;
+    }
+
+    _Byte *cursor = map + sizeof( _Index_Header );
+
+    self->map = map;
+    self->map_length = st.st_size;
+    self->keys = (MiniMidi_Search_Key*)cursor;
+    self->postings = (uint64_t*)( cursor + keys_bytes );
+    self->path_offsets = (uint64_t*)( cursor + keys_bytes + postings_bytes );
+    self->paths = (char*)( cursor + keys_bytes + postings_bytes + offsets_bytes );
+    self->n_keys = header->n_keys;
+    self->n_postings = header->n_postings;
+    self->n_files = header->n_files;
+
+    return self;
+}
+
+void MiniMidi_Search_Index_free( MiniMidi_Search_Index *self )
+{
+    if (!self) return;
+
+    if (self->map) munmap( self->map, self->map_length );
+    free( self->block );
+    free( self );
+}
+
+const char *MiniMidi_Search_Index_path( MiniMidi_Search_Index *self, uint32_t file )
+{
+    return file < self->n_files ? self->paths + self->path_offsets[ file ] : NULL;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Queries
+****************************************************************************************/
+// first key >= key
+static size_t _lower_bound( MiniMidi_Search_Index *self, uint64_t key )
+{
+    size_t lo = 0, hi = self->n_keys;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (self->keys[mid].key < key) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// postings of the gram at offset, shifted back to the query start, sorted
+static uint64_t *_gram_refs( MiniMidi_Search_Index *self, const int *intervals, const int *rhythm, size_t offset, size_t *n_out )
+{
+    int steps[ MINIMIDI_SEARCH_GRAM - 1 ];
+    uint64_t want = 0, mask = 0;
+    size_t n = 0;
+
+    // rhythm steps that matter, the others are matched as a key range
+    for (int k = 0; k < MINIMIDI_SEARCH_GRAM - 1; k++)
+    {
+        int r = rhythm ? rhythm[ offset + k ] : MINIMIDI_SEARCH_ANY_RHYTHM;
+        int shift = 3 * ( MINIMIDI_SEARCH_GRAM - 2 - k );
+
+        steps[k] = r == MINIMIDI_SEARCH_ANY_RHYTHM ? -4 : r;
+        if (r != MINIMIDI_SEARCH_ANY_RHYTHM)
+        {
+            want |= (uint64_t)( r + 4 ) << shift;
+            mask |= (uint64_t)7 << shift;
+        }
+    }
+
+    uint64_t lo = _key( intervals + offset, steps ) & ~_RHYTHM_MASK,
+             hi = lo | _RHYTHM_MASK;
+    size_t first = _lower_bound( self, lo ), last;
+
+    for (last = first; last < self->n_keys && self->keys[ last ].key <= hi; last++)
+    {
+        if (( self->keys[ last ].key & mask ) == want) n += self->keys[ last + 1 ].first - self->keys[ last ].first;
+    }
+
+    uint64_t *refs = (uint64_t*)malloc( ( n ? n : 1 ) * sizeof( uint64_t ) );
+    size_t m = 0, n_lists = 0;
+
+    if (!refs) return NULL;
+
+    for (size_t k = first; k < last; k++)
+    {
+        if (( self->keys[k].key & mask ) != want) continue;
+
+        for (uint64_t p = self->keys[k].first; p < self->keys[ k + 1 ].first; p++)
+        {
+            uint64_t ref = self->postings[p];
+            if (MINIMIDI_SEARCH_REF_POS( ref ) >= offset) refs[ m++ ] = ref - offset;
+        }
+        n_lists++;
+    }
+
+    // several keys in the range: their lists are sorted, the union isn't
+    if (n_lists > 1) qsort( refs, m, sizeof( uint64_t ), _cmp_u64 );
+
+    *n_out = m;
+    return refs;
+}
+
+// keep the refs of a that are in b, both sorted. galloping, a is the short one
+static size_t _intersect( uint64_t *a, size_t n_a, const uint64_t *b, size_t n_b )
+{
+    size_t w = 0, j = 0;
+
+    for (size_t i = 0; i < n_a && j < n_b; i++)
+    {
+        size_t step = 1, hi;
+
+        while (j + step < n_b && b[ j + step ] < a[i]) step *= 2;
+        hi = j + step < n_b ? j + step + 1 : n_b;
+
+        while (j < hi)
+        {
+            size_t mid = (j + hi) / 2;
+            if (b[mid] < a[i]) j = mid + 1; else hi = mid;
+        }
+
+        if (j < n_b && b[j] == a[i]) a[ w++ ] = a[i];
+    }
+    return w;
+}
+
+uint64_t *MiniMidi_Search_query( MiniMidi_Search_Index *self, const int *intervals, const int *rhythm,
+    size_t n_intervals, size_t *n_out )
+{
+    *n_out = 0;
+    if (n_intervals < MINIMIDI_SEARCH_GRAM) return NULL;
+
+    size_t n_grams = n_intervals - MINIMIDI_SEARCH_GRAM + 1;
+    uint64_t *lists[ n_grams ];
+    size_t sizes[ n_grams ], best = 0;
+    uint64_t *result = NULL;
+    bool failed = false;
+
+    for (size_t g = 0; g < n_grams; g++)
+    {
+        lists[g] = _gram_refs( self, intervals, rhythm, g, &(sizes[g]) );
+        if (!lists[g]) failed = true;
+        else if (sizes[g] < sizes[ best ] || !lists[ best ]) best = g;
+    }
+
+    if (!failed)
+    {
+        // the rarest gram first, the others only ever shrink it
+        result = lists[ best ];
+        lists[ best ] = NULL;
+        *n_out = sizes[ best ];
+
+        for (size_t g = 0; g < n_grams && *n_out; g++)
+        {
+            if (lists[g]) *n_out = _intersect( result, *n_out, lists[g], sizes[g] );
+        }
+    }
+
+    for (size_t g = 0; g < n_grams; g++) free( lists[g] );
+
+    if (!*n_out)
+    {
+        free( result );
+        return NULL;
+    }
+    return result;
+}
+
+int MiniMidi_Search_parse( const char *spec, int *intervals, int *rhythm, size_t max, size_t *n_intervals, bool *has_rhythm )
+{
+    const char *cursor = spec;
+    size_t n = 0, n_rhythm = 0;
+    char *end;
+
+    *has_rhythm = false;
+
+    while (n < max)
+    {
+        intervals[ n++ ] = (int)strtol( cursor, &end, 10 );
+        if (end == cursor) return 1;
+
+        cursor = end;
+        if (*cursor != ',') break;
+        cursor++;
+    }
+
+    if (*cursor == '/')
+    {
+        *has_rhythm = true;
+        cursor++;
+
+        while (n_rhythm < max)
+        {
+            if (*cursor == '*')
+            {
+                rhythm[ n_rhythm++ ] = MINIMIDI_SEARCH_ANY_RHYTHM;
+                cursor++;
+            }
+            else
+            {
+                long r = strtol( cursor, &end, 10 );
+                if (end == cursor || r < -3 || r > 3) return 1;
+
+                rhythm[ n_rhythm++ ] = (int)r;
+                cursor = end;
+            }
+
+            if (*cursor != ',') break;
+            cursor++;
+        }
+        if (n_rhythm + 1 != n) return 1;
+    }
+
+    *n_intervals = n;
+    return *cursor != '\0' || n < MINIMIDI_SEARCH_GRAM;
+}
+
+static int _cmp_match( const void *a, const void *b )
+{
+    const MiniMidi_Search_Match *x = a, *y = b;
+    if (x->start_ticks != y->start_ticks) return x->start_ticks < y->start_ticks ? -1 : 1;
+    return x->track < y->track ? -1 : x->track > y->track;
+}
+
+MiniMidi_Search_Match *MiniMidi_Search_file( MiniMidi_File *file, const int *intervals, const int *rhythm,
+    size_t n_intervals, size_t *n_out )
+{
+    MiniMidi_Search_Builder *builder = MiniMidi_Search_Builder_init();
+    MiniMidi_Search_Index *index;
+    MiniMidi_Search_Match *matches = NULL;
+    size_t n_refs = 0, longest = 1;
+
+    *n_out = 0;
+    if (!builder) return NULL;
+    if (MiniMidi_Search_Builder_add( builder, file ))
+    {
+        MiniMidi_Search_Builder_free( builder );
+        return NULL;
+    }
+
+    index = MiniMidi_Search_Builder_finish( builder );
+    if (!index) return NULL;
+
+    uint64_t *refs = MiniMidi_Search_query( index, intervals, rhythm, n_intervals, &n_refs );
+    MiniMidi_Search_Index_free( index );
+    if (!refs) return NULL;
+
+    for (size_t t = 0; t < file->n_tracks; t++)
+    {
+        if (file->tracks[t].n_events > longest) longest = file->tracks[t].n_events;
+    }
+
+    _Byte *pitch = (_Byte*)malloc( longest );
+    uint64_t *ticks = (uint64_t*)malloc( longest * sizeof( uint64_t ) );
+    matches = (MiniMidi_Search_Match*)malloc( n_refs * sizeof( MiniMidi_Search_Match ) );
+
+    if (pitch && ticks && matches)
+    {
+        uint32_t track = UINT32_MAX;
+
+        // refs are sorted by track, each melody line is rebuilt once
+        for (size_t i = 0; i < n_refs; i++)
+        {
+            uint32_t pos = MINIMIDI_SEARCH_REF_POS( refs[i] );
+
+            if (MINIMIDI_SEARCH_REF_TRACK( refs[i] ) != track)
+            {
+                track = MINIMIDI_SEARCH_REF_TRACK( refs[i] );
+                _melody( &(file->tracks[ track ]), pitch, ticks );
+            }
+
+            matches[i].track = track;
+            matches[i].start_ticks = ticks[ pos ];
+            matches[i].end_ticks = ticks[ pos + n_intervals ];
+            matches[i].pitch = pitch[ pos ];
+        }
+
+        qsort( matches, n_refs, sizeof( MiniMidi_Search_Match ), _cmp_match );
+        *n_out = n_refs;
+    }
+    else
+    {
+        free( matches );
+        matches = NULL;
+    }
+
+    free( pitch );
+    free( ticks );
+    free( refs );
+
+    return matches;
+}
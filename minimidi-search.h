@@ -0,0 +1,113 @@
+#ifndef MINIMIDI_SEARCH_H
+#define MINIMIDI_SEARCH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// intervals per n-gram, queries need at least this many
+#define MINIMIDI_SEARCH_GRAM 4
+
+// posting refs: file | track | onset, in one integer so lists sort and intersect as numbers
+#define MINIMIDI_SEARCH_REF( file, track, pos ) ( ( (uint64_t)(file) << 40 ) | ( (uint64_t)( (track) & 0xFFF ) << 28 ) | ( (pos) & 0xFFFFFFF ) )
+#define MINIMIDI_SEARCH_REF_FILE( ref )  ( (uint32_t)( (ref) >> 40 ) )
+#define MINIMIDI_SEARCH_REF_TRACK( ref ) ( (uint32_t)( ( (ref) >> 28 ) & 0xFFF ) )
+#define MINIMIDI_SEARCH_REF_POS( ref )   ( (uint32_t)( (ref) & 0xFFFFFFF ) )
+
+// rhythm steps are log2 of the ratio between consecutive onset gaps, -3 .. 3
+#define MINIMIDI_SEARCH_ANY_RHYTHM 0x7F
+
+/***
+*  * Melodic Search:
+*
+*   Each track is reduced to its melody line, the highest pitch at every
+*   onset. N-grams of MINIMIDI_SEARCH_GRAM pitch intervals, plus the rhythm
+*   steps between their onset gaps, are packed into a key with the intervals
+*   in the high bits: a query without rhythm looks up a key range.
+*
+*   The index maps every key to a sorted posting list of refs. A query is
+*   split into overlapping grams, each list is shifted back by the gram's
+*   offset and the lists are intersected, smallest first. Intervals are
+*   clamped to +-63 semitones, which is the only approximation.
+*
+*   Index files are little-endian and mapped read only:
+*       header, keys ( key, first posting ) + sentinel, postings,
+*       path offsets + sentinel, path bytes
+*/
+typedef struct MiniMidi_Search_Key
+{
+    uint64_t key,
+             first;     // into postings, the list runs up to the next key's first
+
+} MiniMidi_Search_Key;
+
+typedef struct MiniMidi_Search_Index
+{
+    MiniMidi_Search_Key *keys;
+    size_t              n_keys;
+
+    uint64_t            *postings;
+    size_t              n_postings;
+
+    uint64_t            *path_offsets;
+    char                *paths;
+    uint32_t            n_files;
+
+    // an index read from disk lives in the mapping, a built one in one block
+    void                *map;
+    size_t              map_length;
+    void                *block;
+
+} MiniMidi_Search_Index;
+
+typedef struct MiniMidi_Search_Builder
+{
+    uint64_t    *pairs;         // key, ref
+    size_t      n_pairs,
+                capacity;
+
+    char        *paths;
+    size_t      n_paths_bytes;
+    uint64_t    *path_offsets;
+    uint32_t    n_files;
+
+} MiniMidi_Search_Builder;
+
+// a match resolved against an open file
+typedef struct MiniMidi_Search_Match
+{
+    uint32_t    track;
+    uint64_t    start_ticks,
+                end_ticks;      // onset of the last note
+    int         pitch;          // of the first note
+
+} MiniMidi_Search_Match;
+
+MiniMidi_Search_Builder *MiniMidi_Search_Builder_init( void );
+// the file gets the next id
+int                     MiniMidi_Search_Builder_add( MiniMidi_Search_Builder *self, MiniMidi_File *file );
+// sort everything into an index, the builder is freed
+MiniMidi_Search_Index   *MiniMidi_Search_Builder_finish( MiniMidi_Search_Builder *self );
+void                    MiniMidi_Search_Builder_free( MiniMidi_Search_Builder *self );
+
+int                     MiniMidi_Search_Index_write( MiniMidi_Search_Index *self, const char *path );
+MiniMidi_Search_Index   *MiniMidi_Search_Index_open( const char *path );
+void                    MiniMidi_Search_Index_free( MiniMidi_Search_Index *self );
+
+const char              *MiniMidi_Search_Index_path( MiniMidi_Search_Index *self, uint32_t file );
+
+// refs of every occurrence's first note, sorted. rhythm is NULL or n_intervals - 1 steps,
+// MINIMIDI_SEARCH_ANY_RHYTHM for don't care. free() the result, NULL with n_out = 0 if none
+uint64_t *MiniMidi_Search_query( MiniMidi_Search_Index *self, const int *intervals, const int *rhythm,
+            size_t n_intervals, size_t *n_out );
+
+// parse "2,2,-4,5" or "2,2,-4,5/0,1,*". returns 1 if it can't be read
+int MiniMidi_Search_parse( const char *spec, int *intervals, int *rhythm, size_t max, size_t *n_intervals, bool *has_rhythm );
+
+// search one file, matches sorted by start_ticks. free() the result
+MiniMidi_Search_Match *MiniMidi_Search_file( MiniMidi_File *file, const int *intervals, const int *rhythm,
+            size_t n_intervals, size_t *n_out );
+
+#endif /* MINIMIDI_SEARCH_H */
@@ -0,0 +1,268 @@
+// memfd_create and file sealing
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "minimidi-shared.h"
+#include "minimidi-log.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+static inline size_t _aligned( size_t n )
+{
+    return ( n + 7 ) & ~(size_t)7;
+}
+
+static size_t _n_checkpoints( size_t n_events )
+{
+    return n_events ? ( n_events + MINIMIDI_INDEX_BLOCK_EVENTS - 1 ) / MINIMIDI_INDEX_BLOCK_EVENTS + 1 : 1;
+}
+
+// a checkpoint before every block and one at the end, with the notes sounding there found the
+// way a seek index skim finds them. without cps and open only counts, the open notes it returns
+static size_t _checkpoints( MiniMidi_Track *track, MiniMidi_Shared_Checkpoint *cps, MiniMidi_Open_Note *open )
+{
+    MiniMidi_Open_Note sounding[MINIMIDI_NOTE_KEYS];
+    bool is_sounding[MINIMIDI_NOTE_KEYS] = { false };
+    size_t n_open = 0,
+           k = 0;
+
+    for (size_t i = 0; ; i++)
+    {
+        if (i % MINIMIDI_INDEX_BLOCK_EVENTS == 0 || i == track->n_events)
+        {
+            if (cps)
+            {
+                cps[k].abs_ticks = i ? track->event_arr[i - 1].abs_ticks : 0;
+                cps[k].event_index = i;
+                cps[k].first_open = n_open;
+                cps[k].n_open = 0;
+            }
+            for (int p = 0; p < MINIMIDI_NOTE_KEYS; p++)
+            {
+                if (!is_sounding[p]) continue;
+
+                if (open) open[n_open] = sounding[p];
+                if (cps) cps[k].n_open++;
+                n_open++;
+            }
+            k++;
+        }
+        if (i == track->n_events) break;
+
+        MiniMidi_Event *evt = &(track->event_arr[i]);
+        size_t p = MINIMIDI_NOTE_KEY( evt );
+
+        if (evt->status_code == MIDI_NOTE_ON)
+        {
+            memset( &(sounding[p]), 0, sizeof( MiniMidi_Open_Note ) );
+            sounding[p].abs_ticks = evt->abs_ticks;
+            sounding[p].channel = evt->channel;
+            sounding[p].pitch = evt->evt_data[0];
+            sounding[p].velocity = evt->evt_data[1];
+            is_sounding[p] = true;
+        }
+        else if (evt->status_code == MIDI_NOTE_OFF)
+        {
+            is_sounding[p] = false;
+        }
+    }
+    return n_open;
+}
+
+// n items of width bytes at offset, inside the segment
+static bool _fits( const MiniMidi_Shared_Header *header, uint64_t offset, uint64_t n, size_t width )
+{
+    return offset <= header->size && n <= ( header->size - offset ) / width && offset % 8 == 0;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+int MiniMidi_Shared_build( MiniMidi_File *file )
+{
+    size_t n_tracks = file->n_tracks,
+           *n_open = (size_t*)calloc( n_tracks ? n_tracks : 1, sizeof( size_t ) ),
+           size = _aligned( sizeof( MiniMidi_Shared_Header ) )
+                + _aligned( file->track->n_tempos * sizeof( MiniMidi_Tempo ) )
+                + _aligned( n_tracks * sizeof( MiniMidi_Shared_Track ) );
+
+    if (!n_open) return -1;
+
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+
+        n_open[t] = _checkpoints( track, NULL, NULL );
+        size += _aligned( track->n_events * sizeof( MiniMidi_Shared_Event ) )
+              + _aligned( _n_checkpoints( track->n_events ) * sizeof( MiniMidi_Shared_Checkpoint ) )
+              + _aligned( n_open[t] * sizeof( MiniMidi_Open_Note ) );
+    }
+
+    int fd = memfd_create( "minimidi-segment", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+    _Byte *base = MAP_FAILED;
+
+    if (fd >= 0 && ftruncate( fd, size ) == 0) base = (_Byte*)mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (base == MAP_FAILED)
+    {
+        if (fd >= 0) close( fd );
+        free( n_open );
+        return -1;
+    }
+
+    // the memfd starts zeroed, padding stays that way
+    MiniMidi_Shared_Header *header = (MiniMidi_Shared_Header*)base;
+    size_t cursor = _aligned( sizeof( MiniMidi_Shared_Header ) );
+
+    header->magic = MINIMIDI_SHARED_MAGIC;
+    header->version = MINIMIDI_SHARED_VERSION;
+    header->size = size;
+    header->format = file->header->format;
+    header->ppqn = file->header->ppqn;
+    header->file_length = file->length;
+
+    header->tempos = cursor;
+    header->n_tempos = file->track->n_tempos;
+    memcpy( base + cursor, file->track->tempo_arr, header->n_tempos * sizeof( MiniMidi_Tempo ) );
+    cursor += _aligned( header->n_tempos * sizeof( MiniMidi_Tempo ) );
+
+    header->tracks = cursor;
+    header->n_tracks = n_tracks;
+    cursor += _aligned( n_tracks * sizeof( MiniMidi_Shared_Track ) );
+
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(file->tracks[t]);
+        MiniMidi_Shared_Track *shared = (MiniMidi_Shared_Track*)( base + header->tracks ) + t;
+
+        shared->length = track->length;
+        shared->total_ticks = track->n_events ? track->event_arr[ track->n_events - 1 ].abs_ticks : 0;
+
+        shared->events = cursor;
+        shared->n_events = track->n_events;
+        cursor += _aligned( track->n_events * sizeof( MiniMidi_Shared_Event ) );
+
+        MiniMidi_Shared_Event *events = (MiniMidi_Shared_Event*)( base + shared->events );
+        for (size_t i = 0; i < track->n_events; i++)
+        {
+            MiniMidi_Event *evt = &(track->event_arr[i]);
+
+            events[i].abs_ticks = evt->abs_ticks;
+            events[i].status = evt->status_code;
+            events[i].channel = evt->channel;
+            events[i].data[0] = evt->evt_data[0];
+            events[i].data[1] = evt->evt_data[1];
+        }
+
+        shared->checkpoints = cursor;
+        shared->n_checkpoints = _n_checkpoints( track->n_events );
+        cursor += _aligned( shared->n_checkpoints * sizeof( MiniMidi_Shared_Checkpoint ) );
+
+        shared->open_notes = cursor;
+        shared->n_open = n_open[t];
+        cursor += _aligned( n_open[t] * sizeof( MiniMidi_Open_Note ) );
+
+        _checkpoints( track, (MiniMidi_Shared_Checkpoint*)( base + shared->checkpoints ), (MiniMidi_Open_Note*)( base + shared->open_notes ) );
+    }
+    free( n_open );
+    munmap( base, size );
+
+    // read-only for good, a writable mapping would have kept the write seal off
+    if (fcntl( fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL ))
+    {
+        close( fd );
+        return -1;
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-shared.c > MiniMidi_Shared_build() : %s : %zu tracks, %zu bytes",
+        file->filepath, n_tracks, size );
+    MiniMidi_Log_writeline();
+
+    return fd;
+}
+
+const MiniMidi_Shared_Header *MiniMidi_Shared_map( int fd )
+{
+    struct stat st;
+
+    if (fstat( fd, &st ) || (size_t)st.st_size < sizeof( MiniMidi_Shared_Header )) return NULL;
+
+    void *base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if (base == MAP_FAILED) return NULL;
+
+    const MiniMidi_Shared_Header *header = (const MiniMidi_Shared_Header*)base;
+    bool is_valid = header->magic == MINIMIDI_SHARED_MAGIC && header->version == MINIMIDI_SHARED_VERSION
+        && header->size == (uint64_t)st.st_size && header->ppqn
+        && _fits( header, header->tempos, header->n_tempos, sizeof( MiniMidi_Tempo ) )
+        && _fits( header, header->tracks, header->n_tracks, sizeof( MiniMidi_Shared_Track ) );
+
+    // every offset is looked at once here, so the viewer can trust them afterwards
+    for (uint64_t t = 0; is_valid && t < header->n_tracks; t++)
+    {
+        const MiniMidi_Shared_Track *track = MiniMidi_Shared_tracks( header ) + t;
+        const MiniMidi_Shared_Checkpoint *cps = MiniMidi_Shared_checkpoints( header, track );
+
+        is_valid = _fits( header, track->events, track->n_events, sizeof( MiniMidi_Shared_Event ) )
+            && _fits( header, track->checkpoints, track->n_checkpoints, sizeof( MiniMidi_Shared_Checkpoint ) )
+            && _fits( header, track->open_notes, track->n_open, sizeof( MiniMidi_Open_Note ) )
+            && track->n_checkpoints && cps[0].event_index == 0
+            && cps[ track->n_checkpoints - 1 ].event_index == track->n_events;
+
+        for (uint64_t k = 0; is_valid && k < track->n_checkpoints; k++)
+        {
+            is_valid = cps[k].first_open <= track->n_open && cps[k].n_open <= track->n_open - cps[k].first_open
+                && ( !k || cps[k].event_index >= cps[k - 1].event_index );
+        }
+    }
+
+    if (!is_valid)
+    {
+        munmap( base, st.st_size );
+        return NULL;
+    }
+    return header;
+}
+
+void MiniMidi_Shared_unmap( const MiniMidi_Shared_Header *header )
+{
+    if (header) munmap( (void*)header, header->size );
+}
+
+const MiniMidi_Shared_Track *MiniMidi_Shared_tracks( const MiniMidi_Shared_Header *header )
+{
+    return (const MiniMidi_Shared_Track*)( (const _Byte*)header + header->tracks );
+}
+
+const MiniMidi_Shared_Event *MiniMidi_Shared_events( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track )
+{
+    return (const MiniMidi_Shared_Event*)( (const _Byte*)header + track->events );
+}
+
+const MiniMidi_Shared_Checkpoint *MiniMidi_Shared_checkpoints( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track )
+{
+    return (const MiniMidi_Shared_Checkpoint*)( (const _Byte*)header + track->checkpoints );
+}
+
+const MiniMidi_Open_Note *MiniMidi_Shared_open_notes( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track )
+{
+    return (const MiniMidi_Open_Note*)( (const _Byte*)header + track->open_notes );
+}
+
+const MiniMidi_Tempo *MiniMidi_Shared_tempos( const MiniMidi_Shared_Header *header )
+{
+    return (const MiniMidi_Tempo*)( (const _Byte*)header + header->tempos );
+}
@@ -0,0 +1,97 @@
+#ifndef MINIMIDI_SHARED_H
+#define MINIMIDI_SHARED_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+#include "minimidi-index.h"
+
+#define MINIMIDI_SHARED_MAGIC 0x4853494Du      // "MISH"
+#define MINIMIDI_SHARED_VERSION 1
+
+/***
+*  * Shared Segment:
+*
+*   A parsed file laid out to be mapped read-only by any number of
+*   processes at once. Nothing in it is a pointer, every array is found by
+*   its offset from the start of the segment, so it reads the same at
+*   whatever address it lands.
+*
+*   Events are 16 bytes and carry no links. Every track has a checkpoint
+*   each MINIMIDI_INDEX_BLOCK_EVENTS events with the notes sounding across
+*   it, the same as a seek index: a viewer copies out the blocks in view,
+*   the sounding notes in front, and links that window on its own ( see
+*   MiniMidi_Lazy_File_init_shared ). So each viewer only pays for what is
+*   on its screen, the events are paid for once per host.
+*
+*   The segment is a sealed memfd: once built, nobody can write to it,
+*   grow it or shrink it, the builder included.
+*/
+typedef struct MiniMidi_Shared_Event
+{
+    uint64_t    abs_ticks;
+    _Byte       status,
+                channel,
+                data[2];
+    uint32_t    reserved;
+
+} MiniMidi_Shared_Event;
+
+typedef struct MiniMidi_Shared_Checkpoint
+{
+    uint64_t    abs_ticks,          // of the event before it, like a seek index checkpoint
+                event_index;
+    uint32_t    first_open,         // notes sounding there, in the track's open notes
+                n_open;
+
+} MiniMidi_Shared_Checkpoint;
+
+// offsets are bytes from the start of the segment
+typedef struct MiniMidi_Shared_Track
+{
+    uint64_t    length,             // of the MTrk chunk
+                total_ticks,
+                events,             // MiniMidi_Shared_Event[ n_events ]
+                n_events,
+                checkpoints,        // MiniMidi_Shared_Checkpoint[ n_checkpoints ], the last one at the end
+                n_checkpoints,
+                open_notes,         // MiniMidi_Open_Note[ n_open ]
+                n_open;
+
+} MiniMidi_Shared_Track;
+
+typedef struct MiniMidi_Shared_Header
+{
+    uint32_t    magic,
+                version;
+    uint64_t    size;               // of the whole segment
+
+    // the MIDI file it was parsed from
+    uint16_t    format,
+                ppqn;
+    uint64_t    file_length;
+
+    uint64_t    tempos,             // MiniMidi_Tempo[ n_tempos ], the built tempo map
+                n_tempos,
+                tracks,             // MiniMidi_Shared_Track[ n_tracks ]
+                n_tracks;
+
+} MiniMidi_Shared_Header;
+
+// a sealed memfd holding file, -1 on failure. file isn't needed afterwards
+int MiniMidi_Shared_build( MiniMidi_File *file );
+
+// map a segment read-only and check everything in it lies inside it. NULL if it doesn't
+const MiniMidi_Shared_Header *MiniMidi_Shared_map( int fd );
+void MiniMidi_Shared_unmap( const MiniMidi_Shared_Header *header );
+
+// arrays of a mapped segment
+const MiniMidi_Shared_Track         *MiniMidi_Shared_tracks( const MiniMidi_Shared_Header *header );
+const MiniMidi_Shared_Event         *MiniMidi_Shared_events( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track );
+const MiniMidi_Shared_Checkpoint    *MiniMidi_Shared_checkpoints( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track );
+const MiniMidi_Open_Note            *MiniMidi_Shared_open_notes( const MiniMidi_Shared_Header *header, const MiniMidi_Shared_Track *track );
+const MiniMidi_Tempo                *MiniMidi_Shared_tempos( const MiniMidi_Shared_Header *header );
+
+#endif /* MINIMIDI_SHARED_H */
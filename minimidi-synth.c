@@ -0,0 +1,667 @@
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "minimidi-synth.h"
+#include "minimidi-merge.h"
+
+// 16 bit mono samples the RIFF and data sizes, 32 bits each, can count
+#define _MAX_WAV_SAMPLES ( ( UINT32_MAX - 36 ) / 2 )
+
+typedef enum {
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_DECAY,
+    ENV_SUSTAIN,
+    ENV_RELEASE
+} _Env_Stage;
+
+typedef enum {
+    CMD_START,
+    CMD_RELEASE
+} _Cmd_Type;
+
+// something that happens to a voice, at a sample offset inside the current block
+typedef struct _Voice_Cmd
+{
+    uint32_t  offset,
+              voice;
+    _Cmd_Type type;
+    float     inc,
+              gain;
+
+} _Voice_Cmd;
+
+typedef struct MiniMidi_Synth
+{
+    MiniMidi_Synth_Config cfg;
+
+    // voice state, one column per field so render loops stream through them
+    float      *phase,
+               *inc,
+               *gain,
+               *level,
+               *rel_step;
+    uint8_t    *stage;
+
+    // voice allocation, only touched by the sequencing thread
+    uint8_t    *chan,
+               *pitch;
+    bool       *held,
+               *busy;
+    uint64_t   *started,
+                n_started;
+
+    float       att_step,
+                dec_step,
+                freq_inc[128];
+
+    // commands for the block being rendered, sorted by offset
+    _Voice_Cmd *cmds;
+    size_t      n_cmds,
+                cmd_cap;
+    uint32_t    block_len;
+
+    // one mix buffer per thread, summed after every block
+    float     **mix;
+
+    pthread_t        *workers;
+    pthread_barrier_t start_barrier,
+                      done_barrier;
+    bool              quit;
+
+    // workers wait here until the barriers are sized to the ones that started
+    pthread_mutex_t   gate;
+    pthread_cond_t    gate_open;
+    bool              is_gate_open;
+
+} MiniMidi_Synth;
+
+typedef struct _Worker_Arg
+{
+    MiniMidi_Synth *synth;
+    uint32_t        id;
+
+} _Worker_Arg;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Voice Rendering
+****************************************************************************************/
+
+// level after n more samples, moving through stages as they finish
+static float _advance_env( MiniMidi_Synth *self, uint32_t v, uint32_t n )
+{
+    float lvl = self->level[v];
+    float steps;
+
+    while (n > 0)
+    {
+        switch (self->stage[v])
+        {
+            case ENV_ATTACK:
+                steps = ceilf( (1.0f - lvl) / self->att_step );
+                if (steps <= n) {
+                    lvl = 1.0f;
+                    n -= (uint32_t)steps;
+                    self->stage[v] = ENV_DECAY;
+                } else {
+                    lvl += n * self->att_step;
+                    n = 0;
+                }
+                break;
+
+            case ENV_DECAY:
+                steps = ceilf( (lvl - self->cfg.sustain_level) / self->dec_step );
+                if (steps <= n) {
+                    lvl = self->cfg.sustain_level;
+                    n -= (uint32_t)steps;
+                    self->stage[v] = ENV_SUSTAIN;
+                } else {
+                    lvl -= n * self->dec_step;
+                    n = 0;
+                }
+                break;
+
+            case ENV_RELEASE:
+                steps = ceilf( lvl / self->rel_step[v] );
+                if (steps <= n) {
+                    lvl = 0.0f;
+                    self->stage[v] = ENV_IDLE;
+                } else {
+                    lvl -= n * self->rel_step[v];
+                }
+                n = 0;
+                break;
+
+            case ENV_SUSTAIN:
+            case ENV_IDLE:
+            default:
+                n = 0;
+                break;
+        }
+    }
+
+    self->level[v] = lvl;
+    return lvl;
+}
+
+// band-limited saw. phase is computed from the start of the chunk rather than
+// carried from sample to sample, and the polyBLEP terms are selects, so the
+// loop has no dependencies between iterations and vectorizes.
+static void _saw_blep( float *restrict out, uint32_t n, float *phase_io, float inc, float gain, float l0, float dl )
+{
+    const float p0 = *phase_io;
+    const float inv_inc = 1.0f / inc;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        float t = p0 + inc * (float)k;
+        t -= (float)(int)t;
+
+        float a = t * inv_inc;              // just after the wrap
+        float b = (t - 1.0f) * inv_inc;     // just before it
+        float s = 2.0f * t - 1.0f;
+
+        s -= (float)( t < inc )        * ( a + a - a * a - 1.0f );
+        s -= (float)( t > 1.0f - inc ) * ( b * b + b + b + 1.0f );
+
+        out[k] += s * gain * ( l0 + dl * (float)k );
+    }
+
+    float p = p0 + inc * (float)n;
+    *phase_io = p - (float)(int)p;
+}
+
+static void _render_segment( MiniMidi_Synth *self, uint32_t v, float *out, uint32_t n )
+{
+    while (n > 0 && self->stage[v] != ENV_IDLE)
+    {
+        uint32_t chunk = n < MINIMIDI_SYNTH_CONTROL_RATE ? n : MINIMIDI_SYNTH_CONTROL_RATE;
+
+        float l0 = self->level[v];
+        float l1 = _advance_env( self, v, chunk );
+
+        _saw_blep( out, chunk, &(self->phase[v]), self->inc[v], self->gain[v], l0, (l1 - l0) / chunk );
+
+        out += chunk;
+        n -= chunk;
+    }
+}
+
+static void _apply_cmd( MiniMidi_Synth *self, _Voice_Cmd *cmd )
+{
+    uint32_t v = cmd->voice;
+
+    if (cmd->type == CMD_START)
+    {
+        // a stolen voice restarts from where its envelope is, no click
+        if (self->stage[v] == ENV_IDLE)
+        {
+            self->phase[v] = 0.0f;
+            self->level[v] = 0.0f;
+        }
+        self->inc[v] = cmd->inc;
+        self->gain[v] = cmd->gain;
+        self->stage[v] = ENV_ATTACK;
+
+    } else if (self->stage[v] != ENV_IDLE)
+    {
+        self->stage[v] = ENV_RELEASE;
+        self->rel_step[v] = fmaxf( self->level[v] / ( self->cfg.release_sec * self->cfg.sample_rate ), 1e-7f );
+    }
+}
+
+static void _render_voice( MiniMidi_Synth *self, uint32_t v, float *out )
+{
+    uint32_t pos = 0;
+    size_t c = 0;
+
+    for (;;)
+    {
+        while (c < self->n_cmds && self->cmds[c].voice != v) c++;
+
+        uint32_t stop = c < self->n_cmds ? self->cmds[c].offset : self->block_len;
+
+        _render_segment( self, v, out + pos, stop - pos );
+        pos = stop;
+
+        if (c == self->n_cmds) break;
+        _apply_cmd( self, &(self->cmds[c++]) );
+    }
+}
+
+static void _render_share( MiniMidi_Synth *self, uint32_t id )
+{
+    float *out = self->mix[id];
+    memset( out, 0, self->block_len * sizeof( float ) );
+
+    for (uint32_t v = id; v < self->cfg.max_voices; v += self->cfg.n_threads)
+    {
+        _render_voice( self, v, out );
+    }
+}
+
+static void *_worker_loop( void *arg )
+{
+    _Worker_Arg *w = (_Worker_Arg*)arg;
+    MiniMidi_Synth *self = w->synth;
+
+    pthread_mutex_lock( &(self->gate) );
+    while (!self->is_gate_open) pthread_cond_wait( &(self->gate_open), &(self->gate) );
+    pthread_mutex_unlock( &(self->gate) );
+
+    for (;;)
+    {
+        pthread_barrier_wait( &(self->start_barrier) );
+        if (self->quit) break;
+
+        _render_share( self, w->id );
+        pthread_barrier_wait( &(self->done_barrier) );
+    }
+
+    free( w );
+    return NULL;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Sequencing
+****************************************************************************************/
+static int _push_cmd( MiniMidi_Synth *self, uint32_t offset, uint32_t voice, _Cmd_Type type, float inc, float gain )
+{
+    if (self->n_cmds == self->cmd_cap)
+    {
+        size_t new_cap = self->cmd_cap ? self->cmd_cap * 2 : 64;
+        _Voice_Cmd *cmds = (_Voice_Cmd*)realloc( self->cmds, new_cap * sizeof( _Voice_Cmd ) );
+        if (!cmds) return 1;
+
+        self->cmds = cmds;
+        self->cmd_cap = new_cap;
+    }
+
+    _Voice_Cmd *cmd = &(self->cmds[ self->n_cmds++ ]);
+    cmd->offset = offset;
+    cmd->voice = voice;
+    cmd->type = type;
+    cmd->inc = inc;
+    cmd->gain = gain;
+
+    return 0;
+}
+
+// a free voice if any, else the oldest releasing one, else the oldest one
+static uint32_t _alloc_voice( MiniMidi_Synth *self )
+{
+    uint32_t best = 0;
+    int best_rank = 3;
+
+    for (uint32_t v = 0; v < self->cfg.max_voices; v++)
+    {
+        int rank = !self->busy[v] ? 0 : ( !self->held[v] ? 1 : 2 );
+
+        if (rank < best_rank || (rank == best_rank && self->started[v] < self->started[best]))
+        {
+            best = v;
+            best_rank = rank;
+        }
+        if (rank == 0) break;
+    }
+    return best;
+}
+
+static void _note_on( MiniMidi_Synth *self, MiniMidi_Event *evt, uint32_t offset )
+{
+    uint32_t v = _alloc_voice( self );
+
+    self->chan[v] = evt->channel;
+    self->pitch[v] = evt->evt_data[0] & 0x7F;
+    self->held[v] = true;
+    self->busy[v] = true;
+    self->started[v] = ++self->n_started;
+
+    _push_cmd( self, offset, v, CMD_START, self->freq_inc[ self->pitch[v] ],
+        ( evt->evt_data[1] / 127.0f ) * self->cfg.channel_gain[ evt->channel & 0x0F ] );
+}
+
+static void _note_off( MiniMidi_Synth *self, MiniMidi_Event *evt, uint32_t offset )
+{
+    uint32_t found = self->cfg.max_voices;
+
+    // the oldest held voice playing this note
+    for (uint32_t v = 0; v < self->cfg.max_voices; v++)
+    {
+        if (self->held[v] && self->chan[v] == evt->channel && self->pitch[v] == (evt->evt_data[0] & 0x7F)
+            && (found == self->cfg.max_voices || self->started[v] < self->started[found]))
+        {
+            found = v;
+        }
+    }
+
+    if (found == self->cfg.max_voices) return;
+
+    self->held[found] = false;
+    _push_cmd( self, offset, found, CMD_RELEASE, 0.0f, 0.0f );
+}
+
+static uint64_t _event_sample( MiniMidi_File *file, MiniMidi_Synth_Config *cfg, MiniMidi_Event *evt )
+{
+    return MiniMidi_File_ticks_to_usec( file, evt->abs_ticks ) * cfg->sample_rate / 1000000;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> WAV
+****************************************************************************************/
+static void _put_u32( _Byte *p, uint32_t v )
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = (v >> 24) & 0xFF;
+}
+
+static void _put_u16( _Byte *p, uint16_t v )
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF;
+}
+
+static int _write_wav_header( FILE *f, uint32_t sample_rate, uint64_t n_samples )
+{
+    _Byte h[44];
+    uint32_t data_len = (uint32_t)( n_samples * 2 );
+
+    memcpy( h, "RIFF", 4 );
+    _put_u32( h + 4, 36 + data_len );
+    memcpy( h + 8, "WAVEfmt ", 8 );
+    _put_u32( h + 16, 16 );             // fmt chunk size
+    _put_u16( h + 20, 1 );              // PCM
+    _put_u16( h + 22, 1 );              // mono
+    _put_u32( h + 24, sample_rate );
+    _put_u32( h + 28, sample_rate * 2 );
+    _put_u16( h + 32, 2 );              // block align
+    _put_u16( h + 34, 16 );             // bits per sample
+    memcpy( h + 36, "data", 4 );
+    _put_u32( h + 40, data_len );
+
+    fseek( f, 0, SEEK_SET );
+    return fwrite( h, 1, 44, f ) == 44 ? 0 : 1;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+void MiniMidi_Synth_Config_default( MiniMidi_Synth_Config *cfg )
+{
+    cfg->sample_rate = 44100;
+    cfg->block_size = 512;
+    cfg->max_voices = 64;
+    cfg->n_threads = 1;
+
+    cfg->attack_sec = 0.005f;
+    cfg->decay_sec = 0.1f;
+    cfg->sustain_level = 0.7f;
+    cfg->release_sec = 0.15f;
+
+    for (int ch = 0; ch < 16; ch++) cfg->channel_gain[ch] = 1.0f;
+    cfg->master_gain = 0.1f;
+}
+
+static void _synth_free( MiniMidi_Synth *self )
+{
+    if (self->workers)
+    {
+        self->quit = true;
+        pthread_barrier_wait( &(self->start_barrier) );
+
+        for (uint32_t i = 1; i < self->cfg.n_threads; i++) pthread_join( self->workers[i], NULL );
+
+        pthread_barrier_destroy( &(self->start_barrier) );
+        pthread_barrier_destroy( &(self->done_barrier) );
+        pthread_mutex_destroy( &(self->gate) );
+        pthread_cond_destroy( &(self->gate_open) );
+        free( self->workers );
+    }
+
+    if (self->mix)
+    {
+        for (uint32_t i = 0; i < self->cfg.n_threads; i++) free( self->mix[i] );
+        free( self->mix );
+    }
+
+    free( self->phase ); free( self->inc ); free( self->gain ); free( self->level ); free( self->rel_step );
+    free( self->stage ); free( self->chan ); free( self->pitch ); free( self->held ); free( self->busy );
+    free( self->started ); free( self->cmds );
+}
+
+static int _synth_init( MiniMidi_Synth *self, MiniMidi_Synth_Config *cfg )
+{
+    uint32_t nv = cfg->max_voices;
+
+    memset( self, 0, sizeof( MiniMidi_Synth ) );
+    self->cfg = *cfg;
+    if (!self->cfg.n_threads) self->cfg.n_threads = 1;
+    if (self->cfg.n_threads > nv) self->cfg.n_threads = nv;
+
+    self->phase = (float*)calloc( nv, sizeof( float ) );
+    self->inc = (float*)calloc( nv, sizeof( float ) );
+    self->gain = (float*)calloc( nv, sizeof( float ) );
+    self->level = (float*)calloc( nv, sizeof( float ) );
+    self->rel_step = (float*)calloc( nv, sizeof( float ) );
+    self->stage = (uint8_t*)calloc( nv, sizeof( uint8_t ) );
+    self->chan = (uint8_t*)calloc( nv, sizeof( uint8_t ) );
+    self->pitch = (uint8_t*)calloc( nv, sizeof( uint8_t ) );
+    self->held = (bool*)calloc( nv, sizeof( bool ) );
+    self->busy = (bool*)calloc( nv, sizeof( bool ) );
+    self->started = (uint64_t*)calloc( nv, sizeof( uint64_t ) );
+    self->mix = (float**)calloc( self->cfg.n_threads, sizeof( float* ) );
+
+    if (!self->phase || !self->inc || !self->gain || !self->level || !self->rel_step || !self->stage
+        || !self->chan || !self->pitch || !self->held || !self->busy || !self->started || !self->mix)
+    {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < self->cfg.n_threads; i++)
+    {
+        self->mix[i] = (float*)malloc( self->cfg.block_size * sizeof( float ) );
+        if (!self->mix[i]) return 1;
+    }
+
+    for (int p = 0; p < 128; p++)
+    {
+        self->freq_inc[p] = 440.0f * powf( 2.0f, (p - 69) / 12.0f ) / self->cfg.sample_rate;
+    }
+
+    self->att_step = 1.0f / fmaxf( self->cfg.attack_sec * self->cfg.sample_rate, 1.0f );
+    self->dec_step = ( 1.0f - self->cfg.sustain_level ) / fmaxf( self->cfg.decay_sec * self->cfg.sample_rate, 1.0f );
+    if (self->dec_step <= 0.0f) self->dec_step = 1.0f;
+
+    if (self->cfg.n_threads > 1)
+    {
+        uint32_t n = 1;
+
+        self->workers = (pthread_t*)calloc( self->cfg.n_threads, sizeof( pthread_t ) );
+        if (!self->workers) return 1;
+
+        pthread_mutex_init( &(self->gate), NULL );
+        pthread_cond_init( &(self->gate_open), NULL );
+
+        // the first worker that doesn't start ends it, the ones before it share its voices
+        for (; n < self->cfg.n_threads; n++)
+        {
+            _Worker_Arg *w = (_Worker_Arg*)malloc( sizeof( _Worker_Arg ) );
+            if (!w) break;
+
+            w->synth = self;
+            w->id = n;
+            if (pthread_create( &(self->workers[n]), NULL, _worker_loop, w ))
+            {
+                free( w );
+                break;
+            }
+        }
+
+        if (n < self->cfg.n_threads)
+        {
+            sprintf( MiniMidi_Log_log_line, "minimidi-synth.c > _synth_init() : %u of %u threads started",
+                n, self->cfg.n_threads );
+            MiniMidi_Log_writeline();
+
+            for (uint32_t i = n; i < self->cfg.n_threads; i++)
+            {
+                free( self->mix[i] );
+                self->mix[i] = NULL;
+            }
+            self->cfg.n_threads = n;
+        }
+
+        if (n > 1)
+        {
+            pthread_barrier_init( &(self->start_barrier), NULL, n );
+            pthread_barrier_init( &(self->done_barrier), NULL, n );
+        }
+
+        pthread_mutex_lock( &(self->gate) );
+        self->is_gate_open = true;
+        pthread_cond_broadcast( &(self->gate_open) );
+        pthread_mutex_unlock( &(self->gate) );
+
+        // nobody to wait for
+        if (n == 1)
+        {
+            pthread_mutex_destroy( &(self->gate) );
+            pthread_cond_destroy( &(self->gate_open) );
+            free( self->workers );
+            self->workers = NULL;
+        }
+    }
+
+    return 0;
+}
+
+int MiniMidi_Synth_render_wav( MiniMidi_File *file, MiniMidi_Synth_Config *cfg, const char *wav_path )
+{
+    MiniMidi_Synth synth;
+    MiniMidi_Merge events;
+    MiniMidi_Event *evt;
+
+    FILE *out = fopen( wav_path, "wb" );
+    if (!out) return 1;
+
+    // every track, in time order
+    if (MiniMidi_Merge_init( &events, file, 0 ))
+    {
+        fclose( out );
+        return 1;
+    }
+
+    if (_synth_init( &synth, cfg ))
+    {
+        _synth_free( &synth );
+        MiniMidi_Merge_free( &events );
+        fclose( out );
+        return 1;
+    }
+
+    int16_t *pcm = (int16_t*)malloc( synth.cfg.block_size * sizeof( int16_t ) );
+    if (!pcm || _write_wav_header( out, synth.cfg.sample_rate, 0 ))
+    {
+        free( pcm );
+        _synth_free( &synth );
+        MiniMidi_Merge_free( &events );
+        fclose( out );
+        return 1;
+    }
+
+    uint64_t block_start = 0,
+             tail_end = 0;
+    bool voices_busy = false,
+         is_too_long = false;
+
+    while (MiniMidi_Merge_peek( &events, NULL ) || ( voices_busy && block_start < tail_end ))
+    {
+        // a WAV can't say how long it is past 4 GiB, stop at what it can
+        if (block_start + synth.cfg.block_size > _MAX_WAV_SAMPLES)
+        {
+            is_too_long = true;
+            break;
+        }
+
+        uint64_t block_end = block_start + synth.cfg.block_size;
+        synth.n_cmds = 0;
+        synth.block_len = synth.cfg.block_size;
+
+        // turn this block's events into voice commands
+        while ((evt = MiniMidi_Merge_peek( &events, NULL )))
+        {
+            uint64_t at = _event_sample( file, &(synth.cfg), evt );
+
+            if (at >= block_end) break;
+
+            if (evt->status_code == MIDI_NOTE_ON)
+                _note_on( &synth, evt, (uint32_t)(at - block_start) );
+            else if (evt->status_code == MIDI_NOTE_OFF)
+                _note_off( &synth, evt, (uint32_t)(at - block_start) );
+
+            MiniMidi_Merge_next( &events, NULL );
+        }
+
+        if (!evt && !tail_end)
+        {
+            tail_end = block_end + (uint64_t)MINIMIDI_SYNTH_MAX_TAIL_SEC * synth.cfg.sample_rate;
+        }
+
+        if (synth.workers) pthread_barrier_wait( &(synth.start_barrier) );
+        _render_share( &synth, 0 );
+        if (synth.workers) pthread_barrier_wait( &(synth.done_barrier) );
+
+        // mix down
+        float *mix = synth.mix[0];
+        for (uint32_t t = 1; t < synth.cfg.n_threads; t++)
+        {
+            for (uint32_t k = 0; k < synth.block_len; k++) mix[k] += synth.mix[t][k];
+        }
+
+        for (uint32_t k = 0; k < synth.block_len; k++)
+        {
+            float s = mix[k] * synth.cfg.master_gain;
+            s = s > 1.0f ? 1.0f : ( s < -1.0f ? -1.0f : s );
+            pcm[k] = (int16_t)( s * 32767.0f );
+        }
+        fwrite( pcm, sizeof( int16_t ), synth.block_len, out );
+
+        voices_busy = false;
+        for (uint32_t v = 0; v < synth.cfg.max_voices; v++)
+        {
+            synth.busy[v] = synth.held[v] || synth.stage[v] != ENV_IDLE;
+            voices_busy |= synth.busy[v];
+        }
+
+        block_start = block_end;
+    }
+
+    int err = _write_wav_header( out, synth.cfg.sample_rate, block_start ) || is_too_long;
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-synth.c > MiniMidi_Synth_render_wav() : wrote %lu samples to %s%s",
+        block_start, wav_path, is_too_long ? ", cut off at the 4 GiB a WAV can hold" : "" );
+    MiniMidi_Log_writeline();
+
+    free( pcm );
+    _synth_free( &synth );
+    MiniMidi_Merge_free( &events );
+    fclose( out );
+
+    return err;
+}
@@ -0,0 +1,47 @@
+#ifndef MINIMIDI_SYNTH_H
+#define MINIMIDI_SYNTH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+// envelope is evaluated once per this many samples, linear in between
+#define MINIMIDI_SYNTH_CONTROL_RATE 32
+
+// keep rendering after the last event until voices are quiet, at most this long
+#define MINIMIDI_SYNTH_MAX_TAIL_SEC 4
+
+/***
+*  * Offline Synth:
+*
+*   One band-limited saw (polyBLEP) per voice, through a linear ADSR.
+*   Audio is produced in fixed size blocks. Note events are turned into
+*   per-voice commands at sample offsets inside the block, so voices can be
+*   rendered independently (and on several threads) and mixed afterwards.
+*/
+typedef struct MiniMidi_Synth_Config
+{
+    uint32_t sample_rate,
+             block_size,
+             max_voices,
+             n_threads;     // 1 -> render on the calling thread only
+
+    float    attack_sec,
+             decay_sec,
+             sustain_level,
+             release_sec;
+
+    float    channel_gain[16],
+             master_gain;
+
+} MiniMidi_Synth_Config;
+
+void MiniMidi_Synth_Config_default( MiniMidi_Synth_Config *cfg );
+
+// render the whole file to a mono 16 bit WAV. returns 0 on success. past the 4 GiB a WAV
+// can hold it stops, keeps what fits and returns 1
+int MiniMidi_Synth_render_wav( MiniMidi_File *file, MiniMidi_Synth_Config *cfg, const char *wav_path );
+
+#endif /* MINIMIDI_SYNTH_H */
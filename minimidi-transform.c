@@ -0,0 +1,407 @@
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "minimidi-transform.h"
+#include "minimidi-log.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Per Event Math
+****************************************************************************************/
+static inline bool _in_scope( const MiniMidi_Scope *scope, MiniMidi_Event *e )
+{
+    return !scope || ( e->abs_ticks >= scope->start_ticks && e->abs_ticks <= scope->end_ticks
+        && e->evt_data[0] >= scope->start_note && e->evt_data[0] <= scope->end_note );
+}
+
+// back into low..high by octaves when the range spans one, clamped otherwise
+static inline int _fold( int pitch, int low, int high )
+{
+    if (high - low >= 11)
+    {
+        while (pitch < low) pitch += 12;
+        while (pitch > high) pitch -= 12;
+    }
+    return pitch < low ? low : pitch > high ? high : pitch;
+}
+
+static inline uint64_t _grid_line( const MiniMidi_Transform *t, uint64_t k )
+{
+    return k * t->grid + ( ( k & 1 ) ? (uint64_t)( t->swing * t->grid ) : 0 );
+}
+
+static inline uint64_t _quantize( const MiniMidi_Transform *t, uint64_t ticks )
+{
+    uint64_t k = ticks / t->grid,
+             best = _grid_line( t, k );
+
+    // with swing the nearest line can be the one before or after
+    for (uint64_t j = k ? k - 1 : k; j <= k + 1; j++)
+    {
+        uint64_t line = _grid_line( t, j );
+        if (llabs( (long long)( line - ticks ) ) < llabs( (long long)( best - ticks ) )) best = line;
+    }
+
+    return ticks + llround( ( (double)best - (double)ticks ) * t->strength );
+}
+
+static inline _Byte _velocity( const MiniMidi_Transform *t, _Byte velocity )
+{
+    float v = velocity;
+
+    if (t->ratio > 1 && v > t->threshold) v = t->threshold + ( v - t->threshold ) / t->ratio;
+
+    long iv = lroundf( v * t->scale );
+    return iv < 1 ? 1 : iv > 127 ? 127 : (_Byte)iv;
+}
+
+static inline bool _moves_ticks( const MiniMidi_Transform *t )
+{
+    return t->kind == MINIMIDI_TRANSFORM_QUANTIZE || t->kind == MINIMIDI_TRANSFORM_STRETCH;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Pass
+****************************************************************************************/
+// transforms that take a note's NOTE OFF along with it
+static inline bool _moves_off( const MiniMidi_Transform *t )
+{
+    return t->kind == MINIMIDI_TRANSFORM_TRANSPOSE || t->kind == MINIMIDI_TRANSFORM_QUANTIZE;
+}
+
+// NOTE ONs in scope closed by a NOTE OFF that closes other ones too, at most how many
+// copies _run makes
+static size_t _n_shared( const MiniMidi_Transform *t, const MiniMidi_Scope *scope, MiniMidi_Event *arr, size_t n )
+{
+    MiniMidi_Event *last_off[MINIMIDI_NOTE_KEYS] = { NULL };
+    size_t n_shared = 0;
+
+    if (!_moves_off( t )) return 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        MiniMidi_Event *e = &(arr[i]);
+        if (e->status_code != MIDI_NOTE_ON || !e->next) continue;
+
+        bool is_shared = e->next->prev != e || last_off[ MINIMIDI_NOTE_KEY( e ) ] == e->next;
+        last_off[ MINIMIDI_NOTE_KEY( e ) ] = e->next;
+
+        if (is_shared && _in_scope( scope, e )) n_shared++;
+    }
+    return n_shared;
+}
+
+// one pass over src ( links valid ), results in dst which may be src itself.
+// every event is written at most once and only ever after it was read, so
+// in place is fine. returns how many events changed, marked in touched if given.
+// NOTE OFFs made for notes that shared one go in extra, n_extra of them
+static size_t _run( const MiniMidi_Transform *t, const MiniMidi_Scope *scope,
+    MiniMidi_Event *src, MiniMidi_Event *dst, size_t n, _Byte *touched, MiniMidi_Event *extra, size_t *n_extra )
+{
+    // per channel and pitch, a NOTE OFF an earlier NOTE ON still needs where it is
+    MiniMidi_Event *kept[MINIMIDI_NOTE_KEYS] = { NULL };
+    size_t n_touched = 0;
+
+    *n_extra = 0;
+
+    if (t->kind == MINIMIDI_TRANSFORM_STRETCH)
+    {
+        for (size_t i = 0; i < n; i++) dst[i].abs_ticks = llround( src[i].abs_ticks * t->factor );
+
+        if (touched) memset( touched, 1, n );
+        return n;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        MiniMidi_Event *e = &(src[i]),
+                       *off = NULL;
+        size_t key = MINIMIDI_NOTE_KEY( e );
+
+        if (e->status_code != MIDI_NOTE_ON) continue;
+
+        if (!_in_scope( scope, e ))
+        {
+            if (e->next) kept[key] = e->next;
+            continue;
+        }
+
+        // overlapping NOTE ONs on a pitch share a NOTE OFF, paired back to the
+        // last one. it goes along with that one unless an earlier one still
+        // needs it, the others take a copy along
+        bool has_off = e->next && e->next->prev == e && kept[key] != e->next;
+        size_t j = has_off ? (size_t)( e->next - src ) : i;
+
+        if (has_off)
+        {
+            off = &(dst[j]);
+        }
+        else if (e->next && _moves_off( t ))
+        {
+            off = &(extra[ *n_extra ]);
+            *off = *(e->next);
+            off->next = NULL;
+            off->prev = NULL;
+        }
+
+        switch (t->kind)
+        {
+            case MINIMIDI_TRANSFORM_TRANSPOSE:
+            {
+                _Byte p = _fold( e->evt_data[0] + t->semitones, t->low_note, t->high_note );
+
+                dst[i].evt_data[0] = p;
+                dst[i].note = _event_data_bytes_to_note( p );
+                if (off)
+                {
+                    off->evt_data[0] = p;
+                    off->note = dst[i].note;
+                }
+                break;
+            }
+            case MINIMIDI_TRANSFORM_VELOCITY:
+                dst[i].evt_data[1] = _velocity( t, e->evt_data[1] );
+                break;
+
+            case MINIMIDI_TRANSFORM_QUANTIZE:
+            {
+                uint64_t on = _quantize( t, e->abs_ticks );
+
+                if (off)
+                {
+                    int64_t off_ticks = t->ends ? (int64_t)_quantize( t, e->next->abs_ticks )
+                        : (int64_t)e->next->abs_ticks + ( (int64_t)on - (int64_t)e->abs_ticks );
+
+                    // a note never ends before it starts
+                    off->abs_ticks = off_ticks < (int64_t)on ? on : (uint64_t)off_ticks;
+                }
+                dst[i].abs_ticks = on;
+                break;
+            }
+            default:
+                break;
+        }
+
+        // a copy the transform left as it was isn't needed, the shared one still ends the note
+        if (off && !has_off)
+        {
+            if (off->evt_data[0] != e->next->evt_data[0] || off->abs_ticks != e->next->abs_ticks)
+                (*n_extra)++;
+            else
+                kept[key] = e->next;
+        }
+
+        if (touched)
+        {
+            touched[i] = 1;
+            touched[j] = 1;
+        }
+        n_touched += has_off ? 2 : 1;
+    }
+
+    return n_touched;
+}
+
+static bool _is_sorted( MiniMidi_Event *arr, size_t n )
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        if (arr[i].abs_ticks < arr[i - 1].abs_ticks) return false;
+    }
+    return true;
+}
+
+// the transformed events go through the history, as one group
+static int _apply_recorded( MiniMidi_Track *track, MiniMidi_History *history,
+    const MiniMidi_Transform *t, const MiniMidi_Scope *scope )
+{
+    size_t n = track->n_events,
+           n_shared = _n_shared( t, scope, track->event_arr, n ),
+           n_extra,
+           k = 0;
+    int err = 0;
+
+    // copies of shared NOTE OFFs go after the track's events
+    MiniMidi_Event *copy = (MiniMidi_Event*)malloc( ( n + n_shared ? n + n_shared : 1 ) * sizeof( MiniMidi_Event ) );
+    _Byte *touched = (_Byte*)calloc( n ? n : 1, 1 );
+
+    if (!copy || !touched)
+    {
+        free( copy );
+        free( touched );
+        return 1;
+    }
+
+    memcpy( copy, track->event_arr, n * sizeof( MiniMidi_Event ) );
+    size_t n_touched = _run( t, scope, track->event_arr, copy, n, touched, copy + n, &n_extra );
+
+    uint32_t *indices = (uint32_t*)malloc( ( n_touched ? n_touched : 1 ) * sizeof( uint32_t ) );
+    if (!indices)
+    {
+        free( copy );
+        free( touched );
+        return 1;
+    }
+
+    // compact the touched events to the front of copy, in track order
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!touched[i]) continue;
+
+        indices[k] = (uint32_t)i;
+        copy[k++] = copy[i];
+    }
+    memmove( copy + k, copy + n, n_extra * sizeof( MiniMidi_Event ) );
+
+    MiniMidi_Selection sel = { .first = 0, .count = k, .indices = indices };
+
+    if (!k)
+    {
+        // nothing in scope
+    }
+    else if (_moves_ticks( t ))
+    {
+        // a replace keeps ticks, anything that moves is a remove + an insert
+        MiniMidi_History_begin_group( history );
+        err = MiniMidi_History_remove( history, &sel ) || MiniMidi_History_insert( history, copy, k + n_extra );
+        MiniMidi_History_end_group( history );
+    }
+    else
+    {
+        MiniMidi_History_begin_group( history );
+        err = MiniMidi_History_replace( history, &sel, copy ) || MiniMidi_History_insert( history, copy + k, n_extra );
+        MiniMidi_History_end_group( history );
+    }
+
+    free( indices );
+    free( copy );
+    free( touched );
+
+    return err;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+int MiniMidi_Transform_parse( MiniMidi_Transform *t, const char *spec )
+{
+    static const struct { const char *name; MiniMidi_Transform_Kind kind; int min_args; } kinds[] = {
+        { "transpose", MINIMIDI_TRANSFORM_TRANSPOSE, 1 },
+        { "quantize",  MINIMIDI_TRANSFORM_QUANTIZE,  1 },
+        { "velocity",  MINIMIDI_TRANSFORM_VELOCITY,  1 },
+        { "stretch",   MINIMIDI_TRANSFORM_STRETCH,   1 },
+    };
+    double args[4] = { 0 };
+    int n_args = 0;
+    const char *cursor = strchr( spec, ':' );
+    size_t name_len = cursor ? (size_t)( cursor - spec ) : strlen( spec );
+    int k;
+
+    for (k = 0; k < 4; k++)
+    {
+        if (strlen( kinds[k].name ) == name_len && strncmp( spec, kinds[k].name, name_len ) == 0) break;
+    }
+    if (k == 4) return 1;
+
+    while (cursor && *cursor == ':' && n_args < 4)
+    {
+        char *end;
+        args[ n_args ] = strtod( cursor + 1, &end );
+        if (end == cursor + 1) return 1;
+
+        n_args++;
+        cursor = end;
+    }
+    if (( cursor && *cursor ) || n_args < kinds[k].min_args) return 1;
+
+    memset( t, 0, sizeof( MiniMidi_Transform ) );
+    t->kind = kinds[k].kind;
+
+    switch (t->kind)
+    {
+        case MINIMIDI_TRANSFORM_TRANSPOSE:
+            t->semitones = (int)args[0];
+            t->low_note = n_args > 1 ? (int)args[1] : 0;
+            t->high_note = n_args > 2 ? (int)args[2] : 127;
+            if (t->low_note < 0 || t->high_note > 127 || t->low_note > t->high_note) return 1;
+            break;
+
+        case MINIMIDI_TRANSFORM_QUANTIZE:
+            t->grid = (uint32_t)args[0];
+            t->strength = n_args > 1 ? args[1] : 1.0;
+            t->swing = n_args > 2 ? args[2] : 0.0;
+            t->ends = n_args > 3 && args[3] != 0;
+            if (!t->grid || t->strength < 0 || t->strength > 1 || t->swing < 0 || t->swing >= 1) return 1;
+            break;
+
+        case MINIMIDI_TRANSFORM_VELOCITY:
+            t->scale = args[0];
+            t->threshold = n_args > 1 ? (int)args[1] : 127;
+            t->ratio = n_args > 2 ? args[2] : 1.0;
+            if (t->scale <= 0 || t->ratio < 1) return 1;
+            break;
+
+        case MINIMIDI_TRANSFORM_STRETCH:
+            t->factor = args[0];
+            if (t->factor <= 0) return 1;
+            break;
+    }
+
+    return 0;
+}
+
+int MiniMidi_Transform_apply( MiniMidi_Track *track, MiniMidi_History *history,
+    const MiniMidi_Transform *t, const MiniMidi_Scope *scope )
+{
+    if (history)
+    {
+        if (history->track != track) return 1;
+        return _apply_recorded( track, history, t, scope );
+    }
+
+    MiniMidi_Event *base = track->event_arr;
+    size_t n_extra;
+
+    // copies of shared NOTE OFFs are appended, the links have to follow if that moves the array
+    if (MiniMidi_Track_reserve( track, track->n_events + _n_shared( t, scope, track->event_arr, track->n_events ) )) return 1;
+    if (track->event_arr != base) MiniMidi_Track_relink( track );
+
+    _run( t, scope, track->event_arr, track->event_arr, track->n_events, NULL, track->event_arr + track->n_events, &n_extra );
+    track->n_events += n_extra;
+
+    // quantize can push events past their neighbours, the copies go where they belong
+    if (!_is_sorted( track->event_arr, track->n_events )
+        && MiniMidi_Event_sort_by_ticks( track->event_arr, track->n_events )) return 1;
+
+    MiniMidi_Track_relink( track );
+    return 0;
+}
+
+int MiniMidi_Transform_tempo_map( MiniMidi_File *file, const MiniMidi_Transform *t )
+{
+    MiniMidi_Track *conductor = file->track;
+
+    if (t->kind != MINIMIDI_TRANSFORM_STRETCH) return 0;
+
+    for (size_t i = 0; i < conductor->n_tempos; i++)
+    {
+        conductor->tempo_arr[i].abs_ticks = llround( conductor->tempo_arr[i].abs_ticks * t->factor );
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-transform.c > tempo map stretched by %.3f", t->factor );
+    MiniMidi_Log_writeline();
+
+    return _build_tempo_map( file );
+}
@@ -0,0 +1,87 @@
+#ifndef MINIMIDI_TRANSFORM_H
+#define MINIMIDI_TRANSFORM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+#include "minimidi-history.h"
+
+// longest chain the CLI takes
+#define MINIMIDI_TRANSFORM_MAX_CHAIN 16
+
+typedef enum {
+    MINIMIDI_TRANSFORM_TRANSPOSE = 0,
+    MINIMIDI_TRANSFORM_QUANTIZE,
+    MINIMIDI_TRANSFORM_VELOCITY,
+    MINIMIDI_TRANSFORM_STRETCH
+} MiniMidi_Transform_Kind;
+
+/***
+*  * Bulk Transforms:
+*
+*   Operate on notes, picked by their NOTE ON: the matching NOTE OFF goes
+*   along with it. Overlapping notes of a pitch closed by one NOTE OFF get a
+*   copy each when it has to move for some of them. A scope limits them to NOTE ONs inside a tick / pitch
+*   window, NULL means the whole track. Stretch ignores the scope and
+*   moves every event, the tempo map is stretched separately with
+*   MiniMidi_Transform_tempo_map.
+*
+*   Without a history the events are rewritten in place in one pass over
+*   the track. With one the result goes through it, so the whole transform
+*   is a single undo step.
+*
+*   CLI specs, numbers separated by ':' and trailing ones optional:
+*       transpose:semitones[:low:high]          notes leaving low..high move back by octaves
+*       quantize:grid[:strength[:swing[:ends]]] grid in ticks, strength 0..1, swing 0..1
+*       velocity:scale[:threshold:ratio]        compress above threshold, then scale
+*       stretch:factor
+*/
+typedef struct MiniMidi_Transform
+{
+    MiniMidi_Transform_Kind kind;
+
+    // TRANSPOSE
+    int         semitones,
+                low_note,
+                high_note;
+
+    // QUANTIZE: odd grid lines are late by swing * grid, ends quantizes NOTE OFFs too
+    uint32_t    grid;
+    float       strength,
+                swing;
+    bool        ends;
+
+    // VELOCITY
+    float       scale,
+                ratio;
+    int         threshold;
+
+    // STRETCH
+    double      factor;
+
+} MiniMidi_Transform;
+
+typedef struct MiniMidi_Scope
+{
+    uint64_t    start_ticks,
+                end_ticks;      // inclusive
+    int         start_note,
+                end_note;
+
+} MiniMidi_Scope;
+
+// fill t from a spec like "quantize:120:0.8". returns 1 if it can't be read
+int MiniMidi_Transform_parse( MiniMidi_Transform *t, const char *spec );
+
+// history may be NULL. returns 0 on success
+int MiniMidi_Transform_apply( MiniMidi_Track *track, MiniMidi_History *history,
+        const MiniMidi_Transform *t, const MiniMidi_Scope *scope );
+
+// stretch the tempo changes of file along with its tracks, other kinds leave it alone.
+// no history reaches the tempo map: this can't be undone, stretching back by 1 / factor
+// comes close, up to rounding
+int MiniMidi_Transform_tempo_map( MiniMidi_File *file, const MiniMidi_Transform *t );
+
+#endif /* MINIMIDI_TRANSFORM_H */
@@ -1,4 +1,8 @@
 #include <ncurses.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include "minimidi-tui.h"
 
@@ -19,6 +23,13 @@ static const int TOP_BAR_HEIGHT = 1;
 static const int TOP_RIGHT_WIDTH = 10;
 static const int BOTT_BAR_HEIGHT = 1;
 
+// automation lane: a header line and the values under it
+static const int LANE_HEIGHT = 8;
+
+// track layers: a row per MIDI note, over this many screens around the view
+static const int LAYER_NOTES = 128;
+static const int LAYER_SCREENS = 3;
+
 // Graphical elements:
 static const chtype note_delim = '_';
 static const chtype bar_delim = '\'';
@@ -30,7 +41,28 @@ enum COLOR_PAIRS {
     RED_ON_BLK = 1,
     GREEN_ON_BLK = 2,
     BLACK_ON_CYAN = 3,
-    BLACK_ON_GREEN = 4
+    BLACK_ON_GREEN = 4,
+    WHITE_ON_RED = 5,
+    TRACK_COLORS = 6    // N_TRACK_COLORS pairs from here, note bodies by track
+};
+
+// region edits
+enum EDITS {
+    EDIT_TRANSPOSE,
+    EDIT_SHIFT,
+    EDIT_DELETE,
+    EDIT_DUPLICATE
+};
+
+// the first one is what single track files always had
+static const short TRACK_PALETTE[] = { COLOR_MAGENTA, COLOR_GREEN, COLOR_YELLOW, COLOR_BLUE, COLOR_RED, COLOR_WHITE };
+#define N_TRACK_COLORS ( (int)( sizeof( TRACK_PALETTE ) / sizeof( TRACK_PALETTE[0] ) ) )
+
+// layer cells
+enum CELLS {
+    CELL_EMPTY = 0,
+    CELL_HEAD,          // a NOTE ON
+    CELL_BODY           // held up to its NOTE OFF
 };
 
  /**
@@ -58,10 +90,10 @@ int _update_sizes( MiniMidi_TUI *self )
     getmaxyx(self->grid_derwin, self->grid_size[1], self->grid_size[0]);
 
     self->logical_size[0] = self->grid_size[0] * self->ticks_per_col;
-    self->logical_size[1] = ( self->grid_size[1] - 2 ) / LINES_PER_SEMITONE;
+    self->logical_size[1] = ( self->grid_size[1] - 2 - self->lane_height ) / LINES_PER_SEMITONE;
 
-    // calc movement increment
-    self->move_increment = self->logical_size[0] / 4;
+    // calc movement increment, whole columns so panning keeps the layers' columns
+    self->move_increment = ( self->grid_size[0] / 4 ) * self->ticks_per_col;
 
     return 0;
 }
@@ -71,22 +103,31 @@ int _update_sizes( MiniMidi_TUI *self )
 */
 int _snap_to_first_events( MiniMidi_TUI *self )
 {
-    // find 1st NOTE_ON evt
-    MiniMidi_Event *e;
-    
-    int ind = 0;
+    // find the earliest NOTE_ON of the shown tracks
+    MiniMidi_Event *e = NULL;
 
-    while (ind < self->file->track->n_events ) {
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(self->file->tracks[t]);
 
-        e = &(self->file->track->event_arr[ind++]);
+        if (self->track_flags && self->track_flags[t] & MINIMIDI_TUI_HIDE) continue;
 
-        // find first NOTE_ON since 1st event
-        // might be something else?
-        if (e->status_code == MIDI_NOTE_ON) {
-            break;
+        for (size_t ind = 0; ind < track->n_events; ind++)
+        {
+            MiniMidi_Event *candidate = &(track->event_arr[ind]);
+
+            if (e && candidate->abs_ticks >= e->abs_ticks) break;
+            if (candidate->status_code == MIDI_NOTE_ON)
+            {
+                e = candidate;
+                break;
+            }
         }
     }
 
+    // nothing to snap to
+    if (!e) return 0;
+
     // set logical start to start of last bar
     int bars_before = e->abs_ticks / (self->file->header->ppqn * self->beats_in_bar );
     self->logical_start[0] = bars_before * self->file->header->ppqn * self->beats_in_bar;
@@ -128,6 +169,12 @@ int _init_ncurses( MiniMidi_TUI *self )
     init_pair( GREEN_ON_BLK,  COLOR_GREEN, COLOR_BLACK );
     init_pair( BLACK_ON_CYAN, COLOR_BLACK, COLOR_CYAN );
     init_pair( BLACK_ON_GREEN, COLOR_BLACK, COLOR_MAGENTA );
+    init_pair( WHITE_ON_RED,  COLOR_WHITE, COLOR_RED );
+
+    for (int k = 0; k < N_TRACK_COLORS; k++)
+    {
+        init_pair( TRACK_COLORS + k, COLOR_BLACK, TRACK_PALETTE[k] );
+    }
 
 
     getmaxyx(stdscr, self->outer_size[1], self->outer_size[0]);
@@ -147,328 +194,2342 @@ int _init_ncurses( MiniMidi_TUI *self )
     return 0;
 }
 
-int _handle_input( MiniMidi_TUI *self )
+// over-limit regions for the current limit
+int _update_voice_regions( MiniMidi_TUI *self )
 {
-    int key = getch();
+    free( self->over );
+    self->over = NULL;
+    self->n_over = 0;
 
-    if (key == ERR)
-    {
-        return 0; // No key pressed
-    }
+    if (!self->polyphony) return 0;
 
-    switch (key)
-    {
-        case KEY_UP:
-            // Handle up arrow key
-            if (self->logical_start[1] < MAX_NOTE_VAL ){
-                self->logical_start[1]++;
-            }
+    self->over = MiniMidi_Voice_Curve_over( &(self->polyphony->total), self->voice_limit, &(self->n_over) );
+    return 0;
+}
 
-            break;
-        case KEY_DOWN:
-            if (self->logical_start[1] > 0){
-                self->logical_start[1]--;
-            }
-            
-            // Handle down arrow key
-            break;
-        case KEY_LEFT:
-            if (self->logical_start[0] > self->move_increment) // dont allow to go bellow zero
-            {
-                self->logical_start[0] -= self->move_increment;
-            } else {
-                self->logical_start[0] = 0;
-            }
-            break;
-        case KEY_RIGHT:
-            self->logical_start[0] += self->move_increment;
-            break;
-        case 'q':
-        case 'Q':
-            self->is_running = false;
-            break;
-        case 'e':
-        case 'E':
-            self->is_dirty = !self->is_dirty;
-            break;
-        case '+':
-            self->ticks_per_col /= 2;
-            break;
-        case '-':
-            self->ticks_per_col *= 2;
-            break;
+// bring a search hit into view, its bar on the left and its first note mid screen
+int _jump_to_match( MiniMidi_TUI *self, size_t index )
+{
+    if (index >= self->n_matches) return 0;
+
+    MiniMidi_Search_Match *m = &(self->matches[ index ]);
+    int bar_ticks = self->file->header->ppqn * self->beats_in_bar;
+
+    self->match_index = index;
+    self->logical_start[0] = ( m->start_ticks / bar_ticks ) * bar_ticks;
+    self->logical_start[1] = m->pitch > self->logical_size[1] / 2 ? m->pitch - self->logical_size[1] / 2 : 0;
 
-        default:
-            break;
-    }
     return 0;
 }
 
-int _render_note_labels( MiniMidi_TUI *self )
+// solo wins over everything but mute
+static bool _is_audible( MiniMidi_TUI *self, size_t t, bool any_solo )
 {
-    int line_index,
-        oct,
-        note_index;
+    uint8_t flags = self->track_flags[t];
+    return !( flags & MINIMIDI_TUI_MUTE ) && ( !any_solo || ( flags & MINIMIDI_TUI_SOLO ) );
+}
 
-    
-    for (int i_note = self->logical_start[1]; i_note < self->logical_start[1] + self->logical_size[1]; i_note ++ )
+static bool _any_solo( MiniMidi_TUI *self )
+{
+    for (size_t t = 0; t < self->file->n_tracks; t++)
     {
-        line_index = _coords__note_2_grid_row( self->logical_start[1], i_note, LINES_PER_SEMITONE, self->grid_size[1] );
-        
-        assert(line_index > 0 && line_index < self->grid_size[1]);
+        if (self->track_flags[t] & MINIMIDI_TUI_SOLO) return true;
+    }
+    return false;
+}
 
-        oct = i_note / 12;
-        note_index = i_note % 12;  
+// tell the player after a mute or solo changed
+int _update_audible( MiniMidi_TUI *self )
+{
+    if (!self->player) return 0;
 
-        int err;
-        if (( err = mvwprintw( self->grid_derwin, line_index, 3, "%s", ALL_NOTES[note_index]) ))
-        {
-            return err;
-        }
-        if (( err = mvwprintw( self->grid_derwin, line_index, 5, "%d", oct )))
-        {
-            return err;
-        }
+    bool any_solo = _any_solo( self );
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Player_silence( self->player, t, !_is_audible( self, t, any_solo ) );
     }
-
     return 0;
 }
 
-int _render_info( MiniMidi_TUI *self)
+// flip a toggle on the selected track, only its own layer has to go
+int _toggle_track( MiniMidi_TUI *self, uint8_t flag )
+{
+    self->track_flags[ self->track_index ] ^= flag;
+    self->layers[ self->track_index ].is_valid = false;
+
+    return flag == MINIMIDI_TUI_HIDE ? 0 : _update_audible( self );
+}
+
+// the onset index, built again when a capture added events. hidden tracks are stepped over
+static MiniMidi_Navigation *_navigation( MiniMidi_TUI *self )
 {
-    if (mvprintw( 0, 0, "file: %s . size: %li bytes . %li events in %li ticks / %li beats.", 
-            self->file->filepath, 
-            self->file->length,
-            self->file->track->n_events,
-            self->file->track->total_ticks,
-            self->file->track->total_beats) > 0 )
+    if (self->lazy)
     {
-        return 1;
+        self->message = "notes: not available for big files";
+        return NULL;
     }
 
-    if (mvprintw(0, self->outer_size[0] - TOP_RIGHT_WIDTH, self->is_dirty ? "-DIRTY-"  : "-CLEAN-"))
+    uint64_t bar_ticks = (uint64_t)self->file->header->ppqn * self->beats_in_bar;
+    size_t n_events = 0;
+
+    for (size_t t = 0; t < self->file->n_tracks; t++)
     {
-        return 1;
+        n_events += __atomic_load_n( &(self->file->tracks[t].n_events), __ATOMIC_ACQUIRE );
     }
 
-    return 0;
+    if (self->navigation && ( self->navigation->n_events != n_events || self->navigation->bar_ticks != bar_ticks ))
+    {
+        MiniMidi_Navigation_free( self->navigation );
+        self->navigation = NULL;
+    }
+    if (!self->navigation && !( self->navigation = MiniMidi_Navigation_init( self->file, bar_ticks ) )) return NULL;
+
+    for (size_t t = 0; t < self->navigation->n_tracks; t++)
+    {
+        self->navigation->is_skipped[t] = self->track_flags[t] & MINIMIDI_TUI_HIDE;
+    }
+    return self->navigation;
 }
 
+// put the cursor on ticks, scrolling only if it isn't in view: its bar goes to the left edge
+// and, for a note ( a MIDI note number, -1 for none ), its pitch mid screen
+int _jump_to( MiniMidi_TUI *self, uint64_t ticks, int pitch )
+{
+    int bar_ticks = self->file->header->ppqn * self->beats_in_bar;
 
+    self->cursor_ticks = ticks;
+    self->has_cursor = true;
+    self->has_cursor_pitch = pitch >= 0;
+    if (pitch >= 0) self->cursor_pitch = pitch;
 
-int _render_grid( MiniMidi_TUI *self ){
+    if (ticks < (uint64_t)self->logical_start[0] || ticks >= (uint64_t)( self->logical_start[0] + self->logical_size[0] ))
+    {
+        self->logical_start[0] = ( ticks / bar_ticks ) * bar_ticks;
+    }
 
-    sprintf( MiniMidi_Log_log_line, "minimidi-tui.c > _render_grid() : Entering" );
-    MiniMidi_Log_writeline();
-    
-    int err;
-    int line_index, aux_line_index, beat_counter, bar_counter, col_in_grid;
-    int ppqn = self->file->header->ppqn;
+    // the roll counts notes from C0, MIDI from C-1
+    int note = pitch >= 12 ? pitch - 12 : 0;
 
-    bool is_new_beat = false;
-    char bar_number_srt[10];
-    int bar_offset = (self->logical_start[0] / ppqn) / self->beats_in_bar;
-    int x_ticks = 0;
+    if (pitch >= 0 && ( note < self->logical_start[1] || note >= self->logical_start[1] + self->logical_size[1] ))
+    {
+        self->logical_start[1] = note > self->logical_size[1] / 2 ? note - self->logical_size[1] / 2 : 0;
+    }
+    return 0;
+}
 
-    for (int i_note = self->logical_start[1]; i_note < self->logical_start[1] + self->logical_size[1]; i_note ++ ){
+static bool _cursor_in_view( MiniMidi_TUI *self )
+{
+    return self->has_cursor
+        && self->cursor_ticks >= (uint64_t)self->logical_start[0]
+        && self->cursor_ticks < (uint64_t)( self->logical_start[0] + self->logical_size[0] );
+}
 
-        line_index = _coords__note_2_grid_row( self->logical_start[1], i_note, LINES_PER_SEMITONE, self->grid_size[1] );
-        
-        assert(line_index > 0 && line_index < self->grid_size[1]);
-        
-        aux_line_index = line_index - 1;        // where bar delimiters are drawed into
-        beat_counter = self->logical_start[0] / ppqn;  // keep track of actual beats, not just cols
-        bar_counter = 0;
-        
-        // cycle through drawable cols
-        for (int j = GRID_LEFT_LABELS_WIDTH; j < self->grid_size[0] - 1 /* box */; j ++ ){
-            
+// next / previous onset, at the cursor's pitch if by_pitch. from the cursor while it is
+// in view, from the edge of the view otherwise
+int _jump_to_onset( MiniMidi_TUI *self, bool forward, bool by_pitch )
+{
+    MiniMidi_Navigation *nav = _navigation( self );
+    if (!nav) return 0;
 
-            // dash under even beats
-            if ( beat_counter % 2 == 0 ){
-                if ( (err = mvwaddch( self->grid_derwin, line_index, j, note_delim )) )
-                    return 1;
-            }
+    if (by_pitch && !self->has_cursor_pitch)
+    {
+        self->message = "pitch: jump to a note with <.> or <,> first";
+        return 0;
+    }
 
-            col_in_grid = j - GRID_LEFT_LABELS_WIDTH + 1;
+    // chords are one onset: forward starts past the cursor's tick
+    uint64_t from;
+    size_t i;
 
-            x_ticks = self->logical_start[0] + col_in_grid * self->ticks_per_col;
+    if (_cursor_in_view( self )) from = self->cursor_ticks + forward;
+    else from = self->logical_start[0] + ( forward ? 0 : self->logical_size[0] );
 
-            // beat is incremented every cols_in_beat
-            // is_new_beat = col_in_grid != 0 && ( (col_in_grid + 1) % self->cols_in_beat ) == 0;
-            is_new_beat = ( x_ticks - beat_counter * ppqn ) >=  ppqn;
+    if (forward) i = by_pitch ? MiniMidi_Navigation_next_pitch( nav, self->cursor_pitch, from ) : MiniMidi_Navigation_next( nav, from );
+    else i = by_pitch ? MiniMidi_Navigation_prev_pitch( nav, self->cursor_pitch, from ) : MiniMidi_Navigation_prev( nav, from );
 
-            
-            if (is_new_beat) {
-                beat_counter++;
+    if (i == nav->n_onsets)
+    {
+        self->message = forward ? "no more notes after this" : "no more notes before this";
+        return 0;
+    }
+    return _jump_to( self, nav->ticks[i], nav->pitches[i] );
+}
 
-                if ( beat_counter % self->beats_in_bar == 0) {
-                
-                    bar_counter++;
+// read a line on the bottom bar, false if it was cancelled with <esc>
+static bool _prompt( MiniMidi_TUI *self, const char *label, char *buf, size_t size )
+{
+    size_t len = 0;
+    int key;
 
+    buf[0] = '\0';
+    timeout( -1 );
+    curs_set( 1 );
 
-                    if ((err = mvwaddch( self->grid_derwin, aux_line_index, j, bar_delim )))
-                        return 1;
-                
-                    // annotate the bar num for the 1st line only
-                    if (i_note == (self->logical_start[1] + self->logical_size[1] - 1) 
-                        && j < self->grid_size[0] - 10 ){
-                        
-                        wattron( self->grid_derwin, COLOR_PAIR(2));
-                        snprintf( bar_number_srt, 10, "BAR%i", bar_offset + bar_counter );
-                        mvwprintw(self->grid_derwin, aux_line_index, j + 2, bar_number_srt);
-                        wattroff( self->grid_derwin, COLOR_PAIR(2));
-                    }
-                }
-            }  
+    for (;;)
+    {
+        move( self->outer_size[1] - 1, 0 );
+        clrtoeol();
+        mvprintw( self->outer_size[1] - 1, 0, "%s%s", label, buf );
+        refresh();
+
+        key = getch();
+        if (key == '\n' || key == '\r' || key == KEY_ENTER) break;
+        if (key == 27 || key == 3 /* ^C, raw */)
+        {
+            len = 0;
+            buf[0] = '\0';
+            break;
+        }
+        if (( key == KEY_BACKSPACE || key == 127 || key == 8 ) && len) buf[ --len ] = '\0';
+        else if (key >= ' ' && key < 127 && len + 1 < size)
+        {
+            buf[ len++ ] = (char)key;
+            buf[ len ] = '\0';
         }
     }
 
-    return 0;
+    curs_set( 0 );
+    return len > 0;
 }
 
-
-int _render_midi( MiniMidi_TUI *self )
+// first event at or after ticks
+static size_t _first_event_at( MiniMidi_Event *arr, size_t n, uint64_t ticks )
 {
-    sprintf( MiniMidi_Log_log_line, "minimidi-tui.c > _render_midi() : Entering" );
-    MiniMidi_Log_writeline();
-
-    MiniMidi_Event_List_Node *cursor;
-    MiniMidi_Event *aux;
-
-    MiniMidi_get_events_in_range(
-        self->file,
-        self->midi_events_list,
-        self->logical_start[0],
-        self->logical_start[0] + self->logical_size[0],
-        self->logical_start[1],
-        self->logical_start[1] + self->logical_size[1]
-    );
+    size_t lo = 0, hi = n;
 
-    cursor = self->midi_events_list->first;
-    int cursor_tick, cursor_note, tgt_col, note_line, cursor_tick_aux, tgt_col_aux;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (arr[mid].abs_ticks < ticks) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
 
+// events with ticks in [ start_ticks, end_ticks ), as indexes [ *lo, *hi )
+static void _events_between( MiniMidi_Event *arr, size_t n, int64_t start_ticks, int64_t end_ticks, size_t *lo, size_t *hi )
+{
+    *lo = _first_event_at( arr, n, start_ticks > 0 ? start_ticks : 0 );
+    *hi = end_ticks > 0 ? _first_event_at( arr, n, end_ticks ) : *lo;
+    if (*hi < *lo) *hi = *lo;
+}
 
-    while (cursor)
+static void _clear_selection( MiniMidi_TUI *self )
+{
+    for (size_t t = 0; self->selection && t < self->file->n_tracks; t++)
     {
-        cursor_tick = cursor->value->abs_ticks;
-        cursor_note = ( cursor->value->note.octave * 12 ) + (int)( cursor->value->note.note );
+        free( self->selection[t].indices );
+        self->selection[t].indices = NULL;
+        self->selection[t].count = 0;
+    }
+    self->n_selected = 0;
+}
 
-        note_line = _coords__note_2_grid_row( self->logical_start[1], cursor_note, LINES_PER_SEMITONE, self->grid_size[1] );
+// the notes of the shown tracks with their NOTE ON in the rectangle, pitches as MIDI note
+// numbers. the NOTE ONs come from a binary search on ticks, their NOTE OFFs from the links
+int _select( MiniMidi_TUI *self, uint64_t start, uint64_t end, int low, int high )
+{
+    _clear_selection( self );
 
+    self->select_start = start;
+    self->select_end = end;
+    self->select_low = low;
+    self->select_high = high;
 
-        tgt_col = GRID_LEFT_LABELS_WIDTH + ( (cursor_tick - self->logical_start[0]) / self->ticks_per_col );
-        
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        if (self->track_flags[t] & MINIMIDI_TUI_HIDE) continue;
+
+        MiniMidi_Track *track = &(self->file->tracks[t]);
+        MiniMidi_Event *arr = track->event_arr;
+        size_t lo, hi, last = 0, n_on = 0, k = 0;
 
-        // draw this fucker
-        if ( cursor->value->status_code == MIDI_NOTE_ON )
+        _events_between( arr, track->n_events, start, end + 1, &lo, &hi );
+        for (size_t i = lo; i < hi; i++)
         {
-            // paint leading edge of event
-            wattron( self->grid_derwin,  COLOR_PAIR (BLACK_ON_CYAN ));
-            mvwaddch( self->grid_derwin, note_line, tgt_col, ' ' );
-            wattroff( self->grid_derwin,  COLOR_PAIR (BLACK_ON_CYAN ));
+            int pitch = arr[i].evt_data[0] & 0x7F;
+            if (arr[i].status_code != MIDI_NOTE_ON || pitch < low || pitch > high) continue;
 
-            // paint remaining until corresponding note_off
-            aux = (cursor->value)->next;
-            cursor_tick_aux = aux->abs_ticks;
-            
-            if ( cursor_tick_aux < self->logical_start[0] + self->logical_size[0]){
-                tgt_col_aux = GRID_LEFT_LABELS_WIDTH + (( cursor_tick_aux - self->logical_start[0]) / self->ticks_per_col );
-            } else {
-                tgt_col_aux = self->grid_size[0];
-            }
+            size_t off = arr[i].next ? (size_t)( arr[i].next - arr ) : i;
 
-            wattron( self->grid_derwin, COLOR_PAIR(BLACK_ON_GREEN));
-                
-            for (int b = tgt_col + 1; b < tgt_col_aux; b++) {
-                mvwaddch( self->grid_derwin, note_line, b, ' ' );
-            }
-            wattroff( self->grid_derwin, COLOR_PAIR(BLACK_ON_GREEN ));
+            n_on++;
+            if (off > last) last = off;
+        }
+        if (!n_on) continue;
 
-        } else if ( cursor->value->status_code == MIDI_NOTE_OFF )
+        // mark the NOTE ONs and their NOTE OFFs, overlapping notes of a pitch can share one.
+        // reading the marks back gives them sorted
+        _Byte *marks = (_Byte*)calloc( last - lo + 1, 1 );
+        uint32_t *indices = (uint32_t*)malloc( 2 * n_on * sizeof( uint32_t ) );
+        if (!marks || !indices)
         {
-            // handle cases of no NOTE_ON in screen
-            aux = (cursor->value)->prev;
-            assert( aux != NULL );
+            free( marks );
+            free( indices );
+            _clear_selection( self );
+            return 1;
+        }
 
-            if (aux->abs_ticks < self->logical_start[0]){
-                
-                // paint from beat_col + 1 until beat_col_aux
-                wattron( self->grid_derwin, COLOR_PAIR(BLACK_ON_GREEN));
-                
-                for (int b = GRID_LEFT_LABELS_WIDTH + 1; b <= tgt_col; b++) {
-                    mvwaddch( self->grid_derwin, note_line, b, ' ' );
-                }
-                
-                wattroff( self->grid_derwin, COLOR_PAIR(BLACK_ON_GREEN ));
-            }
+        for (size_t i = lo; i < hi; i++)
+        {
+            int pitch = arr[i].evt_data[0] & 0x7F;
+            if (arr[i].status_code != MIDI_NOTE_ON || pitch < low || pitch > high) continue;
+
+            marks[ i - lo ] = 1;
+            if (arr[i].next) marks[ arr[i].next - arr - lo ] = 1;
+        }
+        for (size_t i = lo; i <= last; i++)
+        {
+            if (marks[ i - lo ]) indices[k++] = (uint32_t)i;
         }
+        free( marks );
 
-        cursor = cursor->next;
+        self->selection[t] = (MiniMidi_Selection){ .first = 0, .count = k, .indices = indices };
+        self->n_selected += n_on;
     }
 
+    if (!self->n_selected) self->message = "select: no notes in there";
     return 0;
 }
 
-/**
- * PUBLIC
- */
-int MiniMidi_TUI_init( MiniMidi_TUI *self, MiniMidi_File *file )
+// first <r> drops the anchor, the second selects from it to the cursor. a corner that
+// isn't on a note takes every pitch
+int _mark_corner( MiniMidi_TUI *self )
 {
-    self->is_dirty = false;
-    self->is_running = true;
-    //
-    self->logical_size[0] = 0;
-    self->logical_size[1] = 0;
-    //
-    self->logical_start[0] = 0;
-    self->logical_start[1] = 0;
-    //
-    self->grid_size[0] = 0;
-    self->grid_size[1] = 0;
-    //
-    self->outer_size[0] = 0;
-    self->outer_size[1] = 0;
-    
-    // ZOOM ETERNAL
-    // self->cols_in_beat = 4;
-    self->ticks_per_col = file->header->ppqn / 4; // start at 4 cols -> 1 beat
+    if (self->n_selected || !self->has_cursor)
+    {
+        _clear_selection( self );
+        self->has_anchor = false;
+        if (!self->has_cursor)
+        {
+            self->message = "select: jump somewhere with <.> <,> or <g> first, <R> takes the view";
+            return 0;
+        }
+    }
 
-    // TIME SIG
-    self->beats_in_bar = 4;
+    int pitch = self->has_cursor_pitch ? self->cursor_pitch : -1;
 
-    //
-    self->file = file;
-    self->midi_events_list = MiniMidi_Event_LList_init();
-  
-    if ( _init_ncurses(self) ) return 1;
+    if (!self->has_anchor)
+    {
+        self->anchor_ticks = self->cursor_ticks;
+        self->anchor_pitch = pitch;
+        self->has_anchor = true;
+        self->message = "select: move to the other corner, <r> again";
+        return 0;
+    }
 
-    return 0;
-}
+    bool any_pitch = pitch < 0 || self->anchor_pitch < 0;
 
+    self->has_anchor = false;
+    return _select( self,
+        self->anchor_ticks < self->cursor_ticks ? self->anchor_ticks : self->cursor_ticks,
+        self->anchor_ticks < self->cursor_ticks ? self->cursor_ticks : self->anchor_ticks,
+        any_pitch ? 0 : ( self->anchor_pitch < pitch ? self->anchor_pitch : pitch ),
+        any_pitch ? 127 : ( self->anchor_pitch < pitch ? pitch : self->anchor_pitch ) );
+}
 
-int MiniMidi_TUI_update( MiniMidi_TUI *self )
+// the roll counts notes from C0, MIDI from C-1
+int _select_view( MiniMidi_TUI *self )
 {
-    // just handle_input here?
-    _handle_input(self);
-    return 0;
-}
+    int low = self->logical_start[1] + 12,
+        high = low + self->logical_size[1] - 1;
 
+    self->has_anchor = false;
+    return _select( self, self->logical_start[0], self->logical_start[0] + self->logical_size[0] - 1,
+        low, high < 127 ? high : 127 );
+}
 
-int MiniMidi_TUI_render( MiniMidi_TUI *self )
+static MiniMidi_History *_history( MiniMidi_TUI *self, size_t t )
+{
+    if (!self->histories[t]) self->histories[t] = MiniMidi_History_init( &(self->file->tracks[t]), 0 );
+    return self->histories[t];
+}
+
+static int _log_track( MiniMidi_TUI *self, uint32_t entry )
+{
+    if (self->n_logged == self->log_capacity)
+    {
+        size_t new_cap = self->log_capacity ? self->log_capacity * 2 : 64;
+        uint32_t *log = (uint32_t*)realloc( self->edit_log, new_cap * sizeof( uint32_t ) );
+        if (!log) return 1;
+
+        self->edit_log = log;
+        self->log_capacity = new_cap;
+    }
+    self->edit_log[ self->n_logged++ ] = entry;
+    return 0;
+}
+
+// whatever was indexed from the notes is stale now, the edited tracks' layers too
+static void _notes_edited( MiniMidi_TUI *self )
+{
+    MiniMidi_Navigation_free( self->navigation );
+    self->navigation = NULL;
+
+    if (self->polyphony)
+    {
+        MiniMidi_Polyphony_free( self->polyphony );
+        self->polyphony = self->show_polyphony ? MiniMidi_Polyphony_init( self->file ) : NULL;
+        _update_voice_regions( self );
+    }
+}
+
+// nothing may read the tracks while they change under it
+static bool _can_edit( MiniMidi_TUI *self )
+{
+    if (self->lazy)
+    {
+        self->message = "edit: not available for big files";
+        return false;
+    }
+    if (self->is_live)
+    {
+        self->message = "edit: not available while capturing";
+        return false;
+    }
+    if (self->player && MiniMidi_Player_is_playing( self->player )) MiniMidi_Player_stop( self->player );
+
+    // a file with edits isn't let go of when the workspace runs over its budget
+    if (self->workspace) MiniMidi_Workspace_edited( self->workspace );
+
+    return true;
+}
+
+static bool _is_selected( MiniMidi_Selection *sel, size_t i )
+{
+    size_t lo = 0, hi = sel->count;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (sel->indices[mid] < i) lo = mid + 1; else hi = mid;
+    }
+    return lo < sel->count && sel->indices[lo] == i;
+}
+
+// a NOTE OFF closing selected and unselected notes alike, e.g. overlapping notes of a pitch,
+// gets a copy for the selected ones, which takes its place in the selection. what the edit
+// does to the copy then strands no note outside it
+static int _split_shared_offs( MiniMidi_History *history, MiniMidi_Selection *sel )
+{
+    MiniMidi_Track *track = history->track;
+    MiniMidi_Event *arr = track->event_arr,
+                   *copies = NULL;
+    uint32_t *kept = NULL;
+    size_t n_shared = 0,
+           n_kept = 0;
+    int err = 1;
+
+    copies = (MiniMidi_Event*)malloc( ( sel->count ? sel->count : 1 ) * sizeof( MiniMidi_Event ) );
+    kept = (uint32_t*)malloc( ( sel->count ? sel->count : 1 ) * sizeof( uint32_t ) );
+    if (!copies || !kept) goto done;
+
+    for (size_t k = 0; k < sel->count; k++)
+    {
+        size_t i = sel->indices[k];
+        bool is_shared = false;
+
+        // every NOTE ON since the last NOTE OFF of its channel and pitch closes here
+        for (size_t j = i; arr[i].status_code == MIDI_NOTE_OFF && j-- > 0; )
+        {
+            if (arr[j].status_code != MIDI_NOTE_ON && arr[j].status_code != MIDI_NOTE_OFF) continue;
+            if (MINIMIDI_NOTE_KEY( &(arr[j]) ) != MINIMIDI_NOTE_KEY( &(arr[i]) )) continue;
+            if (arr[j].status_code == MIDI_NOTE_OFF) break;
+
+            if (arr[j].next == &(arr[i]) && !_is_selected( sel, j ))
+            {
+                is_shared = true;
+                break;
+            }
+        }
+
+        if (is_shared)
+        {
+            copies[ n_shared ] = arr[i];
+            copies[ n_shared ].next = NULL;
+            copies[ n_shared++ ].prev = NULL;
+        } else {
+            kept[ n_kept++ ] = (uint32_t)i;
+        }
+    }
+
+    err = 0;
+    if (!n_shared || ( err = MiniMidi_History_insert( history, copies, n_shared ) )) goto done;
+
+    // the copies went in after their originals, the rest of the selection moved up past them
+    uint32_t *landed = history->edits[ history->n_applied - 1 ].sel.indices;
+    size_t a, b = 0, k = 0;
+
+    for (a = 0; a < n_kept; a++)
+    {
+        while (b < n_shared && landed[b] <= kept[a] + b) b++;
+        kept[a] += (uint32_t)b;
+    }
+    for (a = 0, b = 0; a < n_kept || b < n_shared; )
+    {
+        if (b == n_shared || ( a < n_kept && kept[a] < landed[b] ))
+            sel->indices[ k++ ] = kept[ a++ ];
+        else
+            sel->indices[ k++ ] = landed[ b++ ];
+    }
+
+done:
+    free( copies );
+    free( kept );
+    return err;
+}
+
+// one edit on a track's selection, a single merge and relink in the history.
+// shifts and duplicates leave the selection on the notes they put down
+static int _edit_track( MiniMidi_TUI *self, size_t t, int kind, int64_t amount )
+{
+    MiniMidi_History *history = _history( self, t );
+    MiniMidi_Selection *sel = &(self->selection[t]);
+    MiniMidi_Track *track = &(self->file->tracks[t]);
+    MiniMidi_Event *moved = NULL;
+    int err = 0;
+
+    if (!history) return 1;
+
+    // a group of its own, so quick repeats aren't merged behind the edit log's back
+    MiniMidi_History_begin_group( history );
+
+    if (kind != EDIT_DUPLICATE) err = _split_shared_offs( history, sel );
+    if (!err && ( kind == EDIT_SHIFT || kind == EDIT_DUPLICATE ))
+    {
+        moved = (MiniMidi_Event*)malloc( sel->count * sizeof( MiniMidi_Event ) );
+        if (!moved) err = 1;
+    }
+    if (moved)
+    {
+        for (size_t k = 0; k < sel->count; k++)
+        {
+            moved[k] = track->event_arr[ sel->indices[k] ];
+            moved[k].abs_ticks += amount;
+        }
+    }
+
+    switch (err ? -1 : kind)
+    {
+        case EDIT_TRANSPOSE:
+            err = MiniMidi_History_transpose( history, sel, (int)amount );
+            break;
+        case EDIT_SHIFT:
+            err = MiniMidi_History_move( history, sel, moved );
+            break;
+        case EDIT_DELETE:
+            err = MiniMidi_History_remove( history, sel );
+            break;
+        case EDIT_DUPLICATE:
+            // the insert's selection is where the copies landed
+            err = MiniMidi_History_insert( history, moved, sel->count );
+            if (!err) memcpy( sel->indices, history->edits[ history->n_applied - 1 ].sel.indices, sel->count * sizeof( uint32_t ) );
+            break;
+    }
+    MiniMidi_History_end_group( history );
+
+    free( moved );
+    self->layers[t].is_valid = false;
+
+    return err || _log_track( self, (uint32_t)t );
+}
+
+// apply an edit to every track with selected notes, as one step of the edit log
+int _edit_selection( MiniMidi_TUI *self, int kind, int64_t amount )
+{
+    if (!self->n_selected)
+    {
+        self->message = "edit: nothing selected, mark a region with <r> or take the view with <R>";
+        return 0;
+    }
+    if (!_can_edit( self )) return 0;
+
+    // nothing goes before the start of the file
+    if (kind == EDIT_SHIFT && amount < 0 && (uint64_t)( -amount ) > self->select_start)
+    {
+        for (size_t t = 0; t < self->file->n_tracks; t++)
+        {
+            if (!self->selection[t].count) continue;
+
+            uint64_t first = self->file->tracks[t].event_arr[ self->selection[t].indices[0] ].abs_ticks;
+            if ((uint64_t)( -amount ) > first) amount = -(int64_t)first;
+        }
+        if (!amount) return 0;
+    }
+
+    // the redo tail goes
+    self->n_logged = self->n_log_applied;
+
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        if (!self->selection[t].count) continue;
+
+        if (_edit_track( self, t, kind, amount ))
+        {
+            self->message = "edit: out of memory";
+            break;
+        }
+    }
+
+    if (_log_track( self, UINT32_MAX )) return 1;
+    self->n_log_applied = self->n_logged;
+    self->is_dirty = true;
+    _notes_edited( self );
+
+    switch (kind)
+    {
+        case EDIT_TRANSPOSE:
+            self->select_low = self->select_low + amount < 0 ? 0 : self->select_low + amount > 127 ? 127 : self->select_low + amount;
+            self->select_high = self->select_high + amount < 0 ? 0 : self->select_high + amount > 127 ? 127 : self->select_high + amount;
+            break;
+        case EDIT_SHIFT:
+        case EDIT_DUPLICATE:
+            self->select_start += amount;
+            self->select_end += amount;
+            break;
+        case EDIT_DELETE:
+            _clear_selection( self );
+            break;
+    }
+    return 0;
+}
+
+// copies go right after the region, a whole number of bars later
+int _duplicate_selection( MiniMidi_TUI *self )
+{
+    uint64_t bar_ticks = (uint64_t)self->file->header->ppqn * self->beats_in_bar,
+             width = self->select_end + 1 - self->select_start;
+
+    return _edit_selection( self, EDIT_DUPLICATE, ( ( width + bar_ticks - 1 ) / bar_ticks ) * bar_ticks );
+}
+
+// take back or replay the last step of the edit log, on every track it touched
+int _undo( MiniMidi_TUI *self, bool redo )
+{
+    size_t first, last;
+
+    if (redo ? self->n_log_applied == self->n_logged : !self->n_log_applied)
+    {
+        self->message = redo ? "redo: nothing to redo" : "undo: nothing to undo";
+        return 0;
+    }
+    if (!_can_edit( self )) return 0;
+
+    if (redo)
+    {
+        first = last = self->n_log_applied;
+        while (self->edit_log[ last ] != UINT32_MAX) last++;
+    } else {
+        first = last = self->n_log_applied - 1;
+        while (first > 0 && self->edit_log[ first - 1 ] != UINT32_MAX) first--;
+    }
+
+    // a history over its budget forgets its oldest edits
+    for (size_t i = first; i < last; i++)
+    {
+        MiniMidi_History *history = self->histories[ self->edit_log[i] ];
+
+        if (redo ? !MiniMidi_History_can_redo( history ) : !MiniMidi_History_can_undo( history ))
+        {
+            self->message = redo ? "redo: nothing to redo" : "undo: too old to undo";
+            return 0;
+        }
+    }
+
+    for (size_t i = first; i < last; i++)
+    {
+        size_t t = self->edit_log[i];
+
+        if (redo ? !MiniMidi_History_redo( self->histories[t] ) : !MiniMidi_History_undo( self->histories[t] ))
+        {
+            self->layers[t].is_valid = false;
+            continue;
+        }
+
+        // out of memory: the tracks done so far go back, they had room for it before
+        while (i-- > first)
+        {
+            t = self->edit_log[i];
+            if (redo) MiniMidi_History_undo( self->histories[t] );
+            else MiniMidi_History_redo( self->histories[t] );
+        }
+        self->message = redo ? "redo: out of memory" : "undo: out of memory";
+        _notes_edited( self );
+        return 0;
+    }
+    self->n_log_applied = redo ? last + 1 : first;
+
+    // the indices moved under it
+    _clear_selection( self );
+    _notes_edited( self );
+    self->is_dirty = true;
+
+    return 0;
+}
+
+// selection and undo, of the n_tracks the file had
+static void _drop_edits( MiniMidi_TUI *self, size_t n_tracks )
+{
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        free( self->selection[t].indices );
+        self->selection[t] = (MiniMidi_Selection){ 0 };
+
+        MiniMidi_History_free( self->histories[t] );
+        self->histories[t] = NULL;
+    }
+    self->n_selected = 0;
+    self->has_anchor = false;
+    self->n_logged = 0;
+    self->n_log_applied = 0;
+}
+
+// per track state for a file that now has n_old tracks less or more
+static int _resize_tracks( MiniMidi_TUI *self, size_t n_old )
+{
+    size_t n = self->file->n_tracks;
+
+    for (size_t t = 0; t < n_old; t++)
+    {
+        free( self->layers[t].cells );
+        free( self->layers[t].left.arr );
+        free( self->layers[t].right.arr );
+    }
+    free( self->layers );
+    free( self->selection );
+    free( self->histories );
+
+    uint8_t *flags = (uint8_t*)realloc( self->track_flags, n ? n : 1 );
+    if (flags) self->track_flags = flags;
+
+    self->layers = (MiniMidi_TUI_Layer*)calloc( n ? n : 1, sizeof( MiniMidi_TUI_Layer ) );
+    self->selection = (MiniMidi_Selection*)calloc( n ? n : 1, sizeof( MiniMidi_Selection ) );
+    self->histories = (MiniMidi_History**)calloc( n ? n : 1, sizeof( MiniMidi_History* ) );
+
+    if (!flags || !self->layers || !self->selection || !self->histories) return 1;
+
+    // the tracks past the old ones start shown
+    for (size_t t = n_old; t < n; t++) self->track_flags[t] = 0;
+    if (self->track_index >= n) self->track_index = n ? n - 1 : 0;
+    if (self->stacked_first >= n) self->stacked_first = 0;
+
+    return 0;
+}
+
+// the file changed on disk: swap in the tracks that did, the view stays where it is.
+// undo doesn't reach across a reload, the indices it kept may be gone. not while edited
+int _reload_now( MiniMidi_TUI *self )
+{
+    size_t n_old = self->file->n_tracks;
+
+    // same as the workspace does, a change on disk doesn't throw edits away
+    if (self->is_dirty)
+    {
+        self->message = "reload: the file changed on disk, keeping your unsaved edits";
+        return 0;
+    }
+
+    if (self->player && MiniMidi_Player_is_playing( self->player )) MiniMidi_Player_stop( self->player );
+
+    if (MiniMidi_Watch_reload( self->watch ))
+    {
+        self->message = "reload: can't read the file yet, waiting for the next save";
+        return 0;
+    }
+
+    size_t n = self->file->n_tracks;
+    _drop_edits( self, n_old );
+
+    if (n != n_old)
+    {
+        if (_resize_tracks( self, n_old ))
+        {
+            self->is_running = false;
+            return 1;
+        }
+    }
+    else
+    {
+        for (size_t t = 0; t < n; t++)
+        {
+            if (self->watch->changed[t]) self->layers[t].is_valid = false;
+        }
+    }
+
+    _notes_edited( self );
+    _update_audible( self );
+
+    if (self->automation)
+    {
+        MiniMidi_Automation_free( self->automation );
+        self->automation = self->lane_height ? MiniMidi_Automation_init( self->file ) : NULL;
+        self->lane_index = 0;
+    }
+
+    snprintf( self->message_line, sizeof( self->message_line ), "reloaded: %zu of %zu tracks read again",
+        self->watch->n_decoded, n );
+    self->message = self->message_line;
+
+    if (self->workspace) MiniMidi_Workspace_stamp( self->workspace );
+
+    return 0;
+}
+
+int _reload( MiniMidi_TUI *self )
+{
+    if (!self->watch || !MiniMidi_Watch_poll( self->watch )) return 0;
+
+    return _reload_now( self );
+}
+
+// true once there is a key or a resize for getch, false when the watch has something
+static bool _wait_key( MiniMidi_TUI *self )
+{
+    struct pollfd fds[2] = { { .fd = STDIN_FILENO, .events = POLLIN }, { .fd = self->watch->fd, .events = POLLIN } };
+
+    // what ncurses read ahead is no longer on stdin
+    timeout( 0 );
+    int key = getch();
+    timeout( -1 );
+    if (key != ERR)
+    {
+        ungetch( key );
+        return true;
+    }
+
+    // a resize interrupts the poll, getch has it then
+    if (poll( fds, 2, -1 ) < 0) return true;
+
+    return fds[0].revents || !fds[1].revents;
+}
+
+// go to the file of tab index. what was worked out from the file being left goes with it,
+// undo too, and the view comes back to where it was on that tab
+int _switch_tab( MiniMidi_TUI *self, size_t index )
+{
+    MiniMidi_Workspace *ws = self->workspace;
+    MiniMidi_TUI_Tab *tab = &(self->tabs[ ws->current ]);
+    size_t n_old = self->file->n_tracks;
+    struct timespec t0, t1;
+
+    if (index == ws->current) return 0;
+
+    // the file left may be packed away by the switch, nothing may be reading it
+    if (self->player) MiniMidi_Player_stop( self->player );
+
+    uint8_t *flags = (uint8_t*)realloc( tab->track_flags, n_old ? n_old : 1 );
+    if (flags)
+    {
+        memcpy( flags, self->track_flags, n_old );
+        tab->track_flags = flags;
+        tab->n_tracks = n_old;
+    }
+    tab->logical_start[0] = self->logical_start[0];
+    tab->logical_start[1] = self->logical_start[1];
+    tab->ticks_per_col = self->ticks_per_col;
+    tab->track_index = self->track_index;
+    tab->is_stacked = self->is_stacked;
+    tab->is_seen = true;
+
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+    MiniMidi_File *file = MiniMidi_Workspace_open( ws, index );
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+    if (!file)
+    {
+        snprintf( self->message_line, sizeof( self->message_line ), "can't read %s: %s",
+            ws->entries[index].path, MiniMidi_Parse_Status_str( ws->error.status ) );
+        self->message = self->message_line;
+        return 0;
+    }
+
+    _drop_edits( self, n_old );
+    self->file = file;
+    if (_resize_tracks( self, n_old ))
+    {
+        self->is_running = false;
+        return 1;
+    }
+
+    tab = &(self->tabs[index]);
+    if (tab->is_seen && tab->n_tracks == file->n_tracks) memcpy( self->track_flags, tab->track_flags, file->n_tracks );
+    else memset( self->track_flags, 0, file->n_tracks ? file->n_tracks : 1 );
+
+    if (self->player) MiniMidi_Player_set_file( self->player, file );
+    _update_audible( self );
+
+    if (self->watch)
+    {
+        MiniMidi_Watch_free( self->watch );
+        self->watch = MiniMidi_Watch_init( file, ws->has_filter ? &(ws->filter) : NULL );
+    }
+
+    MiniMidi_Automation_free( self->automation );
+    self->automation = self->lane_height ? MiniMidi_Automation_init( file ) : NULL;
+    self->lane_index = 0;
+    _notes_edited( self );
+
+    self->has_cursor = false;
+    self->has_cursor_pitch = false;
+    self->is_dirty = ws->entries[index].is_edited;
+
+    if (tab->is_seen)
+    {
+        self->logical_start[0] = tab->logical_start[0];
+        self->logical_start[1] = tab->logical_start[1];
+        self->ticks_per_col = tab->ticks_per_col;
+        self->track_index = tab->track_index < file->n_tracks ? tab->track_index : 0;
+        self->is_stacked = tab->is_stacked;
+        _update_sizes( self );
+    }
+    else
+    {
+        self->ticks_per_col = file->header->ppqn / 4 ? file->header->ppqn / 4 : 1;
+        self->track_index = 0;
+        self->is_stacked = false;
+        _update_sizes( self );
+        _snap_to_first_events( self );
+    }
+    self->stacked_first = 0;
+
+    if (ws->is_kept_stale)
+        snprintf( self->message_line, sizeof( self->message_line ), "file %zu of %zu changed on disk, showing your unsaved edits",
+            index + 1, ws->n_entries );
+    else
+        snprintf( self->message_line, sizeof( self->message_line ), "file %zu of %zu, opened in %.1f ms",
+            index + 1, ws->n_entries, ( t1.tv_sec - t0.tv_sec ) * 1e3 + ( t1.tv_nsec - t0.tv_nsec ) / 1e6 );
+    self->message = self->message_line;
+
+    return 0;
+}
+
+// the next tab in direction that opens, files that can't be read are stepped over
+int _step_tab( MiniMidi_TUI *self, int direction )
+{
+    if (!self->workspace) return 0;
+
+    size_t n = self->workspace->n_entries,
+           from = self->workspace->current;
+
+    for (size_t k = 1; k < n && self->workspace->current == from; k++)
+    {
+        if (_switch_tab( self, ( from + ( direction > 0 ? k : n - k ) ) % n )) return 1;
+    }
+    return 0;
+}
+
+int _handle_input( MiniMidi_TUI *self )
+{
+    int key = getch();
+
+    if (key == ERR)
+    {
+        return 0; // No key pressed
+    }
+
+    switch (key)
+    {
+        case KEY_UP:
+            // Handle up arrow key
+            if (self->logical_start[1] < MAX_NOTE_VAL ){
+                self->logical_start[1]++;
+            }
+
+            break;
+        case KEY_DOWN:
+            if (self->logical_start[1] > 0){
+                self->logical_start[1]--;
+            }
+            
+            // Handle down arrow key
+            break;
+        case KEY_LEFT:
+            if (self->logical_start[0] > self->move_increment) // dont allow to go bellow zero
+            {
+                self->logical_start[0] -= self->move_increment;
+            } else {
+                self->logical_start[0] = 0;
+            }
+            self->pan_direction = -1;
+            break;
+        case KEY_RIGHT:
+            self->logical_start[0] += self->move_increment;
+            self->pan_direction = 1;
+            break;
+        case 'q':
+        case 'Q':
+            self->is_running = false;
+            break;
+        case 'e':
+        case 'E':
+            self->is_dirty = !self->is_dirty;
+            break;
+        case 'f':
+        case 'F':
+            self->is_following = !self->is_following;
+            break;
+        case ' ':
+            if (!self->player) break;
+
+            if (MiniMidi_Player_is_playing( self->player ))
+            {
+                MiniMidi_Player_stop( self->player );
+            } else {
+                self->playhead = self->logical_start[0];
+                MiniMidi_Player_start( self->player, self->playhead );
+            }
+            break;
+        case 'a':
+            if (!self->lane_height && !self->automation && !self->lazy)
+            {
+                self->automation = MiniMidi_Automation_init( self->file );
+            }
+            self->lane_height = self->lane_height ? 0 : LANE_HEIGHT;
+            break;
+        case 'A':
+            if (self->automation && self->automation->n_lanes)
+            {
+                self->lane_index = ( self->lane_index + 1 ) % self->automation->n_lanes;
+            }
+            break;
+        case 'v':
+        case 'V':
+            if (!self->show_polyphony && !self->polyphony && !self->lazy)
+            {
+                self->polyphony = MiniMidi_Polyphony_init( self->file );
+                _update_voice_regions( self );
+            }
+            self->show_polyphony = !self->show_polyphony;
+            break;
+        case '<':
+            if (self->voice_limit > 1)
+            {
+                self->voice_limit--;
+                _update_voice_regions( self );
+            }
+            break;
+        case '>':
+            self->voice_limit++;
+            _update_voice_regions( self );
+            break;
+        case 'n':
+            if (self->n_matches) _jump_to_match( self, ( self->match_index + 1 ) % self->n_matches );
+            break;
+        case 'N':
+            if (self->n_matches) _jump_to_match( self, ( self->match_index + self->n_matches - 1 ) % self->n_matches );
+            break;
+        case ']':
+            if (self->track_index + 1 < self->file->n_tracks) self->track_index++;
+            break;
+        case '[':
+            if (self->track_index > 0) self->track_index--;
+            break;
+        case 'm':
+            _toggle_track( self, MINIMIDI_TUI_MUTE );
+            break;
+        case 's':
+            _toggle_track( self, MINIMIDI_TUI_SOLO );
+            break;
+        case 'h':
+            _toggle_track( self, MINIMIDI_TUI_HIDE );
+            break;
+        case 'H':
+            for (size_t t = 0; t < self->file->n_tracks; t++) self->track_flags[t] &= ~MINIMIDI_TUI_HIDE;
+            break;
+        case 't':
+        case 'T':
+            self->is_stacked = !self->is_stacked;
+            break;
+        case '.':
+            _jump_to_onset( self, true, false );
+            break;
+        case ',':
+            _jump_to_onset( self, false, false );
+            break;
+        case 'p':
+            _jump_to_onset( self, true, true );
+            break;
+        case 'P':
+            _jump_to_onset( self, false, true );
+            break;
+        case 'g':
+        case 'G':
+        {
+            char spec[32];
+            uint64_t ticks;
+
+            if (!_prompt( self, "go to (bar, m:ss, 90s, 4800t): ", spec, sizeof( spec ) )) break;
+
+            if (MiniMidi_Navigation_parse_goto( self->file, spec, (uint64_t)self->file->header->ppqn * self->beats_in_bar, &ticks ))
+            {
+                self->message = "go to: can't read that";
+                break;
+            }
+            _jump_to( self, ticks, -1 );
+            break;
+        }
+        case 'd':
+        case 'D':
+        {
+            MiniMidi_Navigation *nav = _navigation( self );
+            if (!nav) break;
+
+            if (!nav->densest_count)
+            {
+                self->message = "no notes";
+                break;
+            }
+            _jump_to( self, nav->densest_bar * nav->bar_ticks, -1 );
+            break;
+        }
+        case 'r':
+            _mark_corner( self );
+            break;
+        case 'R':
+            _select_view( self );
+            break;
+        case 'k':
+            _edit_selection( self, EDIT_TRANSPOSE, 1 );
+            break;
+        case 'j':
+            _edit_selection( self, EDIT_TRANSPOSE, -1 );
+            break;
+        case 'K':
+            _edit_selection( self, EDIT_TRANSPOSE, 12 );
+            break;
+        case 'J':
+            _edit_selection( self, EDIT_TRANSPOSE, -12 );
+            break;
+        case '{':
+            _edit_selection( self, EDIT_SHIFT, -self->ticks_per_col );
+            break;
+        case '}':
+            _edit_selection( self, EDIT_SHIFT, self->ticks_per_col );
+            break;
+        case 'x':
+        case 'X':
+            _edit_selection( self, EDIT_DELETE, 0 );
+            break;
+        case 'y':
+        case 'Y':
+            _duplicate_selection( self );
+            break;
+        case 'u':
+            _undo( self, false );
+            break;
+        case 'U':
+            _undo( self, true );
+            break;
+        case '\t':
+            _step_tab( self, 1 );
+            break;
+        case KEY_BTAB:
+            _step_tab( self, -1 );
+            break;
+        case '+':
+            if (self->ticks_per_col > 1) self->ticks_per_col /= 2;
+            break;
+        case '-':
+            self->ticks_per_col *= 2;
+            break;
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+int _render_note_labels( MiniMidi_TUI *self )
+{
+    int line_index,
+        oct,
+        note_index;
+
+    
+    for (int i_note = self->logical_start[1]; i_note < self->logical_start[1] + self->logical_size[1]; i_note ++ )
+    {
+        line_index = _coords__note_2_grid_row( self->logical_start[1], i_note, LINES_PER_SEMITONE, self->grid_size[1] - self->lane_height );
+        
+        assert(line_index > 0 && line_index < self->grid_size[1] - self->lane_height);
+
+        oct = i_note / 12;
+        note_index = i_note % 12;  
+
+        int err;
+        if (( err = mvwprintw( self->grid_derwin, line_index, 3, "%s", ALL_NOTES[note_index]) ))
+        {
+            return err;
+        }
+        if (( err = mvwprintw( self->grid_derwin, line_index, 5, "%d", oct )))
+        {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+int _render_info( MiniMidi_TUI *self)
+{
+    if (self->lazy)
+    {
+        size_t n_events;
+        uint64_t total_ticks;
+        double fraction;
+
+        // only what has been skimmed so far is known
+        MiniMidi_Lazy_progress( self->lazy, &n_events, &total_ticks, &fraction );
+
+        if (mvprintw( 0, 0, "file: %s . size: %li bytes . %zu events in %lu ticks . indexed %.0f%%.",
+                self->file->filepath,
+                self->file->length,
+                n_events,
+                total_ticks,
+                fraction * 100.0 ) > 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        size_t n_events = 0,
+               total_ticks = 0,
+               total_beats = 0;
+
+        for (size_t t = 0; t < self->file->n_tracks; t++)
+        {
+            MiniMidi_Track *track = &(self->file->tracks[t]);
+
+            n_events += track->n_events;
+            if (track->total_ticks > total_ticks) total_ticks = track->total_ticks;
+            if (track->total_beats > total_beats) total_beats = track->total_beats;
+        }
+
+        int x = 0;
+
+        if (self->workspace)
+        {
+            if (mvprintw( 0, 0, "[%zu/%zu] ", self->workspace->current + 1, self->workspace->n_entries ) > 0) return 1;
+            x = getcurx( stdscr );
+        }
+
+        if (mvprintw( 0, x, "file: %s . size: %li bytes . %zu tracks . %zu events in %zu ticks / %zu beats.",
+                self->file->filepath,
+                self->file->length,
+                self->file->n_tracks,
+                n_events,
+                total_ticks,
+                total_beats) > 0 )
+        {
+            return 1;
+        }
+    }
+
+    if (mvprintw(0, self->outer_size[0] - TOP_RIGHT_WIDTH, self->is_dirty ? "-DIRTY-"  : "-CLEAN-"))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+
+
+int _render_grid( MiniMidi_TUI *self ){
+
+    int err;
+    int line_index, aux_line_index, beat_counter, bar_counter, col_in_grid;
+    int ppqn = self->file->header->ppqn;
+
+    bool is_new_beat = false;
+    char bar_number_srt[16];
+    int bar_offset = (self->logical_start[0] / ppqn) / self->beats_in_bar;
+    int x_ticks = 0;
+
+    for (int i_note = self->logical_start[1]; i_note < self->logical_start[1] + self->logical_size[1]; i_note ++ ){
+
+        line_index = _coords__note_2_grid_row( self->logical_start[1], i_note, LINES_PER_SEMITONE, self->grid_size[1] - self->lane_height );
+        
+        assert(line_index > 0 && line_index < self->grid_size[1] - self->lane_height);
+        
+        aux_line_index = line_index - 1;        // where bar delimiters are drawed into
+        beat_counter = self->logical_start[0] / ppqn;  // keep track of actual beats, not just cols
+        bar_counter = 0;
+        
+        // cycle through drawable cols
+        for (int j = GRID_LEFT_LABELS_WIDTH; j < self->grid_size[0] - 1 /* box */; j ++ ){
+            
+
+            // dash under even beats
+            if ( beat_counter % 2 == 0 ){
+                if ( (err = mvwaddch( self->grid_derwin, line_index, j, note_delim )) )
+                    return 1;
+            }
+
+            col_in_grid = j - GRID_LEFT_LABELS_WIDTH + 1;
+
+            x_ticks = self->logical_start[0] + col_in_grid * self->ticks_per_col;
+
+            // beat is incremented every cols_in_beat
+            // is_new_beat = col_in_grid != 0 && ( (col_in_grid + 1) % self->cols_in_beat ) == 0;
+            is_new_beat = ( x_ticks - beat_counter * ppqn ) >=  ppqn;
+
+            
+            if (is_new_beat) {
+                beat_counter++;
+
+                if ( beat_counter % self->beats_in_bar == 0) {
+                
+                    bar_counter++;
+
+
+                    if ((err = mvwaddch( self->grid_derwin, aux_line_index, j, bar_delim )))
+                        return 1;
+                
+                    // annotate the bar num for the 1st line only
+                    if (i_note == (self->logical_start[1] + self->logical_size[1] - 1) 
+                        && j < self->grid_size[0] - 10 ){
+                        
+                        wattron( self->grid_derwin, COLOR_PAIR(2));
+                        snprintf( bar_number_srt, sizeof( bar_number_srt ), "BAR%i", bar_offset + bar_counter );
+                        mvwprintw(self->grid_derwin, aux_line_index, j + 2, bar_number_srt);
+                        wattroff( self->grid_derwin, COLOR_PAIR(2));
+                    }
+                }
+            }  
+        }
+    }
+
+    return 0;
+}
+
+
+// drawable columns of the grid, right of the labels
+static int _view_cols( MiniMidi_TUI *self )
+{
+    return self->grid_size[0] - 1 /* box */ - GRID_LEFT_LABELS_WIDTH;
+}
+
+// a row per note, or one line when stacked
+static int _layer_rows( MiniMidi_TUI *self )
+{
+    return self->is_stacked ? 1 : LAYER_NOTES;
+}
+
+static int _layer_row( MiniMidi_TUI_Layer *layer, MiniMidi_Event *evt )
+{
+    if (layer->is_stacked) return 0;
+
+    int note = ( evt->note.octave * 12 ) + (int)( evt->note.note );
+    return note >= 0 && note < layer->rows ? note : -1;
+}
+
+// where a NOTE ON's NOTE OFF is, INT64_MAX while the note is held
+static int64_t _off_ticks( MiniMidi_Event *on )
+{
+    // a live capture may be linking it right now
+    MiniMidi_Event *off = __atomic_load_n( &(on->next), __ATOMIC_ACQUIRE );
+    return off ? (int64_t)off->abs_ticks : INT64_MAX;
+}
+
+static int _spans_push( MiniMidi_TUI_Spans *list, int64_t on_ticks, int64_t off_ticks, int row )
+{
+    if (list->n == list->capacity)
+    {
+        size_t cap = list->capacity ? list->capacity * 2 : 64;
+        MiniMidi_TUI_Span *arr = (MiniMidi_TUI_Span*)realloc( list->arr, cap * sizeof( MiniMidi_TUI_Span ) );
+        if (!arr) return 1;
+        list->arr = arr;
+        list->capacity = cap;
+    }
+
+    list->arr[ list->n ].on_ticks = on_ticks;
+    list->arr[ list->n ].off_ticks = off_ticks;
+    list->arr[ list->n++ ].row = row;
+    return 0;
+}
+
+// keep the spans that still sound after ticks
+static void _spans_keep_after( MiniMidi_TUI_Spans *list, int64_t ticks )
+{
+    size_t n = 0;
+    for (size_t i = 0; i < list->n; i++)
+    {
+        if (list->arr[i].off_ticks > ticks) list->arr[ n++ ] = list->arr[i];
+    }
+    list->n = n;
+}
+
+// a note's head and body, only in columns [ col_from, col_to ) of the window.
+// the body runs up to the column of its NOTE OFF
+static void _paint_span( MiniMidi_TUI_Layer *layer, int row, int64_t on_ticks, int64_t off_ticks, int col_from, int col_to )
+{
+    int64_t start = layer->start_ticks,
+            on_col = on_ticks >= start ? ( on_ticks - start ) / layer->ticks_per_col : -1,
+            off_col = off_ticks == INT64_MAX ? col_to : ( off_ticks >= start ? ( off_ticks - start ) / layer->ticks_per_col : -1 ),
+            from = on_col + 1 > col_from ? on_col + 1 : col_from,
+            to = off_col < col_to ? off_col : col_to;
+    _Byte *cells = layer->cells + (size_t)row * layer->cols;
+
+    if (row < layer->used_first) layer->used_first = row;
+    if (row > layer->used_last) layer->used_last = row;
+
+    if (on_col >= col_from && on_col < col_to) cells[ on_col ] = CELL_HEAD;
+
+    for (int64_t c = from; c < to; c++)
+    {
+        if (cells[c] == CELL_EMPTY) cells[c] = CELL_BODY;
+    }
+}
+
+// move the cells by shift columns, left when it is positive, and clear what comes in
+static void _shift_cells( MiniMidi_TUI_Layer *layer, int shift )
+{
+    int keep = layer->cols - ( shift > 0 ? shift : -shift );
+
+    for (int row = layer->used_first; row <= layer->used_last; row++)
+    {
+        _Byte *cells = layer->cells + (size_t)row * layer->cols;
+
+        if (shift > 0)
+        {
+            memmove( cells, cells + shift, keep );
+            memset( cells + keep, CELL_EMPTY, shift );
+        }
+        else
+        {
+            memmove( cells - shift, cells, keep );
+            memset( cells, CELL_EMPTY, -shift );
+        }
+    }
+}
+
+static bool _layer_fits( MiniMidi_TUI *self, MiniMidi_TUI_Layer *layer, MiniMidi_Track *track )
+{
+    return layer->is_valid
+        && layer->rows == _layer_rows( self )
+        && layer->cols == LAYER_SCREENS * _view_cols( self )
+        && layer->ticks_per_col == self->ticks_per_col
+        && layer->is_stacked == self->is_stacked
+        // a lazy file's events are only moved around, never changed
+        && ( self->lazy || ( layer->event_arr == track->event_arr
+            && layer->n_events == __atomic_load_n( &(track->n_events), __ATOMIC_ACQUIRE ) ) );
+}
+
+static void _layer_seen( MiniMidi_TUI_Layer *layer, MiniMidi_Track *track, size_t n_events )
+{
+    layer->event_arr = track->event_arr;
+    layer->n_events = n_events;
+    layer->is_valid = true;
+}
+
+// notes that started before index lo and sound into the window, but for the ones their NOTE
+// OFF brings in: those sounding across all of it, or never stopping, and those sharing a NOTE
+// OFF with a later NOTE ON. walks back until a NOTE OFF of each channel and pitch, what came
+// before one of those ended before the window
+static int _seed_across( MiniMidi_TUI_Layer *layer, MiniMidi_Event *arr, size_t lo, int64_t start, int64_t end )
+{
+    bool is_closed[MINIMIDI_NOTE_KEYS] = { false };
+    size_t n_closed = 0;
+
+    for (size_t i = lo; i-- > 0 && n_closed < MINIMIDI_NOTE_KEYS; )
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        size_t key = MINIMIDI_NOTE_KEY( evt );
+
+        if (( evt->status_code != MIDI_NOTE_ON && evt->status_code != MIDI_NOTE_OFF ) || is_closed[key]) continue;
+
+        if (evt->status_code == MIDI_NOTE_OFF)
+        {
+            is_closed[key] = true;
+            n_closed++;
+            continue;
+        }
+
+        int row = _layer_row( layer, evt );
+        int64_t off = _off_ticks( evt );
+
+        if (row < 0 || off <= start) continue;
+        if (off < end && evt->next && evt->next->prev == evt) continue;
+
+        _paint_span( layer, row, evt->abs_ticks, off, 0, layer->cols );
+        if (_spans_push( &(layer->left), evt->abs_ticks, off, row )) return 1;
+        if (off > end && _spans_push( &(layer->right), evt->abs_ticks, off, row )) return 1;
+    }
+    return 0;
+}
+
+// draw one track's window from scratch, the view in its middle screen
+int _build_layer( MiniMidi_TUI *self, size_t t )
+{
+    MiniMidi_TUI_Layer *layer = &(self->layers[t]);
+    MiniMidi_Track *track = &(self->file->tracks[t]);
+
+    int rows = _layer_rows( self ),
+        cols = LAYER_SCREENS * _view_cols( self );
+
+    if (cols <= 0) return 1;
+
+    if ((size_t)layer->rows * layer->cols != (size_t)rows * cols)
+    {
+        _Byte *cells = (_Byte*)realloc( layer->cells, (size_t)rows * cols );
+        if (!cells) return 1;
+        layer->cells = cells;
+    }
+    memset( layer->cells, CELL_EMPTY, (size_t)rows * cols );
+
+    layer->rows = rows;
+    layer->cols = cols;
+    layer->used_first = rows;
+    layer->used_last = -1;
+    layer->ticks_per_col = self->ticks_per_col;
+    layer->is_stacked = self->is_stacked;
+    layer->start_ticks = self->logical_start[0] - (int64_t)_view_cols( self ) * self->ticks_per_col;
+    layer->left.n = 0;
+    layer->right.n = 0;
+
+    int64_t start = layer->start_ticks,
+            end = start + (int64_t)cols * self->ticks_per_col;
+
+    // big files only have what is around the view
+    if (self->lazy) MiniMidi_Lazy_view( self->lazy, t, start > 0 ? start : 0, end );
+
+    // a live capture may be appending, only look at what is published
+    size_t n_events = __atomic_load_n( &(track->n_events), __ATOMIC_ACQUIRE ),
+           lo,
+           hi;
+    MiniMidi_Event *arr = track->event_arr;
+
+    _events_between( arr, n_events, start, end, &lo, &hi );
+
+    // a lazy window starts with the notes sounding into it, look at those too
+    if (self->lazy) lo = 0;
+    else if (_seed_across( layer, arr, lo, start, end )) return 1;
+
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        int row = _layer_row( layer, evt );
+
+        if (row < 0) continue;
+
+        if (evt->status_code == MIDI_NOTE_ON)
+        {
+            int64_t on = evt->abs_ticks,
+                    off = _off_ticks( evt );
+
+            if (off <= start) continue;
+
+            _paint_span( layer, row, on, off, 0, cols );
+            if (on < start && _spans_push( &(layer->left), on, off, row )) return 1;
+            if (off > end && _spans_push( &(layer->right), on, off, row )) return 1;
+        }
+        // ended in the window, started left of what was looked at
+        else if (evt->status_code == MIDI_NOTE_OFF && evt->prev && evt->prev < arr + lo
+            && (int64_t)evt->abs_ticks > start)
+        {
+            int64_t on = evt->prev->abs_ticks;
+
+            _paint_span( layer, row, on, evt->abs_ticks, 0, cols );
+            if (_spans_push( &(layer->left), on, evt->abs_ticks, row )) return 1;
+        }
+    }
+
+    _layer_seen( layer, track, n_events );
+    return 0;
+}
+
+// slide the window shift columns right: draw the strip coming in from the right edge
+static int _extend_right( MiniMidi_TUI *self, size_t t, int shift )
+{
+    MiniMidi_TUI_Layer *layer = &(self->layers[t]);
+    MiniMidi_Track *track = &(self->file->tracks[t]);
+
+    int cols = layer->cols,
+        from = cols - shift;
+    int64_t start = layer->start_ticks,
+            end = start + (int64_t)cols * layer->ticks_per_col,
+            new_start = start + (int64_t)shift * layer->ticks_per_col,
+            new_end = end + (int64_t)shift * layer->ticks_per_col;
+
+    // what leaves on the left is still needed to know what sounds across the new left edge
+    if (self->lazy) MiniMidi_Lazy_view( self->lazy, t, start > 0 ? start : 0, new_end );
+
+    size_t n_events = __atomic_load_n( &(track->n_events), __ATOMIC_ACQUIRE ),
+           lo,
+           hi;
+    MiniMidi_Event *arr = track->event_arr;
+
+    _shift_cells( layer, shift );
+    layer->start_ticks = new_start;
+
+    // a note whose NOTE OFF was past what was decoded, or not there yet, may end in the strip
+    _events_between( arr, n_events, end, new_end, &lo, &hi );
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        if (evt->status_code != MIDI_NOTE_OFF || !evt->prev || (int64_t)evt->prev->abs_ticks >= end) continue;
+
+        int row = _layer_row( layer, evt );
+
+        for (size_t k = 0; k < layer->right.n; k++)
+        {
+            MiniMidi_TUI_Span *span = &(layer->right.arr[k]);
+
+            if (span->off_ticks == INT64_MAX && span->row == row && span->on_ticks == (int64_t)evt->prev->abs_ticks)
+            {
+                span->off_ticks = evt->abs_ticks;
+                break;
+            }
+        }
+    }
+
+    // notes that sounded across the old right edge, then the ones starting in the strip
+    for (size_t i = 0; i < layer->right.n; i++)
+    {
+        MiniMidi_TUI_Span *span = &(layer->right.arr[i]);
+        _paint_span( layer, span->row, span->on_ticks, span->off_ticks, from, cols );
+    }
+    _spans_keep_after( &(layer->right), new_end );
+
+    _events_between( arr, n_events, end, new_end, &lo, &hi );
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        int row = _layer_row( layer, evt );
+
+        if (evt->status_code != MIDI_NOTE_ON || row < 0) continue;
+
+        int64_t off = _off_ticks( evt );
+
+        _paint_span( layer, row, evt->abs_ticks, off, from, cols );
+        if (off > new_end && _spans_push( &(layer->right), evt->abs_ticks, off, row )) return 1;
+    }
+
+    // the new left edge: what sounded across the old one, or started since and still sounds
+    _spans_keep_after( &(layer->left), new_start );
+
+    _events_between( arr, n_events, start, new_start, &lo, &hi );
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        int row = _layer_row( layer, evt );
+
+        if (evt->status_code != MIDI_NOTE_ON || row < 0) continue;
+
+        int64_t off = _off_ticks( evt );
+        if (off > new_start && _spans_push( &(layer->left), evt->abs_ticks, off, row )) return 1;
+    }
+
+    _layer_seen( layer, track, n_events );
+    return 0;
+}
+
+// slide the window shift columns left: draw the strip coming in from the left edge
+static int _extend_left( MiniMidi_TUI *self, size_t t, int shift )
+{
+    MiniMidi_TUI_Layer *layer = &(self->layers[t]);
+    MiniMidi_Track *track = &(self->file->tracks[t]);
+
+    int cols = layer->cols;
+    int64_t start = layer->start_ticks,
+            end = start + (int64_t)cols * layer->ticks_per_col,
+            new_start = start - (int64_t)shift * layer->ticks_per_col,
+            new_end = end - (int64_t)shift * layer->ticks_per_col;
+
+    // what leaves on the right is still needed to know what sounds across the new right edge
+    if (self->lazy) MiniMidi_Lazy_view( self->lazy, t, new_start > 0 ? new_start : 0, end );
+
+    size_t n_events = __atomic_load_n( &(track->n_events), __ATOMIC_ACQUIRE ),
+           lo,
+           hi;
+    MiniMidi_Event *arr = track->event_arr;
+
+    _shift_cells( layer, -shift );
+    layer->start_ticks = new_start;
+
+    // the new left edge. a lazy window starts with every note sounding into it
+    if (self->lazy)
+    {
+        layer->left.n = 0;
+        _events_between( arr, n_events, new_start, new_start, &lo, &hi );
+
+        for (size_t i = 0; i < lo; i++)
+        {
+            MiniMidi_Event *evt = &(arr[i]);
+            int row = _layer_row( layer, evt );
+
+            if (evt->status_code != MIDI_NOTE_ON || row < 0) continue;
+
+            int64_t off = _off_ticks( evt );
+            if (off > new_start && _spans_push( &(layer->left), evt->abs_ticks, off, row )) return 1;
+        }
+    }
+    else
+    {
+        // sounding across the old one and started before the new one, or ending in the strip
+        size_t n = 0;
+        for (size_t i = 0; i < layer->left.n; i++)
+        {
+            if (layer->left.arr[i].on_ticks < new_start) layer->left.arr[ n++ ] = layer->left.arr[i];
+        }
+        layer->left.n = n;
+
+        _events_between( arr, n_events, new_start, start, &lo, &hi );
+        for (size_t i = lo; i < hi; i++)
+        {
+            MiniMidi_Event *evt = &(arr[i]);
+            int row = _layer_row( layer, evt );
+
+            if (evt->status_code != MIDI_NOTE_OFF || row < 0 || !evt->prev) continue;
+            if ((int64_t)evt->prev->abs_ticks >= new_start || (int64_t)evt->abs_ticks <= new_start) continue;
+
+            if (_spans_push( &(layer->left), evt->prev->abs_ticks, evt->abs_ticks, row )) return 1;
+        }
+    }
+
+    for (size_t i = 0; i < layer->left.n; i++)
+    {
+        MiniMidi_TUI_Span *span = &(layer->left.arr[i]);
+        _paint_span( layer, span->row, span->on_ticks, span->off_ticks, 0, shift );
+    }
+
+    _events_between( arr, n_events, new_start, start, &lo, &hi );
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        int row = _layer_row( layer, evt );
+
+        if (evt->status_code != MIDI_NOTE_ON || row < 0) continue;
+        _paint_span( layer, row, evt->abs_ticks, _off_ticks( evt ), 0, shift );
+    }
+
+    // the new right edge: what sounded across the old one and started before the new one,
+    // or ends between the two
+    size_t n = 0;
+    for (size_t i = 0; i < layer->right.n; i++)
+    {
+        if (layer->right.arr[i].on_ticks < new_end) layer->right.arr[ n++ ] = layer->right.arr[i];
+    }
+    layer->right.n = n;
+
+    _events_between( arr, n_events, new_end, end, &lo, &hi );
+    for (size_t i = lo; i < hi; i++)
+    {
+        MiniMidi_Event *evt = &(arr[i]);
+        int row = _layer_row( layer, evt );
+
+        if (evt->status_code != MIDI_NOTE_OFF || row < 0 || !evt->prev) continue;
+        if ((int64_t)evt->prev->abs_ticks >= new_end || (int64_t)evt->abs_ticks <= new_end) continue;
+
+        if (_spans_push( &(layer->right), evt->prev->abs_ticks, evt->abs_ticks, row )) return 1;
+    }
+
+    _layer_seen( layer, track, n_events );
+    return 0;
+}
+
+// get a track's window around the view: nothing to do while the view is inside it, a strip
+// when it left by less than the window's width, from scratch otherwise
+int _update_layer( MiniMidi_TUI *self, size_t t )
+{
+    MiniMidi_TUI_Layer *layer = &(self->layers[t]);
+    int view_cols = _view_cols( self );
+
+    if (view_cols <= 0) return 1;
+    if (!_layer_fits( self, layer, &(self->file->tracks[t]) )) return _build_layer( self, t );
+
+    int64_t moved = self->logical_start[0] - layer->start_ticks;
+    if (moved % layer->ticks_per_col) return _build_layer( self, t );
+
+    int64_t col = moved / layer->ticks_per_col;
+    if (col >= 0 && col + view_cols <= layer->cols) return 0;
+
+    // put the view back in the middle screen
+    int64_t shift = col - view_cols;
+
+    if (shift > 0 && shift < layer->cols) return _extend_right( self, t, shift );
+    if (shift < 0 && -shift < layer->cols) return _extend_left( self, t, -shift );
+
+    return _build_layer( self, t );
+}
+
+// put the part of a track's layer that is in view on the grid, from grid line top
+int _draw_layer( MiniMidi_TUI *self, size_t t, int top, bool is_audible )
+{
+    MiniMidi_TUI_Layer *layer = &(self->layers[t]);
+
+    if (_update_layer( self, t )) return 1;
+
+    attr_t dim = is_audible ? 0 : A_DIM;
+    chtype head = ' ' | COLOR_PAIR( BLACK_ON_CYAN ) | dim,
+           body = ' ' | COLOR_PAIR( TRACK_COLORS + t % N_TRACK_COLORS ) | dim;
+
+    int view_cols = _view_cols( self ),
+        first_col = ( self->logical_start[0] - layer->start_ticks ) / layer->ticks_per_col,
+        low_note = self->logical_start[1],
+        high_note = low_note + self->logical_size[1];
+
+    // only the rows something was painted in
+    int first = layer->is_stacked ? 0 : ( low_note > layer->used_first ? low_note : layer->used_first ),
+        last = layer->is_stacked ? 1 : ( high_note < layer->used_last + 1 ? high_note : layer->used_last + 1 );
+
+    for (int note = first; note < last; note++)
+    {
+
+        _Byte *cells = layer->cells + (size_t)note * layer->cols + first_col;
+        int line = layer->is_stacked
+            ? top
+            : _coords__note_2_grid_row( low_note, note, LINES_PER_SEMITONE, self->grid_size[1] - self->lane_height );
+
+        for (int c = 0; c < view_cols; c++)
+        {
+            if (cells[c] == CELL_EMPTY) continue;
+            mvwaddch( self->grid_derwin, line, GRID_LEFT_LABELS_WIDTH + c, cells[c] == CELL_HEAD ? head : body );
+        }
+    }
+
+    return 0;
+}
+
+// every shown track over the piano roll, the selected one last
+int _render_midi( MiniMidi_TUI *self )
+{
+    bool any_solo = _any_solo( self );
+
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        if (t == self->track_index || self->track_flags[t] & MINIMIDI_TUI_HIDE) continue;
+        if (_draw_layer( self, t, 0, _is_audible( self, t, any_solo ) )) return 1;
+    }
+
+    size_t t = self->track_index;
+    if (!( self->track_flags[t] & MINIMIDI_TUI_HIDE ) && _draw_layer( self, t, 0, _is_audible( self, t, any_solo ) )) return 1;
+
+    return 0;
+}
+
+// a line per track: number and toggles on the left, where its notes sound on the right
+int _render_stacked( MiniMidi_TUI *self )
+{
+    int top = 1,
+        n_lines = self->grid_size[1] - 2 - self->lane_height;
+    bool any_solo = _any_solo( self );
+
+    if (n_lines <= 0) return 0;
+
+    // keep the selected track on screen
+    if (self->track_index < self->stacked_first) self->stacked_first = self->track_index;
+    if (self->track_index >= self->stacked_first + n_lines) self->stacked_first = self->track_index - n_lines + 1;
+
+    for (int line = 0; line < n_lines; line++)
+    {
+        size_t t = self->stacked_first + line;
+        if (t >= self->file->n_tracks) break;
+
+        uint8_t flags = self->track_flags[t];
+
+        if (t == self->track_index) wattron( self->grid_derwin, A_REVERSE );
+        mvwprintw( self->grid_derwin, top + line, 1, "%3zu%c%c%c", t + 1,
+            flags & MINIMIDI_TUI_MUTE ? 'M' : ' ',
+            flags & MINIMIDI_TUI_SOLO ? 'S' : ' ',
+            flags & MINIMIDI_TUI_HIDE ? 'H' : ' ' );
+        if (t == self->track_index) wattroff( self->grid_derwin, A_REVERSE );
+
+        if (flags & MINIMIDI_TUI_HIDE) continue;
+        if (_draw_layer( self, t, top + line, _is_audible( self, t, any_solo ) )) return 1;
+    }
+
+    return 0;
+}
+
+// selected track and its toggles, on the bottom bar
+int _render_track_info( MiniMidi_TUI *self )
+{
+    if (self->file->n_tracks < 2) return 0;
+
+    uint8_t flags = self->track_flags[ self->track_index ];
+
+    mvprintw( self->outer_size[1] - 1, self->outer_size[0] - 56, "track %zu / %zu%s%s%s",
+        self->track_index + 1, self->file->n_tracks,
+        flags & MINIMIDI_TUI_MUTE ? " . muted" : "",
+        flags & MINIMIDI_TUI_SOLO ? " . solo" : "",
+        flags & MINIMIDI_TUI_HIDE ? " . hidden" : "" );
+
+    return 0;
+}
+
+int _render_lane( MiniMidi_TUI *self )
+{
+    if (!self->lane_height) return 0;
+
+    int top = self->grid_size[1] - 1 - self->lane_height,
+        bottom = self->grid_size[1] - 2,
+        n_cols = self->grid_size[0] - 1 - GRID_LEFT_LABELS_WIDTH;
+
+    for (int j = 1; j < self->grid_size[0] - 1; j++)
+    {
+        mvwaddch( self->grid_derwin, top, j, '-' );
+    }
+
+    if (!self->automation || !self->automation->n_lanes || n_cols <= 0)
+    {
+        mvwprintw( self->grid_derwin, top, 2, " no automation " );
+        return 0;
+    }
+
+    MiniMidi_Lane *lane = &(self->automation->lanes[ self->lane_index ]);
+    static const char *KIND_NAMES[] = { "CC", "Bend", "ChanAT", "PolyAT" };
+
+    wattron( self->grid_derwin, COLOR_PAIR( GREEN_ON_BLK ));
+    if (lane->kind == MINIMIDI_LANE_CC || lane->kind == MINIMIDI_LANE_POLY_AFTERTOUCH)
+        mvwprintw( self->grid_derwin, top, 2, " %s %d . ch %d . %zu/%zu ", KIND_NAMES[ lane->kind ], lane->controller,
+            lane->channel + 1, self->lane_index + 1, self->automation->n_lanes );
+    else
+        mvwprintw( self->grid_derwin, top, 2, " %s . ch %d . %zu/%zu ", KIND_NAMES[ lane->kind ],
+            lane->channel + 1, self->lane_index + 1, self->automation->n_lanes );
+    wattroff( self->grid_derwin, COLOR_PAIR( GREEN_ON_BLK ));
+
+    int16_t min[ n_cols ], max[ n_cols ], lo, hi;
+    MiniMidi_Lane_limits( lane, &lo, &hi );
+
+    // one range query per column, however many points fall in it
+    MiniMidi_Lane_envelope( lane, self->logical_start[0], self->ticks_per_col, n_cols, min, max );
+
+    int rows = bottom - top - 1;
+
+    wattron( self->grid_derwin, COLOR_PAIR( BLACK_ON_CYAN ));
+    for (int c = 0; c < n_cols; c++)
+    {
+        if (min[c] > max[c]) continue;
+
+        int row_lo = bottom - ( min[c] - lo ) * rows / ( hi - lo ),
+            row_hi = bottom - ( max[c] - lo ) * rows / ( hi - lo );
+
+        for (int row = row_hi; row <= row_lo; row++)
+        {
+            mvwaddch( self->grid_derwin, row, GRID_LEFT_LABELS_WIDTH + c, ' ' );
+        }
+    }
+    wattroff( self->grid_derwin, COLOR_PAIR( BLACK_ON_CYAN ));
+
+    return 0;
+}
+
+// shade the empty cells of columns that go over the voice limit, notes keep their colors
+int _render_polyphony( MiniMidi_TUI *self )
+{
+    if (!self->show_polyphony) return 0;
+
+    if (!self->polyphony)
+    {
+        mvprintw( self->outer_size[1] - 1, 0, "voices: not available for big files" );
+        return 0;
+    }
+
+    mvprintw( self->outer_size[1] - 1, 0, "voices: peak %u . limit %u . %zu regions over",
+        self->polyphony->total.peak, self->voice_limit, self->n_over );
+
+    uint64_t view_start = self->logical_start[0];
+    size_t lo = 0, hi = self->n_over;
+
+    // first region still going at the left edge
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (self->over[mid].end_ticks <= view_start) lo = mid + 1; else hi = mid;
+    }
+
+    int bottom = self->grid_size[1] - 2 - self->lane_height;
+
+    for (int j = GRID_LEFT_LABELS_WIDTH; j < self->grid_size[0] - 1 && lo < self->n_over; j++)
+    {
+        uint64_t col_start = view_start + (uint64_t)( j - GRID_LEFT_LABELS_WIDTH ) * self->ticks_per_col,
+                 col_end = col_start + self->ticks_per_col;
+
+        while (lo < self->n_over && self->over[lo].end_ticks <= col_start) lo++;
+        if (lo == self->n_over || self->over[lo].start_ticks >= col_end) continue;
+
+        for (int row = 1; row <= bottom; row++)
+        {
+            chtype cell = mvwinch( self->grid_derwin, row, j );
+            if (PAIR_NUMBER( cell & A_COLOR )) continue;
+
+            mvwaddch( self->grid_derwin, row, j, ( cell & A_CHARTEXT ) | COLOR_PAIR( WHITE_ON_RED ) );
+        }
+    }
+
+    return 0;
+}
+
+// a ^ run on the top line of the grid under every hit in view
+int _render_matches( MiniMidi_TUI *self )
+{
+    if (!self->n_matches) return 0;
+
+    mvprintw( self->outer_size[1] - 1, self->outer_size[0] - 24, "match %zu / %zu",
+        self->match_index + 1, self->n_matches );
+
+    uint64_t view_start = self->logical_start[0],
+             view_end = view_start + (uint64_t)self->logical_size[0];
+
+    wattron( self->grid_derwin, COLOR_PAIR( WHITE_ON_RED ));
+    for (size_t i = 0; i < self->n_matches && self->matches[i].start_ticks < view_end; i++)
+    {
+        MiniMidi_Search_Match *m = &(self->matches[i]);
+        if (m->end_ticks < view_start) continue;
+
+        uint64_t from = m->start_ticks > view_start ? m->start_ticks : view_start;
+        int col = GRID_LEFT_LABELS_WIDTH + ( from - view_start ) / self->ticks_per_col,
+            last = GRID_LEFT_LABELS_WIDTH + ( m->end_ticks - view_start ) / self->ticks_per_col;
+
+        for (; col <= last && col < self->grid_size[0] - 1; col++) mvwaddch( self->grid_derwin, 1, col, '^' );
+    }
+    wattroff( self->grid_derwin, COLOR_PAIR( WHITE_ON_RED ));
+
+    return 0;
+}
+
+// a v on the top line of the grid over where the last jump landed
+int _render_cursor( MiniMidi_TUI *self )
+{
+    if (!_cursor_in_view( self )) return 0;
+
+    int col = GRID_LEFT_LABELS_WIDTH + ( self->cursor_ticks - self->logical_start[0] ) / self->ticks_per_col;
+    if (col >= self->grid_size[0] - 1) return 0;
+
+    wattron( self->grid_derwin, COLOR_PAIR( GREEN_ON_BLK ) | A_BOLD );
+    mvwaddch( self->grid_derwin, 1, col, 'v' );
+    wattroff( self->grid_derwin, COLOR_PAIR( GREEN_ON_BLK ) | A_BOLD );
+
+    return 0;
+}
+
+// the selected notes over the roll, and how many there are on the bottom bar
+int _render_selection( MiniMidi_TUI *self )
+{
+    if (self->has_anchor) mvprintw( self->outer_size[1] - 1, 0, "select: from tick %lu", self->anchor_ticks );
+    if (!self->n_selected) return 0;
+
+    mvprintw( self->outer_size[1] - 1, 0, "%zu notes selected", self->n_selected );
+    if (self->is_stacked) return 0;
+
+    int64_t view_start = self->logical_start[0],
+            view_end = view_start + (int64_t)_view_cols( self ) * self->ticks_per_col;
+    chtype head = '#' | COLOR_PAIR( WHITE_ON_RED ) | A_BOLD,
+           body = ' ' | COLOR_PAIR( WHITE_ON_RED );
+
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Selection *sel = &(self->selection[t]);
+        MiniMidi_Event *arr = self->file->tracks[t].event_arr;
+
+        if (self->track_flags[t] & MINIMIDI_TUI_HIDE) continue;
+
+        for (size_t k = 0; k < sel->count; k++)
+        {
+            MiniMidi_Event *on = &(arr[ sel->indices[k] ]);
+            if (on->status_code != MIDI_NOTE_ON) continue;
+
+            // the roll counts notes from C0, MIDI from C-1
+            int note = ( on->evt_data[0] & 0x7F ) - 12;
+            int64_t off_ticks = on->next ? (int64_t)on->next->abs_ticks : (int64_t)on->abs_ticks + 1;
+
+            if (note < self->logical_start[1] || note >= self->logical_start[1] + self->logical_size[1]) continue;
+            if ((int64_t)on->abs_ticks >= view_end || off_ticks <= view_start) continue;
+
+            int line = _coords__note_2_grid_row( self->logical_start[1], note, LINES_PER_SEMITONE, self->grid_size[1] - self->lane_height ),
+                from = (int64_t)on->abs_ticks > view_start ? ( (int64_t)on->abs_ticks - view_start ) / self->ticks_per_col : 0,
+                to = ( off_ticks - 1 - view_start ) / self->ticks_per_col;
+
+            if (to >= _view_cols( self )) to = _view_cols( self ) - 1;
+            for (int c = from; c <= to; c++)
+            {
+                mvwaddch( self->grid_derwin, line, GRID_LEFT_LABELS_WIDTH + c,
+                    (int64_t)on->abs_ticks >= view_start && c == from ? head : body );
+            }
+        }
+    }
+
+    return 0;
+}
+
+int _render_message( MiniMidi_TUI *self )
+{
+    if (!self->message) return 0;
+
+    move( self->outer_size[1] - 1, 0 );
+    clrtoeol();
+    mvprintw( self->outer_size[1] - 1, 0, "%s", self->message );
+    self->message = NULL;
+
+    return 0;
+}
+
+// big files: have the next window the way the view is panning decoded in the background
+int _prefetch_ahead( MiniMidi_TUI *self )
+{
+    if (!self->lazy || !self->prefetch_tracks) return 0;
+
+    int64_t width = (int64_t)LAYER_SCREENS * _view_cols( self ) * self->ticks_per_col,
+            start = self->pan_direction < 0
+                ? self->logical_start[0] - width
+                : self->logical_start[0] + self->logical_size[0];
+
+    if (start < 0) start = 0;
+    if (start == self->prefetch_start) return 0;
+
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        self->prefetch_tracks[t] = !( self->track_flags[t] & MINIMIDI_TUI_HIDE );
+    }
+
+    self->prefetch_start = start;
+    return MiniMidi_Lazy_prefetch( self->lazy, start, start + width, self->prefetch_tracks );
+}
+
+int _follow_track_end( MiniMidi_TUI *self )
+{
+    if (!self->is_following) return 0;
+
+    uint64_t end = self->file->track->total_ticks;
+    int bar_ticks = self->file->header->ppqn * self->beats_in_bar;
+
+    // jump a bar at a time, keeping the latest events in the right half
+    if (end >= (uint64_t)(self->logical_start[0] + self->logical_size[0] * 3 / 4))
+    {
+        int64_t start = (int64_t)end - self->logical_size[0] / 2;
+        self->logical_start[0] = start > 0 ? ( start / bar_ticks ) * bar_ticks : 0;
+    }
+
+    return 0;
+}
+
+int _render_playhead( MiniMidi_TUI *self )
+{
+    if (!self->player) return 0;
+
+    // follow the playhead a bar at a time
+    if (MiniMidi_Player_poll_playhead( self->player, &(self->playhead) )
+        && MiniMidi_Player_is_playing( self->player )
+        && self->playhead >= (uint64_t)(self->logical_start[0] + self->logical_size[0]))
+    {
+        int bar_ticks = self->file->header->ppqn * self->beats_in_bar;
+        self->logical_start[0] = ( self->playhead / bar_ticks ) * bar_ticks;
+    }
+
+    if (self->playhead < (uint64_t)self->logical_start[0]
+        || self->playhead >= (uint64_t)(self->logical_start[0] + self->logical_size[0]))
+    {
+        return 0;
+    }
+
+    int col = GRID_LEFT_LABELS_WIDTH + ( (self->playhead - self->logical_start[0]) / self->ticks_per_col );
+    if (col >= self->grid_size[0] - 1) return 0;
+
+    wattron( self->grid_derwin, COLOR_PAIR( RED_ON_BLK ));
+    for (int line = 1; line < self->grid_size[1] - 1; line++)
+    {
+        mvwaddch( self->grid_derwin, line, col, '|' );
+    }
+    wattroff( self->grid_derwin, COLOR_PAIR( RED_ON_BLK ));
+
+    return 0;
+}
+
+/**
+ * PUBLIC
+ */
+int MiniMidi_TUI_init( MiniMidi_TUI *self, MiniMidi_File *file )
+{
+    self->is_dirty = false;
+    self->is_running = true;
+    //
+    self->logical_size[0] = 0;
+    self->logical_size[1] = 0;
+    //
+    self->logical_start[0] = 0;
+    self->logical_start[1] = 0;
+    //
+    self->grid_size[0] = 0;
+    self->grid_size[1] = 0;
+    //
+    self->outer_size[0] = 0;
+    self->outer_size[1] = 0;
+    
+    // ZOOM ETERNAL
+    // self->cols_in_beat = 4;
+    self->ticks_per_col = file->header->ppqn / 4; // start at 4 cols -> 1 beat
+
+    // TIME SIG
+    self->beats_in_bar = 4;
+
+    //
+    self->file = file;
+    self->layers = (MiniMidi_TUI_Layer*)calloc( file->n_tracks, sizeof( MiniMidi_TUI_Layer ) );
+    self->track_flags = (uint8_t*)calloc( file->n_tracks, sizeof( uint8_t ) );
+    self->selection = (MiniMidi_Selection*)calloc( file->n_tracks ? file->n_tracks : 1, sizeof( MiniMidi_Selection ) );
+    self->histories = (MiniMidi_History**)calloc( file->n_tracks ? file->n_tracks : 1, sizeof( MiniMidi_History* ) );
+    self->track_index = 0;
+    self->stacked_first = 0;
+    self->is_stacked = false;
+
+    if (!self->layers || !self->track_flags || !self->selection || !self->histories) return 1;
+
+    self->player = NULL;
+    self->lazy = NULL;
+    self->prefetch_tracks = NULL;
+    self->pan_direction = 1;
+    self->prefetch_start = -1;
+    self->automation = NULL;
+    self->lane_index = 0;
+    self->lane_height = 0;
+    self->polyphony = NULL;
+    self->over = NULL;
+    self->n_over = 0;
+    self->voice_limit = MINIMIDI_POLY_DEFAULT_LIMIT;
+    self->show_polyphony = false;
+    self->matches = NULL;
+    self->n_matches = 0;
+    self->match_index = 0;
+    self->navigation = NULL;
+    self->cursor_ticks = 0;
+    self->cursor_pitch = 0;
+    self->has_cursor = false;
+    self->has_cursor_pitch = false;
+    self->n_selected = 0;
+    self->anchor_ticks = 0;
+    self->select_start = 0;
+    self->select_end = 0;
+    self->anchor_pitch = -1;
+    self->select_low = 0;
+    self->select_high = 127;
+    self->has_anchor = false;
+    self->is_live = false;
+    self->edit_log = NULL;
+    self->n_logged = 0;
+    self->n_log_applied = 0;
+    self->log_capacity = 0;
+    self->watch = NULL;
+    self->workspace = NULL;
+    self->tabs = NULL;
+    self->message = NULL;
+    self->playhead = 0;
+    self->is_following = false;
+  
+    if ( _init_ncurses(self) ) return 1;
+
+    return 0;
+}
+
+
+int MiniMidi_TUI_attach_player( MiniMidi_TUI *self, MiniMidi_Player *player )
+{
+    self->player = player;
+    return 0;
+}
+
+int MiniMidi_TUI_attach_lazy( MiniMidi_TUI *self, MiniMidi_Lazy_File *lazy )
+{
+    self->lazy = lazy;
+    if (!lazy) return 0;
+
+    self->prefetch_tracks = (bool*)calloc( self->file->n_tracks ? self->file->n_tracks : 1, sizeof( bool ) );
+    if (!self->prefetch_tracks) return 1;
+
+    // nothing was decoded when the UI started, snap on the first screen
+    for (size_t t = 0; t < self->file->n_tracks; t++)
+    {
+        MiniMidi_Lazy_view( lazy, t, 0, self->logical_size[0] );
+    }
+    return _snap_to_first_events( self );
+}
+
+int MiniMidi_TUI_attach_matches( MiniMidi_TUI *self, MiniMidi_Search_Match *matches, size_t n_matches )
+{
+    free( self->matches );
+    self->matches = matches;
+    self->n_matches = n_matches;
+
+    return _jump_to_match( self, 0 );
+}
+
+int MiniMidi_TUI_attach_watch( MiniMidi_TUI *self, MiniMidi_Watch *watch )
+{
+    MiniMidi_Watch_free( self->watch );
+    self->watch = watch;
+    return 0;
+}
+
+int MiniMidi_TUI_attach_workspace( MiniMidi_TUI *self, MiniMidi_Workspace *workspace )
+{
+    self->workspace = workspace;
+    if (!workspace) return 0;
+
+    self->tabs = (MiniMidi_TUI_Tab*)calloc( workspace->n_entries ? workspace->n_entries : 1, sizeof( MiniMidi_TUI_Tab ) );
+    return self->tabs ? 0 : 1;
+}
+
+int MiniMidi_TUI_follow( MiniMidi_TUI *self, bool follow )
+{
+    self->is_following = follow;
+    if (follow) self->is_live = true;
+    return 0;
+}
+
+int MiniMidi_TUI_update( MiniMidi_TUI *self )
+{
+    // while playing or following, don't block on getch so the screen keeps moving.
+    // a watched file is looked at a few times a second
+    bool is_moving = (self->player && MiniMidi_Player_is_playing( self->player )) || self->is_following;
+
+    // while playing or following, don't block on getch so the screen keeps moving
+    timeout( is_moving ? 30 : -1 );
+
+    // otherwise a watched file is slept on along with the keyboard. writes to other files
+    // in its directory don't come back to be drawn
+    while (!is_moving && self->watch && self->watch->fd >= 0 && !_wait_key( self ))
+    {
+        if (MiniMidi_Watch_poll( self->watch )) return _reload_now( self );
+    }
+
+    // just handle_input here?
+    _handle_input(self);
+    return _reload( self );
+}
+
+
+int MiniMidi_TUI_render( MiniMidi_TUI *self )
 {
     clear();
     _update_sizes( self );
+    _follow_track_end( self );
 
     if (_render_info( self )) return 1;
-    if (_render_note_labels( self )) return 1;
-    if (_render_grid( self )) return 1;
-    if (_render_midi( self )) return 1;
+    if (self->is_stacked)
+    {
+        if (_render_stacked( self )) return 1;
+    }
+    else
+    {
+        if (_render_note_labels( self )) return 1;
+        if (_render_grid( self )) return 1;
+        if (_render_midi( self )) return 1;
+    }
+    if (_render_track_info( self )) return 1;
+    if (_render_polyphony( self )) return 1;
+    if (_render_matches( self )) return 1;
+    if (_render_selection( self )) return 1;
+    if (_render_cursor( self )) return 1;
+    if (_render_lane( self )) return 1;
+    if (_render_playhead( self )) return 1;
+    if (_render_message( self )) return 1;
 
     box( self->grid_derwin, '|', '=' );
 
     wrefresh( stdscr );
     wrefresh( self->grid_derwin );
+
+    // while the user looks at this frame
+    _prefetch_ahead( self );
     
     return 0;
 }
@@ -477,6 +2538,36 @@ int MiniMidi_TUI_destroy( MiniMidi_TUI *self)
 {
     delwin( self->grid_derwin );
     endwin();
+    MiniMidi_Automation_free( self->automation );
+    MiniMidi_Polyphony_free( self->polyphony );
+    free( self->over );
+    free( self->matches );
+    MiniMidi_Navigation_free( self->navigation );
+    MiniMidi_Watch_free( self->watch );
+
+    for (size_t i = 0; self->tabs && i < self->workspace->n_entries; i++) free( self->tabs[i].track_flags );
+    free( self->tabs );
+
+    for (size_t t = 0; self->layers && t < self->file->n_tracks; t++)
+    {
+        free( self->layers[t].cells );
+        free( self->layers[t].left.arr );
+        free( self->layers[t].right.arr );
+    }
+    _clear_selection( self );
+    for (size_t t = 0; self->histories && t < self->file->n_tracks; t++)
+    {
+        MiniMidi_History_free( self->histories[t] );
+    }
+    free( self->selection );
+    free( self->histories );
+    free( self->edit_log );
+    free( self->prefetch_tracks );
+    free( self->layers );
+    free( self->track_flags );
+
+    // holds the file
+    MiniMidi_Workspace_free( self->workspace );
     free(self);
 
     return 0;
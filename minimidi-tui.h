@@ -7,9 +7,95 @@
 
 #include "minimidi.h"
 #include "minimidi-log.h"
+#include "minimidi-player.h"
+#include "minimidi-index.h"
+#include "minimidi-automation.h"
+#include "minimidi-polyphony.h"
+#include "minimidi-search.h"
+#include "minimidi-navigation.h"
+#include "minimidi-history.h"
+#include "minimidi-watch.h"
+#include "minimidi-workspace.h"
 
 #define DEBUG 0
 
+// per track toggles
+#define MINIMIDI_TUI_MUTE 0x01
+#define MINIMIDI_TUI_SOLO 0x02
+#define MINIMIDI_TUI_HIDE 0x04
+
+/***
+*  * Track Layers:
+*
+*   Every shown track keeps what it puts on the grid as a layer of cells:
+*   a row per note, or one when stacked, and a column per ticks_per_col,
+*   over a window three screens wide around the view. A frame
+*   composites the parts of the layers in view, in their tracks' colors
+*   and the selected one on top.
+*
+*   Panning inside the window draws nothing. Once the view leaves it, the
+*   window slides to have the view in its middle again: the cells that
+*   stay are moved over and only the strip coming in is drawn, from the
+*   notes starting in it and the ones the layer knows to sound across the
+*   edge it comes in from. Zooming, resizing or a track's events changing
+*   draw the window from scratch. Toggling a track leaves every other
+*   layer alone, and hidden tracks are neither scanned nor decoded.
+*
+*   Lazily opened files also have the next window in the direction of the
+*   last pan decoded ahead, on the lazy file's prefetch thread.
+*/
+typedef struct MiniMidi_TUI_Span
+{
+    int64_t on_ticks,
+            off_ticks;      // INT64_MAX while the note is held
+    int     row;
+
+} MiniMidi_TUI_Span;
+
+typedef struct MiniMidi_TUI_Spans
+{
+    MiniMidi_TUI_Span   *arr;
+    size_t              n,
+                        capacity;
+
+} MiniMidi_TUI_Spans;
+
+typedef struct MiniMidi_TUI_Layer
+{
+    _Byte               *cells;         // rows x cols
+    int                 rows,
+                        cols,
+                        used_first,     // rows anything was painted in, for the slides
+                        used_last;
+
+    // what the cells were drawn for, column 0 starts at start_ticks
+    int64_t             start_ticks;
+    int                 ticks_per_col;
+    bool                is_stacked,
+                        is_valid;
+    MiniMidi_Event      *event_arr;
+    size_t              n_events;
+
+    // notes sounding across the left and right edges of the window
+    MiniMidi_TUI_Spans  left,
+                        right;
+
+} MiniMidi_TUI_Layer;
+
+// where a file of the workspace was left, to come back to
+typedef struct MiniMidi_TUI_Tab
+{
+    int                 logical_start[2],
+                        ticks_per_col;
+    size_t              track_index;
+    bool                is_stacked,
+                        is_seen;
+
+    uint8_t             *track_flags;   // n_tracks of them, dropped if the file comes back with others
+    size_t              n_tracks;
+
+} MiniMidi_TUI_Tab;
+
 /***
 *  * MiniMidi State:
 * 
@@ -27,17 +113,99 @@ typedef struct MiniMidi_TUI
         move_increment;     // how many ticks are moved by a press of <- or ->
 
     bool is_dirty,
-        is_running;
+        is_running,
+        is_following;   // keep the end of a growing track in view
     
     // opened midi file
     MiniMidi_File *file;
     
-    // list with events that should be drawn to current grid
-    MiniMidi_Event_List *midi_events_list;
+    // one layer and a set of MINIMIDI_TUI_ toggles per file->tracks.
+    // <[> <]> select, <m> <s> <h> mute, solo, hide it, <H> shows all, <t> stacks them
+    MiniMidi_TUI_Layer  *layers;
+    uint8_t             *track_flags;
+    size_t              track_index,
+                        stacked_first;  // top line when stacked
+    bool                is_stacked;
 
     // derwin pointer -> Grid Area
     WINDOW *grid_derwin;
 
+    // playback, NULL when no sink was given
+    MiniMidi_Player *player;
+    uint64_t        playhead;
+
+    // big files: events are decoded for the viewport only, NULL otherwise.
+    // what the last pan is heading for is prefetched
+    MiniMidi_Lazy_File *lazy;
+    bool            *prefetch_tracks;
+    int             pan_direction;      // -1 left, 1 right
+    int64_t         prefetch_start;
+
+    // automation lane under the piano roll, <a> shows it, <A> picks the next one.
+    // built the first time it is shown
+    MiniMidi_Automation *automation;
+    size_t          lane_index;
+    int             lane_height;    // lines taken from the grid, 0 when hidden
+
+    // columns where more than voice_limit notes sound get shaded, <v> toggles it,
+    // <  > change the limit. built the first time it is shown
+    MiniMidi_Polyphony      *polyphony;
+    MiniMidi_Voice_Region   *over;
+    size_t                  n_over;
+    uint32_t                voice_limit;
+    bool                    show_polyphony;
+
+    // melodic search hits, marked above the grid. <n> / <N> jump to the next / previous
+    MiniMidi_Search_Match   *matches;
+    size_t                  n_matches,
+                            match_index;
+
+    // note onsets to jump through, built the first time one is asked for.
+    // <.> <,> next / previous note, <p> <P> next / previous at the same pitch,
+    // <g> go to a bar or time, <d> busiest bar. the cursor marks where the last jump landed
+    MiniMidi_Navigation     *navigation;
+    uint64_t                cursor_ticks;
+    _Byte                   cursor_pitch;
+    bool                    has_cursor,
+                            has_cursor_pitch;
+
+    // region edits on the notes of the shown tracks. <r> marks a corner at the cursor and
+    // selects up to it on the second press, <R> selects the view. <k> <j> transpose by a
+    // semitone, <K> <J> by an octave, <{> <}> shift a column, <x> deletes, <y> duplicates
+    // after the region, <u> <U> undo / redo. a selection is the NOTE ONs with their NOTE OFFs,
+    // sorted indices per track, resolved once and carried along by the edits
+    MiniMidi_Selection      *selection;
+    size_t                  n_selected;     // notes
+    uint64_t                anchor_ticks,
+                            select_start,
+                            select_end;     // inclusive
+    int                     anchor_pitch,   // MIDI note numbers, -1 for any
+                            select_low,
+                            select_high;
+    bool                    has_anchor,
+                            is_live;        // a capture appends to the file, it can't be edited
+
+    // a history per track, made on its first edit. the log lists the tracks each edit
+    // touched, with UINT32_MAX after each one, so <u> undoes them together
+    MiniMidi_History        **histories;
+    uint32_t                *edit_log;
+    size_t                  n_logged,
+                            n_log_applied,
+                            log_capacity;
+
+    // the file on disk, tracks that changed there are swapped in where the view is.
+    // NULL when it isn't watched
+    MiniMidi_Watch          *watch;
+
+    // several files open, one tab per file of the workspace. <tab> <shift-tab> go to the
+    // next / previous one, each comes back with its view and track toggles. NULL for one file
+    MiniMidi_Workspace      *workspace;
+    MiniMidi_TUI_Tab        *tabs;
+
+    // shown on the bottom bar for one frame, message_line for the ones put together
+    const char              *message;
+    char                    message_line[80];
+
 } MiniMidi_TUI;
 
 /***
@@ -47,6 +215,24 @@ typedef struct MiniMidi_TUI
 // init all ncurses, sizes, load file, context
 int MiniMidi_TUI_init( MiniMidi_TUI *self, MiniMidi_File *file );
 
+// hook up playback, <space> starts / stops from the left edge of the grid
+int MiniMidi_TUI_attach_player( MiniMidi_TUI *self, MiniMidi_Player *player );
+
+// the file was opened lazily, decode what is on screen before drawing it
+int MiniMidi_TUI_attach_lazy( MiniMidi_TUI *self, MiniMidi_Lazy_File *lazy );
+
+// search hits to mark and jump through, the UI owns them and starts at the first
+int MiniMidi_TUI_attach_matches( MiniMidi_TUI *self, MiniMidi_Search_Match *matches, size_t n_matches );
+
+// reload the tracks that change on disk, the UI owns the watch
+int MiniMidi_TUI_attach_watch( MiniMidi_TUI *self, MiniMidi_Watch *watch );
+
+// files to switch between, the UI owns the workspace. file, given to init, is its current one
+int MiniMidi_TUI_attach_workspace( MiniMidi_TUI *self, MiniMidi_Workspace *workspace );
+
+// for live captures: scroll along as the track grows, <f> toggles it
+int MiniMidi_TUI_follow( MiniMidi_TUI *self, bool follow );
+
 // act upon result of user intput
 //  returns:
 //      running status
@@ -0,0 +1,367 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "minimidi-watch.h"
+#include "minimidi-log.h"
+
+// an MTrk chunk of the file on disk
+typedef struct _Chunk
+{
+    size_t      start,          // of its "MTrk"
+                length;
+    uint64_t    hash;
+    bool        has_tempos;
+
+} _Chunk;
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+static inline uint64_t _mix( uint64_t x )
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ ( x >> 31 );
+}
+
+// a word at a time, tells re-exports apart, not meant to stand up to tampering
+static uint64_t _hash( const _Byte *bytes, size_t len )
+{
+    uint64_t h = len, w;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        memcpy( &w, bytes + i, 8 );
+        h = ( h ^ w ) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    for (; i < len; i++) h = ( h ^ bytes[i] ) * 0x100000001B3ULL;
+
+    return _mix( h );
+}
+
+// a set tempo is FF 51 03. the bytes turning up anywhere else only errs on the safe side
+static bool _may_have_tempos( const _Byte *bytes, size_t len )
+{
+    const _Byte *p = bytes, *end = bytes + len;
+
+    while (p + 3 <= end && ( p = (const _Byte*)memchr( p, 0xFF, end - p - 2 ) ))
+    {
+        if (p[1] == 0x51 && p[2] == 0x03) return true;
+        p++;
+    }
+    return false;
+}
+
+static _Byte *_read_all( const char *path, size_t *length )
+{
+    FILE *fileptr = fopen( path, "rb" );
+    _Byte *buffer = NULL;
+
+    if (!fileptr) return NULL;
+
+    fseek( fileptr, 0, SEEK_END );
+    *length = ftell( fileptr );
+    fseek( fileptr, 0, SEEK_SET );
+
+    buffer = (_Byte*)malloc( *length ? *length : 1 );
+    if (buffer && fread( buffer, 1, *length, fileptr ) != *length)
+    {
+        free( buffer );
+        buffer = NULL;
+    }
+    fclose( fileptr );
+
+    return buffer;
+}
+
+// the MTrk chunks of a file buffer, in file order. returns 1 when it isn't a MIDI file
+// or a chunk runs past the end, it may still be being written
+static int _scan( _Byte *buffer, size_t length, MiniMidi_Header *header, _Chunk **chunks, size_t *n_chunks )
+{
+    size_t cursor, capacity = 0;
+    uint32_t chunk_len;
+
+    *chunks = NULL;
+    *n_chunks = 0;
+
+    if (length < 14 || memcmp( buffer, "MThd", 4 ) != 0 || _midi_header_read( header, buffer ) || !header->ppqn) return 1;
+
+    for (cursor = 8 + header->length; cursor + 8 <= length; cursor += 8 + chunk_len)
+    {
+        chunk_len = ( (uint32_t)buffer[cursor + 4] << 24 ) | ( buffer[cursor + 5] << 16 ) | ( buffer[cursor + 6] << 8 ) | buffer[cursor + 7];
+        if (cursor + 8 + chunk_len > length) return 1;
+
+        if (memcmp( buffer + cursor, "MTrk", 4 ) != 0) continue;
+
+        if (*n_chunks == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            _Chunk *arr = (_Chunk*)realloc( *chunks, capacity * sizeof( _Chunk ) );
+            if (!arr) return 1;
+            *chunks = arr;
+        }
+
+        _Chunk *chunk = &((*chunks)[ (*n_chunks)++ ]);
+        chunk->start = cursor;
+        chunk->length = chunk_len;
+        chunk->hash = _hash( buffer + cursor + 8, chunk_len );
+        chunk->has_tempos = _may_have_tempos( buffer + cursor + 8, chunk_len );
+    }
+
+    return *n_chunks ? 0 : 1;
+}
+
+// per track arrays for n tracks, the old ones are only replaced when all of them are there
+static int _resize( MiniMidi_Watch *self, size_t n )
+{
+    uint64_t *hashes = (uint64_t*)calloc( n ? n : 1, sizeof( uint64_t ) );
+    size_t *lengths = (size_t*)calloc( n ? n : 1, sizeof( size_t ) );
+    bool *has_tempos = (bool*)calloc( n ? n : 1, sizeof( bool ) ),
+         *changed = (bool*)calloc( n ? n : 1, sizeof( bool ) );
+
+    if (!hashes || !lengths || !has_tempos || !changed)
+    {
+        free( hashes );
+        free( lengths );
+        free( has_tempos );
+        free( changed );
+        return 1;
+    }
+
+    free( self->hashes );
+    free( self->lengths );
+    free( self->has_tempos );
+    free( self->changed );
+
+    self->hashes = hashes;
+    self->lengths = lengths;
+    self->has_tempos = has_tempos;
+    self->changed = changed;
+    return 0;
+}
+
+static void _remember( MiniMidi_Watch *self, size_t t, const _Chunk *chunk )
+{
+    self->hashes[t] = chunk->hash;
+    self->lengths[t] = chunk->length;
+    self->has_tempos[t] = chunk->has_tempos;
+}
+
+static bool _is_same( MiniMidi_Watch *self, size_t t, const _Chunk *chunk )
+{
+    return self->lengths[t] == chunk->length && self->hashes[t] == chunk->hash;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Watch *MiniMidi_Watch_init( MiniMidi_File *file, const MiniMidi_Filter *filter )
+{
+    MiniMidi_Watch *self = (MiniMidi_Watch*)calloc( 1, sizeof( MiniMidi_Watch ) );
+    MiniMidi_Header header;
+    _Chunk *chunks = NULL;
+    _Byte *buffer;
+    size_t length, n_chunks = 0;
+
+    if (!self) return NULL;
+
+    self->file = file;
+    self->fd = -1;
+    self->wd = -1;
+    if (filter)
+    {
+        self->filter = *filter;
+        self->has_filter = true;
+    }
+
+    // the directory, saving by rename swaps the file's inode
+    const char *slash = strrchr( file->filepath, '/' );
+    char *dir = slash ? strndup( file->filepath, slash == file->filepath ? 1 : (size_t)( slash - file->filepath ) ) : strdup( "." );
+
+    self->name = strdup( slash ? slash + 1 : file->filepath );
+    self->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if (dir && self->fd >= 0) self->wd = inotify_add_watch( self->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO );
+    free( dir );
+
+    if (!self->name || self->wd < 0 || _resize( self, file->n_tracks )) goto fail;
+
+    // what the tracks were decoded from. if the file moved on since, they all count as changed
+    buffer = _read_all( file->filepath, &length );
+    if (buffer && !_scan( buffer, length, &header, &chunks, &n_chunks ) && n_chunks == file->n_tracks)
+    {
+        for (size_t t = 0; t < n_chunks; t++) _remember( self, t, &chunks[t] );
+    }
+    else
+    {
+        for (size_t t = 0; t < file->n_tracks; t++) self->has_tempos[t] = true;
+    }
+    free( chunks );
+    free( buffer );
+
+    return self;
+
+fail:
+    MiniMidi_Watch_free( self );
+    return NULL;
+}
+
+void MiniMidi_Watch_free( MiniMidi_Watch *self )
+{
+    if (!self) return;
+
+    if (self->fd >= 0) close( self->fd );
+    free( self->name );
+    free( self->hashes );
+    free( self->lengths );
+    free( self->has_tempos );
+    free( self->changed );
+    free( self );
+}
+
+bool MiniMidi_Watch_poll( MiniMidi_Watch *self )
+{
+    char buf[4096] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    const struct inotify_event *evt;
+    bool is_changed = false;
+    ssize_t n;
+
+    // drain it all, a save is often several writes
+    while ((n = read( self->fd, buf, sizeof( buf ) )) > 0)
+    {
+        for (char *p = buf; p < buf + n; p += sizeof( struct inotify_event ) + evt->len)
+        {
+            evt = (const struct inotify_event*)p;
+            if (evt->len && !strcmp( evt->name, self->name )) is_changed = true;
+        }
+    }
+    return is_changed;
+}
+
+int MiniMidi_Watch_reload( MiniMidi_Watch *self )
+{
+    MiniMidi_File *file = self->file;
+    const MiniMidi_Filter *filter = self->has_filter ? &(self->filter) : NULL;
+    MiniMidi_Header header;
+    MiniMidi_Track *decoded = NULL;
+    _Chunk *chunks = NULL;
+    size_t *from = NULL, length, n = 0, n_old = file->n_tracks;
+    bool *is_taken = NULL, refold = false;
+    int err = 1;
+
+    self->n_decoded = 0;
+
+    _Byte *buffer = _read_all( file->filepath, &length );
+    if (!buffer || _scan( buffer, length, &header, &chunks, &n )) goto done;
+
+    decoded = (MiniMidi_Track*)calloc( n, sizeof( MiniMidi_Track ) );
+    from = (size_t*)malloc( n * sizeof( size_t ) );
+    is_taken = (bool*)calloc( n_old ? n_old : 1, sizeof( bool ) );
+    if (!decoded || !from || !is_taken) goto done;
+
+    // the same chunk at the same place, then anywhere
+    for (size_t t = 0; t < n; t++)
+    {
+        from[t] = SIZE_MAX;
+        if (t < n_old && _is_same( self, t, &chunks[t] ))
+        {
+            from[t] = t;
+            is_taken[t] = true;
+        }
+    }
+    for (size_t t = 0; t < n; t++)
+    {
+        for (size_t i = 0; from[t] == SIZE_MAX && i < n_old; i++)
+        {
+            if (is_taken[i] || !_is_same( self, i, &chunks[t] )) continue;
+
+            from[t] = i;
+            is_taken[i] = true;
+        }
+    }
+
+    // the first track holds every tempo change. when one comes or goes, or the first
+    // track isn't the one it was, they are all read again and folded in afresh
+    refold = from[0] != 0;
+    for (size_t t = 0; t < n; t++) refold = refold || ( from[t] == SIZE_MAX && chunks[t].has_tempos );
+    for (size_t i = 0; i < n_old; i++) refold = refold || ( !is_taken[i] && self->has_tempos[i] );
+
+    for (size_t t = 0; t < n; t++)
+    {
+        if (refold && ( t == 0 || from[t] == 0 || chunks[t].has_tempos )) from[t] = SIZE_MAX;
+        if (from[t] != SIZE_MAX) continue;
+
+        if (MiniMidi_Track_read( &(decoded[t]), buffer, chunks[t].start, length, filter )) goto done;
+        self->n_decoded++;
+    }
+
+    // the per track arrays first, swapping can't be undone
+    uint64_t *old_hashes = self->hashes;
+    size_t *old_lengths = self->lengths;
+    bool *old_has_tempos = self->has_tempos,
+         *old_changed = self->changed;
+
+    self->hashes = NULL;
+    self->lengths = NULL;
+    self->has_tempos = NULL;
+    self->changed = NULL;
+
+    if (_resize( self, n ) || MiniMidi_File_swap_tracks( file, &header, length, decoded, from, n ))
+    {
+        free( self->hashes );
+        free( self->lengths );
+        free( self->has_tempos );
+        free( self->changed );
+
+        self->hashes = old_hashes;
+        self->lengths = old_lengths;
+        self->has_tempos = old_has_tempos;
+        self->changed = old_changed;
+        goto done;
+    }
+    free( old_hashes );
+    free( old_lengths );
+    free( old_has_tempos );
+    free( old_changed );
+
+    for (size_t t = 0; t < n; t++)
+    {
+        _remember( self, t, &chunks[t] );
+        self->changed[t] = from[t] != t;
+    }
+    err = 0;
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-watch.c > MiniMidi_Watch_reload() : %s, decoded %zu of %zu tracks%s",
+        file->filepath, self->n_decoded, n, refold ? ", tempo map folded again" : "" );
+    MiniMidi_Log_writeline();
+
+done:
+    // what was decoded belongs to the file now, unless something failed
+    for (size_t t = 0; err && decoded && from && t < n; t++)
+    {
+        if (from[t] != SIZE_MAX) continue;
+
+        MiniMidi_Track_release( &(decoded[t]) );
+        free( decoded[t].tempo_arr );
+    }
+    free( decoded );
+    free( from );
+    free( is_taken );
+    free( chunks );
+    free( buffer );
+
+    return err;
+}
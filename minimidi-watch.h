@@ -0,0 +1,57 @@
+#ifndef MINIMIDI_WATCH_H
+#define MINIMIDI_WATCH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "minimidi.h"
+
+/***
+*  * Watching a file:
+*
+*   inotify on the file's directory, so saves that write a new file and
+*   rename it over the old one are seen too. A burst of writes reads as
+*   one change.
+*
+*   Every MTrk chunk is remembered by its length and a hash of its bytes.
+*   A reload reads the file again and hashes the chunks: a track whose
+*   chunk is still there, at the same place or another, keeps its events,
+*   edits included. Only the others are decoded, and all of them are
+*   swapped into the file at once, when nothing failed. A file that is
+*   cut short is taken for one still being written and left for the next
+*   change.
+*/
+typedef struct MiniMidi_Watch
+{
+    MiniMidi_File   *file;
+    MiniMidi_Filter filter;
+    bool            has_filter;
+
+    int             fd,             // inotify, non blocking
+                    wd;
+    char            *name;          // file name inside the watched directory
+
+    // per track, of the chunk it was decoded from
+    uint64_t        *hashes;
+    size_t          *lengths;
+    bool            *has_tempos;    // might hold tempo changes
+
+    // per track, after a reload: not the events it had before
+    bool            *changed;
+    size_t          n_decoded;      // by the last reload
+
+} MiniMidi_Watch;
+
+// filter, when not NULL, is what the file was read with. NULL if inotify isn't there
+MiniMidi_Watch  *MiniMidi_Watch_init( MiniMidi_File *file, const MiniMidi_Filter *filter );
+void            MiniMidi_Watch_free( MiniMidi_Watch *self );
+
+// written since the last call? never blocks
+bool MiniMidi_Watch_poll( MiniMidi_Watch *self );
+
+// read the file again, decoding only the tracks that changed. returns 0 on success,
+// the file is left as it was otherwise
+int MiniMidi_Watch_reload( MiniMidi_Watch *self );
+
+#endif /* MINIMIDI_WATCH_H */
@@ -0,0 +1,264 @@
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "minimidi-workspace.h"
+#include "minimidi-log.h"
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Helpers
+****************************************************************************************/
+static void _close( MiniMidi_Workspace_Entry *entry )
+{
+    MiniMidi_File_free( entry->file );
+    MiniMidi_Packed_File_free( entry->packed );
+
+    entry->file = NULL;
+    entry->packed = NULL;
+    entry->bytes = 0;
+    entry->state = MINIMIDI_WORKSPACE_CLOSED;
+}
+
+static int _pack( MiniMidi_Workspace_Entry *entry )
+{
+    MiniMidi_Packed_File *packed = MiniMidi_Packed_File_init( entry->file );
+    if (!packed) return 1;
+
+    MiniMidi_File_free( entry->file );
+    entry->file = NULL;
+    entry->packed = packed;
+    entry->bytes = MiniMidi_Packed_File_bytes( packed );
+    entry->state = MINIMIDI_WORKSPACE_PACKED;
+
+    return 0;
+}
+
+// least recently used in state, not the current one. edited files are never closed
+static MiniMidi_Workspace_Entry *_least_recent( MiniMidi_Workspace *self, MiniMidi_Workspace_State state )
+{
+    MiniMidi_Workspace_Entry *found = NULL;
+
+    for (size_t i = 0; i < self->n_entries; i++)
+    {
+        MiniMidi_Workspace_Entry *entry = &(self->entries[i]);
+
+        if (i == self->current || entry->state != state) continue;
+        if (state == MINIMIDI_WORKSPACE_PACKED && entry->is_edited) continue;
+
+        if (!found || entry->last_used < found->last_used) found = entry;
+    }
+    return found;
+}
+
+// parsed files are packed, oldest first, then packed ones closed until it all fits
+static void _fit( MiniMidi_Workspace *self )
+{
+    MiniMidi_Workspace_Entry *entry;
+    size_t used = MiniMidi_Workspace_bytes( self ),
+           n_packed = 0,
+           n_closed = 0;
+
+    while (used > self->budget && (entry = _least_recent( self, MINIMIDI_WORKSPACE_PARSED )))
+    {
+        used -= entry->bytes;
+        if (_pack( entry ))
+        {
+            // out of memory, an edited file has nowhere else to go
+            if (entry->is_edited) return;
+            _close( entry );
+            n_closed++;
+        }
+        else
+        {
+            n_packed++;
+        }
+        used += entry->bytes;
+    }
+
+    while (used > self->budget && (entry = _least_recent( self, MINIMIDI_WORKSPACE_PACKED )))
+    {
+        used -= entry->bytes;
+        _close( entry );
+        n_closed++;
+    }
+
+    if (n_packed || n_closed)
+    {
+        sprintf( MiniMidi_Log_log_line, "minimidi-workspace.c > _fit() : packed %zu, closed %zu, %zu of %zu bytes used",
+            n_packed, n_closed, used, self->budget );
+        MiniMidi_Log_writeline();
+    }
+}
+
+static bool _same_time( const struct timespec *a, const struct timespec *b )
+{
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Public
+****************************************************************************************/
+MiniMidi_Workspace *MiniMidi_Workspace_init( size_t budget, const MiniMidi_Filter *filter, bool strict )
+{
+    MiniMidi_Workspace *self = (MiniMidi_Workspace*)calloc( 1, sizeof( MiniMidi_Workspace ) );
+    if (!self) return NULL;
+
+    self->budget = budget ? budget : MINIMIDI_WORKSPACE_DEFAULT_BUDGET;
+    self->strict = strict;
+    if (filter)
+    {
+        self->filter = *filter;
+        self->has_filter = true;
+    }
+
+    return self;
+}
+
+void MiniMidi_Workspace_free( MiniMidi_Workspace *self )
+{
+    if (!self) return;
+
+    for (size_t i = 0; i < self->n_entries; i++)
+    {
+        _close( &(self->entries[i]) );
+        free( self->entries[i].path );
+    }
+    free( self->entries );
+    free( self );
+}
+
+int MiniMidi_Workspace_add( MiniMidi_Workspace *self, const char *path )
+{
+    if (self->n_entries == self->capacity)
+    {
+        size_t capacity = self->capacity ? self->capacity * 2 : 16;
+        MiniMidi_Workspace_Entry *arr = (MiniMidi_Workspace_Entry*)realloc( self->entries, capacity * sizeof( MiniMidi_Workspace_Entry ) );
+        if (!arr) return 1;
+
+        self->entries = arr;
+        self->capacity = capacity;
+    }
+
+    MiniMidi_Workspace_Entry *entry = &(self->entries[ self->n_entries ]);
+    memset( entry, 0, sizeof( MiniMidi_Workspace_Entry ) );
+
+    entry->path = strdup( path );
+    if (!entry->path) return 1;
+
+    // nothing open yet stays nothing open
+    if (self->current == self->n_entries) self->current++;
+    self->n_entries++;
+
+    return 0;
+}
+
+MiniMidi_File *MiniMidi_Workspace_open( MiniMidi_Workspace *self, size_t index )
+{
+    MiniMidi_Workspace_Entry *entry;
+    MiniMidi_File *file = NULL;
+    struct stat st;
+    const char *how = "kept";
+
+    if (index >= self->n_entries) return NULL;
+
+    entry = &(self->entries[index]);
+    entry->last_used = ++self->clock;
+    self->error.status = MINIMIDI_PARSE_OK;
+    self->is_kept_stale = false;
+
+    if (index == self->current) return entry->file;
+
+    // a file that can't be looked at any more still shows what was kept of it
+    bool is_stale = entry->state != MINIMIDI_WORKSPACE_CLOSED
+        && stat( entry->path, &st ) == 0 && !_same_time( &(st.st_mtim), &(entry->mtime) );
+
+    // reading it again would throw the edits away, those are opened instead
+    if (is_stale && entry->is_edited)
+    {
+        is_stale = false;
+        self->is_kept_stale = true;
+    }
+
+    if (entry->state == MINIMIDI_WORKSPACE_PARSED && !is_stale)
+    {
+        file = entry->file;
+    }
+    else if (entry->state == MINIMIDI_WORKSPACE_PACKED && !is_stale)
+    {
+        file = MiniMidi_Packed_File_unpack( entry->packed );
+        if (file)
+        {
+            self->n_unpacks++;
+            how = "unpacked";
+        }
+    }
+
+    if (!file)
+    {
+        // taken first, a write while reading makes it stale rather than missed
+        bool has_time = stat( entry->path, &st ) == 0;
+
+        file = MiniMidi_File_init_checked( entry->path, self->has_filter ? &(self->filter) : NULL, !self->strict, &(self->error) );
+        if (!file) return NULL;
+
+        self->n_reads++;
+        how = is_stale ? "read again, it changed on disk" : "read";
+        entry->is_edited = false;
+        if (has_time) entry->mtime = st.st_mtim;
+    }
+
+    if (file != entry->file)
+    {
+        _close( entry );
+        entry->file = file;
+    }
+    entry->state = MINIMIDI_WORKSPACE_PARSED;
+    entry->bytes = MiniMidi_File_bytes( file );
+
+    // edits may have grown the one being left
+    if (self->current < self->n_entries)
+    {
+        MiniMidi_Workspace_Entry *left = &(self->entries[ self->current ]);
+        left->bytes = MiniMidi_File_bytes( left->file );
+    }
+    self->current = index;
+
+    _fit( self );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-workspace.c > MiniMidi_Workspace_open() : %s, %s%s, %zu bytes kept",
+        entry->path, how, self->is_kept_stale ? ", edits kept over a change on disk" : "", MiniMidi_Workspace_bytes( self ) );
+    MiniMidi_Log_writeline();
+
+    return file;
+}
+
+void MiniMidi_Workspace_edited( MiniMidi_Workspace *self )
+{
+    if (self->current < self->n_entries) self->entries[ self->current ].is_edited = true;
+}
+
+void MiniMidi_Workspace_stamp( MiniMidi_Workspace *self )
+{
+    struct stat st;
+
+    if (self->current < self->n_entries && stat( self->entries[ self->current ].path, &st ) == 0)
+    {
+        self->entries[ self->current ].mtime = st.st_mtim;
+    }
+}
+
+size_t MiniMidi_Workspace_bytes( MiniMidi_Workspace *self )
+{
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < self->n_entries; i++) bytes += self->entries[i].bytes;
+    return bytes;
+}
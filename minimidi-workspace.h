@@ -0,0 +1,100 @@
+#ifndef MINIMIDI_WORKSPACE_H
+#define MINIMIDI_WORKSPACE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "minimidi.h"
+#include "minimidi-packed.h"
+
+// what the files kept around may take, parsed and packed ones alike
+#define MINIMIDI_WORKSPACE_DEFAULT_BUDGET ( 256 * 1024 * 1024 )
+
+/***
+*  * Workspace:
+*
+*   Many files open at once, one of them current. A file is kept parsed,
+*   packed ( see Packed Tracks, a few bytes an event ) or not at all, in
+*   which case only its path is, and it is read from disk the next time it
+*   is opened. Nothing is read before a file is opened the first time.
+*
+*   Every file kept counts against budget bytes. When over, the least
+*   recently used parsed files are packed first, then the least recently
+*   used packed ones let go of. The current file is always parsed, and is
+*   left out of it, so one file bigger than the budget still opens.
+*
+*   Opening a packed file unpacks it, no parsing; that is what makes going
+*   back and forth between a few dozen takes cheap. A file whose
+*   modification time moved on since it was read is read again, whatever
+*   is kept of it, unless it was edited: the edits are opened instead and
+*   the open says so, for the UI to tell. A file that was edited is never
+*   let go of, its packed copy holds the edits.
+*/
+typedef enum MiniMidi_Workspace_State
+{
+    MINIMIDI_WORKSPACE_CLOSED,      // only the path
+    MINIMIDI_WORKSPACE_PACKED,
+    MINIMIDI_WORKSPACE_PARSED
+
+} MiniMidi_Workspace_State;
+
+typedef struct MiniMidi_Workspace_Entry
+{
+    char                        *path;
+    MiniMidi_Workspace_State    state;
+
+    MiniMidi_File               *file;      // when parsed
+    MiniMidi_Packed_File        *packed;    // when packed
+    size_t                      bytes;      // of what is kept, as of the last time it was looked at
+
+    struct timespec             mtime;      // of the file on disk it was read from
+    uint64_t                    last_used;
+    bool                        is_edited;
+
+} MiniMidi_Workspace_Entry;
+
+typedef struct MiniMidi_Workspace
+{
+    MiniMidi_Workspace_Entry    *entries;
+    size_t                      n_entries,
+                                capacity,
+                                current;        // n_entries while nothing is open
+
+    size_t                      budget;
+    uint64_t                    clock;
+
+    MiniMidi_Filter             filter;
+    bool                        has_filter,
+                                strict;         // refuse damaged files
+
+    // of the last open, for the UI to tell
+    MiniMidi_Parse_Error        error;
+    size_t                      n_reads,        // from disk
+                                n_unpacks;
+    bool                        is_kept_stale;  // changed on disk, but the edits were opened
+
+} MiniMidi_Workspace;
+
+// budget 0 for MINIMIDI_WORKSPACE_DEFAULT_BUDGET, filter NULL to read every event
+MiniMidi_Workspace  *MiniMidi_Workspace_init( size_t budget, const MiniMidi_Filter *filter, bool strict );
+void                MiniMidi_Workspace_free( MiniMidi_Workspace *self );
+
+// a file to open later, nothing is read. returns 0 on success
+int MiniMidi_Workspace_add( MiniMidi_Workspace *self, const char *path );
+
+// make entry index the current file, parsed, and fit the others in the budget. NULL if it
+// can't be read, the current file stays what it was then. the file is the workspace's
+MiniMidi_File *MiniMidi_Workspace_open( MiniMidi_Workspace *self, size_t index );
+
+// the current file had its events changed, keep them
+void MiniMidi_Workspace_edited( MiniMidi_Workspace *self );
+
+// the current file was brought up to date with the one on disk
+void MiniMidi_Workspace_stamp( MiniMidi_Workspace *self );
+
+// bytes of everything kept
+size_t MiniMidi_Workspace_bytes( MiniMidi_Workspace *self );
+
+#endif /* MINIMIDI_WORKSPACE_H */
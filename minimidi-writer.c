@@ -0,0 +1,256 @@
+#include <string.h>
+
+#include "minimidi-writer.h"
+#include "minimidi-log.h"
+
+uint8_t _get_midi_data_byte_count( MidiStatusCode status );
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Byte Buffer
+****************************************************************************************/
+static int _reserve( MiniMidi_Writer *self, size_t n )
+{
+    if (self->n_buf + n <= self->capacity) return 0;
+
+    size_t new_cap = self->capacity ? self->capacity : 4096;
+    while (new_cap < self->n_buf + n) new_cap *= 2;
+
+    _Byte *buf = (_Byte*)realloc( self->buf, new_cap );
+    if (!buf) return 1;
+
+    self->buf = buf;
+    self->capacity = new_cap;
+    return 0;
+}
+
+static inline void _put_vlq( MiniMidi_Writer *self, uint64_t v )
+{
+    _Byte tmp[10];
+    int n = 0;
+
+    do
+    {
+        tmp[n++] = v & 0x7F;
+        v >>= 7;
+    } while (v);
+
+    while (n--) self->buf[ self->n_buf++ ] = tmp[n] | ( n ? 0x80 : 0 );
+}
+
+// a delta is four VLQ bytes at most. longer gaps are bridged by empty text events, which
+// cancel running status. makes room for them and n_after bytes of the event that follows
+static int _put_delta( MiniMidi_Writer *self, uint64_t delta, _Byte *running, size_t n_after )
+{
+    uint64_t n_bridges = delta ? ( delta - 1 ) / MINIMIDI_WRITER_MAX_DELTA : 0;
+
+    if (_reserve( self, n_bridges * 7 + 4 + n_after )) return 1;
+
+    while (delta > MINIMIDI_WRITER_MAX_DELTA)
+    {
+        _put_vlq( self, MINIMIDI_WRITER_MAX_DELTA );
+        self->buf[ self->n_buf++ ] = 0xFF;
+        self->buf[ self->n_buf++ ] = 0x01;
+        self->buf[ self->n_buf++ ] = 0x00;
+
+        delta -= MINIMIDI_WRITER_MAX_DELTA;
+        *running = 0;
+    }
+    _put_vlq( self, delta );
+
+    return 0;
+}
+
+static inline void _put_be( _Byte *dst, uint32_t v, int width )
+{
+    for (int i = 0; i < width; i++) dst[i] = v >> ( 8 * ( width - 1 - i ) );
+}
+
+// the bytes a SysEx / Meta event had after its status byte, NULL when the track doesn't
+// have them. n is how many
+static const _Byte *_payload( MiniMidi_Track *track, MiniMidi_Event *e, size_t *n )
+{
+    const _Byte *p, *data;
+    uint64_t len = 0;
+    _Byte b;
+
+    if (!e->payload || e->payload > track->n_payload_bytes) return NULL;
+
+    data = p = track->payload_arr + e->payload - 1;
+    if (e->channel == 0x0F) p++;    // meta type
+
+    // the parser only kept whole events, the length is followed by that many bytes
+    do {
+        b = *p++;
+        len = ( len << 7 ) | ( b & 0x7F );
+    } while (b & 0x80);
+
+    *n = (size_t)( p - data ) + len;
+    return e->payload - 1 + *n <= track->n_payload_bytes ? data : NULL;
+}
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Writer
+****************************************************************************************/
+MiniMidi_Writer *MiniMidi_Writer_open( const char *path, uint16_t format, uint16_t n_tracks, uint16_t ppqn )
+{
+    _Byte header[14] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6 };
+    MiniMidi_Writer *self = (MiniMidi_Writer*)calloc( 1, sizeof( MiniMidi_Writer ) );
+    if (!self) return NULL;
+
+    self->out = fopen( path, "wb" );
+    if (!self->out)
+    {
+        free( self );
+        return NULL;
+    }
+    self->n_tracks = n_tracks;
+
+    // format 0 is a single track, more than one can only go out as format 1
+    if (format == 0 && n_tracks > 1) format = 1;
+
+    _put_be( header + 8, format, 2 );
+    _put_be( header + 10, n_tracks, 2 );
+    _put_be( header + 12, ppqn, 2 );
+    fwrite( header, 1, sizeof( header ), self->out );
+
+    return self;
+}
+
+int MiniMidi_Writer_track( MiniMidi_Writer *self, MiniMidi_Track *track, MiniMidi_Tempo *tempos, size_t n_tempos )
+{
+    uint64_t last_ticks = 0;
+    _Byte running = 0;
+    size_t t = 0;
+
+    // chunk header, 4 bytes of delta + 3 per event and + 6 per tempo, end of track. only a
+    // hint, every event makes sure of its own room
+    self->n_buf = 0;
+    if (_reserve( self, 8 + track->n_events * 7 + n_tempos * 10 + 7 )) return 1;
+
+    memcpy( self->buf, "MTrk", 4 );
+    self->n_buf = 8;
+
+    for (size_t i = 0; i <= track->n_events; i++)
+    {
+        MiniMidi_Event *e = i < track->n_events ? &(track->event_arr[i]) : NULL;
+
+        // tempo changes go before the events on the same tick
+        while (t < n_tempos && ( !e || tempos[t].abs_ticks <= e->abs_ticks ))
+        {
+            if (_put_delta( self, tempos[t].abs_ticks - last_ticks, &running, 6 )) return 1;
+            self->buf[ self->n_buf++ ] = 0xFF;
+            self->buf[ self->n_buf++ ] = 0x51;
+            self->buf[ self->n_buf++ ] = 0x03;
+            _put_be( self->buf + self->n_buf, tempos[t].usec_per_beat, 3 );
+            self->n_buf += 3;
+
+            last_ticks = tempos[t++].abs_ticks;
+            running = 0;    // meta events cancel running status
+        }
+
+        if (!e || e->status_code == MIDI_INVALID) continue;
+
+        if (e->status_code == MIDI_SYSTEM)
+        {
+            _Byte status = MIDI_SYSTEM | e->channel;
+            size_t n = 0;
+            const _Byte *payload = _payload( track, e, &n );
+
+            // tempo changes came from the map, end of track goes last
+            if (status == 0xFF && ( e->evt_data[0] == MIDI_META_TEMPO || e->evt_data[0] == MIDI_META_END_OF_TRACK )) continue;
+
+            // a SysEx has nothing to say without its bytes, a meta event goes out empty
+            if (!payload && status != 0xFF) continue;
+
+            if (_put_delta( self, e->abs_ticks - last_ticks, &running, payload ? 1 + n : 3 )) return 1;
+            self->buf[ self->n_buf++ ] = status;
+            if (payload)
+            {
+                memcpy( self->buf + self->n_buf, payload, n );
+                self->n_buf += n;
+            } else {
+                self->buf[ self->n_buf++ ] = e->evt_data[0];
+                self->buf[ self->n_buf++ ] = 0x00;
+            }
+
+            last_ticks = e->abs_ticks;
+            running = 0;
+            continue;
+        }
+
+        _Byte status = e->status_code | ( e->channel & 0x0F );
+
+        if (_put_delta( self, e->abs_ticks - last_ticks, &running, 3 )) return 1;
+        if (status != running) self->buf[ self->n_buf++ ] = status;
+        running = status;
+
+        self->buf[ self->n_buf++ ] = e->evt_data[0] & 0x7F;
+        if (_get_midi_data_byte_count( e->status_code ) == 2) self->buf[ self->n_buf++ ] = e->evt_data[1] & 0x7F;
+
+        last_ticks = e->abs_ticks;
+    }
+
+    // end of track, where the last event was
+    if (_put_delta( self, ( track->total_ticks > last_ticks ? track->total_ticks : last_ticks ) - last_ticks, &running, 3 )) return 1;
+    self->buf[ self->n_buf++ ] = 0xFF;
+    self->buf[ self->n_buf++ ] = 0x2F;
+    self->buf[ self->n_buf++ ] = 0x00;
+
+    _put_be( self->buf + 4, self->n_buf - 8, 4 );
+    fwrite( self->buf, 1, self->n_buf, self->out );
+    self->n_written++;
+
+    return ferror( self->out );
+}
+
+int MiniMidi_Writer_close( MiniMidi_Writer *self )
+{
+    int err = 0;
+
+    if (!self) return 1;
+
+    if (self->n_written != self->n_tracks)
+    {
+        _Byte ntrks[2];
+        _put_be( ntrks, self->n_written, 2 );
+
+        err |= fseek( self->out, 10, SEEK_SET ) != 0;
+        fwrite( ntrks, 1, 2, self->out );
+    }
+
+    err |= ferror( self->out ) | fclose( self->out );
+    free( self->buf );
+    free( self );
+
+    return err;
+}
+
+int MiniMidi_File_write( MiniMidi_File *file, const char *path )
+{
+    MiniMidi_Writer *w = MiniMidi_Writer_open( path, file->header->format, file->n_tracks, file->header->ppqn );
+    int err = 0;
+
+    if (!w) return 1;
+
+    for (size_t t = 0; t < file->n_tracks && !err; t++)
+    {
+        err = t ? MiniMidi_Writer_track( w, &(file->tracks[t]), NULL, 0 )
+                : MiniMidi_Writer_track( w, file->track, file->track->tempo_arr, file->track->n_tempos );
+    }
+
+    err |= MiniMidi_Writer_close( w );
+
+    sprintf( MiniMidi_Log_log_line, "minimidi-writer.c > MiniMidi_File_write() : %s, %zu tracks%s",
+        path, file->n_tracks, err ? ", failed" : "" );
+    MiniMidi_Log_writeline();
+
+    return err;
+}
@@ -0,0 +1,50 @@
+#ifndef MINIMIDI_WRITER_H
+#define MINIMIDI_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "minimidi.h"
+
+// the longest delta an SMF reader has to take
+#define MINIMIDI_WRITER_MAX_DELTA 0x0FFFFFFF
+
+/***
+*  * SMF Writer:
+*
+*   Writes a Standard MIDI File one track at a time, so a track can be freed
+*   as soon as it is out. Channel events are written with running status.
+*   Meta / SysEx events go back as the parser read them, from the track's
+*   payload bytes. Tempo changes are the exception: the tempo map has those
+*   of every track, it is written into the first track and the tempo events
+*   themselves are skipped. End of track is written once, at the end.
+*
+*   A delta can't go past MINIMIDI_WRITER_MAX_DELTA, four VLQ bytes. Longer
+*   gaps, a stretch can make them, are bridged with empty text events.
+*/
+typedef struct MiniMidi_Writer
+{
+    FILE        *out;
+    uint16_t    n_tracks,       // announced in MThd
+                n_written;
+
+    _Byte       *buf;           // the current MTrk, its length goes first
+    size_t      n_buf,
+                capacity;
+
+} MiniMidi_Writer;
+
+// NULL if path can't be written. format 0 with more than one track is written as format 1
+MiniMidi_Writer *MiniMidi_Writer_open( const char *path, uint16_t format, uint16_t n_tracks, uint16_t ppqn );
+
+// append track. tempos go in with the events, pass NULL / 0 for the other tracks
+int MiniMidi_Writer_track( MiniMidi_Writer *self, MiniMidi_Track *track, MiniMidi_Tempo *tempos, size_t n_tempos );
+
+// fixes up the track count if fewer were written. returns nonzero if anything failed to write
+int MiniMidi_Writer_close( MiniMidi_Writer *self );
+
+// the whole file in one go
+int MiniMidi_File_write( MiniMidi_File *file, const char *path );
+
+#endif /* MINIMIDI_WRITER_H */
@@ -4,6 +4,7 @@
 #include <unistd.h>
 
 #include "minimidi.h"
+#include "minimidi-parallel.h"
 
 #define DEBUG 0
 
@@ -309,241 +310,1315 @@ size_t _read_VLQ_delta_t( _Byte *bytes, size_t len, uint64_t *val_ptr)
 
 
 
+// skims run over every byte of a file, keep this out of function calls
+static inline size_t _vlq( const _Byte *bytes, size_t len, uint64_t *val )
+{
+    size_t i = 0;
+    uint64_t v = 0;
+
+    while (i < len && i < 4)
+    {
+        _Byte b = bytes[i++];
+        v = ( v << 7 ) | ( b & 0x7F );
+        if (!( b & 0x80 )) break;
+    }
+    *val = v;
+    return i;
+}
+
+// one event at *offset, same rules as _parse_track_events but nothing is recorded
+// on the track. returns nonzero at the end of the data or on anything that can't
+// be decoded, leaving the state untouched
+int _decode_event( _Byte *data, size_t len, size_t *offset, _Byte *status, uint64_t *ticks, MiniMidi_Event *evt )
+{
+    size_t i = *offset;
+    uint64_t delta, payload;
+    _Byte s, running = *status;
+
+    if (i >= len) return 1;
+    i += _vlq( data + i, len - i, &delta );
+    if (i >= len) return 1;
+
+    s = data[i];
+    if (s & 0x80)
+    {
+        i++;
+        // system messages don't take part in running status
+        if (s < 0xF0) running = s;
+    }
+    else if (running)
+    {
+        s = running;
+    }
+    else
+    {
+        return 1;
+    }
+
+    evt->delta_ticks = delta;
+    evt->abs_ticks = *ticks + delta;
+    evt->status_code = (MidiStatusCode)( s & 0xF0 );   // s has its high bit set
+    evt->channel = s & 0x0F;
+    evt->evt_data[0] = 0;
+    evt->evt_data[1] = 0;
+    evt->next = NULL;
+    evt->prev = NULL;
+
+    if (evt->status_code == MIDI_SYSTEM)
+    {
+        if (evt->channel == 0x0F)
+        {
+            if (i >= len) return 1;
+            evt->evt_data[0] = data[i++]; // meta type
+        }
+        if (i >= len) return 1;
+
+        i += _vlq( data + i, len - i, &payload );
+        if (payload > len - i) return 1;
+        i += payload;
+    }
+    else
+    {
+        uint8_t n = ( evt->status_code == MIDI_PROGRAM_CHANGE || evt->status_code == MIDI_CHAN_AFTERTOUCH ) ? 1 : 2;
+        if (i + n > len) return 1;
+
+        for (uint8_t b = 0; b < n; b++) evt->evt_data[b] = data[i + b];
+        i += n;
+
+        // NOTE ON with zero velocity is a NOTE OFF in disguise
+        if (evt->status_code == MIDI_NOTE_ON && evt->evt_data[1] == 0)
+        {
+            evt->status_code = MIDI_NOTE_OFF;
+        }
+        if (evt->status_code == MIDI_NOTE_ON || evt->status_code == MIDI_NOTE_OFF)
+        {
+            evt->note = _event_data_bytes_to_note( evt->evt_data[0] );
+        }
+    }
+
+    *offset = i;
+    *status = running;
+    *ticks = evt->abs_ticks;
+
+    return 0;
+}
+
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Validation
+****************************************************************************************/
+// what the walk found out about a track chunk, all the decoder goes by
+typedef struct _Track_Shape
+{
+    size_t  start,          // of the events, in the file
+            length,         // of the chunk, or what the file has of it
+            valid_length;   // whole events from start
+    size_t  n_events,
+            n_tempos,
+            n_payload_bytes;    // SysEx / Meta, after the status byte
+    long    n_cores;        // more than one: the parallel decoder takes it
+
+} _Track_Shape;
+
+static const char *_PARSE_STATUS_STR[] = {
+    "ok",
+    "can't be read",
+    "no MThd header or a zero ppqn",
+    "no MTrk chunks",
+    "chunk runs past the end of the file",
+    "VLQ longer than four bytes",
+    "data bytes without a status byte",
+    "status byte that doesn't belong in a file",
+    "chunk ends inside an event",
+};
+
+const char *MiniMidi_Parse_Status_str( MiniMidi_Parse_Status status )
+{
+    if ((size_t)status >= sizeof( _PARSE_STATUS_STR ) / sizeof( _PARSE_STATUS_STR[0] )) return "unknown";
+    return _PARSE_STATUS_STR[ status ];
+}
+
+// a VLQ at data[*i], no more than four bytes and all of them before len
+static inline MiniMidi_Parse_Status _vlq_checked( const _Byte *data, size_t len, size_t *i, uint64_t *val )
+{
+    size_t k = *i;
+    uint64_t v = 0;
+
+    for (int n = 0; n < 4; n++)
+    {
+        if (k >= len) return MINIMIDI_PARSE_CUT_EVENT;
+
+        _Byte b = data[k++];
+        v = ( v << 7 ) | ( b & 0x7F );
+        if (!( b & 0x80 ))
+        {
+            *i = k;
+            *val = v;
+            return MINIMIDI_PARSE_OK;
+        }
+    }
+    return MINIMIDI_PARSE_BAD_VLQ;
+}
+
+// only for bytes _validate_events has been over
+static inline uint64_t _vlq_unchecked( const _Byte **p )
+{
+    uint64_t v = 0;
+    _Byte b;
+
+    do {
+        b = *(*p)++;
+        v = ( v << 7 ) | ( b & 0x7F );
+    } while (b & 0x80);
+
+    return v;
+}
+
+// walk a chunk's events the way _parse_track_events reads them, counting events, tempo
+// changes and SysEx / Meta bytes. on a problem, shape covers the events before it and valid_length is
+// where the bad one starts
+static MiniMidi_Parse_Status _validate_events( const _Byte *data, size_t len, _Track_Shape *shape )
+{
+    MiniMidi_Parse_Status status = MINIMIDI_PARSE_OK;
+    size_t i = 0,
+           at = 0,
+           n_events = 0,
+           n_tempos = 0,
+           n_payload_bytes = 0;
+    uint64_t val;
+    _Byte running = 0;
+
+    while (i < len)
+    {
+        at = i;
+
+        // most deltas are one byte
+        if (data[i] < 0x80) i++;
+        else if (( status = _vlq_checked( data, len, &i, &val ) )) break;
+
+        if (i >= len)
+        {
+            status = MINIMIDI_PARSE_CUT_EVENT;
+            break;
+        }
+
+        _Byte s = data[i];
+        if (s >= 0xF0)
+        {
+            if (s != 0xF0 && s != 0xF7 && s != 0xFF)
+            {
+                status = MINIMIDI_PARSE_BAD_STATUS;
+                break;
+            }
+            i++;
+
+            size_t from = i;
+            _Byte type = 0;
+            if (s == 0xFF)
+            {
+                if (i >= len)
+                {
+                    status = MINIMIDI_PARSE_CUT_EVENT;
+                    break;
+                }
+                type = data[i++];
+            }
+
+            if (( status = _vlq_checked( data, len, &i, &val ) )) break;
+            if (val > len - i)
+            {
+                status = MINIMIDI_PARSE_CUT_EVENT;
+                break;
+            }
+            i += val;
+
+            if (s == 0xFF && type == MIDI_META_TEMPO && val == 3) n_tempos++;
+            n_payload_bytes += i - from;
+            n_events++;
+            continue;
+        }
+
+        // status byte or running status, picked without a branch: they come mixed
+        bool has_status = s >> 7;
+        running = has_status ? s : running;
+        i += has_status;
+
+        if (!running)
+        {
+            status = MINIMIDI_PARSE_NO_STATUS;
+            break;
+        }
+
+        // program change and channel aftertouch ( 0xC_, 0xD_ ) take one
+        size_t n_data = 2 - ( ( running & 0xE0 ) == 0xC0 );
+        if (n_data > len - i)
+        {
+            status = MINIMIDI_PARSE_CUT_EVENT;
+            break;
+        }
+        i += n_data;
+        n_events++;
+    }
+
+    shape->valid_length = status == MINIMIDI_PARSE_OK ? len : at;
+    shape->n_events = n_events;
+    shape->n_tempos = n_tempos;
+    shape->n_payload_bytes = n_payload_bytes;
+
+    return status;
+}
+
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Arena
+****************************************************************************************/
+#define _ARENA_ALIGN 16
+
+static inline size_t _aligned( size_t n )
+{
+    return ( n + _ARENA_ALIGN - 1 ) & ~(size_t)( _ARENA_ALIGN - 1 );
+}
+
+static void *_arena_alloc( MiniMidi_Arena *arena, size_t n )
+{
+    n = _aligned( n );
+    if (!arena || arena->size - arena->used < n) return NULL;
+
+    void *p = arena->base + arena->used;
+    arena->used += n;
+    return p;
+}
+
+static inline bool _in_arena( const MiniMidi_Arena *arena, const void *p )
+{
+    return arena && p && (const _Byte*)p >= arena->base && (const _Byte*)p < arena->base + arena->size;
+}
+
+// realloc, except that arrays in the arena are copied out to the heap
+static void *_grow( MiniMidi_Arena *arena, void *arr, size_t used_bytes, size_t new_bytes )
+{
+    if (!_in_arena( arena, arr )) return realloc( arr, new_bytes );
+
+    void *moved = malloc( new_bytes );
+    if (moved && used_bytes) memcpy( moved, arr, used_bytes );
+    return moved;
+}
+
+static void _track_free_arrays( MiniMidi_Track *track )
+{
+    if (!_in_arena( track->arena, track->event_arr )) free( track->event_arr );
+    if (!_in_arena( track->arena, track->tempo_arr )) free( track->tempo_arr );
+    if (!_in_arena( track->arena, track->payload_arr )) free( track->payload_arr );
+}
+
+// file struct, header, path and n_tracks zeroed tracks at the start of one block,
+// with extra bytes left for the track arrays
+static MiniMidi_File *_file_alloc( const char *filepath, size_t n_tracks, size_t extra )
+{
+    size_t path_len = strlen( filepath ) + 1;
+    MiniMidi_Arena arena = { 0 };
+
+    arena.size = _aligned( sizeof( MiniMidi_File ) ) + _aligned( sizeof( MiniMidi_Header ) )
+        + _aligned( path_len ) + _aligned( n_tracks * sizeof( MiniMidi_Track ) ) + extra;
+    arena.base = (_Byte*)malloc( arena.size );
+    if (!arena.base) return NULL;
+
+    // only the front is cleared, the track arrays are written before they are read
+    MiniMidi_File *file = (MiniMidi_File*)_arena_alloc( &arena, sizeof( MiniMidi_File ) );
+    file->header = (MiniMidi_Header*)_arena_alloc( &arena, sizeof( MiniMidi_Header ) );
+    file->filepath = (char*)_arena_alloc( &arena, path_len );
+    file->tracks = (MiniMidi_Track*)_arena_alloc( &arena, n_tracks * sizeof( MiniMidi_Track ) );
+
+    memset( file->header, 0, sizeof( MiniMidi_Header ) );
+    memcpy( file->filepath, filepath, path_len );
+    memset( file->tracks, 0, n_tracks * sizeof( MiniMidi_Track ) );
+
+    file->track = file->tracks;
+    file->n_tracks = n_tracks;
+    file->length = 0;
+    file->arena = arena;
+
+    for (size_t t = 0; t < n_tracks; t++) file->tracks[t].arena = &(file->arena);
+
+    return file;
+}
+
+// big chunks are split over the cores, their arrays come from the parallel decoder
+static bool _decodes_in_parallel( uint32_t chunk_len, long *n_cores )
+{
+    if (chunk_len < MINIMIDI_PARALLEL_MIN_BYTES) return false;
+
+    *n_cores = sysconf( _SC_NPROCESSORS_ONLN );
+    return *n_cores > 1;
+}
+
+// what a walked track chunk takes from the arena
+static size_t _track_arena_bytes( const _Track_Shape *shape )
+{
+    if (shape->n_cores > 1) return 0;
+
+    return _aligned( shape->n_tempos * sizeof( MiniMidi_Tempo ) ) + _aligned( shape->n_events * sizeof( MiniMidi_Event ) )
+        + _aligned( shape->n_payload_bytes );
+}
+
+int MiniMidi_Track_reserve( MiniMidi_Track *track, size_t n )
+{
+    if (n <= track->capacity) return 0;
+
+    size_t new_cap = track->capacity ? track->capacity : 16;
+    while (new_cap < n) new_cap *= 2;
+
+    MiniMidi_Event *arr = (MiniMidi_Event*)_grow( track->arena, track->event_arr,
+        track->n_events * sizeof( MiniMidi_Event ), new_cap * sizeof( MiniMidi_Event ) );
+    if (!arr) return 1;
+
+    track->event_arr = arr;
+    track->capacity = new_cap;
+    return 0;
+}
+
+void MiniMidi_Track_release( MiniMidi_Track *track )
+{
+    if (!_in_arena( track->arena, track->event_arr )) free( track->event_arr );
+    if (!_in_arena( track->arena, track->payload_arr )) free( track->payload_arr );
+
+    track->event_arr = NULL;
+    track->n_events = 0;
+    track->capacity = 0;
+    track->payload_arr = NULL;
+    track->n_payload_bytes = 0;
+}
+
+
+
+
+/****************************************************************************************
+*
+*
+*   -> Filters
+****************************************************************************************/
+// kept notes sounding while a track is decoded front to back, by channel and pitch. before
+// the tick window, the last NOTE ON of each key still sounding is held back until it starts
+typedef struct _Filter_State
+{
+    bool     open[ MINIMIDI_NOTE_KEYS ];
+    size_t   n_open;
+
+    bool     is_held[ MINIMIDI_NOTE_KEYS ];
+    uint64_t held_ticks[ MINIMIDI_NOTE_KEYS ];
+    _Byte    held_velocity[ MINIMIDI_NOTE_KEYS ];
+    size_t   n_held;
+
+} _Filter_State;
+
+typedef struct _Held_Note
+{
+    uint64_t ticks;
+    size_t   key;
+
+} _Held_Note;
+
+static const struct { const char *name; uint8_t classes; } _FILTER_CLASSES[] = {
+    { "notes",     MINIMIDI_FILTER_NOTES },
+    { "on",        MINIMIDI_FILTER_CLASS( MIDI_NOTE_ON ) },
+    { "off",       MINIMIDI_FILTER_CLASS( MIDI_NOTE_OFF ) },
+    { "polytouch", MINIMIDI_FILTER_CLASS( MIDI_POLY_AFTERTOUCH ) },
+    { "cc",        MINIMIDI_FILTER_CLASS( MIDI_CONTROL_CHANGE ) },
+    { "program",   MINIMIDI_FILTER_CLASS( MIDI_PROGRAM_CHANGE ) },
+    { "touch",     MINIMIDI_FILTER_CLASS( MIDI_CHAN_AFTERTOUCH ) },
+    { "bend",      MINIMIDI_FILTER_CLASS( MIDI_PITCH_BEND ) },
+    { "system",    MINIMIDI_FILTER_CLASS( MIDI_SYSTEM ) },
+};
+
+void MiniMidi_Filter_all( MiniMidi_Filter *filter )
+{
+    filter->classes = 0xFF;
+    filter->channels = 0xFFFF;
+    filter->start_ticks = 0;
+    filter->end_ticks = UINT64_MAX;
+    filter->low_note = 0;
+    filter->high_note = 127;
+}
+
+static int _parse_class( MiniMidi_Filter *filter, const char *name, size_t len )
+{
+    for (size_t i = 0; i < sizeof( _FILTER_CLASSES ) / sizeof( _FILTER_CLASSES[0] ); i++)
+    {
+        if (strlen( _FILTER_CLASSES[i].name ) == len && strncmp( _FILTER_CLASSES[i].name, name, len ) == 0)
+        {
+            filter->classes |= _FILTER_CLASSES[i].classes;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int MiniMidi_Filter_parse( MiniMidi_Filter *filter, const char *spec )
+{
+    const char *part = spec;
+    bool has_classes = false;
+
+    MiniMidi_Filter_all( filter );
+
+    while (*part)
+    {
+        size_t len = strcspn( part, ":" );
+        unsigned long long a, b;
+        int n;
+
+        if (strncmp( part, "ch=", 3 ) == 0)
+        {
+            const char *c = part + 3;
+
+            filter->channels = 0;
+            while (c < part + len)
+            {
+                if (sscanf( c, "%llu%n", &a, &n ) != 1 || a < 1 || a > 16) return 1;
+                filter->channels |= 1u << ( a - 1 );
+                c += n;
+                if (*c == ',') c++;
+            }
+        }
+        else if (strncmp( part, "ticks=", 6 ) == 0)
+        {
+            if (sscanf( part + 6, "%llu-%llu%n", &a, &b, &n ) != 2 || (size_t)n != len - 6 || a > b) return 1;
+            filter->start_ticks = a;
+            filter->end_ticks = b;
+        }
+        else if (strncmp( part, "pitch=", 6 ) == 0)
+        {
+            if (sscanf( part + 6, "%llu-%llu%n", &a, &b, &n ) != 2 || (size_t)n != len - 6 || a > b || b > 127) return 1;
+            filter->low_note = a;
+            filter->high_note = b;
+        }
+        else
+        {
+            // a list of classes
+            const char *c = part;
+
+            if (!has_classes) filter->classes = 0;
+            has_classes = true;
+
+            while (c < part + len)
+            {
+                size_t n_name = strcspn( c, ",:" );
+                if (_parse_class( filter, c, n_name )) return 1;
+                c += n_name;
+                if (*c == ',') c++;
+            }
+        }
+
+        part += len;
+        if (*part == ':') part++;
+    }
+
+    return 0;
+}
+
+bool MiniMidi_Filter_keeps( const MiniMidi_Filter *filter, const MiniMidi_Event *evt )
+{
+    if (!( filter->classes & MINIMIDI_FILTER_CLASS( evt->status_code ) )) return false;
+    if (evt->status_code == MIDI_SYSTEM) return evt->abs_ticks >= filter->start_ticks && evt->abs_ticks <= filter->end_ticks;
+
+    if (!( filter->channels & ( 1u << ( evt->channel & 0x0F ) ) )) return false;
+
+    if (evt->status_code == MIDI_NOTE_ON || evt->status_code == MIDI_NOTE_OFF || evt->status_code == MIDI_POLY_AFTERTOUCH)
+    {
+        if (evt->evt_data[0] < filter->low_note || evt->evt_data[0] > filter->high_note) return false;
+    }
+
+    // a NOTE ON before the window may still be sounding in it
+    return evt->status_code == MIDI_NOTE_OFF
+        || ( evt->status_code == MIDI_NOTE_ON && evt->abs_ticks < filter->start_ticks )
+        || ( evt->abs_ticks >= filter->start_ticks && evt->abs_ticks <= filter->end_ticks );
+}
+
+static void _filter_open( const MiniMidi_Filter *filter, _Filter_State *state, size_t key )
+{
+    // nothing to wait for when NOTE OFFs aren't wanted
+    if (state->open[key] || !( filter->classes & MINIMIDI_FILTER_CLASS( MIDI_NOTE_OFF ) )) return;
+
+    state->open[key] = true;
+    state->n_open++;
+}
+
+// front to back: NOTE OFFs go with the NOTE ONs that were kept. like the links, one
+// NOTE OFF ends every NOTE ON of its channel and pitch before it
+static bool _filter_keep( const MiniMidi_Filter *filter, _Filter_State *state, const MiniMidi_Event *evt )
+{
+    if (!filter) return true;
+
+    size_t key = MINIMIDI_NOTE_KEY( evt );
+
+    if (evt->status_code == MIDI_NOTE_OFF)
+    {
+        if (state->is_held[key])
+        {
+            state->is_held[key] = false;
+            state->n_held--;
+        }
+        if (!state->open[key]) return false;
+
+        state->open[key] = false;
+        state->n_open--;
+        return true;
+    }
+
+    if (!MiniMidi_Filter_keeps( filter, evt )) return false;
+
+    if (evt->status_code == MIDI_NOTE_ON && evt->abs_ticks < filter->start_ticks)
+    {
+        if (!state->is_held[key]) state->n_held++;
+
+        state->is_held[key] = true;
+        state->held_ticks[key] = evt->abs_ticks;
+        state->held_velocity[key] = evt->evt_data[1];
+        return false;
+    }
+
+    if (evt->status_code == MIDI_NOTE_ON) _filter_open( filter, state, key );
+    return true;
+}
+
+static int _cmp_held( const void *a, const void *b )
+{
+    const _Held_Note *x = a, *y = b;
+    return x->ticks < y->ticks ? -1 : x->ticks > y->ticks;
+}
+
+// once the window starts, the NOTE ONs held back sounding into it go in, oldest first.
+// each of them was skipped over, so out has room. returns how many were put there
+static size_t _filter_release( const MiniMidi_Filter *filter, _Filter_State *state, MiniMidi_Event *out )
+{
+    _Held_Note held[ MINIMIDI_NOTE_KEYS ];
+    size_t n = 0;
+
+    for (size_t key = 0; key < MINIMIDI_NOTE_KEYS && n < state->n_held; key++)
+    {
+        if (!state->is_held[key]) continue;
+
+        held[n].ticks = state->held_ticks[key];
+        held[n++].key = key;
+        state->is_held[key] = false;
+    }
+    state->n_held = 0;
+    qsort( held, n, sizeof( _Held_Note ), _cmp_held );
+
+    for (size_t k = 0; k < n; k++)
+    {
+        MiniMidi_Event *evt = &(out[k]);
+
+        memset( evt, 0, sizeof( MiniMidi_Event ) );
+        evt->abs_ticks = held[k].ticks;
+        evt->delta_ticks = held[k].ticks - ( k ? held[k - 1].ticks : 0 );
+        evt->status_code = MIDI_NOTE_ON;
+        evt->channel = (_Byte)( held[k].key >> 7 );
+        evt->evt_data[0] = (_Byte)( held[k].key & 0x7F );
+        evt->evt_data[1] = state->held_velocity[ held[k].key ];
+        evt->note = _event_data_bytes_to_note( evt->evt_data[0] );
+
+        _filter_open( filter, state, held[k].key );
+    }
+    return n;
+}
+
+// nothing kept can come after ticks
+static inline bool _filter_is_done( const MiniMidi_Filter *filter, _Filter_State *state, uint64_t ticks )
+{
+    return filter && ticks > filter->end_ticks && !state->n_open;
+}
+
+// drop what filter doesn't keep from a decoded track, for decoders that can't skip
+static void _filter_track( MiniMidi_Track *track, const MiniMidi_Filter *filter )
+{
+    _Filter_State *state = (_Filter_State*)calloc( 1, sizeof( _Filter_State ) );
+    size_t w = 0;
+
+    if (!state) return;
+
+    for (size_t i = 0; i < track->n_events; i++)
+    {
+        if (state->n_held && track->event_arr[i].abs_ticks >= filter->start_ticks) w += _filter_release( filter, state, track->event_arr + w );
+        if (_filter_is_done( filter, state, track->event_arr[i].abs_ticks )) break;
+        if (_filter_keep( filter, state, &(track->event_arr[i]) )) track->event_arr[ w++ ] = track->event_arr[i];
+    }
+
+    if (w < track->n_events)
+    {
+        track->n_events = w;
+        if (w) track->total_ticks = track->event_arr[ w - 1 ].abs_ticks;
+    }
+    free( state );
+}
+
+
+
+
 /****************************************************************************************
 *
 *
 *   -> Main Struct Methods
 ****************************************************************************************/
-void _parse_track_events( MiniMidi_Track *track, _Byte *evts_chunk )
+int _add_tempo( MiniMidi_Track *track, uint64_t abs_ticks, uint32_t usec_per_beat )
+{
+    if (track->n_tempos >= track->tempo_capacity)
+    {
+        size_t new_cap = track->n_tempos ? track->n_tempos * 2 : 8;
+        MiniMidi_Tempo *arr = (MiniMidi_Tempo*)_grow( track->arena, track->tempo_arr,
+            track->n_tempos * sizeof( MiniMidi_Tempo ), new_cap * sizeof( MiniMidi_Tempo ) );
+        if (!arr) return 1;
+
+        track->tempo_arr = arr;
+        track->tempo_capacity = new_cap;
+    }
+
+    track->tempo_arr[ track->n_tempos ].abs_ticks = abs_ticks;
+    track->tempo_arr[ track->n_tempos ].usec_per_beat = usec_per_beat;
+    track->tempo_arr[ track->n_tempos ].usec = 0;
+    track->n_tempos++;
+
+    return 0;
+}
+
+// SysEx ( F0 / F7 <len> <data> ) and Meta ( FF <type> <len> <data> ) events of a
+// validated chunk. bytes points right after the status byte. returns how many bytes were used.
+size_t _parse_system_event( MiniMidi_Track *track, MiniMidi_Event *evt, const _Byte *bytes )
+{
+    const _Byte *p = bytes;
+
+    // channel holds the low nibble for system events: 0xF is Meta
+    if (evt->channel == 0x0F) evt->evt_data[0] = *p++; // meta type
+
+    uint64_t _payload_len = _vlq_unchecked( &p );
+
+    if (evt->channel == 0x0F && evt->evt_data[0] == MIDI_META_TEMPO && _payload_len == 3)
+    {
+        uint32_t usec_per_beat = ( p[0] << 16 ) | ( p[1] << 8 ) | p[2];
+        _add_tempo( track, evt->abs_ticks, usec_per_beat );
+    }
+
+    return (size_t)( p - bytes ) + _payload_len;
+}
+
+// copy what follows a SysEx / Meta status byte to the track's payload bytes, which the
+// walk sized for all of them. returns what goes in the event's payload
+static inline uint32_t _keep_payload( MiniMidi_Track *track, const _Byte *bytes, size_t n )
+{
+    memcpy( track->payload_arr + track->n_payload_bytes, bytes, n );
+    track->n_payload_bytes += n;
+
+    return (uint32_t)( track->n_payload_bytes - n ) + 1;
+}
+
+// past the end of a filter's window nothing is stored any more, but tempo changes still go
+// in the tempo map. p is right after the delta of the first event left, at ticks
+static void _skim_tempos( MiniMidi_Track *track, const _Byte *p, const _Byte *end, uint64_t ticks, _Byte running )
+{
+    for (;;)
+    {
+        _Byte s = *p;
+        if (s & 0x80)
+        {
+            p++;
+            if (s < 0xF0) running = s;
+        }
+        else
+        {
+            s = running;
+        }
+
+        if (( s & 0xF0 ) == MIDI_SYSTEM)
+        {
+            MiniMidi_Event evt = { .abs_ticks = ticks, .channel = s & 0x0F };
+            p += _parse_system_event( track, &evt, p );
+        }
+        else
+        {
+            p += _get_midi_data_byte_count( (MidiStatusCode)( s & 0xF0 ) );
+        }
+
+        if (p >= end) return;
+        ticks += _vlq_unchecked( &p );
+    }
+}
+
+// decode the first len bytes of a chunk that _validate_events has walked: they hold
+// whole events only, so nothing here looks at where the data ends
+static inline __attribute__((always_inline)) void _decode_events( MiniMidi_Track *track, const _Byte *evts_chunk, size_t len,
+    const MiniMidi_Filter *filter )
+{
+    const _Byte *p = evts_chunk,
+                *end = evts_chunk + len;
+
+    // only looked at with a filter
+    _Filter_State state;
+    if (filter) memset( &state, 0, sizeof( state ) );
+
+    uint64_t ticks = 0;
+    size_t _event_counter = 0;
+
+    // Last status byte for running status handling, the walk made sure there is one when needed
+    _Byte _last_status = 0;
+
+    while (p < end)
+    {
+        struct MiniMidi_Event evt;
+
+        evt.next = NULL;
+        evt.prev = NULL;
+
+        evt.delta_ticks = _vlq_unchecked( &p );
+        ticks += evt.delta_ticks;
+        evt.abs_ticks = ticks;
+
+        if (filter && state.n_held && ticks >= filter->start_ticks) _event_counter += _filter_release( filter, &state, track->event_arr + _event_counter );
+
+        // the rest of the chunk can't have anything the filter keeps
+        if (_filter_is_done( filter, &state, ticks ))
+        {
+            _skim_tempos( track, p, end, ticks, _last_status );
+            break;
+        }
+
+        _Byte s = *p;
+        if (s & 0x80)
+        {
+            p++;
+            // system messages don't take part in running status
+            if (s < 0xF0) _last_status = s;
+        }
+        else
+        {
+            s = _last_status;
+        }
+
+        evt.status_code = (MidiStatusCode)( s & 0xF0 );
+        evt.channel = s & 0x0F;
+        evt.evt_data[0] = 0;
+        evt.evt_data[1] = 0;
+
+        if (evt.status_code == MIDI_SYSTEM)
+        {
+            size_t n_bytes = _parse_system_event( track, &evt, p );
+
+            if (_filter_keep( filter, &state, &evt ))
+            {
+                evt.payload = _keep_payload( track, p, n_bytes );
+                track->event_arr[_event_counter ++] = evt;
+            }
+            p += n_bytes;
+            continue;
+        }
+
+        // keep the raw data bytes, edits work on these (pitch, velocity, ...)
+        evt.evt_data[0] = *p++;
+        if (evt.status_code != MIDI_PROGRAM_CHANGE && evt.status_code != MIDI_CHAN_AFTERTOUCH) evt.evt_data[1] = *p++;
+
+        // NOTE ON with zero velocity is a NOTE OFF in disguise
+        if (evt.status_code == MIDI_NOTE_ON && evt.evt_data[1] == 0)
+        {
+            evt.status_code = MIDI_NOTE_OFF;
+        }
+        if (evt.status_code == MIDI_NOTE_ON || evt.status_code == MIDI_NOTE_OFF)
+        {
+            evt.note = _event_data_bytes_to_note( evt.evt_data[0] );
+        }
+
+        if (_filter_keep( filter, &state, &evt )) track->event_arr[_event_counter ++] = evt;
+    }
+
+    track->total_ticks = ticks;
+    track->n_events = _event_counter;
+}
+
+// the loop without a filter has nothing to check per event
+void _parse_track_events( MiniMidi_Track *track, const _Byte *evts_chunk, size_t len, const MiniMidi_Filter *filter )
+{
+    if (filter)
+        _decode_events( track, evts_chunk, len, filter );
+    else
+        _decode_events( track, evts_chunk, len, NULL );
+}
+MiniMidi_File* create_mini_midi_file(const char *filepath) {
+    MiniMidi_File *midi_file = _file_alloc( filepath, 1, 0 );
+    if (!midi_file) return NULL;
+
+    // Set format = 0 and ntrks = 1 by convention for single-track
+    midi_file->header->format = 0;
+    midi_file->header->ntrks = 1;
+
+    return midi_file;
+}
+
+// pairs every NOTE ON with the first NOTE OFF of the same channel and pitch after it.
+// walks the array backwards once, remembering the closest NOTE OFF per key.
+int hook_up_events( MiniMidi_Event *arr, size_t n )
+{
+    sprintf( MiniMidi_Log_log_line, "minimidi.c > hook_up_events() : Entering" );
+    MiniMidi_Log_writeline();
+
+    int hook_counter = 0;
+    MiniMidi_Event *cursor;
+    MiniMidi_Event *next_off[MINIMIDI_NOTE_KEYS] = { NULL };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        arr[i].next = NULL;
+        arr[i].prev = NULL;
+    }
+
+    for (size_t i = n; i-- > 0; )
+    {
+        cursor = &(arr[i]);
+
+        if (cursor->status_code == MIDI_NOTE_OFF)
+        {
+            next_off[ MINIMIDI_NOTE_KEY( cursor ) ] = cursor;
+
+        } else if (cursor->status_code == MIDI_NOTE_ON && next_off[ MINIMIDI_NOTE_KEY( cursor ) ])
+        {
+            cursor->next = next_off[ MINIMIDI_NOTE_KEY( cursor ) ];
+
+            // the latest NOTE ON wins, same as a forward search would do
+            if (!cursor->next->prev)
+            {
+                cursor->next->prev = cursor;
+            }
+            hook_counter++;
+        }
+    }
+
+    sprintf( MiniMidi_Log_log_line, "minimidi.c > hook_up_events() : hooked up %i pairs", hook_counter );
+    MiniMidi_Log_writeline();
+
+    return hook_counter;
+}
+
+int MiniMidi_Track_relink( MiniMidi_Track *track )
+{
+    uint64_t last_tick = 0;
+
+    for (size_t i = 0; i < track->n_events; i++)
+    {
+        track->event_arr[i].delta_ticks = track->event_arr[i].abs_ticks - last_tick;
+        last_tick = track->event_arr[i].abs_ticks;
+    }
+    track->total_ticks = last_tick;
+
+    return hook_up_events( track->event_arr, track->n_events );
+}
+
+// a key's pairs only change between its last NOTE OFF before the span and its first one
+// after it: NOTE ONs before that pair up earlier, NOTE ONs after it later
+int MiniMidi_Track_relink_span( MiniMidi_Track *track, size_t lo, size_t hi, const bool *keys )
 {
-    track->total_ticks = 0;
-    
-    size_t _byte_counter = 0;
-    size_t _event_counter = 0;
+    MiniMidi_Event *arr = track->event_arr,
+                   *cursor,
+                   *next_off[MINIMIDI_NOTE_KEYS] = { NULL };
+    size_t n = track->n_events,
+           from[MINIMIDI_NOTE_KEYS],
+           to[MINIMIDI_NOTE_KEYS],
+           start = lo,
+           end = 0,
+           n_open = 0;
+    int hook_counter = 0;
 
-#if DEBUG
-    size_t _debug_event_byte_count = 0;
-#endif
+    if (hi > n) hi = n;
+    if (lo > hi) lo = hi;
 
-    // Last status byte for running status handling.
-    _Byte *_last_status_byte = NULL;
-    // _Byte *_next_byte = NULL;
-    uint8_t _data_bytes_count = 0;
+    for (size_t i = lo; i < n && i <= hi; i++)
+    {
+        arr[i].delta_ticks = arr[i].abs_ticks - ( i ? arr[i - 1].abs_ticks : 0 );
+    }
+    track->total_ticks = n ? arr[n - 1].abs_ticks : 0;
 
-    while ( _byte_counter < track->length )
+    // what changed may have been copied in with links of its own, notes get theirs below
+    for (size_t i = lo; i < hi; i++)
     {
+        if (arr[i].status_code == MIDI_NOTE_ON || arr[i].status_code == MIDI_NOTE_OFF) continue;
 
-#if DEBUG
-        /* DEBUG IT */_debug_event_byte_count = _byte_counter;
-        /* DEBUG IT */ printf(BOLDWHITE "Starting grab %lith byte. byte_counter=%li\n" RESET, (_byte_counter + 1), _byte_counter);
-#endif
+        arr[i].next = NULL;
+        arr[i].prev = NULL;
+    }
 
+    for (size_t k = 0; k < MINIMIDI_NOTE_KEYS; k++)
+    {
+        from[k] = to[k] = SIZE_MAX;
+        if (keys[k]) n_open++;
+    }
+    if (!n_open) return 0;
 
-        struct MiniMidi_Event evt;
+    for (size_t i = lo, left = n_open; i-- > 0 && left; )
+    {
+        size_t k = MINIMIDI_NOTE_KEY( &(arr[i]) );
+        if (arr[i].status_code != MIDI_NOTE_OFF || !keys[k] || from[k] != SIZE_MAX) continue;
 
-        evt.next = NULL;
-        evt.prev = NULL;
+        from[k] = i + 1;
+        left--;
+    }
+    for (size_t i = hi, left = n_open; i < n && left; i++)
+    {
+        size_t k = MINIMIDI_NOTE_KEY( &(arr[i]) );
+        if (arr[i].status_code != MIDI_NOTE_OFF || !keys[k] || to[k] != SIZE_MAX) continue;
 
-        _byte_counter += _read_VLQ_delta_t( evts_chunk + _byte_counter, track->length - _byte_counter, &(evt.delta_ticks));
-        track->total_ticks += evt.delta_ticks;
-        evt.abs_ticks = track->total_ticks;
+        to[k] = i;
+        left--;
+    }
 
+    for (size_t k = 0; k < MINIMIDI_NOTE_KEYS; k++)
+    {
+        if (!keys[k]) continue;
 
+        if (from[k] == SIZE_MAX) from[k] = 0;
+        if (to[k] == SIZE_MAX) to[k] = n ? n - 1 : 0;
+        if (from[k] < start) start = from[k];
+        if (to[k] > end) end = to[k];
+    }
 
-#if DEBUG
-        /* DEBUG IT */ printf(BOLDWHITE "Parsed Event number %lu:\n  " RESET CYAN "ticks=%lu\n" RESET, _event_counter, evt.delta_ticks );
-        /* DEBUG IT */ printf(TAB "After moving, counter is at %lu.\n", _byte_counter);      
-        /* DEBUG IT */ printf(TAB TAB "parseEvents::Next Bite is ");
-        /* DEBUG IT */ print_byte_as_binary(evts_chunk + _byte_counter, 0);
-        /* DEBUG IT */ printf("\n");
-#endif
+    for (size_t i = start; i < n && i <= end; i++)
+    {
+        size_t k = MINIMIDI_NOTE_KEY( &(arr[i]) );
+        if (!keys[k] || i < from[k] || i > to[k]) continue;
+        if (arr[i].status_code != MIDI_NOTE_ON && arr[i].status_code != MIDI_NOTE_OFF) continue;
+
+        arr[i].next = NULL;
+        arr[i].prev = NULL;
+    }
 
-        if ( *(evts_chunk + _byte_counter) >= 0x80 )
+    for (size_t i = ( end < n ? end + 1 : n ); i-- > start; )
+    {
+        cursor = &(arr[i]);
+        size_t k = MINIMIDI_NOTE_KEY( cursor );
+        if (!keys[k] || i < from[k] || i > to[k]) continue;
+
+        if (cursor->status_code == MIDI_NOTE_OFF)
         {
-            // This is a new status byte (has the high bit set)
-            evt.status_code = _get_midi_status_code((evts_chunk + _byte_counter));
-            _last_status_byte = (evts_chunk + _byte_counter);  // Remember for running status
-            _byte_counter++;
+            next_off[k] = cursor;
 
-        } else {
-            // No new status byte — use running status
-#if DEBUG
-            /* DEBUG IT */ printf( TAB TAB RED "Status is Running!\n" RESET );
-#endif
+        } else if (cursor->status_code == MIDI_NOTE_ON && next_off[k])
+        {
+            cursor->next = next_off[k];
 
-            evt.status_code = _get_midi_status_code(_last_status_byte);
-            // Note: byte_counter not incremented here, since there's no status byte.
+            if (!cursor->next->prev)
+            {
+                cursor->next->prev = cursor;
+            }
+            hook_counter++;
         }
+    }
 
-        if (evt.status_code == MIDI_INVALID) {
-            printf(RED "Invalid status byte detected — aborting!\n" RESET);
-            return;
-        }
-#if DEBUG
-        /* DEBUG IT */ printf( TAB TAB GREEN "Status Code: " RESET );
-         /* DEBUG IT */ _print_midi_status_code( evt.status_code );
-#endif
-         _data_bytes_count = _get_midi_data_byte_count( evt.status_code );
-#if DEBUG
-        /* DEBUG IT */ printf( TAB TAB "Event has %li data bytes: " RESET, _data_bytes_count);
-#endif
-        
- 
-        // extract databytes
-        // when do we care?
-        //  when evt is a Note On, and never elses
-        if (evt.status_code == MIDI_NOTE_ON || evt.status_code == MIDI_NOTE_OFF)
+    return hook_counter;
+}
+
+// stable merge sort on abs_ticks, so events on the same tick keep their order
+int MiniMidi_Event_sort_by_ticks( MiniMidi_Event *arr, size_t n )
+{
+    if (n < 2) return 0;
+
+    MiniMidi_Event *aux = (MiniMidi_Event*)malloc( n * sizeof( MiniMidi_Event ) );
+    if (!aux) return 1;
+
+    MiniMidi_Event *src = arr, *dst = aux, *swap;
+
+    for (size_t width = 1; width < n; width *= 2)
+    {
+        for (size_t lo = 0; lo < n; lo += 2 * width)
         {
-            evt.note = _event_data_bytes_to_note(*(evts_chunk + _byte_counter));
-#if DEBUG
-            _print_midi_note(evt.note);
-            printf("\n");
-#endif
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, w = lo;
+
+            while (i < mid && j < hi)
+            {
+                dst[w++] = ( src[j].abs_ticks < src[i].abs_ticks ) ? src[j++] : src[i++];
+            }
+            while (i < mid) dst[w++] = src[i++];
+            while (j < hi)  dst[w++] = src[j++];
         }
-        _byte_counter += _data_bytes_count;
-#if DEBUG
-        /* DEBUG IT */ printf(TAB TAB "Event Size in Bytes: %li\n", (_byte_counter - _debug_event_byte_count));
-        /* DEBUG IT */ printf(TAB TAB "Finishing %linth loop, byte_counter=%li.\n\n\n", _event_counter, _byte_counter);
-#endif
-        track->event_arr[_event_counter ++] = evt;
 
+        swap = src;
+        src = dst;
+        dst = swap;
     }
-    track->n_events = _event_counter;
-    // track->total_beats = track->total_ticks / ppqn;
+
+    if (src != arr) memcpy( arr, src, n * sizeof( MiniMidi_Event ) );
+    free( aux );
+
+    return 0;
+}
+
+// "Class" Methods
+int _midi_header_read( MiniMidi_Header *header, _Byte *file_contents )
+{
+    uint32_t aux_for_chunk_size;
+    _extract_number_from_byte_array( &aux_for_chunk_size, file_contents, 4, 4 );
+    header->length = (size_t)aux_for_chunk_size;
+
+    _extract_number_from_byte_array( &(header->format), file_contents, 8, 2 );
+    _extract_number_from_byte_array( &(header->ntrks), file_contents, 10, 2 );
+    _extract_number_from_byte_array( &(header->ppqn), file_contents, 12, 2 );
+
+    return 0;
 }
 
 
 
 
-MiniMidi_File* create_mini_midi_file(const char *filepath) {
-    MiniMidi_File *midi_file = malloc(sizeof(MiniMidi_File));
-    if (!midi_file) return NULL;
+// decode the chunk shape describes into track, in the arena when it has room.
+// returns 0 on success
+static int _track_read_into( MiniMidi_Track *track, _Byte *file_content, const _Track_Shape *shape,
+    const MiniMidi_Filter *filter )
+{
+    _Byte *data = file_content + shape->start;
 
-    midi_file->filepath = strdup(filepath);
-    if (!midi_file->filepath) {
-        free(midi_file);
-        return NULL;
+#if DEBUG
+    printf(GREEN "Reading Track Chunk" RESET ": %zu bytes at %zu.\n", shape->length, shape->start);
+#endif
+
+    track->length = shape->length;
+    track->event_arr = NULL;
+    track->capacity = 0;
+    track->tempo_arr = NULL;
+    track->n_tempos = 0;
+    track->tempo_capacity = 0;
+    track->payload_arr = NULL;
+    track->n_payload_bytes = 0;
+
+    if (shape->n_cores > 1)
+    {
+        if (MiniMidi_Track_decode_parallel( track, data, shape->length, shape->n_cores )) return 1;
+
+        // segments start mid stream, what they skip is only known afterwards
+        if (filter) _filter_track( track, filter );
+        hook_up_events( track->event_arr, track->n_events );
+        return 0;
     }
 
-    // Allocate and zero-initialize the header
-    midi_file->header = calloc(1, sizeof(MiniMidi_Header));
-    if (!midi_file->header) {
-        free(midi_file->filepath);
-        free(midi_file);
-        return NULL;
+    // exactly what the walk counted, a filter only keeps fewer
+    if (shape->n_tempos)
+    {
+        track->tempo_arr = (MiniMidi_Tempo*)_arena_alloc( track->arena, shape->n_tempos * sizeof( MiniMidi_Tempo ) );
+        if (!track->tempo_arr) track->tempo_arr = (MiniMidi_Tempo*)malloc( shape->n_tempos * sizeof( MiniMidi_Tempo ) );
+        if (!track->tempo_arr) return 1;
+        track->tempo_capacity = shape->n_tempos;
+    }
+    if (shape->n_events)
+    {
+        track->event_arr = (MiniMidi_Event*)_arena_alloc( track->arena, shape->n_events * sizeof( MiniMidi_Event ) );
+        if (!track->event_arr) track->event_arr = (MiniMidi_Event*)malloc( shape->n_events * sizeof( MiniMidi_Event ) );
+        if (!track->event_arr) return 1;
+        track->capacity = shape->n_events;
+    }
+    if (shape->n_payload_bytes)
+    {
+        track->payload_arr = (_Byte*)_arena_alloc( track->arena, shape->n_payload_bytes );
+        if (!track->payload_arr) track->payload_arr = (_Byte*)malloc( shape->n_payload_bytes );
+        if (!track->payload_arr) return 1;
     }
 
-    // Set format = 0 and ntrks = 1 by convention for single-track
-    midi_file->header->format = 0;
-    midi_file->header->ntrks = 1;
+    // events are decoded straight out of the file buffer
+    _parse_track_events( track, data, shape->valid_length, filter );
+    hook_up_events( track->event_arr, track->n_events );
 
-    // Allocate one track
-    midi_file->track = calloc(1, sizeof(MiniMidi_Track));
-    if (!midi_file->track) {
-        free(midi_file->header);
-        free(midi_file->filepath);
-        free(midi_file);
-        return NULL;
+    return 0;
+}
+
+int MiniMidi_Track_read( MiniMidi_Track *track, _Byte *file_content, size_t start_index, size_t total_chunk_len,
+    const MiniMidi_Filter *filter )
+{
+    _Track_Shape shape = { 0 };
+    uint32_t chunk_len;
+
+    memset( track, 0, sizeof( MiniMidi_Track ) );
+
+    if (start_index + 8 > total_chunk_len) return 1;
+
+    _extract_number_from_byte_array( &chunk_len, file_content, start_index + 4, 4 );
+
+    //                        Chunk Id + Chunk len
+    if (start_index + chunk_len + 4 + 4 > total_chunk_len) return 1;
+
+    shape.start = start_index + 8;
+    shape.length = chunk_len;
+    shape.valid_length = chunk_len;
+    if (!_decodes_in_parallel( chunk_len, &shape.n_cores ))
+    {
+        shape.n_cores = 0;
+        _validate_events( file_content + shape.start, shape.length, &shape );
     }
 
-    midi_file->length = 0; // can set this when writing or parsing
+    // no arena, everything goes on the heap
+    if (_track_read_into( track, file_content, &shape, filter ))
+    {
+        _track_free_arrays( track );
+        memset( track, 0, sizeof( MiniMidi_Track ) );
+        return 1;
+    }
 
-    return midi_file;
+    return 0;
 }
 
-int hook_up_events( MiniMidi_Event *arr, size_t n )
+int MiniMidi_File_swap_tracks( MiniMidi_File *self, const MiniMidi_Header *header, size_t length,
+    MiniMidi_Track *decoded, const size_t *from, size_t n_tracks )
 {
-    sprintf( MiniMidi_Log_log_line, "minimidi.c > hook_up_events() : Entering" );
-    MiniMidi_Log_writeline();
+    MiniMidi_Track *tracks = self->tracks,
+                   *old = (MiniMidi_Track*)malloc( ( self->n_tracks ? self->n_tracks : 1 ) * sizeof( MiniMidi_Track ) );
+    bool *is_kept = (bool*)calloc( self->n_tracks ? self->n_tracks : 1, sizeof( bool ) );
 
+    if (n_tracks != self->n_tracks) tracks = (MiniMidi_Track*)calloc( n_tracks ? n_tracks : 1, sizeof( MiniMidi_Track ) );
 
+    // nothing is touched before everything needed is there
+    if (!old || !is_kept || !tracks)
+    {
+        free( old );
+        free( is_kept );
+        if (tracks != self->tracks) free( tracks );
+        return 1;
+    }
 
-    int hook_counter = 0;
-    MiniMidi_Event *cursor, *cursor2;
+    // kept tracks can move, read them from a copy
+    memcpy( old, self->tracks, self->n_tracks * sizeof( MiniMidi_Track ) );
 
-    for (int i = 0; i < n; i++)
+    for (size_t t = 0; t < n_tracks; t++)
     {
+        if (from[t] != SIZE_MAX) is_kept[ from[t] ] = true;
+    }
+    for (size_t i = 0; i < self->n_tracks; i++)
+    {
+        if (!is_kept[i]) _track_free_arrays( &(old[i]) );
+    }
 
-        cursor = &(arr[i]);
-        
-        // snprintf(log_line, 100, "hook_up_events:: connecting %li", i);
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        tracks[t] = from[t] != SIZE_MAX ? old[ from[t] ] : decoded[t];
+    }
 
-        if (cursor->status_code == MIDI_NOTE_ON)
-        {            
-            // odds are that a NOTE OFF exists for this note
-            for (int j = i; j < n; j++)
-            {
-                cursor2 = &(arr[j]);
-                if ( cursor2->status_code == MIDI_NOTE_OFF && _compare_MidiNote( &(cursor->note), &(cursor2->note) ))
-                {
-                    sprintf( MiniMidi_Log_log_line, "minimidi.c > hook_up_events() > hooking up %i to %i ", i, j );
-                    MiniMidi_Log_writeline();
-                    
-                    hook_counter++;
-                    cursor->next = cursor2;
-                    cursor2->prev = cursor;
+    if (tracks != self->tracks && !_in_arena( &(self->arena), self->tracks )) free( self->tracks );
 
-                    break;
-                }
-            }
-        }
+    *(self->header) = *header;
+    self->length = length;
+    self->tracks = tracks;
+    self->track = tracks;
+    self->n_tracks = n_tracks;
+
+    for (size_t t = 0; t < n_tracks; t++)
+    {
+        tracks[t].total_beats = (tracks[t].total_ticks / self->header->ppqn) + 1;
     }
 
-    return hook_counter;
+    free( old );
+    free( is_kept );
+
+    return _build_tempo_map( self );
 }
 
-// "Class" Methods
-MiniMidi_Header *_midi_header_read( _Byte *file_contents )
+// only the first problem is kept
+static void _parse_error( MiniMidi_Parse_Error *error, MiniMidi_Parse_Status status, size_t track, size_t offset, size_t n_events )
 {
+    if (error->status != MINIMIDI_PARSE_OK) return;
 
-    MiniMidi_Header *retval = (MiniMidi_Header*)malloc( sizeof( struct MiniMidi_Header ) );
-    if (!retval) return NULL; 
-    
-    uint32_t aux_for_chunk_size;
-    _extract_number_from_byte_array( &aux_for_chunk_size, file_contents, 4, 4 );
-    retval->length = (size_t)aux_for_chunk_size;
+    error->status = status;
+    error->track = track;
+    error->offset = offset;
+    error->n_events = n_events;
+}
 
-    _extract_number_from_byte_array( &(retval->format), file_contents, 8, 2 );
-    _extract_number_from_byte_array( &(retval->ntrks), file_contents, 10, 2 );
-    _extract_number_from_byte_array( &(retval->ppqn), file_contents, 12, 2 );
+// walk the MTrk chunks in file order into shapes, and add up the arena bytes they take.
+// chunks of unknown type are skipped. the chunks the parallel decoder takes are only
+// walked to fill in error. returns 1 on a problem when there is no recovering
+static int _scan_tracks( MiniMidi_Header *header, _Byte *buffer, size_t length, bool recover,
+    _Track_Shape **shapes, size_t *n_tracks, size_t *arena_bytes, MiniMidi_Parse_Error *error, bool wants_error )
+{
+    size_t cursor = 8 + header->length,
+           capacity = 0;
+    uint32_t chunk_len;
 
-    return retval;
-}
+    *shapes = NULL;
+    *n_tracks = 0;
+    *arena_bytes = 0;
 
+    while (cursor + 8 <= length)
+    {
+        bool is_track = memcmp( buffer + cursor, "MTrk", 4 ) == 0;
+        size_t len;
 
+        _extract_number_from_byte_array( &chunk_len, buffer, cursor + 4, 4 );
+        len = chunk_len;
 
+        if (cursor + 8 + len > length)
+        {
+            _parse_error( error, MINIMIDI_PARSE_CUT_CHUNK, *n_tracks, cursor, 0 );
+            if (!recover) return 1;
+            if (!is_track) break;
 
-MiniMidi_Track *MiniMidi_Track_read( _Byte *file_content, size_t start_index, size_t total_chunk_len )
-{
-    MiniMidi_Track *track = (MiniMidi_Track*)malloc( sizeof( struct MiniMidi_Track ) );
-    _Byte _track_bin_data[ total_chunk_len ];
+            // a cut off upload still has its front
+            len = length - cursor - 8;
+        }
 
-    if (!track) return NULL; 
+        if (is_track)
+        {
+            if (*n_tracks == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 16;
+                _Track_Shape *arr = (_Track_Shape*)realloc( *shapes, capacity * sizeof( _Track_Shape ) );
+                if (!arr) return 1;
+                *shapes = arr;
+            }
 
-#if DEBUG
-    printf(GREEN "Reading Track Chunk" RESET ": Starting at %lu / %lu Bytes.\n", start_index, total_chunk_len);
-#endif
+            _Track_Shape *shape = &((*shapes)[ *n_tracks ]);
+            memset( shape, 0, sizeof( _Track_Shape ) );
+            shape->start = cursor + 8;
+            shape->length = len;
+            shape->valid_length = len;
 
-    track->length = total_chunk_len;
+            bool in_parallel = _decodes_in_parallel( len, &(shape->n_cores) );
+            if (!in_parallel) shape->n_cores = 0;
 
-    // ESTIMATE: each event is minimum 3 bytes.
-    size_t max_events = track->length / 3;
-    track->event_arr = (MiniMidi_Event*)malloc( max_events * sizeof( MiniMidi_Event ) );
+            if (!in_parallel || wants_error)
+            {
+                MiniMidi_Parse_Status status = _validate_events( buffer + shape->start, len, shape );
 
-    _extract_number_from_byte_array( &(track->length), file_content, start_index + 4, 4 );
-    _get_substring(file_content, _track_bin_data, start_index + 8, track->length, false );
+                if (status != MINIMIDI_PARSE_OK)
+                {
+                    _parse_error( error, status, *n_tracks, shape->start + shape->valid_length, shape->n_events );
+                    if (!recover) return 1;
 
-    //      total                                    + Chunk Id + Chunk len
-    assert( total_chunk_len == ( start_index + track->length + 4        + 4 ));
-    _parse_track_events( track, _track_bin_data );
-    hook_up_events( track->event_arr, track->n_events );
+                    // the front that is known to be good, on this thread
+                    shape->n_cores = 0;
+                }
+            }
+
+            *arena_bytes += _track_arena_bytes( shape );
+            (*n_tracks)++;
+        }
+        cursor += len + 8;
+    }
 
-    return track;
+    return 0;
 }
 
+// fills in the tracks _file_alloc made room for, in file order
+int _read_tracks( MiniMidi_File *self, _Byte *buffer, const _Track_Shape *shapes, const MiniMidi_Filter *filter )
+{
+    for (size_t t = 0; t < self->n_tracks; t++)
+    {
+        MiniMidi_Track *track = &(self->tracks[t]);
 
+        if (_track_read_into( track, buffer, &shapes[t], filter )) return 1;
 
+        track->total_beats = (track->total_ticks / self->header->ppqn) + 1;
+    }
 
+    return 0;
+}
 void MiniMidi_Header_print( MiniMidi_Header *mh )
 {
     printf(BOLDWHITE "HEADER:\n---------------------------\n" RESET);
@@ -662,18 +1737,124 @@ void MiniMidi_File_free( MiniMidi_File *self )
 {
     if (!self) return;
 
-    if (self->filepath) free(self->filepath);
-    if (self->header) free(self->header);
+    MiniMidi_Arena *arena = &(self->arena);
+
+    // whatever grew or was swapped in after parsing lives on the heap.
+    // self->track is the first of self->tracks
+    for (size_t i = 0; self->tracks && i < self->n_tracks; i++) _track_free_arrays( &(self->tracks[i]) );
+
+    if (!_in_arena( arena, self->tracks )) free( self->tracks );
+    if (!_in_arena( arena, self->header )) free( self->header );
+    if (!_in_arena( arena, self->filepath )) free( self->filepath );
+
+    // the block holds self
+    free( arena->base );
+}
+
+size_t MiniMidi_File_bytes( MiniMidi_File *self )
+{
+    MiniMidi_Arena *arena = &(self->arena);
+    size_t bytes = arena->size;
+
+    // the arena is counted whole, what moved out of it on top
+    for (size_t i = 0; i < self->n_tracks; i++)
+    {
+        MiniMidi_Track *track = &(self->tracks[i]);
+
+        if (track->event_arr && !_in_arena( arena, track->event_arr )) bytes += track->capacity * sizeof( MiniMidi_Event );
+        if (track->tempo_arr && !_in_arena( arena, track->tempo_arr )) bytes += track->tempo_capacity * sizeof( MiniMidi_Tempo );
+        if (track->payload_arr && !_in_arena( arena, track->payload_arr )) bytes += track->n_payload_bytes;
+    }
+    if (!_in_arena( arena, self->tracks )) bytes += self->n_tracks * sizeof( MiniMidi_Track );
+
+    return bytes;
+}
+
+// tempo changes come from the conductor track, a file without any plays at 120 BPM.
+// fills in the wall time at every change so lookups don't have to add up segments.
+int _build_tempo_map( MiniMidi_File *self )
+{
+    MiniMidi_Track *conductor = self->track;
+
+    // some format 1 writers put tempo changes on other tracks, fold them in
+    for (size_t i = 1; i < self->n_tracks; i++)
+    {
+        MiniMidi_Track *track = &(self->tracks[i]);
+
+        for (size_t j = 0; j < track->n_tempos; j++)
+        {
+            MiniMidi_Tempo tempo = track->tempo_arr[j];
+            size_t k;
+
+            if (_add_tempo( conductor, tempo.abs_ticks, tempo.usec_per_beat )) return 1;
 
-    if (self->track) {
-        // Free event array if it exists
-        if (self->track->event_arr) {
-            free(self->track->event_arr);
+            // keep it sorted, ties go after what is already there
+            for (k = conductor->n_tempos - 1; k > 0 && conductor->tempo_arr[k-1].abs_ticks > tempo.abs_ticks; k--)
+            {
+                conductor->tempo_arr[k] = conductor->tempo_arr[k-1];
+            }
+            conductor->tempo_arr[k] = tempo;
         }
-        free(self->track);
+        if (!_in_arena( track->arena, track->tempo_arr )) free( track->tempo_arr );
+        track->tempo_arr = NULL;
+        track->n_tempos = 0;
+        track->tempo_capacity = 0;
     }
 
-    free(self);
+    if (!conductor->n_tempos || conductor->tempo_arr[0].abs_ticks > 0)
+    {
+        if (_add_tempo( conductor, 0, MIDI_DEFAULT_USEC_PER_BEAT )) return 1;
+
+        // the default goes first
+        MiniMidi_Tempo dflt = conductor->tempo_arr[ conductor->n_tempos - 1 ];
+        memmove( conductor->tempo_arr + 1, conductor->tempo_arr, (conductor->n_tempos - 1) * sizeof( MiniMidi_Tempo ) );
+        conductor->tempo_arr[0] = dflt;
+    }
+
+    MiniMidi_Tempo *t = conductor->tempo_arr;
+    t[0].usec = 0;
+
+    for (size_t i = 1; i < conductor->n_tempos; i++)
+    {
+        uint64_t dt = t[i].abs_ticks - t[i-1].abs_ticks;
+        t[i].usec = t[i-1].usec
+            + (dt / self->header->ppqn) * t[i-1].usec_per_beat
+            + (dt % self->header->ppqn) * t[i-1].usec_per_beat / self->header->ppqn;
+    }
+
+    return 0;
+}
+
+uint64_t MiniMidi_File_ticks_to_usec( MiniMidi_File *self, uint64_t ticks )
+{
+    MiniMidi_Tempo *t = self->track->tempo_arr;
+    size_t lo = 0, hi = self->track->n_tempos;
+
+    // last tempo change at or before ticks
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (t[mid].abs_ticks <= ticks) lo = mid; else hi = mid;
+    }
+
+    uint64_t dt = ticks - t[lo].abs_ticks;
+    return t[lo].usec
+        + (dt / self->header->ppqn) * t[lo].usec_per_beat
+        + (dt % self->header->ppqn) * t[lo].usec_per_beat / self->header->ppqn;
+}
+
+uint64_t MiniMidi_File_usec_to_ticks( MiniMidi_File *self, uint64_t usec )
+{
+    MiniMidi_Tempo *t = self->track->tempo_arr;
+    size_t lo = 0, hi = self->track->n_tempos;
+
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (t[mid].usec <= usec) lo = mid; else hi = mid;
+    }
+
+    return t[lo].abs_ticks + (usec - t[lo].usec) * self->header->ppqn / t[lo].usec_per_beat;
 }
 
 void MiniMidi_File_print( MiniMidi_File *file )
@@ -684,15 +1865,24 @@ void MiniMidi_File_print( MiniMidi_File *file )
 
 MiniMidi_File * MiniMidi_File_init( char *file_path )
 {
-    MiniMidi_File *retval = create_mini_midi_file( file_path );
-    
-    if (!retval) return NULL; 
+    return MiniMidi_File_init_filtered( file_path, NULL );
+}
+
+MiniMidi_File * MiniMidi_File_init_filtered( char *file_path, const MiniMidi_Filter *filter )
+{
+    return MiniMidi_File_init_checked( file_path, filter, true, NULL );
+}
+
+static MiniMidi_File *_file_parse( const char *file_path, _Byte *buffer, size_t length, const MiniMidi_Filter *filter,
+    bool recover, MiniMidi_Parse_Error *error );
 
+MiniMidi_File * MiniMidi_File_init_checked( char *file_path, const MiniMidi_Filter *filter, bool recover,
+    MiniMidi_Parse_Error *error )
+{
     FILE *fileptr;
     fileptr = fopen( file_path, "rb" );
     _Byte * buffer = 0;
-    size_t length;
-    // retval->logger = l_i;
+    size_t length = 0;
 
     int freadres = 0;
     
@@ -708,25 +1898,114 @@ MiniMidi_File * MiniMidi_File_init( char *file_path )
         {
             // fread returns read bytes.
             freadres = fread (buffer, 1, length, fileptr);
-            printf(GREEN "Success" RESET " Read %i bytes.\n", freadres);
+            sprintf( MiniMidi_Log_log_line, "MiniMidi_File : read %i bytes from %s.", freadres, file_path );
+            MiniMidi_Log_writeline();
         }
 
         fclose (fileptr);
     }
 
+    return _file_parse( file_path, buffer, length, filter, recover, error );
+}
+
+MiniMidi_File * MiniMidi_File_init_fd( int fd, const char *name, const MiniMidi_Filter *filter, bool recover,
+    MiniMidi_Parse_Error *error )
+{
+    off_t end = lseek( fd, 0, SEEK_END );
+    size_t length = end > 0 ? (size_t)end : 0,
+           got = 0;
+    _Byte *buffer = end >= 0 ? malloc( length ? length : 1 ) : NULL;
+
+    // pread, the descriptor's offset is someone else's
+    while (buffer && got < length)
+    {
+        ssize_t n = pread( fd, buffer + got, length - got, got );
+        if (n <= 0) break;
+        got += n;
+    }
+
+    sprintf( MiniMidi_Log_log_line, "MiniMidi_File : read %zu bytes from %s.", got, name );
+    MiniMidi_Log_writeline();
+
+    return _file_parse( name, buffer, got, filter, recover, error );
+}
+
+// buffer is the whole file, taken over. NULL for one that couldn't be read
+static MiniMidi_File *_file_parse( const char *file_path, _Byte *buffer, size_t length, const MiniMidi_Filter *filter,
+    bool recover, MiniMidi_Parse_Error *error )
+{
+    MiniMidi_File *retval = NULL;
+    MiniMidi_Header header;
+    MiniMidi_Parse_Error _error;
+    bool wants_error = error != NULL;
+
+    if (!error) error = &_error;
+    memset( error, 0, sizeof( MiniMidi_Parse_Error ) );
+
+    if (!buffer)
+    {
+        error->status = MINIMIDI_PARSE_UNREADABLE;
+        return NULL;
+    }
+
+    if (length < 14 || memcmp( buffer, "MThd", 4 ) != 0 || _midi_header_read( &header, buffer ) || !header.ppqn)
+    {
+        error->status = MINIMIDI_PARSE_BAD_HEADER;
+        free( buffer );
+        return NULL;
+    }
+
+    // walk every chunk once, then one block for everything
+    _Track_Shape *shapes;
+    size_t arena_bytes, n_tracks;
+    int scan_failed = _scan_tracks( &header, buffer, length, recover, &shapes, &n_tracks, &arena_bytes, error, wants_error );
+
+    if (error->status != MINIMIDI_PARSE_OK)
+    {
+        sprintf( MiniMidi_Log_log_line, "MiniMidi_File : %s: %s in track %zu at byte %zu, after %zu events.",
+            file_path, MiniMidi_Parse_Status_str( error->status ), error->track, error->offset, error->n_events );
+        MiniMidi_Log_writeline();
+    }
+
+    if (!scan_failed && !n_tracks) error->status = MINIMIDI_PARSE_NO_TRACKS;
+    if (!scan_failed && n_tracks) retval = _file_alloc( file_path, n_tracks, arena_bytes );
+    if (!retval)
+    {
+        if (error->status == MINIMIDI_PARSE_OK) error->status = MINIMIDI_PARSE_UNREADABLE;
+        free( shapes );
+        free( buffer );
+        return NULL;
+    }
+
+    *(retval->header) = header;
     retval->length = length;
-    retval->header = _midi_header_read( buffer );
-    retval->track = MiniMidi_Track_read( buffer, 14, length );
-    retval->track->total_beats = (retval->track->total_ticks / retval->header->ppqn) + 1;
-    
+
+    if (_read_tracks( retval, buffer, shapes, filter ))
+    {
+        if (error->status == MINIMIDI_PARSE_OK) error->status = MINIMIDI_PARSE_UNREADABLE;
+        free( shapes );
+        free( buffer );
+        MiniMidi_File_free( retval );
+        return NULL;
+    }
+    free( shapes );
     free( buffer );
 
+    // without a tempo map no tick has a time
+    if (_build_tempo_map( retval ))
+    {
+        if (error->status == MINIMIDI_PARSE_OK) error->status = MINIMIDI_PARSE_UNREADABLE;
+        MiniMidi_File_free( retval );
+        return NULL;
+    }
+
     // logging
-    char note_name[5];
+    char note_name[8];
     
     sprintf( MiniMidi_Log_log_line, 
-        "MiniMidi_File : parsed %s : %ld bytes, got %ld events.",
+        "MiniMidi_File : parsed %s : %zu tracks, first one %ld bytes, got %ld events.",
         file_path,
+        retval->n_tracks,
         retval->track->length,
         retval->track->n_events );
 
@@ -862,7 +2141,10 @@ int MiniMidi_get_events_in_range( MiniMidi_File *self,  MiniMidi_Event_List *lis
     _emptyList(list);
     MiniMidi_Event *evt;
 
-    for (int i = 0; i < self->track->n_events; i++ )
+    // a live capture may be appending, only look at what is published
+    size_t n_events = __atomic_load_n( &(self->track->n_events), __ATOMIC_ACQUIRE );
+
+    for (size_t i = 0; i < n_events; i++ )
     {
         evt = &(self->track->event_arr[i]);
 
@@ -29,6 +29,17 @@ typedef enum {
     MIDI_INVALID         = 0x00   // Invalid status
 } MidiStatusCode;
 
+// Meta event types we look at
+#define MIDI_META_TEMPO         0x51
+#define MIDI_META_END_OF_TRACK  0x2F
+
+// 120 BPM, what a file without tempo events plays at
+#define MIDI_DEFAULT_USEC_PER_BEAT 500000
+
+// NOTE ON / OFF pair up by channel and pitch, one key for each
+#define MINIMIDI_NOTE_KEYS          ( 16 * 128 )
+#define MINIMIDI_NOTE_KEY( evt )    ( ( (evt)->channel & 0x0F ) << 7 | ( (evt)->evt_data[0] & 0x7F ) )
+
 typedef enum Note {
     C  = 0,
     Cs = 1,
@@ -69,8 +80,13 @@ typedef struct MiniMidi_Event
                    abs_ticks;
 
     MidiStatusCode status_code;
-    _Byte          evt_data[2];
-    MidiNote       note;
+    _Byte          channel;     // low nibble of the status byte, 0xF on Meta events
+    _Byte          evt_data[2]; // data bytes, Meta events keep their type in [0]
+    union
+    {
+        MidiNote   note;        // NOTE ON / OFF
+        uint32_t   payload;     // SysEx / Meta: 1 + offset of the rest in the track's payload_arr, 0 for none
+    };
 
     // if a sequence is implied, such as NOTE ON / OFF pair,
     // use this to hook up related events
@@ -78,13 +94,124 @@ typedef struct MiniMidi_Event
 
 } MiniMidi_Event;
 
+typedef struct MiniMidi_Tempo
+{
+    uint64_t abs_ticks,
+             usec;              // wall time at abs_ticks, from the start of the file
+    uint32_t usec_per_beat;
+
+} MiniMidi_Tempo;
+
+/***
+*  * Filters:
+*
+*   Which events a parse keeps. Everything else is skipped once its length
+*   is known and never stored, running status and ticks still follow it,
+*   and tempo changes always go in the tempo map.
+*
+*   NOTE OFFs are kept when they end a NOTE ON that was kept, whatever the
+*   tick window. A note still sounding when the window starts is kept too:
+*   the last NOTE ON of its channel and pitch before the window goes in, at
+*   its own tick. Past the end of the window with no kept note sounding, the
+*   rest of a track is only skimmed for tempo changes: its total_ticks stops
+*   there.
+*/
+typedef struct MiniMidi_Filter
+{
+    uint8_t  classes;       // MINIMIDI_FILTER_CLASS bits
+    uint16_t channels;      // bit per channel, system events don't have one
+    uint64_t start_ticks,   // inclusive
+             end_ticks;
+    _Byte    low_note,      // NOTE ON / OFF and poly aftertouch, inclusive
+             high_note;
+
+} MiniMidi_Filter;
+
+#define MINIMIDI_FILTER_CLASS( status ) ( 1u << ( ( (status) >> 4 ) & 0x07 ) )
+#define MINIMIDI_FILTER_NOTES ( MINIMIDI_FILTER_CLASS( MIDI_NOTE_ON ) | MINIMIDI_FILTER_CLASS( MIDI_NOTE_OFF ) )
+
+/***
+*  * Validation:
+*
+*   Every track chunk is walked once before it is decoded: each delta has
+*   to end within four bytes, each channel event needs a status byte of its
+*   own or a running one and all of its data bytes, each SysEx / Meta event
+*   a length that fits the chunk. The walk also counts events, tempo
+*   changes and SysEx / Meta bytes, so the arrays are sized exactly and
+*   the decoder runs without checking a single byte.
+*
+*   Chunks big enough for the parallel decoder are checked by it instead,
+*   and only walked when it gives up.
+*
+*   The first problem found is reported with its track and file offset.
+*   With recovery a bad track keeps the events before it, a chunk cut off
+*   by the end of the file keeps what is there; otherwise the file isn't
+*   read.
+*/
+typedef enum MiniMidi_Parse_Status
+{
+    MINIMIDI_PARSE_OK = 0,
+    MINIMIDI_PARSE_UNREADABLE,      // couldn't open or allocate
+    MINIMIDI_PARSE_BAD_HEADER,      // no MThd, or a zero ppqn
+    MINIMIDI_PARSE_NO_TRACKS,
+    MINIMIDI_PARSE_CUT_CHUNK,       // chunk length runs past the end of the file
+    MINIMIDI_PARSE_BAD_VLQ,         // longer than four bytes
+    MINIMIDI_PARSE_NO_STATUS,       // data bytes before any status byte
+    MINIMIDI_PARSE_BAD_STATUS,      // 0xF1 - 0xFE, not in a file
+    MINIMIDI_PARSE_CUT_EVENT,       // the chunk ends inside an event
+
+} MiniMidi_Parse_Status;
+
+typedef struct MiniMidi_Parse_Error
+{
+    MiniMidi_Parse_Status   status;
+    size_t                  track,      // MTrk chunk, counted from 0
+                            offset,     // of the event or chunk, in the file
+                            n_events;   // whole events before it in the track
+
+} MiniMidi_Parse_Error;
+
+/***
+*  * Arena:
+*
+*   Everything a parsed file needs for its lifetime is carved from one
+*   block: the file struct itself, header, path, tracks, event and tempo
+*   arrays and SysEx / Meta payloads. It is sized from the validation pass
+*   before anything is decoded, so loading is one malloc and
+*   MiniMidi_File_free is one free.
+*
+*   Arrays that have to grow afterwards move out to the heap; a track
+*   knows which of its arrays are still in the arena.
+*/
+typedef struct MiniMidi_Arena
+{
+    _Byte   *base;
+    size_t  size,
+            used;
+
+} MiniMidi_Arena;
+
 typedef struct MiniMidi_Track
 {
     size_t          length;
-    size_t          n_events;
+    size_t          n_events,
+                    capacity;   // allocated slots in event_arr
     MiniMidi_Event *event_arr;
     size_t          total_ticks,
                     total_beats;
+
+    // tempo changes found in this track, sorted by ticks
+    MiniMidi_Tempo *tempo_arr;
+    size_t          n_tempos,
+                    tempo_capacity;
+
+    // SysEx / Meta events as read after their status byte ( meta type, length, data ),
+    // back to back. only the parsers fill it, for the writer
+    _Byte          *payload_arr;
+    size_t          n_payload_bytes;
+
+    // the file's arena, NULL when the arrays are plain mallocs
+    MiniMidi_Arena *arena;
 } MiniMidi_Track;
 
 
@@ -98,14 +225,93 @@ typedef struct MiniMidi_File
 {
     char                 *filepath;
     MiniMidi_Header      *header;
-    MiniMidi_Track       *track;
+    MiniMidi_Track       *track;    // first track, the conductor in format 1 files
+    MiniMidi_Track       *tracks;   // every MTrk chunk, in file order
+    size_t               n_tracks;
     size_t               length;
 
+    // holds this struct too
+    MiniMidi_Arena       arena;
+
 } MiniMidi_File;
 
 MiniMidi_File       *MiniMidi_File_init( char *file_path );
+// only the events filter keeps, NULL keeps them all
+MiniMidi_File       *MiniMidi_File_init_filtered( char *file_path, const MiniMidi_Filter *filter );
+// error, when not NULL, gets the first problem found, MINIMIDI_PARSE_OK if there is none.
+// without recover any problem fails the read. the other two inits recover
+MiniMidi_File       *MiniMidi_File_init_checked( char *file_path, const MiniMidi_Filter *filter, bool recover,
+                        MiniMidi_Parse_Error *error );
+// the same from a descriptor open for reading, name is only what the file is called
+MiniMidi_File       *MiniMidi_File_init_fd( int fd, const char *name, const MiniMidi_Filter *filter, bool recover,
+                        MiniMidi_Parse_Error *error );
+const char          *MiniMidi_Parse_Status_str( MiniMidi_Parse_Status status );
+// empty file with one empty track, for material that is not read from disk
+MiniMidi_File       *create_mini_midi_file( const char *filepath );
 // void                MiniMidi_File_print( MiniMidi_File *file );
 void                MiniMidi_File_free( MiniMidi_File *file );
+// resident size, the arena and whatever grew out of it
+size_t              MiniMidi_File_bytes( MiniMidi_File *file );
+
+/***
+*  * Reloading:
+*
+*   A file that changed on disk can be read again a track at a time. The
+*   caller decodes the chunks that changed with MiniMidi_Track_read, then
+*   swaps the whole set in with MiniMidi_File_swap_tracks, which keeps the
+*   unchanged tracks' events where they are and can't fail halfway.
+*
+*   Tempo changes of every track are folded into the first one, so when a
+*   track with tempo changes comes or goes, the first track has to be
+*   decoded again along with every other track that has some.
+*/
+// decode the MTrk chunk at start_index of a file buffer into track, its arrays on the heap.
+// filter may be NULL. returns 0 on success
+int                 MiniMidi_Track_read( MiniMidi_Track *track, _Byte *file_content, size_t start_index,
+                        size_t total_chunk_len, const MiniMidi_Filter *filter );
+// track t becomes old track from[t], or decoded[t] when from[t] is SIZE_MAX. old tracks
+// nothing comes from are freed, and the tempo map is built again. returns 0 on success,
+// the file is left as it was otherwise
+int                 MiniMidi_File_swap_tracks( MiniMidi_File *self, const MiniMidi_Header *header, size_t length,
+                        MiniMidi_Track *decoded, const size_t *from, size_t n_tracks );
+
+// conversions through the tempo map
+uint64_t            MiniMidi_File_ticks_to_usec( MiniMidi_File *self, uint64_t ticks );
+uint64_t            MiniMidi_File_usec_to_ticks( MiniMidi_File *self, uint64_t usec );
+
+
+// a filter that keeps everything
+void                MiniMidi_Filter_all( MiniMidi_Filter *filter );
+// "notes,cc:ch=1,10:ticks=0-1920:pitch=36-60", every part optional. classes are notes, on, off,
+// polytouch, cc, program, touch, bend and system. returns 1 if it can't be read
+int                 MiniMidi_Filter_parse( MiniMidi_Filter *filter, const char *spec );
+// class, channel, pitch and, but for NOTE OFFs and the NOTE ONs before it, the tick window.
+// for decoders without note state, they drop the NOTE ONs that end before the window themselves
+bool                MiniMidi_Filter_keeps( const MiniMidi_Filter *filter, const MiniMidi_Event *evt );
+
+// room for n events in event_arr, moving it out of the arena if it has to grow.
+// use these instead of realloc / free on event_arr
+int                 MiniMidi_Track_reserve( MiniMidi_Track *track, size_t n );
+// drop every event and their memory
+void                MiniMidi_Track_release( MiniMidi_Track *track );
+
+// recompute delta ticks, total ticks and NOTE ON / OFF links after an edit
+int                 MiniMidi_Track_relink( MiniMidi_Track *track );
+// the same after only events in [lo, hi) changed, for the pairs of the keys marked in keys
+// ( MINIMIDI_NOTE_KEYS of them ). events at lo and after may have moved, the array itself not
+int                 MiniMidi_Track_relink_span( MiniMidi_Track *track, size_t lo, size_t hi, const bool *keys );
+
+// stable sort by abs_ticks. links are not touched, call relink afterwards
+int                 MiniMidi_Event_sort_by_ticks( MiniMidi_Event *arr, size_t n );
+
+// (re)compute the wall time of every tempo change, adds 120 BPM if the file has none
+int                 _build_tempo_map( MiniMidi_File *self );
+
+// fills in header from the MThd chunk at file_contents
+int                 _midi_header_read( MiniMidi_Header *header, _Byte *file_contents );
+
+// helpers shared with the edit code
+MidiNote            _event_data_bytes_to_note( _Byte event_data_byte );
 
 
 /****************************************************************************************